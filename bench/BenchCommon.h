@@ -0,0 +1,284 @@
+#ifndef BENCHCOMMON_H
+#define BENCHCOMMON_H
+
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+#include "TcpClient.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * bench/下各个压测程序共用的部分：延迟直方图、loopback上的客户端组和参数解析
+ * 每个结果输出为一行"<bench> key=value ..."，方便脚本比较前后两次的数据
+ */
+using BenchClock = std::chrono::steady_clock;
+
+inline int64_t benchNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(BenchClock::now().time_since_epoch()).count();
+}
+
+inline void benchLogOutput(const char *msg, size_t len)
+{
+    ::fwrite(msg, 1, len, stderr);
+}
+
+// 只保留ERROR日志并写到stderr，stdout上只有结果行
+inline void benchInit()
+{
+    Logger::instance().setLogLevel(ERROR);
+    Logger::instance().setOutput(benchLogOutput);
+}
+
+inline std::atomic_int &benchFailures()
+{
+    static std::atomic_int failures(0);
+    return failures;
+}
+
+// 自检结果，打印为"selftest <name>=ok|FAIL ..."；有失败时main返回非0，ctest据此判断
+inline const char *benchCheck(bool ok)
+{
+    if (!ok)
+    {
+        benchFailures().fetch_add(1);
+    }
+    return ok ? "ok" : "FAIL";
+}
+
+inline int benchExitCode()
+{
+    return benchFailures().load() == 0 ? 0 : 1;
+}
+
+// 轮询等待条件成立，超时返回false
+inline bool benchWaitFor(const std::function<bool()> &pred, double seconds)
+{
+    auto deadline = BenchClock::now() + std::chrono::duration<double>(seconds);
+    while (!pred())
+    {
+        if (BenchClock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// "1,2,4"解析为{1, 2, 4}，支持k/m后缀
+inline std::vector<int> benchParseList(const char *s)
+{
+    std::vector<int> values;
+    while (*s != '\0')
+    {
+        char *end;
+        long v = ::strtol(s, &end, 10);
+        if (*end == 'k' || *end == 'K')
+        {
+            v *= 1024;
+            ++end;
+        }
+        else if (*end == 'm' || *end == 'M')
+        {
+            v *= 1024 * 1024;
+            ++end;
+        }
+        if (end == s)
+        {
+            break;
+        }
+        values.push_back(static_cast<int>(v));
+        s = *end == ',' ? end + 1 : end;
+    }
+    return values;
+}
+
+/**
+ * @brief HdrHistogram风格的延迟直方图，单位纳秒
+ *        每个2的幂区间分成128个线性桶，相对误差不超过1/128，可以记录到2^40ns（约18分钟）
+ *        不是线程安全的，每个线程记录自己的直方图，最后merge
+ */
+class Histogram
+{
+public:
+    Histogram() : counts_(kBuckets, 0), count_(0), sum_(0), min_(INT64_MAX), max_(0) {}
+
+    void record(int64_t ns)
+    {
+        ns = std::max<int64_t>(ns, 0);
+        ++counts_[std::min(bucketIndex(ns), kBuckets - 1)];
+        ++count_;
+        sum_ += ns;
+        min_ = std::min(min_, ns);
+        max_ = std::max(max_, ns);
+    }
+
+    void merge(const Histogram &other)
+    {
+        for (int i = 0; i < kBuckets; ++i)
+        {
+            counts_[i] += other.counts_[i];
+        }
+        count_ += other.count_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    // p为0~100，返回落在该分位的桶的上界（不超过实际最大值）
+    int64_t percentile(double p) const
+    {
+        if (count_ == 0)
+        {
+            return 0;
+        }
+        uint64_t target = std::max<uint64_t>(static_cast<uint64_t>(::ceil(p / 100.0 * count_)), 1);
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; ++i)
+        {
+            seen += counts_[i];
+            if (seen >= target)
+            {
+                return std::min(bucketUpper(i), max_);
+            }
+        }
+        return max_;
+    }
+
+    uint64_t count() const { return count_; }
+    int64_t min() const { return count_ == 0 ? 0 : min_; }
+    int64_t max() const { return max_; }
+    double mean() const { return count_ == 0 ? 0 : static_cast<double>(sum_) / count_; }
+
+private:
+    static const int kSubBits = 7;
+    static const int kSubBuckets = 1 << kSubBits;
+    static const int kBuckets = (40 - kSubBits + 1) * kSubBuckets;
+
+    static int bucketIndex(int64_t v)
+    {
+        if (v < kSubBuckets)
+        {
+            return static_cast<int>(v);
+        }
+        int magnitude = 63 - __builtin_clzll(static_cast<uint64_t>(v));
+        int shift = magnitude - kSubBits;
+        return (shift + 1) * kSubBuckets + static_cast<int>((v >> shift) - kSubBuckets);
+    }
+    static int64_t bucketUpper(int index)
+    {
+        int block = index >> kSubBits;
+        int64_t sub = index & (kSubBuckets - 1);
+        if (block == 0)
+        {
+            return sub;
+        }
+        int shift = block - 1;
+        return ((kSubBuckets + sub + 1) << shift) - 1;
+    }
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_;
+    int64_t sum_;
+    int64_t min_;
+    int64_t max_;
+};
+
+/**
+ * @brief 负载生成端：若干个client loop线程，连接平均分配到各个loop上
+ *        setup在加入连接时调用，用来设置回调；第二个参数是连接所在loop的下标，用于按线程记录统计
+ *        析构时在各自的loop线程中销毁TcpClient，然后退出loop线程
+ */
+class ClientGroup
+{
+public:
+    using Setup = std::function<void(TcpClient *client, int loopIndex)>;
+
+    explicit ClientGroup(int threads)
+    {
+        for (int i = 0; i < std::max(threads, 1); ++i)
+        {
+            threads_.emplace_back(new EventLoopThread(EventLoopThread::ThreadInitCallback(), "benchclient" + std::to_string(i)));
+            loops_.push_back(threads_.back()->startLoop());
+        }
+    }
+
+    ~ClientGroup()
+    {
+        for (size_t i = 0; i < loops_.size(); ++i)
+        {
+            std::promise<void> done;
+            loops_[i]->runInLoop([&]() {
+                for (auto &client : clients_)
+                {
+                    if (client && client->getLoop() == loops_[i])
+                    {
+                        client.reset();
+                    }
+                }
+                done.set_value();
+            });
+            done.get_future().wait();
+        }
+    }
+
+    void connect(const InetAddress &serverAddr, int connections, const Setup &setup)
+    {
+        for (int i = 0; i < connections; ++i)
+        {
+            int loopIndex = i % static_cast<int>(loops_.size());
+            clients_.emplace_back(new TcpClient(loops_[loopIndex], serverAddr, "BenchClient" + std::to_string(i)));
+            setup(clients_.back().get(), loopIndex);
+            clients_.back()->connect();
+        }
+    }
+
+    void disconnect()
+    {
+        for (auto &client : clients_)
+        {
+            client->disconnect();
+        }
+    }
+
+    int threads() const { return static_cast<int>(loops_.size()); }
+
+private:
+    std::vector<std::unique_ptr<EventLoopThread>> threads_;
+    std::vector<EventLoop *> loops_;
+    std::vector<std::unique_ptr<TcpClient>> clients_;
+};
+
+// 每个client loop线程一个计数器，只有该线程写
+struct alignas(64) BenchCounter
+{
+    BenchCounter() : value(0) {}
+    void add(int64_t n) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    std::atomic<int64_t> value;
+};
+
+inline int64_t benchSum(const std::vector<BenchCounter> &counters)
+{
+    int64_t sum = 0;
+    for (const BenchCounter &c : counters)
+    {
+        sum += c.value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+#endif
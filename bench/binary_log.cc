@@ -0,0 +1,270 @@
+#include "BenchCommon.h"
+#include "AsyncLogger.h"
+#include "BinaryLogger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * 二进制日志和文本日志前端开销的对比：threads个线程各写lines行，统计调用方每行的耗时
+ *   mode=async_text AsyncLogger，前端格式化以后拷贝到内存
+ *   mode=binary     BinaryLogger，前端只拷贝格式串id和参数
+ * 最后把二进制日志解码，和snprintf得到的文本逐行比较
+ * 用法: ./bench_binary_log [dir] [threads] [lines]
+ */
+using Clock = std::chrono::steady_clock;
+
+static AsyncLogger *g_asyncLogger = nullptr;
+
+static void asyncOutput(const char *msg, size_t len)
+{
+    g_asyncLogger->append(msg, len);
+}
+
+static void asyncFlush()
+{
+    g_asyncLogger->flush();
+}
+
+static const char *const kPayload = "abcdefghijklmnopqrstuvwxyz0123456789";
+
+template <typename Func>
+static std::vector<double> runThreads(int threads, int lines, Func func)
+{
+    std::vector<std::vector<double>> samples(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([t, lines, &samples, &func]() {
+            std::vector<double> &mine = samples[t];
+            mine.reserve(lines);
+            for (int i = 0; i < lines; ++i)
+            {
+                auto start = Clock::now();
+                func(t, i);
+                mine.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+            }
+        });
+    }
+    for (std::thread &w : workers)
+    {
+        w.join();
+    }
+    std::vector<double> all;
+    for (auto &s : samples)
+    {
+        all.insert(all.end(), s.begin(), s.end());
+    }
+    std::sort(all.begin(), all.end());
+    return all;
+}
+
+static void report(const char *mode, int threads, const std::vector<double> &ns, double seconds)
+{
+    double sum = 0;
+    for (double v : ns)
+    {
+        sum += v;
+    }
+    printf("bench_binary_log mode=%s threads=%d lines=%zu avg_ns=%.0f p50_ns=%.0f p99_ns=%.0f max_ns=%.0f lines_per_sec=%.0f\n",
+           mode, threads, ns.size(), sum / ns.size(), ns[ns.size() / 2], ns[ns.size() * 99 / 100], ns.back(),
+           ns.size() / seconds);
+}
+
+// dir下以prefix开头的文件，按文件名排序
+static std::vector<std::string> listFiles(const std::string &dir, const std::string &prefix)
+{
+    std::vector<std::string> files;
+    DIR *d = ::opendir(dir.c_str());
+    if (d == nullptr)
+    {
+        return files;
+    }
+    while (dirent *entry = ::readdir(d))
+    {
+        if (::strncmp(entry->d_name, prefix.c_str(), prefix.size()) == 0)
+        {
+            files.push_back(dir + "/" + entry->d_name);
+        }
+    }
+    ::closedir(d);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// 解码所有文件，返回每行去掉前缀（级别、位置和时间）以后的内容
+static long decodeFiles(const std::vector<std::string> &files, bool sortByTime, std::vector<std::string> *messages)
+{
+    long total = 0;
+    for (const std::string &file : files)
+    {
+        FILE *in = ::fopen(file.c_str(), "rb");
+        char *text = nullptr;
+        size_t textLen = 0;
+        FILE *out = ::open_memstream(&text, &textLen);
+        long n = BinaryLogger::decode(in, out, sortByTime);
+        ::fclose(in);
+        ::fclose(out);
+        if (n < 0)
+        {
+            ::free(text);
+            return -1;
+        }
+        total += n;
+        // "[INFO]file:line:func: 年/月/日 时:分:秒.微秒 内容"，内容从第三个空格之后开始
+        for (char *line = text; line < text + textLen;)
+        {
+            char *end = static_cast<char *>(::memchr(line, '\n', text + textLen - line));
+            char *msg = line;
+            for (int spaces = 0; spaces < 3 && msg < end; ++msg)
+            {
+                spaces += *msg == ' ';
+            }
+            messages->emplace_back(msg, end);
+            line = end + 1;
+        }
+        ::free(text);
+    }
+    return total;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string dir = argc > 1 ? argv[1] : "/tmp/blogbench";
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    int lines = argc > 3 ? atoi(argv[3]) : 200000;
+    ::mkdir(dir.c_str(), 0755);
+    std::string pid = std::to_string(::getpid());
+
+    std::string basename = "text" + pid;
+    g_asyncLogger = new AsyncLogger(dir + "/" + basename, 1024 * 1024 * 1024);
+    g_asyncLogger->start();
+    Logger::instance().setOutput(asyncOutput);
+    Logger::instance().setFlush(asyncFlush);
+    auto start = Clock::now();
+    std::vector<double> ns = runThreads(threads, lines, [](int t, int i) {
+        LOG_INFO("bench_binary_log thread=%d line=%d payload=%s\n", t, i, kPayload);
+    });
+    report("async_text", threads, ns, std::chrono::duration<double>(Clock::now() - start).count());
+    Logger::instance().flush();
+    // 之后BinaryLogger自己的报错写到stderr，不能再交给已经删除的AsyncLogger
+    Logger::instance().setOutput(benchLogOutput);
+    Logger::instance().setFlush([]() { ::fflush(stderr); });
+    g_asyncLogger->stop();
+    delete g_asyncLogger;
+    g_asyncLogger = nullptr;
+
+    // 每个线程的环形缓冲区8M，足够后台线程跟上
+    BinaryLogger &blog = BinaryLogger::instance();
+    basename = "binary" + pid;
+    blog.start(dir + "/" + basename, 1024 * 1024 * 1024, 8 * 1024 * 1024);
+    start = Clock::now();
+    ns = runThreads(threads, lines, [](int t, int i) {
+        BLOG_INFO("bench_binary_log thread=%d line=%d payload=%s", t, i, kPayload);
+    });
+    report("binary", threads, ns, std::chrono::duration<double>(Clock::now() - start).count());
+    blog.flush();
+    std::vector<std::string> messages;
+    long decoded = decodeFiles(listFiles(dir, basename + "."), false, &messages);
+    uint64_t dropped = blog.droppedRecords();
+    printf("selftest binary_count=%s decoded=%ld dropped=%llu bytes=%llu\n",
+           benchCheck(decoded + static_cast<long>(dropped) == static_cast<long>(threads) * lines),
+           decoded, (unsigned long long)dropped, (unsigned long long)blog.writtenBytes());
+
+    // 各种参数类型解码以后和snprintf的结果一致
+    std::string name = "conn-127.0.0.1:8000#3";
+    const char *nullString = nullptr;
+    int marker = 0;
+    std::vector<std::string> expected;
+    char buf[256];
+    size_t firstLine = messages.size();
+    messages.clear();
+    for (int i = 0; i < 3; ++i)
+    {
+        BLOG_INFO("conn=%s read %zd bytes, ratio=%.3f %5.1f%% ptr=%p", name.c_str(), static_cast<ssize_t>(-i), 1.0 / 3 + i, 12.345 * i, static_cast<void *>(&marker));
+        snprintf(buf, sizeof buf, "conn=%s read %zd bytes, ratio=%.3f %5.1f%% ptr=%p", name.c_str(), static_cast<ssize_t>(-i), 1.0 / 3 + i, 12.345 * i, static_cast<void *>(&marker));
+        expected.push_back(buf);
+        BLOG_ERROR("fd=%d events=0x%x %-6s| %*d %lu %c %s", i, 0x19u + i, "left", 4, i, 18446744073709551615UL, 'A' + i, nullString);
+        snprintf(buf, sizeof buf, "fd=%d events=0x%x %-6s| %*d %lu %c %s", i, 0x19u + i, "left", 4, i, 18446744073709551615UL, 'A' + i, "(null)");
+        expected.push_back(buf);
+        BLOG_INFO("%s", name.c_str());
+        expected.push_back(name);
+        // 整数按64位保存，解码时要按printf读取的宽度截断
+        BLOG_INFO("%x %u %o %hhx %hd %hhu %lx %d", -1 - i, -1 - i, -1, 0x1ff + i, 70000 + i, 300 + i, -1L, -i);
+        snprintf(buf, sizeof buf, "%x %u %o %hhx %hd %hhu %lx %d", -1 - i, -1 - i, -1, 0x1ff + i, 70000 + i, 300 + i, -1L, -i);
+        expected.push_back(buf);
+    }
+    blog.flush();
+    decodeFiles(listFiles(dir, basename + "."), true, &messages);
+    bool same = messages.size() == firstLine + expected.size() &&
+                std::equal(expected.begin(), expected.end(), messages.begin() + firstLine);
+    printf("selftest decode=%s lines=%zu\n", benchCheck(same), messages.size() - firstLine);
+    if (!same && messages.size() >= expected.size())
+    {
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            printf("  expected: %s\n  decoded:  %s\n", expected[i].c_str(), messages[messages.size() - expected.size() + i].c_str());
+        }
+    }
+
+    // 环形缓冲区很小、后台线程来不及写时丢弃并计数，调用方不等待
+    blog.stop();
+    basename = "small" + pid;
+    blog.start(dir + "/" + basename, 1024 * 1024 * 1024, 4096);
+    int burst = 100000;
+    std::thread([burst]() {
+        for (int i = 0; i < burst; ++i)
+        {
+            BLOG_DEBUG("burst i=%d payload=%s", i, kPayload);
+            BLOG_INFO("burst i=%d payload=%s", i, kPayload);
+        }
+    }).join();
+    blog.flush();
+    messages.clear();
+    decoded = decodeFiles(listFiles(dir, basename + "."), false, &messages);
+    dropped = blog.droppedRecords();
+    bool reported = std::any_of(messages.begin(), messages.end(), [](const std::string &msg) {
+        return msg.find("records in total") != std::string::npos; // "[DROPPED] tid=... dropped=... records in total"
+    });
+    printf("selftest drop=%s decoded=%ld dropped=%llu\n",
+           benchCheck(decoded + static_cast<long>(dropped) == burst && dropped > 0 && reported),
+           decoded, (unsigned long long)dropped);
+
+    // 滚动以后每个文件都能单独解码
+    blog.stop();
+    basename = "roll" + pid;
+    blog.start(dir + "/" + basename, 64 * 1024);
+    int rollLines = 0;
+    start = Clock::now();
+    while (std::chrono::duration<double>(Clock::now() - start).count() < 2.2)
+    {
+        for (int i = 0; i < 2000; ++i)
+        {
+            BLOG_INFO("roll line=%d payload=%s", rollLines++, kPayload);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    blog.stop();
+    std::vector<std::string> files = listFiles(dir, basename + ".");
+    long total = 0;
+    bool eachOk = true;
+    for (const std::string &file : files)
+    {
+        messages.clear();
+        long n = decodeFiles({file}, false, &messages);
+        eachOk = eachOk && n >= 0;
+        total += n;
+    }
+    printf("selftest roll=%s files=%zu lines=%ld expected=%d\n",
+           benchCheck(files.size() >= 2 && eachOk && total == rollLines), files.size(), total, rollLines);
+    return benchExitCode();
+}
@@ -0,0 +1,151 @@
+#include "BenchCommon.h"
+#include "TcpServer.h"
+#include "LengthFieldCodec.h"
+#include "Crc32c.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+/**
+ * 分帧编解码器的测试和压测
+ * 1. CRC32C的计算速度
+ * 2. 错误帧（超长、校验失败）会让服务端关闭连接
+ * 3. 客户端和echo服务端之间保持window个帧在途，统计每秒帧数
+ * 自检失败时返回非0
+ * 用法: ./bench_codec [port] [frameSize] [window] [seconds] [checksum 0|1]
+ */
+static double crcThroughput(size_t len, int rounds)
+{
+    std::string data(len, 'x');
+    uint32_t crc = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i)
+    {
+        crc = Crc32c::extend(crc, data.data(), data.size());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return crc == 0 ? 0 : len * rounds / seconds / 1024 / 1024 / 1024;
+}
+
+// 用阻塞socket发送一段原始字节，返回服务端是否关闭了连接
+static bool rawSendExpectClose(uint16_t port, const std::string &bytes)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    timeval tv{2, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    bool closed = false;
+    if (::connect(fd, (sockaddr *)&addr, sizeof addr) == 0 && ::write(fd, bytes.data(), bytes.size()) == (ssize_t)bytes.size())
+    {
+        char c;
+        closed = ::read(fd, &c, 1) <= 0;
+    }
+    ::close(fd);
+    return closed;
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8004;
+    int frameSize = argc > 2 ? atoi(argv[2]) : 1024;
+    int window = argc > 3 ? atoi(argv[3]) : 32;
+    double seconds = argc > 4 ? atof(argv[4]) : 3.0;
+    bool checksum = argc > 5 ? atoi(argv[5]) != 0 : true;
+
+    printf("bench_codec test=crc32c hardware=%d gib_per_sec=%.2f\n", Crc32c::hardwareAccelerated(), crcThroughput(64 * 1024, 20000));
+    // RFC 3720的测试向量
+    printf("selftest crc32c_vector=%s\n", benchCheck(Crc32c::value("123456789", 9) == 0xe3069283));
+
+    EventLoopThread serverThread(EventLoopThread::ThreadInitCallback(), "server");
+    EventLoop *serverLoop = serverThread.startLoop();
+    LengthFieldCodec serverCodec(
+        [&](const TcpConnectionPtr &conn, std::string_view payload, Timestamp) {
+            serverCodec.send(conn, payload);
+        },
+        checksum, 1024 * 1024);
+    std::unique_ptr<TcpServer> server(new TcpServer(serverLoop, InetAddress(port), "CodecEcho"));
+    server->setConnectionCallback([](const TcpConnectionPtr &) {});
+    server->setMessageCallback(std::bind(&LengthFieldCodec::onMessage, &serverCodec,
+                                         std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    std::promise<void> started;
+    serverLoop->runInLoop([&]() {
+        server->start();
+        started.set_value();
+    });
+    started.get_future().wait();
+
+    // 长度头超过maxFrameSize，服务端应该不等后续数据直接断开
+    std::string tooLarge(4, '\0');
+    uint32_t be32 = htonl(64 * 1024 * 1024);
+    ::memcpy(&tooLarge[0], &be32, 4);
+    printf("selftest frame_too_large=%s\n", benchCheck(rawSendExpectClose(port, tooLarge)));
+    if (checksum)
+    {
+        std::string corrupt(4 + 5 + 4, '\0');
+        be32 = htonl(5 + 4);
+        ::memcpy(&corrupt[0], &be32, 4);
+        ::memcpy(&corrupt[4], "hello", 5); // 校验值全为0，不可能匹配
+        printf("selftest checksum_mismatch=%s\n", benchCheck(rawSendExpectClose(port, corrupt)));
+    }
+
+    EventLoop loop;
+    std::atomic<int64_t> frames(0);
+    const std::string payload(frameSize, 'x');
+    LengthFieldCodec clientCodec(
+        [&](const TcpConnectionPtr &conn, std::string_view echoed, Timestamp) {
+            if (echoed.size() == payload.size())
+            {
+                ++frames;
+            }
+            clientCodec.send(conn, echoed);
+        },
+        checksum, 1024 * 1024);
+    TcpClient client(&loop, InetAddress(port), "CodecClient");
+    client.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            for (int i = 0; i < window; ++i)
+            {
+                clientCodec.send(conn, payload);
+            }
+        }
+    });
+    client.setMessageCallback(std::bind(&LengthFieldCodec::onMessage, &clientCodec,
+                                        std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    client.connect();
+
+    auto start = std::chrono::steady_clock::now();
+    loop.runAfter(seconds, [&]() {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("bench_codec frame_size=%d window=%d checksum=%d seconds=%.3f frames=%lld frames_per_sec=%.0f mib_per_sec=%.1f\n",
+               frameSize, window, checksum, elapsed, (long long)frames.load(),
+               frames / elapsed, frames * (double)frameSize / elapsed / 1024 / 1024);
+        printf("selftest echo=%s frames=%lld\n", benchCheck(frames > 0), (long long)frames.load());
+        client.disconnect();
+        loop.quit();
+    });
+    loop.loop();
+
+    std::promise<void> done;
+    // TcpServer要在它的loop线程中析构
+    serverLoop->runInLoop([&]() {
+        server.reset();
+        done.set_value();
+    });
+    done.get_future().wait();
+    return benchExitCode();
+}
@@ -0,0 +1,160 @@
+#include "BenchCommon.h"
+#include "ComputeThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * 计算线程池压测
+ * 1. 吞吐：提交大量CPU任务，统计每秒完成的任务数
+ * 2. io loop延迟：io loop上有CPU密集任务时，测量投递到loop的回调的调度延迟
+ *    对比任务直接在loop中执行和卸载到计算线程池两种方式
+ * 3. 自检：相同key的任务按提交顺序执行，done也按顺序回到loop
+ * 用法: ./bench_compute [workers] [tasks] [workUs]
+ */
+using Clock = std::chrono::steady_clock;
+
+static void burnCpu(int us)
+{
+    auto end = Clock::now() + std::chrono::microseconds(us);
+    volatile uint64_t x = 0;
+    while (Clock::now() < end)
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            x = x * 31 + i;
+        }
+    }
+}
+
+static void benchThroughput(int workers, int tasks, int workUs)
+{
+    ComputeThreadPool pool;
+    pool.setThreadNum(workers);
+    pool.start();
+
+    std::atomic_int done(0);
+    auto start = Clock::now();
+    for (int i = 0; i < tasks; ++i)
+    {
+        pool.run([&done, workUs]() {
+            burnCpu(workUs);
+            ++done;
+        });
+    }
+    while (done.load() < tasks)
+    {
+        std::this_thread::yield();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    pool.stop();
+    printf("bench_compute test=throughput workers=%d tasks=%d work_us=%d seconds=%.3f tasks_per_sec=%.0f\n",
+           workers, tasks, workUs, seconds, tasks / seconds);
+}
+
+// offload为false时CPU任务直接在loop中执行，为true时卸载到计算线程池，完成后回到loop
+static void benchLoopLatency(int workers, int tasks, int workUs, bool offload)
+{
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+    ComputeThreadPool pool;
+    pool.setThreadNum(workers);
+    pool.start();
+
+    std::atomic_int done(0);
+    for (int i = 0; i < tasks; ++i)
+    {
+        loop->runInLoop([&, i]() {
+            if (offload)
+            {
+                pool.runOrdered(i % 64, []() {}, loop, [&done]() { ++done; });
+                pool.run([workUs]() { burnCpu(workUs); }, loop, [&done]() { ++done; });
+            }
+            else
+            {
+                burnCpu(workUs);
+                done += 2;
+            }
+        });
+    }
+
+    // 计算任务进行期间，测量一个空回调从投递到在loop中执行的延迟
+    std::vector<int64_t> latencies;
+    while (done.load() < tasks * 2)
+    {
+        std::atomic_bool ran(false);
+        auto posted = Clock::now();
+        int64_t ns = 0;
+        loop->queueInLoop([&]() {
+            ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - posted).count();
+            ran = true;
+        });
+        while (!ran.load())
+        {
+            std::this_thread::yield();
+        }
+        latencies.push_back(ns);
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    pool.stop();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto pct = [&latencies](double p) {
+        return latencies.empty() ? 0 : latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+    };
+    printf("bench_compute test=loop_latency mode=%s workers=%d tasks=%d work_us=%d samples=%zu p50_us=%.1f p99_us=%.1f max_us=%.1f\n",
+           offload ? "offload" : "inline", workers, tasks, workUs, latencies.size(),
+           pct(0.50) / 1000.0, pct(0.99) / 1000.0, latencies.empty() ? 0.0 : latencies.back() / 1000.0);
+}
+
+static void checkOrdered(int workers)
+{
+    const int kKeys = 8;
+    const int kTasks = 20000;
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+    ComputeThreadPool pool;
+    pool.setThreadNum(workers);
+    pool.start();
+
+    // 同一个key的任务只在一个worker中串行执行，每个key一个序列，不需要加锁
+    std::vector<std::vector<int>> executed(kKeys);
+    std::vector<std::vector<int>> completed(kKeys); // 只在loop线程中修改，done计满以后才在这里读
+    std::atomic_int done(0);
+    for (int i = 0; i < kTasks; ++i)
+    {
+        int key = i % kKeys;
+        pool.runOrdered(key, [&executed, key, i]() { executed[key].push_back(i); },
+                        loop, [&completed, &done, key, i]() {
+                            completed[key].push_back(i);
+                            ++done;
+                        });
+    }
+    bool ok = benchWaitFor([&]() { return done == kTasks; }, 30);
+    pool.stop();
+    for (int key = 0; ok && key < kKeys; ++key)
+    {
+        ok = executed[key].size() == static_cast<size_t>(kTasks / kKeys)
+            && std::is_sorted(executed[key].begin(), executed[key].end())
+            && completed[key] == executed[key];
+    }
+    printf("selftest ordered=%s done=%d\n", benchCheck(ok), done.load());
+}
+
+int main(int argc, char *argv[])
+{
+    int workers = argc > 1 ? atoi(argv[1]) : 4;
+    int tasks = argc > 2 ? atoi(argv[2]) : 20000;
+    int workUs = argc > 3 ? atoi(argv[3]) : 50;
+
+    benchThroughput(workers, tasks, workUs);
+    benchLoopLatency(workers, tasks / 10, workUs * 10, false);
+    benchLoopLatency(workers, tasks / 10, workUs * 10, true);
+    checkOrdered(workers);
+    return benchExitCode();
+}
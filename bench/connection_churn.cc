@@ -0,0 +1,117 @@
+#include "BenchCommon.h"
+#include "TcpServer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+/**
+ * 连接建立/断开的速率：每个客户端线程循环执行 connect -> 发1字节 -> 收到回显和服务端的FIN -> 关闭，
+ * 测的是服务端accept、分配subloop、建立和销毁TcpConnection的整条路径，同时记录单次建连加一次回显的延迟
+ * 由服务端先关闭，TIME_WAIT留在服务端，客户端不会因此耗尽本地端口
+ * 用法: ./bench_connection_churn [ioThreadsList=0,1,4] [clientThreads=4] [seconds=3] [port=9300]
+ * 输出: bench_connection_churn io_threads=.. connects_per_sec=.. failed=.. p50_us=.. p99_us=.. p999_us=..
+ */
+static void churn(uint16_t port, const std::atomic_bool *running, Histogram *histogram, std::atomic<long> *failed)
+{
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    timeval timeout = {1, 0}; // 服务端没有回显时不会一直阻塞
+
+    while (running->load(std::memory_order_relaxed))
+    {
+        int64_t start = benchNowNs();
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+        char c = 'c';
+        bool ok = fd >= 0 && ::connect(fd, (sockaddr *)&addr, sizeof addr) == 0 &&
+                  ::write(fd, &c, 1) == 1 && ::read(fd, &c, 1) == 1 && ::read(fd, &c, 1) == 0;
+        if (ok)
+        {
+            histogram->record(benchNowNs() - start);
+        }
+        else
+        {
+            failed->fetch_add(1, std::memory_order_relaxed);
+        }
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+    }
+}
+
+static void runOnce(uint16_t port, int ioThreads, int clientThreads, double seconds)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "ConnectionChurn");
+    server.setThreadNum(ioThreads);
+    std::atomic<long> accepted(0);
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            accepted.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf);
+        conn->shutdown();
+    });
+    server.start();
+
+    std::thread driver([&]() {
+        std::atomic_bool running(true);
+        std::atomic<long> failed(0);
+        std::vector<Histogram> histograms(clientThreads);
+        std::vector<std::thread> threads;
+        auto start = BenchClock::now();
+        for (int i = 0; i < clientThreads; ++i)
+        {
+            threads.emplace_back(churn, port, &running, &histograms[i], &failed);
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        running = false;
+        for (std::thread &t : threads)
+        {
+            t.join();
+        }
+        double elapsed = std::chrono::duration<double>(BenchClock::now() - start).count();
+
+        Histogram total;
+        for (const Histogram &h : histograms)
+        {
+            total.merge(h);
+        }
+        printf("bench_connection_churn io_threads=%d client_threads=%d seconds=%.3f connects=%llu connects_per_sec=%.0f failed=%ld server_accepted=%ld p50_us=%.1f p99_us=%.1f p999_us=%.1f max_us=%.1f\n",
+               ioThreads, clientThreads, elapsed, (unsigned long long)total.count(), total.count() / elapsed,
+               failed.load(), accepted.load(), total.percentile(50) / 1e3, total.percentile(99) / 1e3,
+               total.percentile(99.9) / 1e3, total.max() / 1e3);
+        fflush(stdout);
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+}
+
+int main(int argc, char *argv[])
+{
+    benchInit();
+    std::vector<int> ioThreadsList = benchParseList(argc > 1 ? argv[1] : "0,1,4");
+    int clientThreads = std::max(argc > 2 ? atoi(argv[2]) : 4, 1);
+    double seconds = argc > 3 ? atof(argv[3]) : 3.0;
+    uint16_t port = argc > 4 ? static_cast<uint16_t>(atoi(argv[4])) : 9300;
+
+    for (int ioThreads : ioThreadsList)
+    {
+        runOnce(port++, ioThreads, clientThreads, seconds);
+    }
+    return 0;
+}
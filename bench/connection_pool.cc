@@ -0,0 +1,151 @@
+#include "BenchCommon.h"
+#include "TcpServer.h"
+#include "ConnectionPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * 连接池pipelining压测：后端是按行回显的服务器，请求格式为"<id> <payload>\n"
+ * 每个客户端loop拥有自己的ConnectionPool，保持window个未完成请求，统计QPS
+ * 自检：每个响应都和请求的id对应，运行期间没有失败的请求
+ * 用法: ./bench_connection_pool [port] [clientLoops] [connsPerLoop] [window] [payloadSize] [seconds] [fifo|id]
+ */
+struct Driver
+{
+    ConnectionPool *pool = nullptr;
+    std::string payload;
+    uint64_t nextId = 0;
+    int64_t completed = 0;
+    int64_t failed = 0;
+    int64_t mismatched = 0; // 响应的id和请求的id不同
+    bool running = true;
+};
+
+static ConnectionPool::ParseResult parseLine(Buffer *buf, std::string *response, uint64_t *requestId)
+{
+    const char *eol = static_cast<const char *>(::memchr(buf->peek(), '\n', buf->readableBytes()));
+    if (eol == nullptr)
+    {
+        return ConnectionPool::kIncomplete;
+    }
+    char *end = nullptr;
+    *requestId = ::strtoull(buf->peek(), &end, 10);
+    if (end == buf->peek())
+    {
+        return ConnectionPool::kError;
+    }
+    *response = buf->retrieveAsString(eol - buf->peek() + 1);
+    return ConnectionPool::kComplete;
+}
+
+static void issue(Driver *driver)
+{
+    uint64_t id = driver->nextId++;
+    std::string request = std::to_string(id) + " " + driver->payload + "\n";
+    driver->pool->send(request, [driver, id](bool ok, const std::string &response) {
+        ok ? ++driver->completed : ++driver->failed;
+        if (ok && ::strtoull(response.c_str(), nullptr, 10) != id)
+        {
+            ++driver->mismatched;
+        }
+        if (driver->running)
+        {
+            issue(driver);
+        }
+    }, id);
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8003;
+    int clientLoops = argc > 2 ? atoi(argv[2]) : 2;
+    int connsPerLoop = argc > 3 ? atoi(argv[3]) : 2;
+    int window = argc > 4 ? atoi(argv[4]) : 64;
+    int payloadSize = argc > 5 ? atoi(argv[5]) : 64;
+    double seconds = argc > 6 ? atof(argv[6]) : 5.0;
+    ConnectionPool::MatchMode mode = (argc > 7 && strcmp(argv[7], "id") == 0) ? ConnectionPool::kRequestId : ConnectionPool::kFifo;
+
+    EventLoop loop;
+    InetAddress serverAddr(port);
+    TcpServer server(&loop, serverAddr, "LineEcho");
+    server.setThreadNum(1);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        // 只回显完整的行
+        const char *start = buf->peek();
+        const char *end = start + buf->readableBytes();
+        const char *lastEol = start;
+        for (const char *p = start; p < end; ++p)
+        {
+            if (*p == '\n')
+            {
+                lastEol = p + 1;
+            }
+        }
+        if (lastEol != start)
+        {
+            conn->send(buf->retrieveAsString(lastEol - start));
+        }
+    });
+    server.start();
+
+    std::vector<std::unique_ptr<EventLoopThread>> threads;
+    std::vector<std::unique_ptr<ConnectionPool>> pools(clientLoops);
+    std::vector<Driver> drivers(clientLoops);
+    for (int i = 0; i < clientLoops; ++i)
+    {
+        threads.emplace_back(new EventLoopThread(EventLoopThread::ThreadInitCallback(), "client" + std::to_string(i)));
+        EventLoop *clientLoop = threads.back()->startLoop();
+        Driver *driver = &drivers[i];
+        driver->payload.assign(payloadSize, 'x');
+        clientLoop->runInLoop([&, i, clientLoop, driver]() {
+            pools[i].reset(new ConnectionPool(clientLoop, serverAddr, "pool" + std::to_string(i), connsPerLoop, mode, parseLine));
+            driver->pool = pools[i].get();
+            driver->pool->start();
+            // 连接建立之前的请求在连接池中排队
+            for (int w = 0; w < window; ++w)
+            {
+                issue(driver);
+            }
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    loop.runAfter(seconds, [&]() {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        // 在各自的loop中停止并析构连接池
+        int64_t completed = 0, failed = 0, mismatched = 0;
+        for (int i = 0; i < clientLoops; ++i)
+        {
+            std::promise<void> done;
+            pools[i]->getLoop()->runInLoop([&, i]() {
+                drivers[i].running = false;
+                completed += drivers[i].completed;
+                failed += drivers[i].failed;
+                mismatched += drivers[i].mismatched;
+                pools[i].reset();
+                done.set_value();
+            });
+            done.get_future().wait();
+        }
+        printf("bench_connection_pool mode=%s client_loops=%d conns_per_loop=%d window=%d payload=%d seconds=%.3f completed=%lld failed=%lld qps=%.0f\n",
+               mode == ConnectionPool::kFifo ? "fifo" : "id", clientLoops, connsPerLoop, window, payloadSize,
+               elapsed, (long long)completed, (long long)failed, completed / elapsed);
+        printf("selftest responses=%s completed=%lld failed=%lld mismatched=%lld\n",
+               benchCheck(completed > 0 && failed == 0 && mismatched == 0),
+               (long long)completed, (long long)failed, (long long)mismatched);
+        loop.quit();
+    });
+
+    loop.loop();
+    return benchExitCode();
+}
@@ -0,0 +1,181 @@
+#include "BenchCommon.h"
+#include "TcpServer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+/**
+ * 建连风暴压测：服务端和客户端在同一进程内，通过loopback测试每秒能接受的新连接数
+ * 用法: ./bench_connstorm [port] [ioThreads] [clientThreads] [connsPerClient] [fdLimit]
+ * fdLimit为0时自检所有连接都成功建立，并且服务端都收到了
+ * fdLimit不为0时调低RLIMIT_NOFILE，改为自检fd耗尽的处理：先占满fd，只给服务端留kServerFds个，
+ * 然后建立clientThreads*connsPerClient个连接并保持打开；服务端接受kServerFds个以后accept返回EMFILE，
+ * Acceptor应该用备用fd接受并立即关闭其余的连接，而不是把它们留在监听队列里，baseLoop也不能因此卡住
+ */
+static std::atomic_int g_connected(0);
+static const int kServerFds = 4;
+
+static void runClient(uint16_t port, int conns, std::atomic_int *failed)
+{
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    for (int i = 0; i < conns; ++i)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (::connect(fd, (sockaddr *)&addr, sizeof addr) < 0)
+        {
+            ++*failed;
+        }
+        ::close(fd);
+    }
+}
+
+static void checkFdExhausted(EventLoop *loop, uint16_t port, int conns)
+{
+    // 占满fd以后只让出客户端和服务端需要的部分
+    std::vector<int> fillers;
+    int fd;
+    while ((fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC)) >= 0)
+    {
+        fillers.push_back(fd);
+    }
+    int release = std::min(static_cast<int>(fillers.size()), conns + kServerFds);
+    for (int i = 0; i < release; ++i)
+    {
+        ::close(fillers.back());
+        fillers.pop_back();
+    }
+    std::vector<int> clients;
+    for (int i = 0; i < release - kServerFds; ++i)
+    {
+        clients.push_back(::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0));
+    }
+
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    int connectFailed = 0;
+    for (int c : clients)
+    {
+        if (c < 0 || ::connect(c, (sockaddr *)&addr, sizeof addr) < 0)
+        {
+            ++connectFailed;
+        }
+    }
+
+    // 被接受的连接由服务端保持打开，其余的都应该被关闭（对端看到EOF或者RST）
+    std::vector<bool> closed(clients.size(), false);
+    int closedCount = 0;
+    bool settled = benchWaitFor([&]() {
+        for (size_t i = 0; i < clients.size(); ++i)
+        {
+            char c;
+            ssize_t n = closed[i] || clients[i] < 0 ? 1 : ::recv(clients[i], &c, 1, MSG_DONTWAIT);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+            {
+                closed[i] = true;
+                ++closedCount;
+            }
+        }
+        return g_connected + closedCount == static_cast<int>(clients.size());
+    }, 10);
+    printf("selftest fd_exhausted=%s clients=%zu accepted=%d closed=%d connect_failed=%d\n",
+           benchCheck(settled && closedCount > 0 && connectFailed == 0), clients.size(), g_connected.load(),
+           closedCount, connectFailed);
+
+    // baseLoop没有在EMFILE上空转，还能处理别的任务
+    auto ran = std::make_shared<std::atomic_bool>(false);
+    loop->runInLoop([ran]() { *ran = true; });
+    printf("selftest loop_responsive=%s\n", benchCheck(benchWaitFor([&]() { return ran->load(); }, 2)));
+
+    for (int c : clients)
+    {
+        ::close(c);
+    }
+    for (int f : fillers)
+    {
+        ::close(f);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8001;
+    int ioThreads = argc > 2 ? atoi(argv[2]) : 4;
+    int clientThreads = argc > 3 ? atoi(argv[3]) : 8;
+    int connsPerClient = argc > 4 ? atoi(argv[4]) : 5000;
+    int fdLimit = argc > 5 ? atoi(argv[5]) : 0;
+
+    if (fdLimit > 0)
+    {
+        rlimit rl;
+        rl.rlim_cur = rl.rlim_max = fdLimit;
+        ::setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "ConnStorm");
+    server.setThreadNum(ioThreads);
+    server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            ++g_connected;
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) {
+        buf->retrieveAll();
+    });
+    server.start();
+
+    std::thread driver([&]() {
+        if (fdLimit > 0)
+        {
+            checkFdExhausted(&loop, port, clientThreads * connsPerClient);
+            loop.quit();
+            return;
+        }
+
+        std::atomic_int failed(0);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> clients;
+        for (int i = 0; i < clientThreads; ++i)
+        {
+            clients.emplace_back(runClient, port, connsPerClient, &failed);
+        }
+        for (auto &t : clients)
+        {
+            t.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        int total = clientThreads * connsPerClient;
+        printf("bench_connstorm io_threads=%d client_threads=%d connections=%d failed=%d accepted=%d seconds=%.3f connects_per_sec=%.0f\n",
+               ioThreads, clientThreads, total, failed.load(), g_connected.load(), seconds, total / seconds);
+        // 客户端connect返回时服务端可能还没处理完accept
+        bool ok = failed == 0 && benchWaitFor([&]() { return g_connected == total; }, 10);
+        printf("selftest accept_all=%s failed=%d accepted=%d\n", benchCheck(ok), failed.load(), g_connected.load());
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return benchExitCode();
+}
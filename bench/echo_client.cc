@@ -0,0 +1,102 @@
+#include "BenchCommon.h"
+#include "TcpServer.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * TcpClient测试和压测：同一进程内的echo服务端和多个TcpClient做ping-pong
+ * 服务端在客户端开始连接之后才listen，用来验证连接失败的退避重试
+ * 压测进行到一半时服务端主动断开所有连接，用来验证自动重连
+ * 自检：listen之前的连接经过重试全部建立，断开以后全部重连
+ * 用法: ./bench_echo_client [port] [ioThreads] [clients] [msgSize] [seconds]
+ */
+static std::atomic_int g_connects(0);
+static std::atomic<int64_t> g_bytes(0);
+static std::atomic<int64_t> g_messages(0);
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8002;
+    int ioThreads = argc > 2 ? atoi(argv[2]) : 2;
+    int numClients = argc > 3 ? atoi(argv[3]) : 100;
+    int msgSize = argc > 4 ? atoi(argv[4]) : 4096;
+    double seconds = argc > 5 ? atof(argv[5]) : 5.0;
+    const double listenDelay = 0.3;
+
+    EventLoop loop;
+    InetAddress serverAddr(port);
+    TcpServer server(&loop, serverAddr, "EchoServer");
+    server.setThreadNum(ioThreads);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf->retrieveAllAsString());
+    });
+
+    EventLoopThread clientThread(EventLoopThread::ThreadInitCallback(), "client");
+    EventLoop *clientLoop = clientThread.startLoop();
+
+    const std::string message(msgSize, 'x');
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<double> firstConnect(0);
+    std::vector<std::unique_ptr<TcpClient>> clients;
+    for (int i = 0; i < numClients; ++i)
+    {
+        clients.emplace_back(new TcpClient(clientLoop, serverAddr, "EchoClient" + std::to_string(i)));
+        TcpClient *client = clients.back().get();
+        client->enableRetry();
+        client->setRetryDelay(50, 1000);
+        client->setConnectionCallback([&](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                if (++g_connects == 1)
+                {
+                    firstConnect = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                }
+                conn->send(message);
+            }
+        });
+        client->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            g_bytes += buf->readableBytes();
+            ++g_messages;
+            conn->send(buf->retrieveAllAsString());
+        });
+        client->connect();
+    }
+
+    // 客户端已经开始连接，稍后服务端才开始listen
+    loop.runAfter(listenDelay, [&]() { server.start(); });
+    // 中途断开所有连接，客户端应该自动重连
+    int connectsBeforeClose = 0;
+    loop.runAfter(listenDelay + seconds / 2, [&]() {
+        connectsBeforeClose = g_connects.load();
+        server.forEachConnection([](const TcpConnectionPtr &conn) { conn->forceClose(); });
+    });
+    loop.runAfter(listenDelay + seconds, [&]() {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() - listenDelay;
+        printf("bench_echo_client io_threads=%d clients=%d msg_size=%d seconds=%.3f first_connect_sec=%.3f connects=%d messages=%lld throughput_mib_per_sec=%.1f\n",
+               ioThreads, numClients, msgSize, elapsed, firstConnect.load(), g_connects.load(),
+               (long long)g_messages.load(), g_bytes.load() / elapsed / 1024 / 1024);
+        printf("selftest retry=%s connects=%d first_connect_sec=%.3f\n",
+               benchCheck(connectsBeforeClose == numClients && firstConnect >= listenDelay), connectsBeforeClose, firstConnect.load());
+        printf("selftest reconnect=%s connects=%d\n", benchCheck(g_connects == 2 * numClients), g_connects.load());
+        loop.quit();
+    });
+
+    loop.loop();
+
+    // TcpClient要在它的loop线程中析构
+    std::promise<void> done;
+    clientLoop->runInLoop([&]() {
+        clients.clear();
+        done.set_value();
+    });
+    done.get_future().wait();
+    return benchExitCode();
+}
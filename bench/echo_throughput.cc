@@ -0,0 +1,92 @@
+#include "BenchCommon.h"
+#include "TcpServer.h"
+
+#include <stdio.h>
+
+/**
+ * 多连接回显吞吐：每个连接先发出一个msgSize的消息，之后客户端和服务端都把收到的数据原样发回，
+ * 统计测量窗口内客户端收到的字节数；对列表中的每个服务端io线程数各跑一次
+ * 用法: ./bench_echo_throughput [ioThreadsList=0,1,2,4] [connections=64] [msgSize=16k] [seconds=3] [clientThreads=2] [port=9100]
+ * 输出: bench_echo_throughput io_threads=.. connections=.. msg_size=.. seconds=.. bytes_per_sec=.. mib_per_sec=.. msgs_per_sec=..
+ */
+static void runOnce(uint16_t port, int ioThreads, int connections, int msgSize, double seconds, int clientThreads)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "EchoThroughput");
+    server.setThreadNum(ioThreads);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf);
+    });
+    server.start();
+
+    std::thread driver([&]() {
+        std::atomic_int connected(0);
+        std::atomic_bool running(true);
+        std::vector<BenchCounter> received(clientThreads);
+        const std::string message(msgSize, 'e');
+        {
+            ClientGroup clients(clientThreads);
+            clients.connect(InetAddress(port, "127.0.0.1"), connections, [&](TcpClient *client, int loopIndex) {
+                client->setConnectionCallback([&, loopIndex](const TcpConnectionPtr &conn) {
+                    if (conn->connected())
+                    {
+                        ++connected;
+                        conn->send(message);
+                    }
+                });
+                client->setMessageCallback([&, loopIndex](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+                    received[loopIndex].add(buf->readableBytes());
+                    if (running.load(std::memory_order_relaxed))
+                    {
+                        conn->send(buf);
+                    }
+                    else
+                    {
+                        buf->retrieveAll();
+                    }
+                });
+            });
+            if (!benchWaitFor([&]() { return connected == connections; }, 10))
+            {
+                printf("bench_echo_throughput error=connect_timeout connected=%d\n", connected.load());
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(200)); // 预热
+            int64_t startBytes = benchSum(received);
+            auto start = BenchClock::now();
+            std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+            int64_t bytes = benchSum(received) - startBytes;
+            double elapsed = std::chrono::duration<double>(BenchClock::now() - start).count();
+            running = false;
+            clients.disconnect();
+
+            printf("bench_echo_throughput io_threads=%d client_threads=%d connections=%d msg_size=%d seconds=%.3f bytes_per_sec=%.0f mib_per_sec=%.1f msgs_per_sec=%.0f\n",
+                   ioThreads, clients.threads(), connections, msgSize, elapsed, bytes / elapsed,
+                   bytes / elapsed / (1024 * 1024), bytes / elapsed / msgSize);
+            fflush(stdout);
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+}
+
+int main(int argc, char *argv[])
+{
+    benchInit();
+    std::vector<int> ioThreadsList = benchParseList(argc > 1 ? argv[1] : "0,1,2,4");
+    int connections = argc > 2 ? atoi(argv[2]) : 64;
+    int msgSize = benchParseList(argc > 3 ? argv[3] : "16k").at(0);
+    double seconds = argc > 4 ? atof(argv[4]) : 3.0;
+    int clientThreads = std::max(argc > 5 ? atoi(argv[5]) : 2, 1);
+    uint16_t port = argc > 6 ? static_cast<uint16_t>(atoi(argv[6])) : 9100;
+
+    // 每次换一个端口，避免上一轮残留的连接影响bind
+    for (int ioThreads : ioThreadsList)
+    {
+        runOnce(port++, ioThreads, connections, msgSize, seconds, clientThreads);
+    }
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include "BenchCommon.h"
+#include "TcpServer.h"
+#include "PubSubHub.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+/**
+ * 广播压测：服务端把每个新连接订阅到同一个topic，发布者线程按轮发布消息，
+ * 每轮等所有正常订阅者收完再发下一轮，统计每秒投递到订阅者的消息数
+ * ./bench_fanout [port] [ioThreads] [clientLoops] [subscribers] [messages] [msgSize] [slowSubscribers]
+ *   mode=hub   通过PubSubHub发布，每个loop一次任务，payload共享
+ *   mode=naive 对每个连接调用TcpConnection::send(std::string)，每个连接拷贝一次、投递一次任务
+ * slowSubscribers个连接只发一个字节标明自己、之后不读数据，
+ * 服务端把它们单独订阅到slow/kick两个topic，验证积压超过上限时丢消息/断开连接两种策略
+ */
+using Clock = std::chrono::steady_clock;
+
+static const size_t kMaxPendingBytes = 256 * 1024;
+
+static std::atomic_llong g_received(0);
+static std::atomic_int g_accepted(0);
+
+static bool waitFor(const std::function<bool()> &cond, double seconds)
+{
+    auto deadline = Clock::now() + std::chrono::duration<double>(seconds);
+    while (!cond())
+    {
+        if (Clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    return true;
+}
+
+static int connectSlow(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int rcvbuf = 4096;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof rcvbuf);
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    ::connect(fd, (sockaddr *)&addr, sizeof addr);
+    ::write(fd, "S", 1);
+    return fd;
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8020;
+    int ioThreads = argc > 2 ? atoi(argv[2]) : 4;
+    int clientLoops = argc > 3 ? atoi(argv[3]) : 2;
+    int subscribers = argc > 4 ? atoi(argv[4]) : 1000;
+    int messages = argc > 5 ? atoi(argv[5]) : 1000;
+    int msgSize = argc > 6 ? atoi(argv[6]) : 1024;
+    int slow = argc > 7 ? atoi(argv[7]) : 4;
+    const int kBatch = 100;
+
+    // 连接回调中会用到，要比server后析构：server析构时io线程里还会回调连接断开
+    PubSubHub hub;
+    hub.setSlowSubscriberPolicy(PubSubHub::kDropMessage, kMaxPendingBytes);
+    PubSubHub kickHub;
+    kickHub.setSlowSubscriberPolicy(PubSubHub::kDisconnect, kMaxPendingBytes);
+    std::mutex mutex;
+    std::vector<TcpConnectionPtr> conns; // naive模式使用
+    std::atomic_int slowReady(0);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "FanoutBench");
+    server.setThreadNum(ioThreads);
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            hub.subscribe("bench", conn);
+            std::lock_guard<std::mutex> lock(mutex);
+            conns.push_back(conn);
+            ++g_accepted;
+        }
+        else
+        {
+            hub.unsubscribeAll(conn);
+            kickHub.unsubscribeAll(conn);
+            std::lock_guard<std::mutex> lock(mutex);
+            conns.erase(std::remove(conns.begin(), conns.end(), conn), conns.end());
+        }
+    });
+    server.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        if (buf->retrieveAllAsString() == "S")
+        {
+            hub.subscribe("slow", conn);
+            kickHub.subscribe("kick", conn);
+            ++slowReady;
+        }
+    });
+    server.start();
+
+    std::vector<std::unique_ptr<EventLoopThread>> threads;
+    std::vector<EventLoop *> loops;
+    for (int i = 0; i < clientLoops; ++i)
+    {
+        threads.emplace_back(new EventLoopThread(EventLoopThread::ThreadInitCallback(), "client" + std::to_string(i)));
+        loops.push_back(threads.back()->startLoop());
+    }
+
+    std::vector<std::unique_ptr<TcpClient>> clients;
+    std::vector<int> slowFds;
+
+    std::thread driver([&]() {
+        InetAddress serverAddr(port, "127.0.0.1");
+        for (int i = 0; i < subscribers; ++i)
+        {
+            clients.emplace_back(new TcpClient(loops[i % clientLoops], serverAddr, "Subscriber" + std::to_string(i)));
+            clients.back()->setConnectionCallback([](const TcpConnectionPtr &) {});
+            clients.back()->setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) {
+                g_received += buf->readableBytes();
+                buf->retrieveAll();
+            });
+            clients.back()->connect();
+        }
+        for (int i = 0; i < slow; ++i)
+        {
+            slowFds.push_back(connectSlow(port));
+        }
+        bool connected = waitFor([&]() { return g_accepted == subscribers + slow && slowReady == slow; }, 30);
+        printf("selftest connect=%s accepted=%d\n", benchCheck(connected), g_accepted.load());
+
+        long long expected = 0;
+        auto run = [&](const char *mode, const std::function<void()> &publish, int count, int size, int batch) {
+            auto start = Clock::now();
+            bool ok = true;
+            for (int sent = 0; sent < count && ok; sent += batch)
+            {
+                for (int i = 0; i < batch; ++i)
+                {
+                    publish();
+                }
+                expected += static_cast<long long>(batch) * size * subscribers;
+                ok = waitFor([&]() { return g_received >= expected; }, 30);
+            }
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            double deliveries = static_cast<double>(count) * subscribers;
+            printf("bench_fanout mode=%s io_threads=%d subscribers=%d slow=%d messages=%d msg_size=%d seconds=%.3f deliveries_per_sec=%.0f mb_per_sec=%.1f complete=%s\n",
+                   mode, ioThreads, subscribers, slow, count, size, seconds, deliveries / seconds,
+                   deliveries * size / seconds / (1024 * 1024), ok ? "yes" : "no");
+            printf("selftest %s_complete=%s\n", mode, benchCheck(ok));
+        };
+
+        std::string payload(msgSize, 'm');
+        run("hub", [&]() { hub.publish("bench", payload); }, messages, msgSize, kBatch);
+        run("naive", [&]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const TcpConnectionPtr &conn : conns)
+            {
+                conn->send(payload);
+            }
+        }, messages, msgSize, kBatch);
+
+        // 只有慢订阅者订阅了slow/kick，持续发布直到内核缓冲区填满、积压超过上限
+        std::string big(64 * 1024, 'k');
+        for (int i = 0; i < 1024 && hub.stats().dropped == 0; ++i)
+        {
+            hub.publish("slow", big);
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        PubSubHub::Stats stats = hub.stats();
+        printf("selftest slow_drop=%s published=%llu delivered=%llu dropped=%llu\n",
+               benchCheck(slow == 0 || stats.dropped > 0),
+               (unsigned long long)stats.published, (unsigned long long)stats.delivered, (unsigned long long)stats.dropped);
+
+        for (int i = 0; i < 1024 && kickHub.stats().disconnected < static_cast<uint64_t>(slow); ++i)
+        {
+            kickHub.publish("kick", big);
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        bool kicked = waitFor([&]() { return kickHub.stats().disconnected == static_cast<uint64_t>(slow); }, 5);
+        printf("selftest slow_disconnect=%s disconnected=%llu\n", benchCheck(kicked),
+               (unsigned long long)kickHub.stats().disconnected);
+
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+
+    for (int fd : slowFds)
+    {
+        ::close(fd);
+    }
+    // TcpClient要在它的loop线程中析构
+    for (EventLoop *clientLoop : loops)
+    {
+        std::promise<void> done;
+        clientLoop->runInLoop([&]() {
+            for (auto &client : clients)
+            {
+                if (client && client->getLoop() == clientLoop)
+                {
+                    client.reset();
+                }
+            }
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+    return benchExitCode();
+}
@@ -0,0 +1,270 @@
+#include "BenchCommon.h"
+#include "HttpServer.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+/**
+ * HttpServer的功能自测和wrk风格的压测
+ * ./bench_http server [port] [ioThreads]            只启动服务端，用外部的wrk压测
+ * ./bench_http [port] [ioThreads] [clientLoops] [connections] [pipeline] [seconds] [path]
+ *   先用阻塞socket验证pipelining、chunked请求/响应和Connection: close，
+ *   然后用TcpClient保持connections条连接、每条连接pipeline个在途请求，统计每秒请求数
+ * 路由: /hello 固定响应  /cached 可缓存的固定响应  /big 4M的可缓存响应  /echo 回显请求body  /chunked chunked响应
+ */
+static void onRequest(const HttpRequest &req, HttpResponse *resp)
+{
+    if (req.path() == "/hello")
+    {
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setContentType("text/plain");
+        resp->setBody("hello, world!\n");
+    }
+    else if (req.path() == "/cached" || req.path() == "/big")
+    {
+        // 可缓存的响应，只有第一次请求会执行到这里
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setContentType("text/plain");
+        resp->setBody(req.path() == "/big" ? std::string(4 * 1024 * 1024, 'b') : std::string("hello, cache!\n"));
+        resp->setCacheable(true);
+    }
+    else if (req.path() == "/echo")
+    {
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setBody(std::string(req.body()));
+    }
+    else if (req.path() == "/chunked")
+    {
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setChunked(true);
+        resp->appendChunk("hello, ");
+        resp->appendChunk("chunked ");
+        resp->appendChunk("world!\n");
+    }
+    else
+    {
+        resp->setStatusCode(HttpResponse::k404NotFound);
+    }
+}
+
+// 发送原始请求并读到对端关闭为止
+static std::string rawExchange(uint16_t port, const std::string &request)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    timeval tv{2, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    std::string response;
+    if (::connect(fd, (sockaddr *)&addr, sizeof addr) == 0)
+    {
+        // 分两次发送，验证跨读事件的增量解析
+        size_t half = request.size() / 2;
+        ::write(fd, request.data(), half);
+        ::usleep(20 * 1000);
+        ::write(fd, request.data() + half, request.size() - half);
+        char buf[4096];
+        ssize_t n;
+        while ((n = ::read(fd, buf, sizeof buf)) > 0)
+        {
+            response.append(buf, n);
+        }
+    }
+    ::close(fd);
+    return response;
+}
+
+static void selfTest(uint16_t port)
+{
+    std::string request =
+        "GET /hello HTTP/1.1\r\nHost: x\r\n\r\n"
+        "POST /echo HTTP/1.1\r\nHost: x\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "5\r\nhello\r\n7;ext=1\r\n, world\r\n0\r\nTrailer: y\r\n\r\n"
+        "GET /chunked HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n"
+        "GET /hello HTTP/1.1\r\nHost: x\r\n\r\n"; // 在Connection: close之后，不应该被处理
+    std::string expected =
+        "HTTP/1.1 200 OK\r\nContent-Length: 14\r\nConnection: Keep-Alive\r\nContent-Type: text/plain\r\n\r\nhello, world!\n"
+        "HTTP/1.1 200 OK\r\nContent-Length: 12\r\nConnection: Keep-Alive\r\n\r\nhello, world"
+        "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n"
+        "7\r\nhello, \r\n8\r\nchunked \r\n7\r\nworld!\n\r\n0\r\n\r\n";
+    printf("selftest pipeline_chunked=%s\n", benchCheck(rawExchange(port, request) == expected));
+
+    std::string bad = rawExchange(port, "GET /hello HTTP/1.1\r\nContent-Length: 99999999999\r\n\r\n");
+    printf("selftest body_too_large=%s\n", benchCheck(bad.compare(0, 12, "HTTP/1.1 413") == 0));
+    bad = rawExchange(port, "BREW /pot HTTP/1.1\r\n\r\n");
+    printf("selftest bad_request=%s\n", benchCheck(bad.compare(0, 12, "HTTP/1.1 400") == 0));
+    // 消息边界有歧义的请求一律400，后面跟着的请求不能被当成新请求处理
+    bad = rawExchange(port, "POST /echo HTTP/1.1\r\nContent-Length: 5\r\nTransfer-Encoding: chunked\r\n\r\n"
+                            "0\r\n\r\nGET /hello HTTP/1.1\r\n\r\n");
+    printf("selftest te_and_cl=%s\n", benchCheck(bad.compare(0, 12, "HTTP/1.1 400") == 0 && bad.find("hello, world") == std::string::npos));
+    bad = rawExchange(port, "POST /echo HTTP/1.1\r\nContent-Length: 0\r\nContent-Length: 26\r\n\r\nGET /hello HTTP/1.1\r\n\r\n");
+    printf("selftest duplicate_cl=%s\n", benchCheck(bad.compare(0, 12, "HTTP/1.1 400") == 0 && bad.find("hello, world") == std::string::npos));
+    bad = rawExchange(port, "POST /echo HTTP/1.1\r\nContent-Length: 5, 7\r\n\r\nhello, ");
+    printf("selftest cl_list=%s\n", benchCheck(bad.compare(0, 12, "HTTP/1.1 400") == 0));
+    std::string same = rawExchange(port, "POST /echo HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 5, 5\r\nConnection: close\r\n\r\nhello");
+    printf("selftest cl_same=%s\n", benchCheck(same.compare(0, 12, "HTTP/1.1 200") == 0 && same.find("\r\n\r\nhello") != std::string::npos));
+
+    // 缓存：第一次响应带ETag，带If-None-Match的请求得到304
+    std::string first = rawExchange(port, "GET /cached HTTP/1.1\r\n\r\nGET /hello HTTP/1.1\r\nConnection: close\r\n\r\n");
+    size_t pos = first.find("ETag: ");
+    std::string etag = pos == std::string::npos ? "" : first.substr(pos + 6, first.find("\r\n", pos) - pos - 6);
+    std::string conditional = rawExchange(port,
+        "GET /cached HTTP/1.1\r\n\r\n"
+        "GET /cached HTTP/1.1\r\nIf-None-Match: " + etag + "\r\n\r\n"
+        "GET /hello HTTP/1.1\r\nConnection: close\r\n\r\n");
+    bool ok = !etag.empty()
+        && conditional.find("HTTP/1.1 200") == 0
+        && conditional.find("HTTP/1.1 304 Not Modified\r\nConnection: Keep-Alive\r\nETag: " + etag) != std::string::npos
+        && conditional.find("hello, world!\n") == conditional.size() - 14;
+    printf("selftest cache_etag=%s\n", benchCheck(ok));
+
+    // 大响应写不完时剩余部分以引用的方式留在发送链上，两次请求的body都要完整
+    std::string big = rawExchange(port, "GET /big HTTP/1.1\r\n\r\nGET /big HTTP/1.1\r\nConnection: close\r\n\r\n");
+    const std::string bigBody(4 * 1024 * 1024, 'b');
+    size_t second = big.find("HTTP/1.1 200", 1);
+    ok = second != std::string::npos
+        && big.compare(second - bigBody.size(), bigBody.size(), bigBody) == 0
+        && big.compare(big.size() - bigBody.size(), bigBody.size(), bigBody) == 0;
+    printf("selftest cache_big=%s\n", benchCheck(ok));
+}
+
+// 解析一个响应，返回响应的长度，不完整返回0
+static size_t parseResponse(const char *data, size_t len)
+{
+    const char *end = static_cast<const char *>(::memmem(data, len, "\r\n\r\n", 4));
+    if (end == nullptr)
+    {
+        return 0;
+    }
+    size_t headerLen = end + 4 - data;
+    const char *cl = static_cast<const char *>(::memmem(data, headerLen, "Content-Length: ", 16));
+    size_t bodyLen = cl ? ::strtoul(cl + 16, nullptr, 10) : 0;
+    return len >= headerLen + bodyLen ? headerLen + bodyLen : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    bool serverOnly = argc > 1 && strcmp(argv[1], "server") == 0;
+    int argi = serverOnly ? 2 : 1;
+    uint16_t port = argc > argi ? static_cast<uint16_t>(atoi(argv[argi])) : 8005;
+    int ioThreads = argc > argi + 1 ? atoi(argv[argi + 1]) : 2;
+    int clientLoops = argc > 3 ? atoi(argv[3]) : 2;
+    int connections = argc > 4 ? atoi(argv[4]) : 50;
+    int pipeline = argc > 5 ? atoi(argv[5]) : 1;
+    double seconds = argc > 6 ? atof(argv[6]) : 5.0;
+    std::string path = argc > 7 ? argv[7] : "/hello";
+
+    EventLoop loop;
+    HttpServer server(&loop, InetAddress(port), "HttpBench");
+    server.setThreadNum(ioThreads);
+    server.setHttpCallback(onRequest);
+    server.setResponseCache(64 * 1024 * 1024);
+    server.start();
+    if (serverOnly)
+    {
+        loop.loop();
+        return 0;
+    }
+
+    const std::string request = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    std::string batch;
+    for (int i = 0; i < pipeline; ++i)
+    {
+        batch += request;
+    }
+
+    std::atomic<int64_t> completed(0);
+    std::vector<std::unique_ptr<EventLoopThread>> threads;
+    std::vector<std::unique_ptr<TcpClient>> clients(connections);
+    std::chrono::steady_clock::time_point start;
+
+    // 压测客户端，在自测完成以后由baseLoop启动
+    auto startBench = [&]() {
+        for (int i = 0; i < clientLoops; ++i)
+        {
+            threads.emplace_back(new EventLoopThread(EventLoopThread::ThreadInitCallback(), "client" + std::to_string(i)));
+        }
+        std::vector<EventLoop *> loops;
+        for (auto &thread : threads)
+        {
+            loops.push_back(thread->startLoop());
+        }
+        for (int i = 0; i < connections; ++i)
+        {
+            clients[i].reset(new TcpClient(loops[i % loops.size()], InetAddress(port), "HttpClient" + std::to_string(i)));
+            clients[i]->setConnectionCallback([&batch](const TcpConnectionPtr &conn) {
+                if (conn->connected())
+                {
+                    conn->send(batch);
+                }
+            });
+            // 每收到pipeline个响应就再发一批，保证连接上始终有请求在途
+            auto received = std::make_shared<int>(0);
+            clients[i]->setMessageCallback([&, received](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+                size_t n;
+                while ((n = parseResponse(buf->peek(), buf->readableBytes())) > 0)
+                {
+                    buf->retrieve(n);
+                    ++completed;
+                    if (++*received == pipeline)
+                    {
+                        *received = 0;
+                        conn->send(batch);
+                    }
+                }
+            });
+            clients[i]->connect();
+        }
+
+        start = std::chrono::steady_clock::now();
+        loop.runAfter(seconds, [&]() {
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            uint64_t hits = 0, misses = 0;
+            for (const auto &stats : server.cacheStats())
+            {
+                hits += stats.hits;
+                misses += stats.misses;
+            }
+            printf("bench_http path=%s io_threads=%d client_loops=%d connections=%d pipeline=%d seconds=%.3f requests=%lld requests_per_sec=%.0f cache_hits=%llu cache_misses=%llu\n",
+                   path.c_str(), ioThreads, clientLoops, connections, pipeline, elapsed, (long long)completed.load(), completed / elapsed,
+                   (unsigned long long)hits, (unsigned long long)misses);
+            loop.quit();
+        });
+    };
+
+    // 自测使用阻塞socket，不能在baseLoop线程中执行
+    std::thread tester([&]() {
+        selfTest(port);
+        loop.runInLoop(startBench);
+    });
+    loop.loop();
+    tester.join();
+
+    // TcpClient要在它的loop线程中析构
+    for (int i = 0; i < connections; ++i)
+    {
+        std::promise<void> done;
+        clients[i]->getLoop()->runInLoop([&, i]() {
+            clients[i].reset();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+    return benchExitCode();
+}
@@ -0,0 +1,145 @@
+#include "BenchCommon.h"
+#include "TcpServer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * 大消息单向流式传输：发送方用共享的payload连续发送msgSize的消息，写缓冲区清空（WriteCompleteCallback）时补发，
+ * 始终保持两个消息在途；接收方像codec一样等整条消息到齐再取走，所以接收端Buffer会涨到msgSize
+ * download为服务端发、客户端收，upload为客户端发、服务端收；对列表中的每个消息大小各跑一次
+ * 用法: ./bench_large_message [msgSizeList=64k,1m,16m] [direction=download|upload] [connections=1] [seconds=3] [ioThreads=1] [port=9400]
+ * 输出: bench_large_message direction=.. msg_size=.. messages_per_sec=.. mib_per_sec=..
+ */
+class Streamer
+{
+public:
+    Streamer(int msgSize, const std::atomic_bool *running)
+        : payload_(std::make_shared<const std::string>(msgSize, 'L'))
+        , msgSize_(msgSize)
+        , running_(running)
+    {
+    }
+
+    // 发送方
+    void onConnection(const TcpConnectionPtr &conn)
+    {
+        if (conn->connected())
+        {
+            conn->send(payload_);
+            conn->send(payload_);
+        }
+    }
+    void onWriteComplete(const TcpConnectionPtr &conn)
+    {
+        if (running_->load(std::memory_order_relaxed))
+        {
+            conn->send(payload_);
+        }
+    }
+
+    // 接收方，消息个数很少，多个io线程直接累加到同一个计数
+    void onMessage(Buffer *buf, std::atomic<int64_t> *received)
+    {
+        size_t messages = buf->readableBytes() / msgSize_;
+        if (messages > 0)
+        {
+            buf->retrieve(messages * msgSize_);
+            received->fetch_add(static_cast<int64_t>(messages), std::memory_order_relaxed);
+        }
+    }
+
+private:
+    const std::shared_ptr<const std::string> payload_;
+    const size_t msgSize_;
+    const std::atomic_bool *running_;
+};
+
+static void runOnce(uint16_t port, int msgSize, bool upload, int connections, double seconds, int ioThreads)
+{
+    std::atomic_bool running(true);
+    Streamer streamer(msgSize, &running);
+    std::atomic_int connected(0);
+    std::atomic<int64_t> received(0);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "LargeMessage");
+    server.setThreadNum(ioThreads);
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (!upload)
+        {
+            streamer.onConnection(conn);
+        }
+    });
+    server.setWriteCompleteCallback([&](const TcpConnectionPtr &conn) {
+        streamer.onWriteComplete(conn);
+    });
+    server.setMessageCallback([&](const TcpConnectionPtr &, Buffer *buf, Timestamp) {
+        streamer.onMessage(buf, &received);
+    });
+    server.start();
+
+    std::thread driver([&]() {
+        {
+            ClientGroup clients(1);
+            clients.connect(InetAddress(port, "127.0.0.1"), connections, [&](TcpClient *client, int) {
+                client->setConnectionCallback([&](const TcpConnectionPtr &conn) {
+                    if (conn->connected())
+                    {
+                        ++connected;
+                        if (upload)
+                        {
+                            streamer.onConnection(conn);
+                        }
+                    }
+                });
+                client->setWriteCompleteCallback([&](const TcpConnectionPtr &conn) {
+                    streamer.onWriteComplete(conn);
+                });
+                client->setMessageCallback([&](const TcpConnectionPtr &, Buffer *buf, Timestamp) {
+                    streamer.onMessage(buf, &received);
+                });
+            });
+            if (!benchWaitFor([&]() { return connected == connections; }, 10))
+            {
+                printf("bench_large_message error=connect_timeout connected=%d\n", connected.load());
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(200)); // 预热
+            int64_t startMessages = received.load();
+            auto start = BenchClock::now();
+            std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+            int64_t messages = received.load() - startMessages;
+            double elapsed = std::chrono::duration<double>(BenchClock::now() - start).count();
+            running = false;
+            clients.disconnect();
+
+            double bytes = static_cast<double>(messages) * msgSize;
+            printf("bench_large_message direction=%s io_threads=%d connections=%d msg_size=%d seconds=%.3f messages=%lld messages_per_sec=%.1f bytes_per_sec=%.0f mib_per_sec=%.1f\n",
+                   upload ? "upload" : "download", ioThreads, connections, msgSize, elapsed, (long long)messages,
+                   messages / elapsed, bytes / elapsed, bytes / elapsed / (1024 * 1024));
+            fflush(stdout);
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+}
+
+int main(int argc, char *argv[])
+{
+    benchInit();
+    std::vector<int> msgSizeList = benchParseList(argc > 1 ? argv[1] : "64k,1m,16m");
+    bool upload = argc > 2 && ::strcmp(argv[2], "upload") == 0;
+    int connections = argc > 3 ? atoi(argv[3]) : 1;
+    double seconds = argc > 4 ? atof(argv[4]) : 3.0;
+    int ioThreads = argc > 5 ? atoi(argv[5]) : 1;
+    uint16_t port = argc > 6 ? static_cast<uint16_t>(atoi(argv[6])) : 9400;
+
+    for (int msgSize : msgSizeList)
+    {
+        runOnce(port++, msgSize, upload, connections, seconds, ioThreads);
+    }
+    return 0;
+}
@@ -0,0 +1,226 @@
+#include "BenchCommon.h"
+#include "AsyncLogger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * 日志前端的开销：threads个线程各写lines行LOG_INFO，统计调用方每行的耗时
+ *   mode=sync_flush    每行fwrite+fflush到文件，相当于原来的std::endl
+ *   mode=sync_buffered 每行fwrite到文件，由stdio缓冲
+ *   mode=async         AsyncLogger，前端只拷贝到内存，后台线程写滚动文件
+ * 最后检查滚动：rollSize很小时持续写日志，应该生成多个文件并且行数不丢
+ * mode=disabled 级别不够的LOG_DEBUG的开销，参数不应该被求值；按模块打开以后才输出
+ * 用法: ./bench_log [dir] [threads] [lines]
+ */
+using Clock = std::chrono::steady_clock;
+
+static FILE *g_file = nullptr;
+static AsyncLogger *g_asyncLogger = nullptr;
+
+static void flushOutput(const char *msg, size_t len)
+{
+    ::fwrite(msg, 1, len, g_file);
+    ::fflush(g_file);
+}
+
+static void bufferedOutput(const char *msg, size_t len)
+{
+    ::fwrite(msg, 1, len, g_file);
+}
+
+static void bufferedFlush()
+{
+}
+
+static void asyncOutput(const char *msg, size_t len)
+{
+    g_asyncLogger->append(msg, len);
+}
+
+static void asyncFlush()
+{
+    g_asyncLogger->flush();
+}
+
+static long g_evaluated = 0;
+
+// 只有日志真正输出时才应该被调用
+static int expensiveArgument()
+{
+    ++g_evaluated;
+    return 42;
+}
+
+// 级别不够时每次LOG_DEBUG的开销
+static void disabledCost(long iterations)
+{
+    g_evaluated = 0;
+    auto start = Clock::now();
+    for (long i = 0; i < iterations; ++i)
+    {
+        LOG_DEBUG("bench_log disabled value=%d i=%ld\n", expensiveArgument(), i);
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+    printf("bench_log mode=disabled iterations=%ld ns_per_call=%.2f\n", iterations, ns);
+    printf("selftest lazy_args=%s evaluated=%ld\n", benchCheck(g_evaluated == 0), g_evaluated);
+
+    // 只打开本文件所在模块的DEBUG
+    Logger::instance().setModuleLevel("log", DEBUG);
+    LOG_DEBUG("bench_log enabled value=%d\n", expensiveArgument());
+    Logger::instance().clearModuleLevel("log");
+    LOG_DEBUG("bench_log disabled again value=%d\n", expensiveArgument());
+    printf("selftest module_level=%s evaluated=%ld\n", benchCheck(g_evaluated == 1), g_evaluated);
+}
+
+// 返回每个线程每次调用的耗时（纳秒）
+static std::vector<double> runThreads(int threads, int lines)
+{
+    std::vector<std::vector<double>> samples(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([t, lines, &samples]() {
+            std::vector<double> &mine = samples[t];
+            mine.reserve(lines);
+            for (int i = 0; i < lines; ++i)
+            {
+                auto start = Clock::now();
+                LOG_INFO("bench_log thread=%d line=%d payload=%s\n", t, i, "abcdefghijklmnopqrstuvwxyz0123456789");
+                mine.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+            }
+        });
+    }
+    for (std::thread &w : workers)
+    {
+        w.join();
+    }
+    std::vector<double> all;
+    for (auto &s : samples)
+    {
+        all.insert(all.end(), s.begin(), s.end());
+    }
+    std::sort(all.begin(), all.end());
+    return all;
+}
+
+static void report(const char *mode, int threads, const std::vector<double> &ns, double seconds)
+{
+    double sum = 0;
+    for (double v : ns)
+    {
+        sum += v;
+    }
+    printf("bench_log mode=%s threads=%d lines=%zu avg_ns=%.0f p50_ns=%.0f p99_ns=%.0f max_ns=%.0f lines_per_sec=%.0f\n",
+           mode, threads, ns.size(), sum / ns.size(), ns[ns.size() / 2], ns[ns.size() * 99 / 100], ns.back(),
+           ns.size() / seconds);
+}
+
+// 统计dir下以prefix开头的文件个数和总行数
+static void countFiles(const std::string &dir, const std::string &prefix, int *files, long *lines)
+{
+    *files = 0;
+    *lines = 0;
+    DIR *d = ::opendir(dir.c_str());
+    if (d == nullptr)
+    {
+        return;
+    }
+    while (dirent *entry = ::readdir(d))
+    {
+        if (::strncmp(entry->d_name, prefix.c_str(), prefix.size()) != 0)
+        {
+            continue;
+        }
+        ++*files;
+        FILE *fp = ::fopen((dir + "/" + entry->d_name).c_str(), "r");
+        int c;
+        while ((c = ::fgetc_unlocked(fp)) != EOF)
+        {
+            *lines += c == '\n';
+        }
+        ::fclose(fp);
+    }
+    ::closedir(d);
+}
+
+int main(int argc, char *argv[])
+{
+    std::string dir = argc > 1 ? argv[1] : "/tmp/logbench";
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    int lines = argc > 3 ? atoi(argv[3]) : 200000;
+    ::mkdir(dir.c_str(), 0755);
+    std::string pid = std::to_string(::getpid());
+
+    g_file = ::fopen((dir + "/sync." + pid + ".log").c_str(), "w");
+    Logger::instance().setOutput(bufferedOutput);
+    disabledCost(100000000);
+
+    Logger::instance().setOutput(flushOutput);
+    auto start = Clock::now();
+    std::vector<double> ns = runThreads(threads, lines);
+    report("sync_flush", threads, ns, std::chrono::duration<double>(Clock::now() - start).count());
+
+    Logger::instance().setOutput(bufferedOutput);
+    start = Clock::now();
+    ns = runThreads(threads, lines);
+    report("sync_buffered", threads, ns, std::chrono::duration<double>(Clock::now() - start).count());
+    ::fclose(g_file);
+
+    std::string basename = "async" + pid;
+    g_asyncLogger = new AsyncLogger(dir + "/" + basename, 1024 * 1024 * 1024);
+    g_asyncLogger->start();
+    Logger::instance().setOutput(asyncOutput);
+    Logger::instance().setFlush(asyncFlush);
+    start = Clock::now();
+    ns = runThreads(threads, lines);
+    report("async", threads, ns, std::chrono::duration<double>(Clock::now() - start).count());
+    Logger::instance().flush();
+    int files;
+    long written;
+    countFiles(dir, basename + ".", &files, &written);
+    printf("selftest async_flush=%s files=%d lines=%ld dropped_bytes=%llu\n",
+           benchCheck(written == static_cast<long>(threads) * lines || g_asyncLogger->droppedBytes() > 0),
+           files, written, (unsigned long long)g_asyncLogger->droppedBytes());
+    Logger::instance().setOutput(bufferedOutput);
+    g_asyncLogger->stop();
+    delete g_asyncLogger;
+
+    // 滚动：64K一个文件，同一秒内最多滚动一次，写3秒左右
+    basename = "roll" + pid;
+    g_asyncLogger = new AsyncLogger(dir + "/" + basename, 64 * 1024, 1);
+    g_asyncLogger->start();
+    Logger::instance().setOutput(asyncOutput);
+    int rollLines = 0;
+    start = Clock::now();
+    while (std::chrono::duration<double>(Clock::now() - start).count() < 3.2)
+    {
+        for (int i = 0; i < 1000; ++i)
+        {
+            LOG_INFO("roll line=%d\n", rollLines++);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    // 比一个缓冲区还大的行整行丢弃，并且计入droppedBytes
+    std::string huge(8 * 1024 * 1024, 'h');
+    g_asyncLogger->append(huge.data(), huge.size());
+    Logger::instance().setOutput(bufferedOutput);
+    Logger::instance().setFlush(bufferedFlush);
+    g_asyncLogger->stop();
+    countFiles(dir, basename + ".", &files, &written);
+    printf("selftest roll=%s files=%d lines=%ld expected=%d\n",
+           benchCheck(files >= 3 && written == rollLines), files, written, rollLines);
+    printf("selftest oversized_line=%s dropped_bytes=%llu\n",
+           benchCheck(g_asyncLogger->droppedBytes() == huge.size()), (unsigned long long)g_asyncLogger->droppedBytes());
+    delete g_asyncLogger;
+    return benchExitCode();
+}
@@ -0,0 +1,222 @@
+#include "BenchCommon.h"
+#include "TcpServer.h"
+#include "MetricsServer.h"
+#include "Metrics.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+/**
+ * 指标：回显服务器跑一批阻塞客户端，然后通过MetricsServer的/metrics抓取，
+ * 检查连接数、读写字节数和系统调用次数与客户端的实际流量一致
+ * 同时比较单写者计数器和原子加的开销
+ * 用法: ./bench_metrics [port] [ioThreads] [clients] [rounds] [msgSize]
+ */
+using Clock = std::chrono::steady_clock;
+
+static int connectTo(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(fd, (sockaddr *)&addr, sizeof addr) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool readFull(int fd, char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::read(fd, buf, len);
+        if (n <= 0)
+        {
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+// GET /metrics，读到对端关闭为止，返回body
+static std::string scrape(uint16_t port)
+{
+    int fd = connectTo(port);
+    if (fd < 0)
+    {
+        return std::string();
+    }
+    const char request[] = "GET /metrics HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    ::write(fd, request, sizeof request - 1);
+    std::string response;
+    char buf[65536];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof buf)) > 0)
+    {
+        response.append(buf, n);
+    }
+    ::close(fd);
+    size_t body = response.find("\r\n\r\n");
+    return body == std::string::npos ? std::string() : response.substr(body + 4);
+}
+
+// 按指标名（去掉label）汇总所有采样值
+static std::map<std::string, long long> sumByName(const std::string &text, const std::string &server)
+{
+    std::map<std::string, long long> sums;
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        size_t space = line.rfind(' ');
+        size_t brace = line.find('{');
+        std::string name = line.substr(0, std::min(space, brace));
+        // server的指标只统计被测的服务器
+        if (name.compare(0, 15, "mymuduo_server_") == 0 && line.find("server=\"" + server + "\"") == std::string::npos)
+        {
+            continue;
+        }
+        sums[name] += atoll(line.c_str() + space + 1);
+    }
+    return sums;
+}
+
+static void counterCost()
+{
+    const long kIterations = 200000000;
+    MetricCounter counter;
+    auto start = Clock::now();
+    for (long i = 0; i < kIterations; ++i)
+    {
+        counter.add();
+        asm volatile("" ::: "memory");
+    }
+    double single = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / kIterations;
+
+    std::atomic<int64_t> atomicCounter(0);
+    start = Clock::now();
+    for (long i = 0; i < kIterations; ++i)
+    {
+        atomicCounter.fetch_add(1, std::memory_order_relaxed);
+    }
+    double atomic = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / kIterations;
+    printf("bench_metrics mode=counter_cost single_writer_ns=%.2f atomic_add_ns=%.2f value=%lld\n",
+           single, atomic, (long long)(counter.value() + atomicCounter.load()));
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8030;
+    int ioThreads = argc > 2 ? atoi(argv[2]) : 2;
+    int clients = argc > 3 ? atoi(argv[3]) : 16;
+    int rounds = argc > 4 ? atoi(argv[4]) : 1000;
+    int msgSize = argc > 5 ? atoi(argv[5]) : 4096;
+    uint16_t metricsPort = static_cast<uint16_t>(port + 1);
+
+    counterCost();
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "MetricsBench");
+    server.setThreadNum(ioThreads);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf);
+    });
+    server.start();
+    MetricsServer metrics(&loop, InetAddress(metricsPort, "127.0.0.1"), "metrics");
+    metrics.start();
+
+    std::thread driver([&]() {
+        std::vector<int> fds;
+        for (int i = 0; i < clients; ++i)
+        {
+            fds.push_back(connectTo(port));
+        }
+        std::string msg(msgSize, 'x');
+        std::vector<char> reply(msgSize);
+        auto start = Clock::now();
+        bool ok = true;
+        for (int r = 0; r < rounds && ok; ++r)
+        {
+            for (int fd : fds)
+            {
+                ok = ok && fd >= 0 && ::write(fd, msg.data(), msg.size()) == static_cast<ssize_t>(msg.size());
+            }
+            for (int fd : fds)
+            {
+                ok = ok && readFull(fd, reply.data(), reply.size());
+            }
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        long long bytes = static_cast<long long>(clients) * rounds * msgSize;
+        printf("bench_metrics mode=echo io_threads=%d clients=%d rounds=%d msg_size=%d seconds=%.3f mb_per_sec=%.1f complete=%s\n",
+               ioThreads, clients, rounds, msgSize, seconds, bytes / seconds / (1024 * 1024), ok ? "yes" : "no");
+
+        auto scrapeStart = Clock::now();
+        std::string text = scrape(metricsPort);
+        double scrapeUs = std::chrono::duration<double, std::micro>(Clock::now() - scrapeStart).count();
+        std::map<std::string, long long> sums = sumByName(text, "MetricsBench");
+        printf("bench_metrics mode=scrape bytes=%zu us=%.0f\n", text.size(), scrapeUs);
+
+        bool counts = sums["mymuduo_server_connections_accepted_total"] == clients &&
+                      sums["mymuduo_server_connections_active"] == clients &&
+                      sums["mymuduo_server_read_bytes_total"] == bytes &&
+                      sums["mymuduo_server_written_bytes_total"] == bytes &&
+                      sums["mymuduo_server_read_calls_total"] > 0 &&
+                      sums["mymuduo_server_write_calls_total"] > 0 &&
+                      sums["mymuduo_server_output_buffered_bytes"] == 0 &&
+                      sums["mymuduo_loop_wakeups_total"] > 0 &&
+                      sums["mymuduo_loop_functors_total"] > 0;
+        printf("selftest scrape_counts=%s accepted=%lld active=%lld read_bytes=%lld written_bytes=%lld read_calls=%lld write_calls=%lld write_eagain=%lld expected_bytes=%lld\n",
+               benchCheck(counts), sums["mymuduo_server_connections_accepted_total"], sums["mymuduo_server_connections_active"],
+               sums["mymuduo_server_read_bytes_total"], sums["mymuduo_server_written_bytes_total"],
+               sums["mymuduo_server_read_calls_total"], sums["mymuduo_server_write_calls_total"],
+               sums["mymuduo_server_write_eagain_total"], bytes);
+        bool format = text.find("# TYPE mymuduo_server_read_bytes_total counter\n") != std::string::npos &&
+                      text.find("# TYPE mymuduo_server_connections_active gauge\n") != std::string::npos;
+        printf("selftest prometheus_format=%s\n", benchCheck(format));
+
+        for (int fd : fds)
+        {
+            ::close(fd);
+        }
+        // 关闭在io loop中异步完成
+        long long active = -1;
+        for (int i = 0; i < 100 && active != 0; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            active = sumByName(scrape(metricsPort), "MetricsBench")["mymuduo_server_connections_active"];
+        }
+        sums = sumByName(scrape(metricsPort), "MetricsBench");
+        printf("selftest close_counts=%s active=%lld closed=%lld\n",
+               benchCheck(active == 0 && sums["mymuduo_server_connections_closed_total"] == clients),
+               active, sums["mymuduo_server_connections_closed_total"]);
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return benchExitCode();
+}
@@ -0,0 +1,114 @@
+#include "Buffer.h"
+
+#include <benchmark/benchmark.h>
+#include <string>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+// 稳态：追加一个消息再整块取走，不触发扩容和搬移
+static void BM_BufferAppendRetrieveAll(benchmark::State &state)
+{
+    std::string data(state.range(0), 'a');
+    Buffer buf;
+    for (auto _ : state)
+    {
+        buf.append(data);
+        benchmark::DoNotOptimize(buf.peek());
+        buf.retrieveAll();
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_BufferAppendRetrieveAll)->Arg(16)->Arg(256)->Arg(4096)->Arg(65536);
+
+// 新的Buffer用小块追加到total字节，测扩容（vector::resize）的开销
+static void BM_BufferAppendGrow(benchmark::State &state)
+{
+    const size_t total = state.range(0);
+    char chunk[64] = {0};
+    for (auto _ : state)
+    {
+        Buffer buf;
+        for (size_t n = 0; n < total; n += sizeof chunk)
+        {
+            buf.append(chunk, sizeof chunk);
+        }
+        benchmark::DoNotOptimize(buf.peek());
+    }
+    state.SetBytesProcessed(state.iterations() * total);
+}
+BENCHMARK(BM_BufferAppendGrow)->Arg(4096)->Arg(65536)->Arg(1 << 20);
+
+// 每次追加一块、取走同样大小，始终留下residual字节没读完（比如半个消息），
+// 写到尾部以后makeSpace把剩下的数据挪回开头
+static void BM_BufferMakeSpaceCompact(benchmark::State &state)
+{
+    const size_t residual = state.range(0);
+    std::string chunk(512, 'c');
+    Buffer buf;
+    buf.append(std::string(residual, 'r'));
+    for (auto _ : state)
+    {
+        buf.append(chunk);
+        buf.retrieve(chunk.size());
+        benchmark::DoNotOptimize(buf.peek());
+    }
+    state.SetBytesProcessed(state.iterations() * chunk.size());
+}
+BENCHMARK(BM_BufferMakeSpaceCompact)->Arg(0)->Arg(64)->Arg(512);
+
+// codec的常见用法：追加消息体，在前面填长度头，按长度读出来
+static void BM_BufferPrependLength(benchmark::State &state)
+{
+    std::string body(state.range(0), 'b');
+    Buffer buf;
+    for (auto _ : state)
+    {
+        buf.append(body);
+        buf.prependInt32(static_cast<int32_t>(body.size()));
+        int32_t len = buf.readInt32();
+        benchmark::DoNotOptimize(buf.retrieveAsString(len));
+    }
+    state.SetBytesProcessed(state.iterations() * body.size());
+}
+BENCHMARK(BM_BufferPrependLength)->Arg(64)->Arg(4096);
+
+// 对端写入size字节，readFd一次读出，包括readv和栈上extrabuf的拷贝
+static void BM_BufferReadFd(benchmark::State &state)
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
+    {
+        state.SkipWithError("socketpair failed");
+        return;
+    }
+    int sndbuf = 1 << 20;
+    ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof sndbuf);
+    std::string data(state.range(0), 'd');
+    Buffer buf;
+    int savedErrno = 0;
+    for (auto _ : state)
+    {
+        if (::write(fds[0], data.data(), data.size()) != static_cast<ssize_t>(data.size()))
+        {
+            state.SkipWithError("short write");
+            break;
+        }
+        size_t got = 0;
+        while (got < data.size())
+        {
+            ssize_t n = buf.readFd(fds[1], &savedErrno);
+            if (n <= 0)
+            {
+                state.SkipWithError("readFd failed");
+                break;
+            }
+            got += n;
+        }
+        buf.retrieveAll();
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+BENCHMARK(BM_BufferReadFd)->Arg(64)->Arg(4096)->Arg(65536);
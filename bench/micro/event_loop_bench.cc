@@ -0,0 +1,95 @@
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Channel.h"
+#include "Timestamp.h"
+
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+// 从其他线程投递一个functor到空闲的loop，等它执行完再投递下一个：唤醒加一次往返
+static void BM_QueueInLoopLatency(benchmark::State &state)
+{
+    EventLoopThread thread;
+    EventLoop *loop = thread.startLoop();
+    std::atomic<int64_t> done(0);
+    int64_t queued = 0;
+    for (auto _ : state)
+    {
+        ++queued;
+        loop->queueInLoop([&done]() { done.fetch_add(1, std::memory_order_release); });
+        while (done.load(std::memory_order_acquire) != queued)
+        {
+            std::this_thread::yield(); // 单核机器上让出cpu给loop线程
+        }
+    }
+}
+BENCHMARK(BM_QueueInLoopLatency)->UseRealTime();
+
+// 每轮连续投递batch个functor，等全部执行完，测批量投递时的吞吐
+static void BM_QueueInLoopThroughput(benchmark::State &state)
+{
+    const int64_t batch = state.range(0);
+    EventLoopThread thread;
+    EventLoop *loop = thread.startLoop();
+    std::atomic<int64_t> done(0);
+    int64_t queued = 0;
+    for (auto _ : state)
+    {
+        for (int64_t i = 0; i < batch; ++i)
+        {
+            loop->queueInLoop([&done]() { done.store(done.load(std::memory_order_relaxed) + 1, std::memory_order_release); });
+        }
+        queued += batch;
+        while (done.load(std::memory_order_acquire) != queued)
+        {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_QueueInLoopThroughput)->Arg(64)->Arg(1024)->UseRealTime();
+
+// 在loop线程内runInLoop直接执行，对照上面跨线程的开销
+static void BM_RunInLoopSameThread(benchmark::State &state)
+{
+    EventLoop loop;
+    int64_t calls = 0;
+    for (auto _ : state)
+    {
+        loop.runInLoop([&calls]() { ++calls; });
+    }
+    benchmark::DoNotOptimize(calls);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RunInLoopSameThread);
+
+// poller返回以后对一个channel的分发：按revents选回调并调用，tied时多一次weak_ptr::lock
+static void BM_ChannelHandleEvent(benchmark::State &state)
+{
+    const bool tied = state.range(0) != 0;
+    EventLoop loop;
+    int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    Channel channel(&loop, fd);
+    int64_t reads = 0;
+    channel.setReadCallback([&reads](Timestamp) { ++reads; });
+    std::shared_ptr<int> owner = std::make_shared<int>(0);
+    if (tied)
+    {
+        channel.tie(owner);
+    }
+    Timestamp now = Timestamp::now();
+    for (auto _ : state)
+    {
+        channel.set_revents(EPOLLIN);
+        channel.handleEvent(now);
+    }
+    benchmark::DoNotOptimize(reads);
+    state.SetItemsProcessed(state.iterations());
+    ::close(fd);
+}
+BENCHMARK(BM_ChannelHandleEvent)->ArgName("tied")->Arg(0)->Arg(1);
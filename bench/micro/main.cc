@@ -0,0 +1,32 @@
+#include "Logger.h"
+
+#include <benchmark/benchmark.h>
+#include <sys/resource.h>
+
+/**
+ * 核心组件的微基准，基于Google Benchmark
+ * 用法: ./microbench [--benchmark_filter=Buffer] [--benchmark_format=json] [--benchmark_repetitions=5]
+ * 性能相关的改动前后各跑一次，比较两次的json输出
+ */
+int main(int argc, char **argv)
+{
+    // EventLoop的INFO日志会混进结果里
+    Logger::instance().setLogLevel(ERROR);
+
+    // EpollPoller的用例需要上万个fd
+    rlimit rl;
+    if (::getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max)
+    {
+        rl.rlim_cur = rl.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    ::benchmark::Initialize(&argc, argv);
+    if (::benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    ::benchmark::RunSpecifiedBenchmarks();
+    ::benchmark::Shutdown();
+    return 0;
+}
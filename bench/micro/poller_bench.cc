@@ -0,0 +1,137 @@
+#include "EpollPoller.h"
+#include "EventLoop.h"
+#include "Channel.h"
+
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+/**
+ * 不经过EventLoop，直接测一个单独的EpollPoller
+ * Channel只能通过enableXxx()设置关注的事件，而它会注册到所属loop自己的poller上，
+ * 所以先注册到loop再从loop移除：channel保留关注的事件、index回到kNew，之后只交给这里的poller
+ */
+class PollerFixture
+{
+public:
+    PollerFixture(EventLoop *loop, int fds)
+        : poller_(loop)
+    {
+        for (int i = 0; i < fds; ++i)
+        {
+            int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (fd < 0)
+            {
+                break;
+            }
+            channels_.emplace_back(new Channel(loop, fd));
+            channels_.back()->enableReading();
+            loop->removeChannel(channels_.back().get());
+            poller_.updateChannel(channels_.back().get());
+        }
+    }
+    ~PollerFixture()
+    {
+        for (auto &channel : channels_)
+        {
+            poller_.removeChannel(channel.get());
+            ::close(channel->fd());
+        }
+    }
+
+    // 让前n个fd一直可读（不读走计数）
+    void makeReadable(int n)
+    {
+        uint64_t one = 1;
+        for (int i = 0; i < n && i < static_cast<int>(channels_.size()); ++i)
+        {
+            ::write(channels_[i]->fd(), &one, sizeof one);
+        }
+    }
+
+    EpollPoller &poller() { return poller_; }
+    std::vector<std::unique_ptr<Channel>> &channels() { return channels_; }
+
+private:
+    EpollPoller poller_;
+    std::vector<std::unique_ptr<Channel>> channels_;
+};
+
+// 已注册的channel上EPOLL_CTL_MOD，轮流修改fds个channel中的一个
+static void BM_EpollPollerUpdate(benchmark::State &state)
+{
+    EventLoop loop;
+    PollerFixture fixture(&loop, static_cast<int>(state.range(0)));
+    std::vector<std::unique_ptr<Channel>> &channels = fixture.channels();
+    if (channels.size() != static_cast<size_t>(state.range(0)))
+    {
+        state.SkipWithError("not enough fds");
+        return;
+    }
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        fixture.poller().updateChannel(channels[i].get());
+        i = i + 1 == channels.size() ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EpollPollerUpdate)->Arg(1000)->Arg(10000);
+
+// 连接建立和关闭时的注册和注销（EPOLL_CTL_ADD + EPOLL_CTL_DEL，以及channelMap_的插入删除）
+static void BM_EpollPollerAddRemove(benchmark::State &state)
+{
+    EventLoop loop;
+    PollerFixture fixture(&loop, static_cast<int>(state.range(0)));
+    std::vector<std::unique_ptr<Channel>> &channels = fixture.channels();
+    if (channels.size() != static_cast<size_t>(state.range(0)))
+    {
+        state.SkipWithError("not enough fds");
+        return;
+    }
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        fixture.poller().removeChannel(channels[i].get());
+        fixture.poller().updateChannel(channels[i].get());
+        i = i + 1 == channels.size() ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EpollPollerAddRemove)->Arg(1000)->Arg(10000);
+
+// fds个fd中有active个就绪，poll(0)一次并填充activeChannels
+static void BM_EpollPollerPoll(benchmark::State &state)
+{
+    EventLoop loop;
+    PollerFixture fixture(&loop, static_cast<int>(state.range(0)));
+    if (fixture.channels().size() != static_cast<size_t>(state.range(0)))
+    {
+        state.SkipWithError("not enough fds");
+        return;
+    }
+    const int active = static_cast<int>(state.range(1));
+    fixture.makeReadable(active);
+    Poller::ChannelList activeChannels;
+    // events_从16个开始，一次返回满了才翻倍，先让它长到能一次取完
+    for (int i = 0; i < 16; ++i)
+    {
+        activeChannels.clear();
+        fixture.poller().poll(0, &activeChannels);
+    }
+    for (auto _ : state)
+    {
+        activeChannels.clear();
+        fixture.poller().poll(0, &activeChannels);
+        if (static_cast<int>(activeChannels.size()) != active)
+        {
+            state.SkipWithError("unexpected number of active channels");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * active);
+}
+BENCHMARK(BM_EpollPollerPoll)->ArgNames({"fds", "active"})->Args({1000, 1})->Args({1000, 100})->Args({10000, 1})->Args({10000, 1000});
@@ -0,0 +1,23 @@
+#include "Timestamp.h"
+
+#include <benchmark/benchmark.h>
+
+// 每个poll返回和每条日志都会取一次当前时间
+static void BM_TimestampNow(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(Timestamp::now());
+    }
+}
+BENCHMARK(BM_TimestampNow);
+
+static void BM_TimestampToString(benchmark::State &state)
+{
+    Timestamp ts = Timestamp::now();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(ts.ToString());
+    }
+}
+BENCHMARK(BM_TimestampToString);
@@ -0,0 +1,115 @@
+#include "BenchCommon.h"
+#include "TcpServer.h"
+
+#include <stdio.h>
+
+/**
+ * ping-pong往返延迟：每个连接发一个msgSize的消息，收到完整的回显以后记录往返时间再发下一个，
+ * 每个client loop线程一个直方图，结束后合并输出分位数；对列表中的每个连接数各跑一次
+ * 用法: ./bench_pingpong_latency [connectionsList=1,16,64] [msgSize=64] [seconds=3] [ioThreads=1] [clientThreads=1] [port=9200]
+ * 输出: bench_pingpong_latency connections=.. round_trips_per_sec=.. p50_us=.. p90_us=.. p99_us=.. p999_us=.. max_us=.. mean_us=..
+ */
+struct Session
+{
+    int64_t sentNs;
+};
+
+static void runOnce(uint16_t port, int connections, int msgSize, double seconds, int ioThreads, int clientThreads)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "PingPongLatency");
+    server.setThreadNum(ioThreads);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf);
+    });
+    server.start();
+
+    std::thread driver([&]() {
+        std::atomic_int connected(0);
+        std::atomic_bool recording(false);
+        std::atomic_bool running(true);
+        // 直方图和Session只在所属的client loop线程中访问，ClientGroup析构以后才在这里读
+        std::vector<Histogram> histograms(clientThreads);
+        std::vector<Session> sessions(connections);
+        const std::string message(msgSize, 'p');
+        double elapsed = 0;
+        {
+            ClientGroup clients(clientThreads);
+            int index = 0;
+            clients.connect(InetAddress(port, "127.0.0.1"), connections, [&](TcpClient *client, int loopIndex) {
+                Session *session = &sessions[index++];
+                client->setConnectionCallback([&, session](const TcpConnectionPtr &conn) {
+                    if (conn->connected())
+                    {
+                        ++connected;
+                        session->sentNs = benchNowNs();
+                        conn->send(message);
+                    }
+                });
+                client->setMessageCallback([&, session, loopIndex](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+                    if (buf->readableBytes() < static_cast<size_t>(msgSize))
+                    {
+                        return;
+                    }
+                    int64_t now = benchNowNs();
+                    buf->retrieve(msgSize);
+                    if (recording.load(std::memory_order_relaxed))
+                    {
+                        histograms[loopIndex].record(now - session->sentNs);
+                    }
+                    if (running.load(std::memory_order_relaxed))
+                    {
+                        session->sentNs = benchNowNs();
+                        conn->send(message);
+                    }
+                });
+            });
+            if (!benchWaitFor([&]() { return connected == connections; }, 10))
+            {
+                printf("bench_pingpong_latency error=connect_timeout connected=%d\n", connected.load());
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(200)); // 预热
+            recording = true;
+            auto start = BenchClock::now();
+            std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+            recording = false;
+            elapsed = std::chrono::duration<double>(BenchClock::now() - start).count();
+            running = false;
+            clients.disconnect();
+        }
+
+        Histogram total;
+        for (const Histogram &h : histograms)
+        {
+            total.merge(h);
+        }
+        printf("bench_pingpong_latency io_threads=%d client_threads=%d connections=%d msg_size=%d seconds=%.3f round_trips=%llu round_trips_per_sec=%.0f p50_us=%.1f p90_us=%.1f p99_us=%.1f p999_us=%.1f max_us=%.1f mean_us=%.1f\n",
+               ioThreads, clientThreads, connections, msgSize, elapsed, (unsigned long long)total.count(),
+               total.count() / elapsed, total.percentile(50) / 1e3, total.percentile(90) / 1e3,
+               total.percentile(99) / 1e3, total.percentile(99.9) / 1e3, total.max() / 1e3, total.mean() / 1e3);
+        fflush(stdout);
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+}
+
+int main(int argc, char *argv[])
+{
+    benchInit();
+    std::vector<int> connectionsList = benchParseList(argc > 1 ? argv[1] : "1,16,64");
+    int msgSize = benchParseList(argc > 2 ? argv[2] : "64").at(0);
+    double seconds = argc > 3 ? atof(argv[3]) : 3.0;
+    int ioThreads = argc > 4 ? atoi(argv[4]) : 1;
+    int clientThreads = std::max(argc > 5 ? atoi(argv[5]) : 1, 1);
+    uint16_t port = argc > 6 ? static_cast<uint16_t>(atoi(argv[6])) : 9200;
+
+    for (int connections : connectionsList)
+    {
+        runOnce(port++, connections, msgSize, seconds, ioThreads, clientThreads);
+    }
+    return 0;
+}
@@ -0,0 +1,216 @@
+#include "BenchCommon.h"
+#include "TcpServer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+/**
+ * 内核接收时间戳：回显服务器开启SO_TIMESTAMPING，在消息回调中记录poll返回时间和内核接收时间的差；
+ * 检查时间戳有效、不晚于poll返回时间；让io loop在functor里卡住50ms，期间到达的数据延迟应该超过50ms，
+ * 并且/metrics的计数里能看到；最后比较开启和不开启时ping-pong的往返次数
+ * 用法: ./bench_rx_timestamp [port] [clients] [seconds]
+ */
+using Clock = std::chrono::steady_clock;
+
+static int connectTo(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(fd, (sockaddr *)&addr, sizeof addr) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static long pingPong(const std::vector<int> &fds, double seconds)
+{
+    char msg[64];
+    ::memset(msg, 'p', sizeof msg);
+    char reply[64];
+    long rounds = 0;
+    auto deadline = Clock::now() + std::chrono::duration<double>(seconds);
+    while (Clock::now() < deadline)
+    {
+        for (int fd : fds)
+        {
+            ::write(fd, msg, sizeof msg);
+        }
+        for (int fd : fds)
+        {
+            size_t got = 0;
+            while (got < sizeof reply)
+            {
+                ssize_t n = ::read(fd, reply + got, sizeof reply - got);
+                if (n <= 0)
+                {
+                    return rounds;
+                }
+                got += n;
+            }
+            ++rounds;
+        }
+    }
+    return rounds;
+}
+
+struct Delays
+{
+    std::mutex mutex;
+    std::vector<int64_t> us; // 每次读到数据时的调度延迟
+    long invalid = 0;        // 开启了但没有拿到时间戳的次数
+    long negative = 0;       // 内核时间晚于poll返回时间的次数
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        us.clear();
+        invalid = 0;
+        negative = 0;
+    }
+};
+
+static int64_t scrapeValue(const std::string &text, const std::string &name)
+{
+    int64_t sum = 0;
+    size_t pos = 0;
+    while ((pos = text.find(name + "{", pos)) != std::string::npos)
+    {
+        size_t space = text.find("} ", pos);
+        sum += atoll(text.c_str() + space + 2);
+        pos = space;
+    }
+    return sum;
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8070;
+    int clients = argc > 2 ? atoi(argv[2]) : 8;
+    double seconds = argc > 3 ? atof(argv[3]) : 1.0;
+
+    // Timestamp精确到微秒
+    {
+        Timestamp a = Timestamp::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        int64_t diff = timeDifferenceUs(Timestamp::now(), a);
+        std::string s = a.ToString();
+        printf("selftest timestamp_us=%s diff_us=%lld str=%s\n",
+               benchCheck(diff >= 2000 && diff < 1000000 && s.find('.') != std::string::npos), (long long)diff, s.c_str());
+    }
+
+    std::atomic_bool timestamping(false);
+    Delays delays;
+    EventLoop loop;
+    EventLoop *ioLoop = nullptr;
+    TcpServer server(&loop, InetAddress(port), "RxTimestampBench");
+    server.setThreadNum(1);
+    server.setThreadInitcallback([&](EventLoop *l) { ioLoop = l; });
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected() && timestamping)
+        {
+            conn->setReceiveTimestamping(true);
+        }
+    });
+    server.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime) {
+        if (timestamping)
+        {
+            Timestamp kernelTime = conn->kernelReceiveTime();
+            std::lock_guard<std::mutex> lock(delays.mutex);
+            if (!kernelTime.valid())
+            {
+                ++delays.invalid;
+            }
+            else
+            {
+                int64_t delay = timeDifferenceUs(receiveTime, kernelTime);
+                delays.negative += delay < 0;
+                delays.us.push_back(delay);
+            }
+        }
+        conn->send(buf);
+    });
+    server.start();
+
+    std::thread driver([&]() {
+        std::vector<int> fds;
+        for (int i = 0; i < clients; ++i)
+        {
+            fds.push_back(connectTo(port));
+        }
+        pingPong(fds, 0.1);
+        long baseline = pingPong(fds, seconds);
+        printf("bench_rx_timestamp mode=off clients=%d round_trips_per_sec=%.0f\n", clients, baseline / seconds);
+        for (int fd : fds)
+        {
+            ::close(fd);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        // 新连接都开启时间戳
+        timestamping = true;
+        fds.clear();
+        for (int i = 0; i < clients; ++i)
+        {
+            fds.push_back(connectTo(port));
+        }
+        pingPong(fds, 0.1);
+        delays.clear();
+        long stamped = pingPong(fds, seconds);
+        {
+            std::lock_guard<std::mutex> lock(delays.mutex);
+            std::vector<int64_t> sorted = delays.us;
+            std::sort(sorted.begin(), sorted.end());
+            auto pct = [&](double p) { return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, static_cast<size_t>(p / 100 * sorted.size()))]; };
+            printf("bench_rx_timestamp mode=on clients=%d round_trips_per_sec=%.0f samples=%zu delay_p50_us=%lld delay_p99_us=%lld delay_max_us=%lld\n",
+                   clients, stamped / seconds, sorted.size(), (long long)pct(50), (long long)pct(99),
+                   (long long)(sorted.empty() ? 0 : sorted.back()));
+            bool ok = !sorted.empty() && delays.invalid == 0 && delays.negative == 0 && sorted.back() < 1000000;
+            printf("selftest kernel_time=%s samples=%zu invalid=%ld negative=%ld\n",
+                   benchCheck(ok), sorted.size(), delays.invalid, delays.negative);
+        }
+
+        // io loop卡住50ms，期间到达的数据在socket里等待
+        delays.clear();
+        ioLoop->queueInLoop([]() { std::this_thread::sleep_for(std::chrono::milliseconds(50)); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        pingPong(std::vector<int>(1, fds[0]), 0.001);
+        {
+            std::lock_guard<std::mutex> lock(delays.mutex);
+            int64_t delay = delays.us.empty() ? 0 : delays.us[0];
+            printf("selftest stalled_delay=%s delay_us=%lld\n", benchCheck(delay >= 40000), (long long)delay);
+        }
+
+        std::string text = MetricsRegistry::instance().scrape();
+        int64_t sumUs = scrapeValue(text, "mymuduo_server_receive_delay_microseconds_total");
+        int64_t samples = scrapeValue(text, "mymuduo_server_receive_delay_samples_total");
+        printf("selftest metrics=%s samples=%lld avg_delay_us=%.1f\n", benchCheck(samples > 0 && sumUs >= 40000),
+               (long long)samples, samples > 0 ? static_cast<double>(sumUs) / samples : 0.0);
+
+        for (int fd : fds)
+        {
+            ::close(fd);
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return benchExitCode();
+}
@@ -0,0 +1,229 @@
+#include "BenchCommon.h"
+#include "TcpServer.h"
+#include "Tracer.h"
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+/**
+ * 耗时跟踪：回显服务器上跑阻塞的ping-pong客户端，分别在关闭、每100次采样一次、全部记录三种设置下统计往返次数，
+ * 然后导出Chrome trace，检查各个埋点都有记录、嵌套关系正确、采样比例符合设置
+ * 用法: ./bench_trace [port] [ioThreads] [clients] [seconds] [traceFile]
+ */
+using Clock = std::chrono::steady_clock;
+
+static int connectTo(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(fd, (sockaddr *)&addr, sizeof addr) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 每个客户端发一个64字节的消息，等回显以后再发下一个，返回总往返次数
+static long pingPong(const std::vector<int> &fds, double seconds)
+{
+    char msg[64];
+    ::memset(msg, 'p', sizeof msg);
+    char reply[64];
+    long rounds = 0;
+    auto deadline = Clock::now() + std::chrono::duration<double>(seconds);
+    while (Clock::now() < deadline)
+    {
+        for (int fd : fds)
+        {
+            ::write(fd, msg, sizeof msg);
+        }
+        for (int fd : fds)
+        {
+            size_t got = 0;
+            while (got < sizeof reply)
+            {
+                ssize_t n = ::read(fd, reply + got, sizeof reply - got);
+                if (n <= 0)
+                {
+                    return rounds;
+                }
+                got += n;
+            }
+            ++rounds;
+        }
+    }
+    return rounds;
+}
+
+struct Event
+{
+    std::string name;
+    int tid;
+    double ts;
+    double dur;
+};
+
+// 只解析Tracer::dumpJson()输出的格式，每行一个事件
+static std::vector<Event> parseTrace(const std::string &json)
+{
+    std::vector<Event> events;
+    size_t pos = 0;
+    while ((pos = json.find("{\"name\":\"", pos)) != std::string::npos)
+    {
+        Event e;
+        size_t nameEnd = json.find('"', pos + 9);
+        e.name = json.substr(pos + 9, nameEnd - pos - 9);
+        e.ts = atof(json.c_str() + json.find("\"ts\":", pos) + 5);
+        e.dur = atof(json.c_str() + json.find("\"dur\":", pos) + 6);
+        e.tid = atoi(json.c_str() + json.find("\"tid\":", pos) + 6);
+        events.push_back(e);
+        pos = nameEnd;
+    }
+    return events;
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8050;
+    int ioThreads = argc > 2 ? atoi(argv[2]) : 2;
+    int clients = argc > 3 ? atoi(argv[3]) : 8;
+    double seconds = argc > 4 ? atof(argv[4]) : 1.0;
+    std::string traceFile = argc > 5 ? argv[5] : "/tmp/bench_trace.json";
+
+    // 没有采中时一个根span的开销
+    {
+        const long kIterations = 100000000;
+        auto start = Clock::now();
+        for (long i = 0; i < kIterations; ++i)
+        {
+            TRACE_ROOT_SPAN("bench", i);
+        }
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / kIterations;
+        printf("bench_trace mode=disabled_span ns_per_span=%.2f\n", ns);
+    }
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "TraceBench");
+    server.setThreadNum(ioThreads);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf);
+    });
+    server.start();
+
+    std::thread driver([&]() {
+        std::vector<int> fds;
+        for (int i = 0; i < clients; ++i)
+        {
+            fds.push_back(connectTo(port));
+        }
+        pingPong(fds, 0.1); // 预热
+
+        Tracer &tracer = Tracer::instance();
+        std::map<int, long> roundsByPeriod;
+        for (int period : {0, 100, 1})
+        {
+            tracer.setSamplePeriod(period);
+            tracer.clear();
+            long rounds = pingPong(fds, seconds);
+            roundsByPeriod[period] = rounds;
+            printf("bench_trace mode=period_%d io_threads=%d clients=%d seconds=%.1f round_trips_per_sec=%.0f\n",
+                   period, ioThreads, clients, seconds, rounds / seconds);
+        }
+
+        // 全部记录时每次回显都有完整的嵌套
+        tracer.setSamplePeriod(1);
+        tracer.clear();
+        pingPong(fds, 0.2);
+        tracer.setSamplePeriod(0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        bool dumped = tracer.dump(traceFile);
+        FILE *fp = ::fopen(traceFile.c_str(), "r");
+        std::string json;
+        char buf[65536];
+        size_t n;
+        while (fp && (n = ::fread(buf, 1, sizeof buf, fp)) > 0)
+        {
+            json.append(buf, n);
+        }
+        if (fp)
+        {
+            ::fclose(fp);
+        }
+        std::vector<Event> events = parseTrace(json);
+        std::map<std::string, long> counts;
+        for (const Event &e : events)
+        {
+            ++counts[e.name];
+        }
+        // 每个messageCallback都落在同一线程的某个handleRead里，handleRead落在handleEvent里
+        auto within = [&](const Event &inner, const char *outerName) {
+            for (const Event &outer : events)
+            {
+                if (outer.name == outerName && outer.tid == inner.tid &&
+                    outer.ts <= inner.ts && inner.ts + inner.dur <= outer.ts + outer.dur + 0.001)
+                {
+                    return true;
+                }
+            }
+            return false;
+        };
+        long checked = 0;
+        bool nested = true;
+        for (const Event &e : events)
+        {
+            if (checked < 200 && e.name == "messageCallback")
+            {
+                nested = nested && within(e, "TcpConnection::handleRead") && within(e, "Channel::handleEvent");
+                ++checked;
+            }
+        }
+        bool complete = dumped && counts["Channel::handleEvent"] > 0 && counts["TcpConnection::handleRead"] > 0 &&
+                        counts["messageCallback"] > 0 && json.compare(0, 2, "{\"") == 0 && json.find("\n]}") != std::string::npos;
+        printf("selftest trace=%s events=%zu handleEvent=%ld handleRead=%ld messageCallback=%ld handleWrite=%ld functors=%ld file=%s\n",
+               benchCheck(complete), events.size(), counts["Channel::handleEvent"], counts["TcpConnection::handleRead"],
+               counts["messageCallback"], counts["TcpConnection::handleWrite"], counts["EventLoop::doPendingFunctors"],
+               traceFile.c_str());
+        printf("selftest nesting=%s checked=%ld\n", benchCheck(nested && checked > 0), checked);
+
+        // 每100个根span采一个
+        tracer.setSamplePeriod(100);
+        tracer.clear();
+        long rounds = pingPong(fds, 0.3);
+        tracer.setSamplePeriod(0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        events = parseTrace(tracer.dumpJson());
+        long reads = 0;
+        for (const Event &e : events)
+        {
+            reads += e.name == "TcpConnection::handleRead";
+        }
+        // 根span还包括wakeup和functor，被采中的handleRead不超过回显次数的1/100
+        printf("selftest sampling=%s rounds=%ld sampled_reads=%ld\n",
+               benchCheck(reads > 0 && reads <= rounds / 100 + ioThreads), rounds, reads);
+
+        for (int fd : fds)
+        {
+            ::close(fd);
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return benchExitCode();
+}
@@ -0,0 +1,239 @@
+#include "BenchCommon.h"
+#include "UdpServer.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+/**
+ * UDP收包压测：客户端线程用sendmmsg向服务端连续发送小数据报，统计服务端每秒收到的数据报数
+ * ./bench_udp [port] [ioThreads] [senders] [seconds] [msgSize]
+ *   batch=1    每次可读事件只用recvmmsg收一个数据报，相当于逐个recvfrom
+ *   batch=64   每次recvmmsg最多收64个
+ *   gro=on     服务端开启UDP_GRO，客户端用UDP_SEGMENT一次交给内核多个数据报
+ * 开始之前先做回显和sendSegments的自检
+ */
+using Clock = std::chrono::steady_clock;
+
+static int clientSocket(int timeoutMs)
+{
+    int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    timeval tv{timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    int sndbuf = 4 * 1024 * 1024;
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof sndbuf);
+    return fd;
+}
+
+// 回显：发100个不同长度的数据报，逐个检查收到的内容
+static bool echoTest(const InetAddress &serverAddr)
+{
+    int fd = clientSocket(2000);
+    bool ok = true;
+    char buf[2048];
+    for (int i = 0; i < 100 && ok; ++i)
+    {
+        std::string msg(i * 10 + 1, static_cast<char>('a' + i % 26));
+        ::sendto(fd, msg.data(), msg.size(), 0, (const sockaddr *)serverAddr.getSockAddr(), sizeof(sockaddr_in));
+        ssize_t n = ::recv(fd, buf, sizeof buf, 0);
+        ok = n == static_cast<ssize_t>(msg.size()) && ::memcmp(buf, msg.data(), n) == 0;
+    }
+    ::close(fd);
+    return ok;
+}
+
+// 服务端收到"segments"以后用sendSegments回复kSegments个kSegmentSize字节的数据报
+static const int kSegments = 100;
+static const size_t kSegmentSize = 1000;
+
+static bool segmentsTest(const InetAddress &serverAddr)
+{
+    int fd = clientSocket(2000);
+    int rcvbuf = 4 * 1024 * 1024;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof rcvbuf);
+    ::sendto(fd, "segments", 8, 0, (const sockaddr *)serverAddr.getSockAddr(), sizeof(sockaddr_in));
+    char buf[65536];
+    int received = 0;
+    bool ok = true;
+    while (received < kSegments)
+    {
+        ssize_t n = ::recv(fd, buf, sizeof buf, 0);
+        if (n < 0)
+        {
+            ok = false;
+            break;
+        }
+        ok = ok && n == static_cast<ssize_t>(kSegmentSize) && buf[0] == static_cast<char>('A' + received % 26);
+        ++received;
+    }
+    ::close(fd);
+    return ok && received == kSegments;
+}
+
+// 压测客户端：每次sendmmsg发64个数据报，useGso时每个消息用UDP_SEGMENT带16个数据报
+static void sender(const InetAddress &serverAddr, int msgSize, bool useGso, const std::atomic_bool &stop, std::atomic_llong &sent)
+{
+    const int kBatch = 64;
+    const int kGsoSegments = 16;
+    int fd = clientSocket(0);
+    ::connect(fd, (const sockaddr *)serverAddr.getSockAddr(), sizeof(sockaddr_in));
+    int perMessage = useGso ? kGsoSegments : 1;
+    std::vector<char> data(static_cast<size_t>(msgSize) * perMessage, 'x');
+    std::vector<mmsghdr> msgs(kBatch);
+    std::vector<iovec> iovs(kBatch);
+    char control[CMSG_SPACE(sizeof(uint16_t))];
+    ::memset(control, 0, sizeof control);
+    for (int i = 0; i < kBatch; ++i)
+    {
+        iovs[i].iov_base = data.data();
+        iovs[i].iov_len = data.size();
+        ::memset(&msgs[i], 0, sizeof msgs[i]);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        if (useGso)
+        {
+            msgs[i].msg_hdr.msg_control = control;
+            msgs[i].msg_hdr.msg_controllen = sizeof control;
+        }
+    }
+    if (useGso)
+    {
+        cmsghdr *cmsg = CMSG_FIRSTHDR(&msgs[0].msg_hdr);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t segment = static_cast<uint16_t>(msgSize);
+        ::memcpy(CMSG_DATA(cmsg), &segment, sizeof segment);
+    }
+    long long count = 0;
+    while (!stop)
+    {
+        int n = ::sendmmsg(fd, msgs.data(), kBatch, 0);
+        if (n > 0)
+        {
+            count += static_cast<long long>(n) * perMessage;
+        }
+        else if (useGso)
+        {
+            break; // 内核不支持UDP_SEGMENT
+        }
+    }
+    sent += count;
+    ::close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8030;
+    int ioThreads = argc > 2 ? atoi(argv[2]) : 0;
+    int senders = argc > 3 ? atoi(argv[3]) : 1;
+    double seconds = argc > 4 ? atof(argv[4]) : 2;
+    int msgSize = argc > 5 ? atoi(argv[5]) : 64;
+
+    // 自检
+    {
+        EventLoop loop;
+        UdpServer server(&loop, InetAddress(port), "UdpEcho");
+        server.setThreadNum(ioThreads);
+        server.setMessageCallback([](UdpChannel *channel, const char *data, size_t len, const InetAddress &peer, Timestamp) {
+            if (len == 8 && ::memcmp(data, "segments", 8) == 0)
+            {
+                std::string payload;
+                for (int i = 0; i < kSegments; ++i)
+                {
+                    payload.append(kSegmentSize, static_cast<char>('A' + i % 26));
+                }
+                channel->sendSegments(peer, payload.data(), payload.size(), kSegmentSize);
+                return;
+            }
+            channel->send(peer, data, len);
+        });
+        server.start();
+
+        std::thread client([&]() {
+            InetAddress serverAddr(port, "127.0.0.1");
+            printf("selftest echo=%s\n", benchCheck(echoTest(serverAddr)));
+            printf("selftest segments=%s gso=%s\n", benchCheck(segmentsTest(serverAddr)),
+                   server.channels()[0]->gsoSupported() ? "yes" : "no");
+            loop.quit();
+        });
+        loop.loop();
+        client.join();
+    }
+
+    struct Case
+    {
+        const char *name;
+        int batch;
+        bool gro;
+        bool clientGso;
+    };
+    const Case cases[] = {
+        {"batch1", 1, false, false},
+        {"batch64", 64, false, false},
+        {"batch64_gro", 64, true, true},
+    };
+    for (const Case &c : cases)
+    {
+        EventLoop loop;
+        UdpServer server(&loop, InetAddress(port), "UdpBench");
+        server.setThreadNum(ioThreads);
+        server.setBatch(c.batch, UdpChannel::kDefaultBufferSize);
+        server.enableGro(c.gro);
+        server.setMessageCallback([](UdpChannel *, const char *, size_t, const InetAddress &, Timestamp) {});
+        server.start();
+        for (UdpChannel *channel : server.channels())
+        {
+            int rcvbuf = 8 * 1024 * 1024;
+            ::setsockopt(channel->fd(), SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof rcvbuf);
+        }
+
+        std::thread driver([&]() {
+            InetAddress serverAddr(port, "127.0.0.1");
+            std::atomic_bool stop(false);
+            std::atomic_llong sent(0);
+            std::vector<std::thread> threads;
+            auto start = Clock::now();
+            for (int i = 0; i < senders; ++i)
+            {
+                threads.emplace_back(sender, serverAddr, msgSize, c.clientGso, std::cref(stop), std::ref(sent));
+            }
+            std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+            stop = true;
+            for (std::thread &t : threads)
+            {
+                t.join();
+            }
+            // 等服务端把socket缓冲区中剩下的数据报收完
+            for (uint64_t last = ~0ULL; server.receivedDatagrams() != last;)
+            {
+                last = server.receivedDatagrams();
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+            double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+            uint64_t received = server.receivedDatagrams();
+            uint64_t calls = server.receiveCalls();
+            printf("bench_udp mode=%s io_threads=%d senders=%d msg_size=%d seconds=%.3f sent=%lld received=%llu received_pps=%.0f recv_calls=%llu datagrams_per_call=%.1f dropped=%llu\n",
+                   c.name, ioThreads, senders, msgSize, elapsed, sent.load(), (unsigned long long)received,
+                   received / elapsed, (unsigned long long)calls, calls ? static_cast<double>(received) / calls : 0.0,
+                   (unsigned long long)server.droppedDatagrams());
+            loop.quit();
+        });
+        loop.loop();
+        driver.join();
+    }
+    return benchExitCode();
+}
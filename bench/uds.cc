@@ -0,0 +1,243 @@
+#include "BenchCommon.h"
+#include "TcpServer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+/**
+ * 同一台机器上loopback TCP和unix域socket的对比
+ * 服务端是echo的TcpServer，客户端用阻塞socket：
+ *   latency    每次发msgSize字节等回显，统计往返时间的平均值和分位数
+ *   throughput 每次发64K字节等回显，统计每秒往返的字节数
+ * 开始之前用TcpClient连到unix域地址，双向各传一个memfd，验证SCM_RIGHTS
+ * 用法: ./bench_uds [port] [unixPath] [rounds] [msgSize] [seconds]
+ */
+using Clock = std::chrono::steady_clock;
+
+static int connectBlocking(const InetAddress &addr)
+{
+    int fd = ::socket(addr.family(), SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (::connect(fd, addr.sockAddr(), addr.sockAddrLen()) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    if (!addr.isUnix())
+    {
+        int on = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+    }
+    return fd;
+}
+
+static bool roundTrip(int fd, const std::string &msg, std::string *reply)
+{
+    if (::write(fd, msg.data(), msg.size()) != static_cast<ssize_t>(msg.size()))
+    {
+        return false;
+    }
+    size_t got = 0;
+    while (got < msg.size())
+    {
+        ssize_t n = ::read(fd, &(*reply)[got], msg.size() - got);
+        if (n <= 0)
+        {
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+
+static void latency(const char *transport, const InetAddress &addr, int rounds, int msgSize)
+{
+    int fd = connectBlocking(addr);
+    std::string msg(msgSize, 'l');
+    std::string reply(msgSize, '\0');
+    std::vector<double> samples;
+    samples.reserve(rounds);
+    for (int i = 0; i < rounds && fd >= 0; ++i)
+    {
+        auto start = Clock::now();
+        if (!roundTrip(fd, msg, &reply))
+        {
+            break;
+        }
+        samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    ::close(fd);
+    printf("selftest %s_round_trips=%s rounds=%zu\n", transport,
+           benchCheck(samples.size() == static_cast<size_t>(rounds)), samples.size());
+    if (samples.empty())
+    {
+        return;
+    }
+    double sum = 0;
+    for (double s : samples)
+    {
+        sum += s;
+    }
+    std::sort(samples.begin(), samples.end());
+    printf("bench_uds transport=%s mode=latency msg_size=%d rounds=%zu avg_us=%.2f p50_us=%.2f p99_us=%.2f\n",
+           transport, msgSize, samples.size(), sum / samples.size(),
+           samples[samples.size() / 2], samples[samples.size() * 99 / 100]);
+}
+
+static void throughput(const char *transport, const InetAddress &addr, double seconds)
+{
+    const int kBlock = 64 * 1024;
+    int fd = connectBlocking(addr);
+    std::string msg(kBlock, 't');
+    std::string reply(kBlock, '\0');
+    long long bytes = 0;
+    auto start = Clock::now();
+    double elapsed = 0;
+    while (fd >= 0 && elapsed < seconds)
+    {
+        if (!roundTrip(fd, msg, &reply))
+        {
+            break;
+        }
+        bytes += kBlock;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    ::close(fd);
+    printf("bench_uds transport=%s mode=throughput block=%d seconds=%.3f mb_per_sec=%.1f\n",
+           transport, kBlock, elapsed, elapsed > 0 ? bytes / elapsed / (1024 * 1024) : 0.0);
+}
+
+static int memfdWith(const std::string &content)
+{
+    int fd = ::memfd_create("udsbench", MFD_CLOEXEC);
+    ::write(fd, content.data(), content.size());
+    return fd;
+}
+
+static std::string readFdContent(int fd)
+{
+    char buf[128];
+    ssize_t n = ::pread(fd, buf, sizeof buf, 0);
+    return n > 0 ? std::string(buf, n) : std::string();
+}
+
+// 客户端传给服务端一个memfd，服务端读出内容回复，再传回一个自己的memfd
+static bool fdPassingTest(const InetAddress &unixAddr)
+{
+    EventLoopThread thread(EventLoopThread::ThreadInitCallback(), "fdclient");
+    EventLoop *loop = thread.startLoop();
+    std::promise<bool> result;
+    std::string reply;
+    std::unique_ptr<TcpClient> client;
+    loop->runInLoop([&]() {
+        client.reset(new TcpClient(loop, unixAddr, "FdClient"));
+        client->setConnectionCallback([](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                int fd = memfdWith("from client");
+                conn->sendFd(fd, "F");
+                ::close(fd);
+            }
+        });
+        client->setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            reply += buf->retrieveAllAsString();
+            if (reply.size() < strlen("from client"))
+            {
+                return;
+            }
+            std::vector<int> fds = conn->takePassedFds();
+            bool ok = reply == "from client" && fds.size() == 1 && readFdContent(fds[0]) == "from server";
+            for (int fd : fds)
+            {
+                ::close(fd);
+            }
+            result.set_value(ok);
+        });
+        client->connect();
+    });
+    std::future<bool> future = result.get_future();
+    bool ok = future.wait_for(std::chrono::seconds(5)) == std::future_status::ready && future.get();
+    std::promise<void> done;
+    loop->runInLoop([&]() {
+        client.reset();
+        done.set_value();
+    });
+    done.get_future().wait();
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8040;
+    std::string path = argc > 2 ? argv[2] : "/tmp/udsbench.sock";
+    int rounds = argc > 3 ? atoi(argv[3]) : 20000;
+    int msgSize = argc > 4 ? atoi(argv[4]) : 64;
+    double seconds = argc > 5 ? atof(argv[5]) : 2;
+
+    EventLoopThread serverThread(EventLoopThread::ThreadInitCallback(), "server");
+    EventLoop *serverLoop = serverThread.startLoop();
+
+    InetAddress tcpAddr(port, "127.0.0.1");
+    InetAddress unixAddr = InetAddress::unixDomain(path);
+    std::unique_ptr<TcpServer> tcpServer;
+    std::unique_ptr<TcpServer> unixServer;
+    auto onMessage = [](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        std::vector<int> fds = conn->takePassedFds();
+        if (!fds.empty())
+        {
+            // 收到fd的那一段数据是"F"，回复fd中的内容并传回一个fd
+            buf->retrieve(1);
+            int fd = memfdWith("from server");
+            conn->sendFd(fd, readFdContent(fds[0]));
+            ::close(fd);
+            for (int passed : fds)
+            {
+                ::close(passed);
+            }
+        }
+        conn->send(buf);
+    };
+    std::promise<void> started;
+    serverLoop->runInLoop([&]() {
+        tcpServer.reset(new TcpServer(serverLoop, tcpAddr, "TcpEcho"));
+        unixServer.reset(new TcpServer(serverLoop, unixAddr, "UnixEcho"));
+        for (TcpServer *server : {tcpServer.get(), unixServer.get()})
+        {
+            server->setConnectionCallback([](const TcpConnectionPtr &) {});
+            server->setMessageCallback(onMessage);
+            server->start();
+        }
+        started.set_value();
+    });
+    started.get_future().wait();
+
+    printf("selftest address=%s\n", benchCheck(unixServer->ipPort() == "unix:" + path));
+    printf("selftest fd_passing=%s\n", benchCheck(fdPassingTest(unixAddr)));
+
+    latency("tcp", tcpAddr, rounds, msgSize);
+    latency("unix", unixAddr, rounds, msgSize);
+    throughput("tcp", tcpAddr, seconds);
+    throughput("unix", unixAddr, seconds);
+
+    std::promise<void> stopped;
+    serverLoop->runInLoop([&]() {
+        tcpServer.reset();
+        unixServer.reset();
+        stopped.set_value();
+    });
+    stopped.get_future().wait();
+    printf("selftest socket_file_removed=%s\n", benchCheck(::access(path.c_str(), F_OK) != 0));
+    return benchExitCode();
+}
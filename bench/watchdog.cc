@@ -0,0 +1,210 @@
+#include "BenchCommon.h"
+#include "TcpServer.h"
+#include "LoopWatchdog.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+/**
+ * 卡住的loop检测：回显服务器收到"stall"时在消息回调里sleep，检查watchdog报告了正确的loop、连接名、回调类型和调用栈；
+ * 再在io loop的functor里sleep，检查回调类型；最后比较开启和不开启watchdog时ping-pong的往返次数
+ * 调用栈的函数名需要用-rdynamic链接
+ * 用法: ./bench_watchdog [port] [ioThreads] [clients] [seconds]
+ */
+using Clock = std::chrono::steady_clock;
+
+static int connectTo(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(fd, (sockaddr *)&addr, sizeof addr) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static long pingPong(const std::vector<int> &fds, double seconds)
+{
+    char msg[64];
+    ::memset(msg, 'p', sizeof msg);
+    char reply[64];
+    long rounds = 0;
+    auto deadline = Clock::now() + std::chrono::duration<double>(seconds);
+    while (Clock::now() < deadline)
+    {
+        for (int fd : fds)
+        {
+            ::write(fd, msg, sizeof msg);
+        }
+        for (int fd : fds)
+        {
+            size_t got = 0;
+            while (got < sizeof reply)
+            {
+                ssize_t n = ::read(fd, reply + got, sizeof reply - got);
+                if (n <= 0)
+                {
+                    return rounds;
+                }
+                got += n;
+            }
+            ++rounds;
+        }
+    }
+    return rounds;
+}
+
+// 不内联，调用栈中能看到它
+__attribute__((noinline)) void stallingCallback(int ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    asm volatile("" ::: "memory");
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8060;
+    int ioThreads = argc > 2 ? atoi(argv[2]) : 2;
+    int clients = argc > 3 ? atoi(argv[3]) : 8;
+    double seconds = argc > 4 ? atof(argv[4]) : 1.0;
+
+    // loop线程每个回调多出来的开销
+    {
+        const long kIterations = 100000000;
+        LoopActivity activity(CurrentThread::tid());
+        auto start = Clock::now();
+        for (long i = 0; i < kIterations; ++i)
+        {
+            activity.enter(LoopActivity::kChannelEvent, nullptr);
+            asm volatile("" ::: "memory");
+            activity.leave();
+        }
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / kIterations;
+        printf("bench_watchdog mode=marker_cost ns_per_callback=%.2f seq=%llu\n", ns,
+               (unsigned long long)activity.seq.load());
+    }
+
+    std::mutex mutex;
+    std::vector<LoopWatchdog::StallReport> reports;
+    LoopWatchdog watchdog(0.1);
+    watchdog.setStallCallback([&](const LoopWatchdog::StallReport &r) {
+        std::lock_guard<std::mutex> lock(mutex);
+        reports.push_back(r);
+    });
+
+    EventLoop loop;
+    std::vector<EventLoop *> ioLoops;
+    TcpServer server(&loop, InetAddress(port), "WatchdogBench");
+    server.setThreadNum(ioThreads);
+    server.setThreadInitcallback([&](EventLoop *ioLoop) {
+        watchdog.watch(ioLoop);
+        std::lock_guard<std::mutex> lock(mutex);
+        ioLoops.push_back(ioLoop);
+    });
+    std::atomic<pid_t> stallTid(0);
+    std::string stallConn;
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        if (buf->readableBytes() == 5 && ::memcmp(buf->peek(), "stall", 5) == 0)
+        {
+            stallConn = conn->name();
+            stallTid = CurrentThread::tid();
+            stallingCallback(300);
+        }
+        conn->send(buf);
+    });
+    server.start();
+    watchdog.watch(&loop);
+
+    std::thread driver([&]() {
+        std::vector<int> fds;
+        for (int i = 0; i < clients; ++i)
+        {
+            fds.push_back(connectTo(port));
+        }
+        pingPong(fds, 0.1);
+
+        long baseline = pingPong(fds, seconds);
+        printf("bench_watchdog mode=no_watchdog io_threads=%d clients=%d round_trips_per_sec=%.0f\n",
+               ioThreads, clients, baseline / seconds);
+        watchdog.start();
+        long watched = pingPong(fds, seconds);
+        printf("bench_watchdog mode=watchdog io_threads=%d clients=%d round_trips_per_sec=%.0f\n",
+               ioThreads, clients, watched / seconds);
+
+        // 连接的消息回调卡住300ms
+        ::write(fds[0], "stall", 5);
+        char reply[5];
+        ::read(fds[0], reply, sizeof reply);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            bool found = reports.size() == 1;
+            bool inCallback = false;
+            bool inEventLoop = false;
+            if (found)
+            {
+                const LoopWatchdog::StallReport &r = reports[0];
+                for (const std::string &frame : r.backtrace)
+                {
+                    inCallback = inCallback || frame.find("stallingCallback") != std::string::npos;
+                    inEventLoop = inEventLoop || frame.find("EventLoop") != std::string::npos;
+                }
+                found = r.loopTid == stallTid && r.owner == stallConn && ::strcmp(r.callbackType, "channel event") == 0 &&
+                        r.fd >= 0 && !r.backtrace.empty() && r.stalledSeconds >= 0.1;
+            }
+            printf("selftest stall_event=%s reports=%zu owner=%s frames=%zu stalled_ms=%.0f symbols=%s\n",
+                   benchCheck(found), reports.size(), reports.empty() ? "-" : reports[0].owner.c_str(),
+                   reports.empty() ? 0 : reports[0].backtrace.size(),
+                   reports.empty() ? 0.0 : reports[0].stalledSeconds * 1000,
+                   inCallback && inEventLoop ? "yes" : "no(link with -rdynamic)");
+        }
+
+        // io loop的functor卡住200ms
+        EventLoop *ioLoop;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ioLoop = ioLoops[0];
+        }
+        ioLoop->queueInLoop([]() { stallingCallback(200); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            bool found = reports.size() == 2 && ::strcmp(reports[1].callbackType, "pending functor") == 0 &&
+                         reports[1].fd == -1 && reports[1].owner.empty() && !reports[1].backtrace.empty();
+            printf("selftest stall_functor=%s reports=%zu\n", benchCheck(found), reports.size());
+        }
+
+        // 正常处理时不误报
+        pingPong(fds, 0.3);
+        printf("selftest no_false_positive=%s stalls=%llu\n", benchCheck(watchdog.stalls() == 2),
+               (unsigned long long)watchdog.stalls());
+
+        for (int fd : fds)
+        {
+            ::close(fd);
+        }
+        watchdog.stop();
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return benchExitCode();
+}
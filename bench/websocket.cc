@@ -0,0 +1,449 @@
+#include "BenchCommon.h"
+#include "WebSocketServer.h"
+#include "WebSocketKernels.h"
+#include "PerMessageDeflate.h"
+#include "HttpRequest.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <endian.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+/**
+ * websocket的吞吐压测
+ * ./bench_websocket [port] [ioThreads] [clients] [seconds]
+ *   1. 解掩码和UTF-8校验内核：标量/SSE2/AVX2分别在小帧和大帧上的MB/s，并对比各实现的结果
+ *   2. 用阻塞socket验证握手、分片、ping/pong、非法UTF-8和超长消息的关闭码、permessage-deflate
+ *   3. 端到端回显：clients个客户端线程，每条连接保持pipeline个在途消息，分别测试不压缩和压缩
+ */
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// 带少量多字节字符的文本，接近聊天/JSON这类真实负载
+static std::string makeText(size_t len)
+{
+    static const char *kPieces[] = {"{\"id\":12345,", "\"msg\":\"hello\",", "\"name\":\"\xe5\xbc\xa0\xe4\xb8\x89\",", "\"ok\":true}", "\xf0\x9f\x98\x80 "};
+    std::string text;
+    for (size_t i = 0; text.size() < len; ++i)
+    {
+        text.append(kPieces[i % 5]);
+    }
+    // 截断到len，不能截在多字节字符中间
+    size_t end = len;
+    while (end > 0 && (static_cast<unsigned char>(text[end]) & 0xc0) == 0x80)
+    {
+        --end;
+    }
+    text.resize(end);
+    return text;
+}
+
+static void benchKernels()
+{
+    const char mask[4] = {0x12, 0x34, 0x56, 0x78};
+    WebSocketKernels::Isa best = WebSocketKernels::detectIsa();
+    const size_t sizes[] = {125, 1024 * 1024};
+
+    bool ok = true;
+    for (size_t size : sizes)
+    {
+        std::string text = makeText(size);
+        // 各个实现的结果必须一致，长度覆盖所有尾部处理分支
+        for (size_t len = 0; len < 200 && len <= text.size(); ++len)
+        {
+            std::string expect(text, 0, len);
+            WebSocketKernels::unmask(&expect[0], len, mask, WebSocketKernels::kScalar);
+            for (int isa = WebSocketKernels::kSse2; isa <= best; ++isa)
+            {
+                std::string got(text, 0, len);
+                WebSocketKernels::unmask(&got[0], len, mask, static_cast<WebSocketKernels::Isa>(isa));
+                bool valid = WebSocketKernels::validateUtf8(text.data(), len, static_cast<WebSocketKernels::Isa>(isa));
+                ok = ok && got == expect && valid == WebSocketKernels::validateUtf8(text.data(), len, WebSocketKernels::kScalar);
+            }
+        }
+
+        for (int isa = WebSocketKernels::kScalar; isa <= best; ++isa)
+        {
+            WebSocketKernels::Isa which = static_cast<WebSocketKernels::Isa>(isa);
+            std::string data = text;
+            size_t iterations = (size_t(1) << 30) / size;
+
+            auto start = Clock::now();
+            for (size_t i = 0; i < iterations; ++i)
+            {
+                WebSocketKernels::unmask(&data[0], data.size(), mask, which);
+            }
+            double unmaskSeconds = secondsSince(start);
+
+            start = Clock::now();
+            size_t valid = 0;
+            for (size_t i = 0; i < iterations; ++i)
+            {
+                valid += WebSocketKernels::validateUtf8(text.data(), text.size(), which);
+            }
+            double utf8Seconds = secondsSince(start);
+
+            double mb = static_cast<double>(size) * iterations / (1024 * 1024);
+            printf("bench_websocket test=kernel isa=%s frame_bytes=%zu unmask_mb_per_sec=%.0f utf8_mb_per_sec=%.0f utf8_valid=%s\n",
+                   WebSocketKernels::isaName(which), size, mb / unmaskSeconds, mb / utf8Seconds,
+                   valid == iterations ? "yes" : "no");
+        }
+    }
+
+    // 过长编码、代理对、超过U+10FFFF、被截断的序列
+    const char *invalid[] = {"\xc0\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xe4\xb8", "\xff"};
+    for (const char *s : invalid)
+    {
+        std::string padded = std::string(40, 'a') + s + std::string(40, 'a');
+        for (int isa = WebSocketKernels::kScalar; isa <= best; ++isa)
+        {
+            ok = ok && !WebSocketKernels::validateUtf8(padded.data(), padded.size(), static_cast<WebSocketKernels::Isa>(isa));
+        }
+    }
+    // 随机改写合法文本中的字节，各实现的判断必须和标量实现一致
+    std::mt19937 rng(12345);
+    std::string text = makeText(4096);
+    for (int round = 0; round < 100000 && ok; ++round)
+    {
+        size_t len = rng() % 300;
+        std::string s(text, rng() % (text.size() - len), len);
+        for (int k = rng() % 3; k >= 0 && len > 0; --k)
+        {
+            s[rng() % len] = static_cast<char>(rng() % 2 ? 0x80 | (rng() & 0x7f) : rng());
+        }
+        bool expect = WebSocketKernels::validateUtf8(s.data(), len, WebSocketKernels::kScalar);
+        for (int isa = WebSocketKernels::kSse2; isa <= best; ++isa)
+        {
+            ok = ok && expect == WebSocketKernels::validateUtf8(s.data(), len, static_cast<WebSocketKernels::Isa>(isa));
+        }
+    }
+    printf("selftest kernels=%s\n", benchCheck(ok));
+}
+
+/**
+ * 阻塞的websocket客户端，按协议要求给每一帧加掩码
+ */
+class Client
+{
+public:
+    explicit Client(uint16_t port) : fd_(::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)), rng_(port)
+    {
+        sockaddr_in addr;
+        ::memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+        ::connect(fd_, (sockaddr *)&addr, sizeof addr);
+    }
+    ~Client() { ::close(fd_); }
+
+    // 返回握手应答的头部
+    std::string handshake(const std::string &extra)
+    {
+        std::string request = "GET /chat HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                              "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n" +
+                              extra + "\r\n";
+        writeAll(request.data(), request.size());
+        std::string header = readHeader();
+        deflate_ = header.find("permessage-deflate") != std::string::npos;
+        return header;
+    }
+
+    std::string readHeader()
+    {
+        size_t end;
+        while ((end = in_.find("\r\n\r\n")) == std::string::npos && fill())
+        {
+        }
+        std::string header = in_.substr(0, end == std::string::npos ? in_.size() : end + 4);
+        in_.erase(0, header.size());
+        return header;
+    }
+
+    void appendFrame(std::string *out, int opcode, const std::string &payload, bool fin = true)
+    {
+        std::string data = payload;
+        bool compressed = false;
+        if (deflate_ && opcode < 8 && fin)
+        {
+            data.clear();
+            compressed = PerMessageDeflate::compress(payload.data(), payload.size(), &data);
+        }
+        out->push_back(static_cast<char>((fin ? 0x80 : 0) | (compressed ? 0x40 : 0) | opcode));
+        if (data.size() < 126)
+        {
+            out->push_back(static_cast<char>(0x80 | data.size()));
+        }
+        else if (data.size() <= 0xffff)
+        {
+            out->push_back(static_cast<char>(0x80 | 126));
+            uint16_t be16 = htobe16(static_cast<uint16_t>(data.size()));
+            out->append(reinterpret_cast<char *>(&be16), 2);
+        }
+        else
+        {
+            out->push_back(static_cast<char>(0x80 | 127));
+            uint64_t be64 = htobe64(data.size());
+            out->append(reinterpret_cast<char *>(&be64), 8);
+        }
+        uint32_t m = rng_();
+        char mask[4];
+        ::memcpy(mask, &m, 4);
+        out->append(mask, 4);
+        size_t begin = out->size();
+        out->append(data);
+        WebSocketKernels::unmask(&(*out)[begin], data.size(), mask);
+    }
+
+    void sendFrame(int opcode, const std::string &payload, bool fin = true)
+    {
+        std::string frame;
+        appendFrame(&frame, opcode, payload, fin);
+        writeAll(frame.data(), frame.size());
+    }
+
+    void writeAll(const char *data, size_t len)
+    {
+        while (len > 0)
+        {
+            ssize_t n = ::write(fd_, data, len);
+            if (n <= 0)
+            {
+                return;
+            }
+            data += n;
+            len -= n;
+        }
+    }
+
+    // 读一帧，连接关闭时返回-1
+    int readFrame(std::string *payload)
+    {
+        while (true)
+        {
+            if (in_.size() >= 2)
+            {
+                const unsigned char *p = reinterpret_cast<const unsigned char *>(in_.data());
+                size_t header = 2;
+                uint64_t len = p[1] & 0x7f;
+                if (len == 126 && in_.size() >= 4)
+                {
+                    uint16_t be16;
+                    ::memcpy(&be16, p + 2, 2);
+                    len = be16toh(be16);
+                    header = 4;
+                }
+                else if (len == 127 && in_.size() >= 10)
+                {
+                    uint64_t be64;
+                    ::memcpy(&be64, p + 2, 8);
+                    len = be64toh(be64);
+                    header = 10;
+                }
+                if ((p[1] & 0x7f) < 126 || header > 2)
+                {
+                    if (in_.size() >= header + len)
+                    {
+                        int opcode = p[0] & 0x0f;
+                        payload->clear();
+                        if (p[0] & 0x40)
+                        {
+                            PerMessageDeflate::decompress(in_.data() + header, len, payload, 64 * 1024 * 1024);
+                        }
+                        else
+                        {
+                            payload->assign(in_, header, len);
+                        }
+                        in_.erase(0, header + len);
+                        return opcode;
+                    }
+                }
+            }
+            if (!fill())
+            {
+                return -1;
+            }
+        }
+    }
+
+    // close帧中的关闭码
+    static int closeCode(const std::string &payload)
+    {
+        if (payload.size() < 2)
+        {
+            return 0;
+        }
+        return (static_cast<unsigned char>(payload[0]) << 8) | static_cast<unsigned char>(payload[1]);
+    }
+
+private:
+    bool fill()
+    {
+        char buf[65536];
+        ssize_t n = ::read(fd_, buf, sizeof buf);
+        if (n <= 0)
+        {
+            return false;
+        }
+        in_.append(buf, n);
+        return true;
+    }
+
+    int fd_;
+    std::mt19937 rng_;
+    std::string in_;
+    bool deflate_ = false;
+};
+
+static void selfTest(uint16_t port)
+{
+    std::string payload;
+    {
+        Client client(port);
+        std::string header = client.handshake("");
+        // RFC 6455 1.3节给出的示例
+        printf("selftest handshake=%s\n",
+               benchCheck(header.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") != std::string::npos));
+
+        // ping穿插在分片消息中间
+        client.sendFrame(0x1, "hello, ", false);
+        client.sendFrame(0x9, "are you there");
+        client.sendFrame(0x0, "\xe4\xb8\x96\xe7\x95\x8c");
+        bool ok = client.readFrame(&payload) == 0xa && payload == "are you there";
+        ok = ok && client.readFrame(&payload) == 0x1 && payload == "hello, \xe4\xb8\x96\xe7\x95\x8c";
+        printf("selftest fragment_ping=%s\n", benchCheck(ok));
+
+        client.sendFrame(0x8, std::string("\x03\xe8", 2));
+        ok = client.readFrame(&payload) == 0x8 && Client::closeCode(payload) == 1000 && client.readFrame(&payload) == -1;
+        printf("selftest close=%s\n", benchCheck(ok));
+    }
+    {
+        Client client(port);
+        client.handshake("");
+        client.sendFrame(0x1, "bad \xc0\xaf utf8");
+        bool ok = client.readFrame(&payload) == 0x8 && Client::closeCode(payload) == 1007;
+        printf("selftest invalid_utf8=%s\n", benchCheck(ok));
+    }
+    {
+        Client client(port);
+        client.handshake("");
+        client.sendFrame(0x2, std::string(2 * 1024 * 1024, 'x'));
+        bool ok = client.readFrame(&payload) == 0x8 && Client::closeCode(payload) == 1009;
+        printf("selftest too_big=%s\n", benchCheck(ok));
+    }
+    {
+        Client client(port);
+        std::string header = client.handshake("Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits\r\n");
+        std::string text = makeText(64 * 1024);
+        client.sendFrame(0x1, text);
+        bool ok = header.find("permessage-deflate") != std::string::npos || !PerMessageDeflate::available();
+        ok = ok && client.readFrame(&payload) == 0x1 && payload == text;
+        printf("selftest deflate=%s\n", benchCheck(ok));
+    }
+    {
+        Client client(port);
+        std::string header = client.handshake("Sec-WebSocket-Extensions: permessage-deflate; server_max_window_bits=10\r\n");
+        printf("selftest deflate_declined=%s\n", benchCheck(header.find("permessage-deflate") == std::string::npos));
+    }
+    {
+        Client client(port);
+        client.writeAll("GET / HTTP/1.1\r\nHost: localhost\r\n\r\n", 35);
+        std::string header = client.readHeader();
+        printf("selftest not_upgrade=%s\n", benchCheck(header.compare(0, 12, "HTTP/1.1 426") == 0));
+    }
+}
+
+static void echoBench(uint16_t port, int clients, double seconds, bool deflate, size_t size)
+{
+    const int pipeline = 16;
+    std::atomic_llong messages(0);
+    std::atomic_bool stop(false);
+    std::string text = makeText(size);
+
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < clients; ++i)
+    {
+        threads.emplace_back([&]() {
+            Client client(port);
+            client.handshake(deflate ? "Sec-WebSocket-Extensions: permessage-deflate\r\n" : "");
+            std::string batch;
+            for (int j = 0; j < pipeline; ++j)
+            {
+                client.appendFrame(&batch, 0x1, text);
+            }
+            std::string payload;
+            long long count = 0;
+            while (!stop)
+            {
+                client.writeAll(batch.data(), batch.size());
+                for (int j = 0; j < pipeline; ++j)
+                {
+                    if (client.readFrame(&payload) != 0x1 || payload.size() != text.size())
+                    {
+                        fprintf(stderr, "echo mismatch\n");
+                        return;
+                    }
+                }
+                count += pipeline;
+            }
+            messages += count;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+    double elapsed = secondsSince(start);
+    printf("bench_websocket test=echo deflate=%s frame_bytes=%zu clients=%d pipeline=%d seconds=%.3f messages=%lld messages_per_sec=%.0f mb_per_sec=%.1f\n",
+           deflate ? "on" : "off", text.size(), clients, pipeline, elapsed, messages.load(),
+           messages / elapsed, messages * text.size() / elapsed / (1024 * 1024));
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8010;
+    int ioThreads = argc > 2 ? atoi(argv[2]) : 2;
+    int clients = argc > 3 ? atoi(argv[3]) : 4;
+    double seconds = argc > 4 ? atof(argv[4]) : 2;
+
+    benchKernels();
+
+    EventLoop loop;
+    WebSocketServer server(&loop, InetAddress(port), "WsBench");
+    server.setThreadNum(ioThreads);
+    server.setMaxMessageSize(1024 * 1024);
+    server.enableCompression(true);
+    server.setMessageCallback([&server](const TcpConnectionPtr &conn, std::string_view message, bool binary, Timestamp) {
+        server.send(conn, message, binary);
+    });
+    server.start();
+
+    std::thread driver([&]() {
+        selfTest(port);
+        echoBench(port, clients, seconds, false, 64);
+        echoBench(port, clients, seconds, false, 64 * 1024);
+        echoBench(port, clients, seconds, true, 64 * 1024);
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return benchExitCode();
+}
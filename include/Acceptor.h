@@ -5,15 +5,24 @@
 #include "Socket.h"
 #include "Channel.h"
 
+#include "InetAddress.h"
+
 #include <functional>
+#include <string>
+#include <vector>
+#include <utility>
 
 class EventLoop;
-class InetAddress;
 
 class Acceptor : noncopyable
 {
 public:
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress&)>;
+    using NewConnectionList = std::vector<std::pair<int, InetAddress>>;
+    using NewConnectionBatchCallback = std::function<void(const NewConnectionList&)>;
+
+    static const int kDefaultMaxAcceptPerRead = 64;
+
     Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport);
     ~Acceptor();
 
@@ -22,16 +31,32 @@ public:
         newConnectionCallback_ = cb;
     }
 
+    // 设置以后，一次可读事件中accept到的所有连接一起回调，优先于newConnectionCallback_
+    void setNewConnectionBatchCallback(const NewConnectionBatchCallback &cb)
+    {
+        newConnectionBatchCallback_ = cb;
+    }
+
+    // 每次可读事件最多accept的连接数
+    void setMaxAcceptPerRead(int n) { maxAcceptPerRead_ = n > 0 ? n : 1; }
+
     bool listenning() const { return listenning_; }
     void listen();
 private:
     void handleRead();
+    // fd耗尽时，借用预留的idleFd_把连接accept下来再关闭，避免LT模式下listenfd一直可读导致busy loop
+    void handleFdExhausted();
     
     EventLoop *loop_; // Acceptor用的就是用户定义的那个baseLoop，也称作mainLoop
     Socket acceptSocket_;
     Channel acceptChannel_;
     NewConnectionCallback newConnectionCallback_;
+    NewConnectionBatchCallback newConnectionBatchCallback_;
     bool listenning_;
+    int maxAcceptPerRead_;
+    int idleFd_; // 预留的空闲fd
+    NewConnectionList pendingConns_; // 本次可读事件accept到的连接
+    std::string unixPath_; // 监听unix域地址时创建的socket文件，析构时删除
 };
 
 #endif
@@ -0,0 +1,97 @@
+#ifndef ASYNCLOGGER_H
+#define ASYNCLOGGER_H
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <sys/types.h>
+
+/**
+ * @brief 异步日志，前端双缓冲，后台线程批量写到滚动的日志文件
+ *        前端线程只在加锁后把一行日志拷贝进当前缓冲区，写满时换上备用缓冲区，不会等待磁盘
+ *        后台线程每flushInterval秒或者有缓冲区写满时被唤醒，交换出所有写满的缓冲区后在锁外写文件
+ *        磁盘跟不上、积压的缓冲区过多时丢弃多余的部分，并在文件中记录丢弃的字节数
+ *        用法：
+ *            static AsyncLogger *g_asyncLogger = new AsyncLogger("/var/log/server", 512 * 1024 * 1024);
+ *            g_asyncLogger->start();
+ *            Logger::instance().setOutput([](const char *msg, size_t len) { g_asyncLogger->append(msg, len); });
+ *            Logger::instance().setFlush([]() { g_asyncLogger->flush(); });
+ */
+class AsyncLogger : noncopyable
+{
+public:
+    AsyncLogger(const std::string &basename,
+                off_t rollSize,
+                int flushIntervalSeconds = 3,
+                int rollIntervalSeconds = 24 * 60 * 60);
+    ~AsyncLogger();
+
+    // 任意线程都可以调用
+    void append(const char *msg, size_t len);
+    // 阻塞到调用之前append的日志都写进文件并刷到内核，用于FATAL日志退出之前
+    void flush();
+
+    void start();
+    // 写完剩下的日志后结束后台线程
+    void stop();
+
+    // 积压太多时丢弃的字节数，加上单行超过一个缓冲区被丢弃的字节数
+    uint64_t droppedBytes() const { return droppedBytes_; }
+    int rolledFiles() const { return rolledFiles_; }
+
+private:
+    static const size_t kBufferSize = 4 * 1024 * 1024;
+    static const size_t kMaxBuffersToWrite = 25; // 积压超过这么多缓冲区（100M）时丢弃
+
+    // 定长的日志缓冲区
+    class LogBuffer : noncopyable
+    {
+    public:
+        LogBuffer() : data_(new char[kBufferSize]), len_(0) {}
+        void append(const char *msg, size_t len)
+        {
+            ::memcpy(data_.get() + len_, msg, len);
+            len_ += len;
+        }
+        size_t avail() const { return kBufferSize - len_; }
+        const char *data() const { return data_.get(); }
+        size_t length() const { return len_; }
+        void reset() { len_ = 0; }
+
+    private:
+        std::unique_ptr<char[]> data_;
+        size_t len_;
+    };
+    using BufferPtr = std::unique_ptr<LogBuffer>;
+    using BufferVector = std::vector<BufferPtr>;
+
+    void threadFunc();
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const int flushInterval_;
+    const int rollInterval_;
+
+    std::atomic_bool running_;
+    Thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_; // 唤醒后台线程
+    std::condition_variable flushedCond_; // 通知flush()的调用方
+    BufferPtr currentBuffer_; // 以下受mutex_保护
+    BufferPtr nextBuffer_;
+    BufferVector buffers_; // 写满待写入文件的缓冲区
+    uint64_t flushRequested_; // flush()请求的序号
+    uint64_t flushDone_;      // 后台线程已经完成的flush序号
+
+    std::atomic<uint64_t> droppedBytes_;
+    std::atomic_int rolledFiles_;
+};
+
+#endif
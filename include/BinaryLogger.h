@@ -0,0 +1,278 @@
+#ifndef BINARYLOGGER_H
+#define BINARYLOGGER_H
+
+#include "noncopyable.h"
+#include "Logger.h"
+#include "Thread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+class LogFile;
+
+/**
+ * @brief 二进制日志，用于热路径上的跟踪日志
+ *        调用处不格式化：格式串在第一次调用时登记成一个id，之后每次只把id、时间和原始参数
+ *        拷贝到本线程的单生产者单消费者环形缓冲区，后台线程把各个缓冲区的内容原样写进文件，
+ *        格式串字典也写在文件中，用blogdecode离线还原成和Logger相同格式的文本
+ *        环形缓冲区满时丢弃这条日志并计数，调用线程永远不会等待
+ *        参数支持整数、枚举、浮点数、指针和const char*（按%s保存字符串内容），格式串按printf检查
+ *        用法：
+ *            BinaryLogger::instance().start("/var/log/trace");
+ *            BLOG_INFO("conn=%s read %zd bytes", conn->name().c_str(), n);
+ */
+class BinaryLogger : noncopyable
+{
+public:
+    static const size_t kDefaultBufferSize = 1024 * 1024; // 每个线程的环形缓冲区
+
+    // 文件中的条目类型
+    enum EntryKind : uint8_t
+    {
+        kFormatEntry = 1,  // 格式串字典的一项
+        kRecordsEntry = 2, // 一个线程的一段日志记录
+        kDroppedEntry = 3, // 一个线程累计丢弃的日志条数
+    };
+
+    static BinaryLogger &instance();
+
+    // 启动后台线程，日志写到按大小滚动的文件中，每个文件都带有完整的格式串字典
+    void start(const std::string &basename,
+               off_t rollSize = 1024 * 1024 * 1024,
+               size_t bufferSize = kDefaultBufferSize);
+    void stop();
+    bool running() const { return running_.load(std::memory_order_relaxed); }
+    // 阻塞到调用之前记录的日志都写进文件
+    void flush();
+
+    uint64_t droppedRecords() const;
+    uint64_t writtenBytes() const { return writtenBytes_; }
+
+    // 把二进制日志文件还原成文本写到out，sortByTime为true时按时间排序所有线程的记录，返回还原的条数，格式错误返回-1
+    static long decode(FILE *in, FILE *out, bool sortByTime);
+
+    // 以下供BLOG宏使用
+    template <typename... Args>
+    void record(std::atomic<uint32_t> *formatId, int level, const char *file, int line, const char *func,
+                const char *fmt, const Args &...args);
+
+    __attribute__((format(printf, 1, 2))) static void checkFormat(const char *, ...) {}
+
+private:
+    // 每条记录的头，后面是参数，整条记录按8字节对齐
+    struct RecordHeader
+    {
+        uint32_t formatId;
+        uint32_t argsLen;
+        int64_t timestampNs;
+    };
+
+    // 单生产者（所属线程）单消费者（后台线程）的环形缓冲区
+    class StagingBuffer : noncopyable
+    {
+    public:
+        StagingBuffer(size_t size, int tid);
+
+        // 生产者：申请n字节的连续空间，空间不够时返回nullptr
+        char *reserve(size_t n);
+        void commit(size_t n)
+        {
+            minFreeSpace_ -= n;
+            producerPos_.store(producerPos_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+        }
+
+        // 消费者：取出当前所有可读数据，回绕时分成尾部和开头两段，second可能为空
+        void peek(const char **first, size_t *firstLen, const char **second, size_t *secondLen);
+        // 释放上一次peek返回的数据
+        void consume() { consumerPos_.store(peekedPos_, std::memory_order_release); }
+
+        int tid() const { return tid_; }
+
+        std::atomic<uint64_t> dropped;
+        std::atomic_bool retired; // 所属线程已经退出，读完以后释放
+        uint64_t reportedDropped; // 后台线程已经写进文件的丢弃条数
+
+    private:
+        const size_t size_;
+        const int tid_;
+        std::unique_ptr<char[]> storage_;
+        // 生产者独占
+        size_t minFreeSpace_;
+        alignas(64) std::atomic<size_t> producerPos_;
+        std::atomic<size_t> endOfRecordedSpace_; // 生产者回绕时，之前的数据到这里为止
+        alignas(64) std::atomic<size_t> consumerPos_;
+        size_t peekedPos_; // 消费者独占
+    };
+    using StagingBufferPtr = std::shared_ptr<StagingBuffer>;
+
+    // 登记过的一个格式串
+    struct FormatInfo
+    {
+        uint32_t id;
+        int level;
+        const char *file;
+        int line;
+        const char *func;
+        const char *fmt;
+        std::string argTypes;
+    };
+
+    BinaryLogger();
+    ~BinaryLogger();
+
+    uint32_t registerFormat(int level, const char *file, int line, const char *func, const char *fmt, std::string argTypes);
+    StagingBuffer *stagingBuffer();
+    void threadFunc();
+    // 后台线程的一轮：把所有缓冲区的数据写进文件，返回写入的字节数
+    size_t drain(LogFile *output, size_t *formatsWritten);
+    // 新文件的文件头和前formats项字典
+    std::string fileHeader(size_t formats);
+    static void appendFormat(std::string *out, const FormatInfo &info);
+
+    // 参数的类型标记和编码
+    template <typename T>
+    static char typeOf()
+    {
+        using U = typename std::decay<T>::type;
+        if (std::is_same<U, const char *>::value || std::is_same<U, char *>::value)
+        {
+            return 's';
+        }
+        if (std::is_floating_point<U>::value)
+        {
+            return 'd';
+        }
+        if (std::is_pointer<U>::value)
+        {
+            return 'p';
+        }
+        if (std::is_unsigned<U>::value)
+        {
+            return 'u';
+        }
+        return 'i';
+    }
+
+    static size_t argSize(const char *s) { return sizeof(uint32_t) + (s ? ::strlen(s) : 6); }
+    static size_t argSize(char *s) { return argSize(static_cast<const char *>(s)); }
+    template <typename T>
+    static size_t argSize(const T &) { return 8; }
+
+    static void encode(char *&p, const char *s) { s ? encodeString(p, s, ::strlen(s)) : encodeString(p, "(null)", 6); }
+    static void encode(char *&p, char *s) { encode(p, static_cast<const char *>(s)); }
+    template <typename T>
+    static void encode(char *&p, const T &v)
+    {
+        using U = typename std::decay<T>::type;
+        if constexpr (std::is_floating_point<U>::value)
+        {
+            double d = static_cast<double>(v);
+            ::memcpy(p, &d, 8);
+        }
+        else if constexpr (std::is_pointer<U>::value)
+        {
+            uint64_t u = reinterpret_cast<uintptr_t>(v);
+            ::memcpy(p, &u, 8);
+        }
+        else if constexpr (std::is_unsigned<U>::value)
+        {
+            uint64_t u = static_cast<uint64_t>(v);
+            ::memcpy(p, &u, 8);
+        }
+        else
+        {
+            int64_t i = static_cast<int64_t>(v);
+            ::memcpy(p, &i, 8);
+        }
+        p += 8;
+    }
+    static void encodeString(char *&p, const char *s, size_t len)
+    {
+        uint32_t n = static_cast<uint32_t>(len);
+        ::memcpy(p, &n, sizeof n);
+        ::memcpy(p + sizeof n, s, len);
+        p += sizeof n + len;
+    }
+
+    std::atomic_bool running_;
+    std::unique_ptr<Thread> thread_;
+    std::string basename_;
+    off_t rollSize_;
+    size_t bufferSize_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;        // 唤醒后台线程
+    std::condition_variable flushedCond_; // 通知flush()的调用方
+    std::vector<FormatInfo> formats_;         // 以下受mutex_保护
+    std::vector<StagingBufferPtr> buffers_;
+    uint64_t flushRequested_;
+    uint64_t flushDone_;
+    uint64_t retiredDropped_; // 已经释放的缓冲区丢弃的条数
+
+    std::atomic<uint64_t> writtenBytes_;
+};
+
+template <typename... Args>
+void BinaryLogger::record(std::atomic<uint32_t> *formatId, int level, const char *file, int line, const char *func,
+                          const char *fmt, const Args &...args)
+{
+    if (!running_.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    // x86上acquire/release就是普通的读写，保证看到id的线程写出的记录晚于字典项
+    uint32_t id = formatId->load(std::memory_order_acquire);
+    if (id == 0)
+    {
+        // 两个线程同时第一次调用时会登记两次，只是字典里多一项
+        id = registerFormat(level, file, line, func, fmt, std::string{typeOf<Args>()...});
+        formatId->store(id, std::memory_order_release);
+    }
+
+    size_t argsLen = 0;
+    ((argsLen += argSize(args)), ...);
+    size_t total = (sizeof(RecordHeader) + argsLen + 7) & ~size_t(7);
+    StagingBuffer *buffer = stagingBuffer();
+    char *p = buffer->reserve(total);
+    if (p == nullptr)
+    {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    RecordHeader header{id, static_cast<uint32_t>(argsLen), ts.tv_sec * 1000000000LL + ts.tv_nsec};
+    ::memcpy(p, &header, sizeof header);
+    char *q = p + sizeof header;
+    (encode(q, args), ...);
+    buffer->commit(total);
+}
+
+#define BLOG_AT(level, logmsgfmt, ...)                                                                          \
+    do                                                                                                          \
+    {                                                                                                           \
+        if (false)                                                                                              \
+        {                                                                                                       \
+            BinaryLogger::checkFormat(logmsgfmt, ##__VA_ARGS__);                                                \
+        }                                                                                                       \
+        if (LOG_ENABLED(level))                                                                                 \
+        {                                                                                                       \
+            static std::atomic<uint32_t> blogFormatId(0);                                                       \
+            BinaryLogger::instance().record(&blogFormatId, level, __FILE__, __LINE__, __FUNCTION__, logmsgfmt, ##__VA_ARGS__); \
+        }                                                                                                       \
+    } while (0)
+
+#define BLOG_DEBUG(logmsgfmt, ...) BLOG_AT(DEBUG, logmsgfmt, ##__VA_ARGS__)
+#define BLOG_INFO(logmsgfmt, ...) BLOG_AT(INFO, logmsgfmt, ##__VA_ARGS__)
+#define BLOG_ERROR(logmsgfmt, ...) BLOG_AT(ERROR, logmsgfmt, ##__VA_ARGS__)
+
+#endif
@@ -4,6 +4,11 @@
 #include <vector>
 #include <algorithm>
 #include <string>
+#include <stdint.h>
+#include <string.h>
+#include <endian.h>
+
+class Timestamp;
 
 /**
  * @brief 网络库底层的缓冲区定义
@@ -19,6 +24,13 @@ public:
     {
     }
 
+    void swap(Buffer &rhs)
+    {
+        buffer_.swap(rhs.buffer_);
+        std::swap(readIndex_, rhs.readIndex_);
+        std::swap(writeIndex_, rhs.writeIndex_);
+    }
+
     size_t readableBytes() const 
     {
         return writeIndex_ - readIndex_;
@@ -40,6 +52,12 @@ public:
         return begin() + readIndex_;
     }
 
+    // 可读区的可写指针，用于原地修改已经收到的数据（比如websocket解掩码）
+    char* mutablePeek()
+    {
+        return begin() + readIndex_;
+    }
+
     void retrieve(size_t len)
     {
         if(len < readableBytes())
@@ -95,8 +113,54 @@ public:
         writeIndex_ += len;
     }
 
+    void append(const std::string &str)
+    {
+        append(str.data(), str.size());
+    }
+
+    // 以网络字节序追加一个32位整数
+    void appendInt32(int32_t x)
+    {
+        uint32_t be32 = htobe32(static_cast<uint32_t>(x));
+        append(reinterpret_cast<const char *>(&be32), sizeof be32);
+    }
+
+    // 读取可读区开头的32位整数（网络字节序），不移动读指针，调用方保证readableBytes() >= 4
+    int32_t peekInt32() const
+    {
+        uint32_t be32 = 0;
+        ::memcpy(&be32, peek(), sizeof be32);
+        return static_cast<int32_t>(be32toh(be32));
+    }
+
+    int32_t readInt32()
+    {
+        int32_t result = peekInt32();
+        retrieve(sizeof result);
+        return result;
+    }
+
+    // 把数据写到可读区之前的prependable空间，调用方保证prependableBytes() >= len
+    // 编码时先写消息体，再把长度等头部写到kCheapPrepend预留的空间，避免移动消息体
+    void prepend(const void *data, size_t len)
+    {
+        readIndex_ -= len;
+        const char *d = static_cast<const char *>(data);
+        std::copy(d, d + len, begin() + readIndex_);
+    }
+
+    void prependInt32(int32_t x)
+    {
+        uint32_t be32 = htobe32(static_cast<uint32_t>(x));
+        prepend(&be32, sizeof be32);
+    }
+
     // 从fd上读取数据到writable缓冲区
     ssize_t readFd(int fd, int* saveErrno);
+    // 用于unix域socket：同时接收对端用SCM_RIGHTS传过来的fd，追加到passedFds中，由调用方负责关闭
+    ssize_t readFd(int fd, int* saveErrno, std::vector<int>* passedFds);
+    // 用于开启了SO_TIMESTAMPING的socket：同时取出内核收到数据的时间，没有时间戳时receiveTime为无效值
+    ssize_t readFdWithTimestamp(int fd, int* saveErrno, Timestamp* receiveTime);
 
     // 从readable缓冲区向fd上写入数据
     ssize_t writeFd(int fd, int* saveErrno);
@@ -116,7 +180,8 @@ private:
 
     void makeSpace(size_t len)
     {
-        if(writeableBytes() + prependableBytes() < len + writeIndex_)
+        // 把已读过的空间挪出来也不够时才扩容，扩容后保留kCheapPrepend的预留空间
+        if(writeableBytes() + prependableBytes() < len + kCheapPrepend)
         {
             buffer_.resize(len + writeIndex_);
         }
@@ -2,6 +2,7 @@
 #define CALLBACKS_H
 #include <memory>
 #include <functional>
+#include <stdint.h>
 
 class Buffer;
 class TcpConnection;
@@ -16,4 +17,7 @@ using MessageCallback = std::function<void (const TcpConnectionPtr&,
                                         Timestamp)>;
 using HighWaterMarkCallback = std::function<void (const TcpConnectionPtr&, size_t)>;
 
+using TimerCallback = std::function<void ()>;
+using TimerId = uint64_t;
+
 #endif
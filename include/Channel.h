@@ -19,6 +19,8 @@ class Channel : noncopyable
 public:
     using EventCallback = std::function<void()>;
     using ReadEventCallback = std::function<void(Timestamp)>;
+    // 把channel所属的对象（比如连接名）写到buf中，供LoopWatchdog在信号处理函数中调用，必须是async-signal-safe的
+    using OwnerDescriber = void (*)(const void *owner, char *buf, size_t len);
 
     Channel(EventLoop *loop, int fd);
     ~Channel();
@@ -38,18 +40,26 @@ public:
     int fd() const { return fd_; }
     int events() const { return events_; }
     void set_revents(int revt) { revents_ = revt; }
+    int revents() const { return revents_; }
+
+    void setOwner(const void *owner, OwnerDescriber describe)
+    {
+        owner_ = owner;
+        describeOwner_ = describe;
+    }
+    void describeOwner(char *buf, size_t len) const;
 
     // 设置fd相应的事件状态
     void enableReading() { events_ |= kReadEvent; update(); }
     void disableReading() { events_ &= ~kReadEvent; update(); }
     void enableWriting() { events_ |= kWriteEvent; update(); }
-    void disableWriting() { events_ &= ~kReadEvent; update(); }
+    void disableWriting() { events_ &= ~kWriteEvent; update(); }
     void disableAll() { events_ = kNoneEvent; update(); }
 
     // 返回fd响应的事件状态
     bool isNoneEvent() const { return events_ == kNoneEvent; }
-    bool isReadEvent() const { return events_ == kReadEvent; }
-    bool isWriteEvent() const { return events_ == kWriteEvent; }
+    bool isReadEvent() const { return events_ & kReadEvent; }
+    bool isWriteEvent() const { return events_ & kWriteEvent; }
 
     int index() const { return index_; }
     void set_index(int idx) { index_ = idx; }
@@ -75,6 +85,9 @@ private:
     std::weak_ptr<void> tie_;
     bool tied_;
 
+    const void *owner_;
+    OwnerDescriber describeOwner_;
+
     // 因为Channel里面能够知道fd最终发生的具体事件，所以它负责调用具体回调接口。
     ReadEventCallback readCallback_;
     EventCallback writeCallback_;
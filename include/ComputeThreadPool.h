@@ -0,0 +1,78 @@
+#ifndef COMPUTETHREADPOOL_H
+#define COMPUTETHREADPOOL_H
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class EventLoop;
+
+/**
+ * @brief 计算线程池，用于把CPU密集的消息处理从io loop中卸载出去
+ *        每个worker有自己的任务队列，空闲时从其它worker的队列头部窃取任务
+ *        任务完成后可以把回调投递回连接所属的EventLoop执行
+ */
+class ComputeThreadPool : noncopyable
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit ComputeThreadPool(const std::string &name = std::string("ComputePool"));
+    ~ComputeThreadPool();
+
+    // 在start()之前设置worker个数
+    void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+    void start();
+    // 执行完已经提交的任务以后退出所有worker
+    void stop();
+
+    // 以下提交接口都必须在start()之后、stop()之前调用，否则LOG_FATAL；
+    // stop()排空队列时执行的任务也不能再提交新任务
+    // 提交任务，任意线程都可以调用；在worker线程中提交的任务优先由当前worker执行
+    void run(Task task);
+    // 在worker中执行work，完成以后在loop中执行done
+    void run(Task work, EventLoop *loop, Task done);
+
+    // 相同key（比如连接id）的任务按提交顺序串行执行，这类任务不会被窃取
+    void runOrdered(uint64_t key, Task task);
+    // 相同key的work按顺序执行，done也按相同的顺序在loop中执行
+    void runOrdered(uint64_t key, Task work, EventLoop *loop, Task done);
+
+    size_t numThreads() const { return workers_.size(); }
+    const std::string &name() const { return name_; }
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;   // 可被窃取：owner从尾部取，其它worker从头部窃取
+        std::deque<Task> ordered; // 不可被窃取，只由owner按FIFO执行
+        std::atomic_int orderedCount{0};
+    };
+
+    void workerFunc(int index);
+    bool takeTask(int index, Task *task);
+    void waitForTask(int index);
+    void wakeup(bool all);
+
+    std::string name_;
+    int numThreads_;
+    std::atomic_bool running_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::unique_ptr<Thread>> threads_;
+    std::atomic_uint next_;            // 外部线程提交时轮询选择worker
+    std::atomic_int stealable_;        // 所有tasks队列中的任务总数
+    std::atomic_int idle_;             // 正在等待的worker个数
+    std::mutex sleepMutex_;
+    std::condition_variable cond_;
+};
+
+#endif
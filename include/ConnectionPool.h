@@ -0,0 +1,101 @@
+#ifndef CONNECTIONPOOL_H
+#define CONNECTIONPOOL_H
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "InetAddress.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class EventLoop;
+class TcpClient;
+
+/**
+ * @brief 到同一个后端的长连接池，每个EventLoop拥有自己的连接池
+ *        一条连接上可以同时有多个未完成的请求（pipelining），
+ *        响应按FIFO顺序或者请求id和请求对应
+ *        所有方法都必须在所属loop线程中调用，请求路径上不加锁
+ */
+class ConnectionPool : noncopyable
+{
+public:
+    enum MatchMode
+    {
+        kFifo,      // 后端按请求顺序返回响应
+        kRequestId, // 响应中带有请求id，可以乱序返回
+    };
+
+    enum ParseResult
+    {
+        kComplete,   // 解析出一个完整响应，并已经从buffer中取走
+        kIncomplete, // 数据不够，等待更多数据
+        kError,      // 协议错误，连接会被关闭
+    };
+
+    // 从buf中解析一个响应，kRequestId模式下还要给出响应对应的请求id
+    using ResponseParser = std::function<ParseResult(Buffer *buf, std::string *response, uint64_t *requestId)>;
+    // ok为false表示请求失败（连接断开或者连接池析构），此时response为空
+    using ResponseCallback = std::function<void(bool ok, const std::string &response)>;
+
+    ConnectionPool(EventLoop *loop,
+                   const InetAddress &serverAddr,
+                   const std::string &name,
+                   int numConnections,
+                   MatchMode mode,
+                   const ResponseParser &parser);
+    ~ConnectionPool();
+
+    // 单条连接未完成请求数的上限，超过以后请求在连接池中排队，0表示不限制
+    void setMaxInflightPerConnection(size_t n) { maxInflight_ = n; }
+    void start();
+
+    // 发送请求，选择未完成请求最少的连接；没有可用连接时排队，连接建立后发出
+    // kRequestId模式下requestId必须在未完成的请求中唯一
+    void send(const std::string &request, const ResponseCallback &cb, uint64_t requestId = 0);
+
+    EventLoop *getLoop() const { return loop_; }
+    size_t connectedCount() const;
+    size_t inflight() const { return inflight_; }
+    size_t pending() const { return pending_.size(); }
+
+private:
+    struct Request
+    {
+        std::string data;
+        ResponseCallback callback;
+        uint64_t requestId;
+    };
+
+    struct Backend
+    {
+        std::unique_ptr<TcpClient> client;
+        TcpConnectionPtr conn; // 已连接时非空
+        std::deque<ResponseCallback> fifo;                      // kFifo模式下未完成的请求
+        std::unordered_map<uint64_t, ResponseCallback> byId;    // kRequestId模式下未完成的请求
+        size_t inflight = 0;
+    };
+
+    void onConnection(size_t index, const TcpConnectionPtr &conn);
+    void onMessage(size_t index, const TcpConnectionPtr &conn, Buffer *buf);
+    Backend *pickBackend();
+    void dispatch(Backend &backend, Request &request);
+    void flushPending();
+    void failInflight(Backend &backend);
+
+    EventLoop *loop_;
+    InetAddress serverAddr_;
+    std::string name_;
+    MatchMode mode_;
+    ResponseParser parser_;
+    size_t maxInflight_;
+    size_t inflight_; // 所有连接上未完成的请求总数
+    std::vector<std::unique_ptr<Backend>> backends_;
+    std::deque<Request> pending_; // 等待可用连接的请求
+};
+
+#endif
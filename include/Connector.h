@@ -0,0 +1,68 @@
+#ifndef CONNECTOR_H
+#define CONNECTOR_H
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+class Channel;
+class EventLoop;
+
+/**
+ * @brief 主动发起连接，运行在所属的EventLoop中
+ *        使用非阻塞connect，EINPROGRESS时等待socket可写
+ *        连接失败按指数退避重试，直到成功或者调用stop()
+ */
+class Connector : noncopyable, public std::enable_shared_from_this<Connector>
+{
+public:
+    using NewConnectionCallback = std::function<void(int sockfd)>;
+
+    Connector(EventLoop *loop, const InetAddress &serverAddr);
+    ~Connector();
+
+    void setNewConnectionCallback(const NewConnectionCallback &cb) { newConnectionCallback_ = cb; }
+    // 设置重试的初始间隔和最大间隔，单位毫秒，在start()之前调用
+    void setRetryDelay(int initDelayMs, int maxDelayMs);
+
+    // 以下方法线程安全
+    void start();
+    void stop();
+    // 必须在loop线程调用，重置重试间隔并重新连接
+    void restart();
+
+    const InetAddress &serverAddress() const { return serverAddr_; }
+
+private:
+    enum States { kDisconnected, kConnecting, kConnected };
+    static const int kDefaultInitRetryDelayMs = 500;
+    static const int kDefaultMaxRetryDelayMs = 30 * 1000;
+
+    void setState(States s) { state_ = s; }
+    void startInLoop();
+    void stopInLoop();
+    void connect();
+    void connecting(int sockfd);
+    void handleWrite();
+    void handleError();
+    void retry(int sockfd);
+    int removeAndResetChannel();
+    void resetChannel();
+
+    EventLoop *loop_;
+    InetAddress serverAddr_;
+    std::atomic_bool connect_;
+    std::atomic<States> state_;
+    std::unique_ptr<Channel> channel_; // 只在连接建立过程中存在
+    NewConnectionCallback newConnectionCallback_;
+    int initRetryDelayMs_;
+    int maxRetryDelayMs_;
+    int retryDelayMs_;
+    TimerId retryTimer_; // 0表示没有等待中的重试
+};
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC32C（Castagnoli），x86上支持SSE4.2时使用crc32指令，否则查表计算
+namespace Crc32c
+{
+    // 在crc的基础上继续计算[data, data+len)，crc初始为0
+    uint32_t extend(uint32_t crc, const void *data, size_t len);
+    inline uint32_t value(const void *data, size_t len) { return extend(0, data, len); }
+    // 当前cpu是否使用了硬件加速
+    bool hardwareAccelerated();
+}
+
+#endif
@@ -3,12 +3,20 @@
 
 #include <unistd.h>
 #include <sys/syscall.h>
+#include <vector>
 
 namespace CurrentThread
 {
     extern __thread int t_cachedTid;
     void cachedTid();
 
+    // 把当前线程绑定到cpus上，cpus为空时不做处理
+    bool setAffinity(const std::vector<int> &cpus);
+    // 当前线程之后分配的内存优先放在它所运行cpu的NUMA节点上（依赖内核的first-touch）
+    bool preferLocalNumaNode();
+    // 当前线程正在运行的cpu
+    int cpu();
+
     inline int tid()
     {
         if(__builtin_expect(t_cachedTid == 0, 0))
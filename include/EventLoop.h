@@ -4,6 +4,8 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "Metrics.h"
 
 #include <atomic>
 #include <functional>
@@ -15,6 +17,9 @@
 // 前置声明
 class Poller;
 class Channel;
+class MemoryPool;
+class TimerQueue;
+struct LoopActivity;
 
 /**
 * @brief Eventloop时间循环类，主要包含了两大模块 Channel 和 Poller, 三者共同完成了 Reactor和多路事件分发器的角色
@@ -41,6 +46,11 @@ public:
     // 唤醒loop所在线程
     void wakeup();
 
+    // 定时器，线程安全，时间单位为秒
+    TimerId runAfter(double delay, TimerCallback cb);
+    TimerId runEvery(double interval, TimerCallback cb);
+    void cancel(TimerId timerId);
+
     // 通过loop调用poller的方法
     void updateChannel(Channel* channel);
     void removeChannel(Channel* channel);
@@ -48,12 +58,29 @@ public:
 
     // 判断当前线程是否loop所属线程
     bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
+    pid_t threadId() const { return threadId_; }
+
+    // 当前loop的内存池，用于TcpConnection等对象的分配
+    const std::shared_ptr<MemoryPool> &memoryPool() const { return memoryPool_; }
+
+    // 负载信号，供EventLoopThreadPool的负载均衡策略读取
+    void addActiveConnection(int delta) { activeConnections_.fetch_add(delta, std::memory_order_relaxed); }
+    int activeConnections() const { return activeConnections_.load(std::memory_order_relaxed); }
+    // 最近若干次循环处理事件和回调耗时的滑动平均，单位纳秒
+    int64_t iterationTimeNs() const { return iterationTimeNs_.load(std::memory_order_relaxed); }
+
+    // loop线程当前在执行的回调，由LoopWatchdog读取
+    const std::shared_ptr<LoopActivity> &activity() const { return activity_; }
+
+    // 本loop的运行指标，由MetricsRegistry采集
+    const LoopMetrics &metrics() const { return metrics_; }
 
 private:
     // wakeup
     void handleRead();
     // 执行当前loop的回调
     void doPendingFunctors();
+    void collectMetrics(std::vector<MetricsRegistry::Sample> *out) const;
 
     using ChannelList = std::vector<Channel*>;
     
@@ -70,6 +97,15 @@ private:
 
     ChannelList activeChannels_;
 
+    std::shared_ptr<MemoryPool> memoryPool_; // 当前loop的内存池，loop析构以后由还没释放的对象继续持有
+    std::unique_ptr<TimerQueue> timerQueue_; // 当前loop的定时器
+
+    std::atomic_int activeConnections_;     // 当前loop上的连接数
+    std::atomic<int64_t> iterationTimeNs_;  // 单次循环的忙碌耗时（EWMA）
+    LoopMetrics metrics_;
+    int metricsId_; // 在MetricsRegistry中登记的采集函数
+    std::shared_ptr<LoopActivity> activity_;
+
     std::atomic_bool callingPendingFunctors_; // 是否正在执行回调
     std::vector<Functor> pendingFunctors_; // 用于记录loop需要执行的回调操作
     std::mutex mutex_; // 用来保证pendingFunctors_的线程安全
@@ -8,6 +8,7 @@
 #include <mutex>
 #include <condition_variable>
 #include <string>
+#include <vector>
 
 class EventLoop;
 
@@ -18,6 +19,9 @@ public:
     EventLoopThread(const ThreadInitCallback& cb = ThreadInitCallback(), const std::string& name = std::string());
     ~EventLoopThread();
 
+    // 在startLoop()之前设置loop线程绑定的cpu
+    void setCpuAffinity(const std::vector<int> &cpus, bool numaLocal = false) { thread_.setCpuAffinity(cpus, numaLocal); }
+
     EventLoop* startLoop();
 
 private:
@@ -2,28 +2,48 @@
 #define EVENTLOOPTHREADPOOL_H
 
 #include "noncopyable.h"
+#include "LoadBalancer.h"
 
 #include <functional>
 #include <string>
 #include <vector>
 #include <memory>
+#include <utility>
 
 class EventLoop;
 class EventLoopThread;
+class InetAddress;
 
 class EventLoopThreadPool : noncopyable
 {
 public:
     using ThreadInitCallback = std::function<void(EventLoop *)>;
+    using LoopRetireCallback = std::function<void(EventLoop *)>;
     EventLoopThreadPool(EventLoop *baseLoop, const std::string &nameArg);
     ~EventLoopThreadPool();
 
     void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+    // 在start()之前设置，threadCpus[i]为第i个subloop绑定的cpu集合，为空表示不绑定
+    void setThreadCpus(const std::vector<std::vector<int>> &threadCpus) { threadCpus_ = threadCpus; }
+    // 在start()之前设置，baseLoop（acceptor）所在线程绑定的cpu集合，用于把acceptor隔离出来
+    void setBaseLoopCpus(const std::vector<int> &cpus) { baseLoopCpus_ = cpus; }
+    // 绑核的loop线程的内存（loop、内存池、连接的缓冲区）优先从本地NUMA节点分配
+    void setNumaLocal(bool on) { numaLocal_ = on; }
+    // 设置subloop的选择策略，只能在baseLoop中调用
+    void setLoadBalancePolicy(LoadBalancer::Policy policy);
 
     void start(const ThreadInitCallback &cb = ThreadInitCallback());
 
-    // 如果工作在多线程中，baseLoop_默认以轮询的方式分配channel给subloop
+    // 运行时调整subloop的个数，只能在baseLoop中调用
+    // 缩容时被移除的loop立即不再被getNextLoop选中，然后交给retireCallback_处理其上的连接
+    void resize(int numThreads);
+    void setLoopRetireCallback(const LoopRetireCallback &cb) { retireCallback_ = cb; }
+    // retireCallback_把loop上的连接处理完以后调用，退出并回收该loop线程，只能在baseLoop中调用
+    void retireDone(EventLoop *loop);
+
+    // 如果工作在多线程中，baseLoop_按照负载均衡策略分配channel给subloop，默认轮询
     EventLoop *getNextLoop();
+    EventLoop *getNextLoop(const InetAddress &peerAddr);
 
     std::vector<EventLoop *> getAllLoops();
 
@@ -31,12 +51,22 @@ public:
     const std::string name() const { return name_; }
 
 private:
+    void addLoop();
+
     EventLoop *baseLoop_;
     std::string name_;
     bool started_;
     int numThreads_;
-    int next_;
+    std::vector<std::vector<int>> threadCpus_;
+    std::vector<int> baseLoopCpus_;
+    bool numaLocal_;
+    std::unique_ptr<LoadBalancer> balancer_;
     std::vector<std::unique_ptr<EventLoopThread>> threads_;
     std::vector<EventLoop *> loops_;
+
+    ThreadInitCallback initCallback_;
+    LoopRetireCallback retireCallback_;
+    int nextThreadIndex_; // 用于给新的loop线程命名
+    std::vector<std::pair<EventLoop *, std::unique_ptr<EventLoopThread>>> retiring_; // 正在退出的loop
 };
 #endif
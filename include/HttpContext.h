@@ -0,0 +1,80 @@
+#ifndef HTTPCONTEXT_H
+#define HTTPCONTEXT_H
+
+#include "copyable.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "Timestamp.h"
+
+class Buffer;
+class HttpResponseCache;
+
+/**
+ * @brief 每个http连接的解析状态，挂在TcpConnection的context上
+ *        增量解析：数据不完整时记住已经扫描到的位置，下次从这里继续，不会重复扫描
+ *        请求在回调结束之前不会从Buffer中取走，所有位置都是相对请求起始的偏移量，
+ *        Buffer扩容或者挪动数据都不影响已经解析出来的结果
+ */
+class HttpContext : public copyable
+{
+public:
+    enum ParseResult
+    {
+        kGotRequest, // 解析出一个完整请求
+        kIncomplete, // 等待更多数据
+        kError,      // 请求非法，errorStatus()给出应答的状态码
+    };
+
+    static const size_t kDefaultMaxHeaderSize = 64 * 1024;
+    static const size_t kDefaultMaxBodySize = 16 * 1024 * 1024;
+
+    HttpContext(size_t maxHeaderSize = kDefaultMaxHeaderSize, size_t maxBodySize = kDefaultMaxBodySize);
+
+    ParseResult parseRequest(Buffer *buf, Timestamp receiveTime);
+
+    // kGotRequest之后有效，请求在buf中占用的字节数，处理完以后由调用方retrieve
+    size_t requestLength() const { return pos_; }
+    const HttpRequest &request() const { return request_; }
+    HttpResponse::HttpStatusCode errorStatus() const { return errorStatus_; }
+    // 请求带有Expect: 100-continue并且body还没有到达
+    bool expectContinue() const { return expectContinue_; }
+    void clearExpectContinue() { expectContinue_ = false; }
+
+    // 连接所属loop的响应缓存，没有开启缓存时为空
+    void setCache(HttpResponseCache *cache) { cache_ = cache; }
+    HttpResponseCache *cache() const { return cache_; }
+
+    // 处理完一个请求以后重置，准备解析下一个请求
+    void reset();
+
+private:
+    enum ParseState
+    {
+        kExpectRequestLine,
+        kExpectHeaders,
+        kExpectBody,
+        kExpectChunkSize,
+        kExpectChunkData,
+        kExpectTrailers,
+        kGotAll,
+    };
+
+    // 从pos_开始查找CRLF，返回行尾相对请求起始的偏移量，找不到返回npos
+    size_t findCRLF(const char *begin, size_t readable) const;
+    bool processRequestLine(const char *begin, size_t end);
+    bool processHeader(const char *begin, size_t end);
+    ParseResult fail(HttpResponse::HttpStatusCode code);
+
+    size_t maxHeaderSize_;
+    size_t maxBodySize_;
+    ParseState state_;
+    size_t pos_;           // 下一个待解析字节相对请求起始的偏移量
+    size_t scanned_;       // 查找CRLF时已经扫描过的位置，避免重复扫描
+    size_t contentLength_; // Content-Length或者当前chunk剩余的长度
+    bool expectContinue_;
+    HttpResponse::HttpStatusCode errorStatus_;
+    HttpRequest request_;
+    HttpResponseCache *cache_;
+};
+
+#endif
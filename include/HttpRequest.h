@@ -0,0 +1,90 @@
+#ifndef HTTPREQUEST_H
+#define HTTPREQUEST_H
+
+#include "copyable.h"
+#include "Timestamp.h"
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief http请求，由HttpContext在连接的inputBuffer上原地解析
+ *        请求行、头部和Content-Length的body都以偏移量的形式保存，
+ *        返回的string_view指向inputBuffer，只在HttpCallback执行期间有效
+ *        chunked的body不连续，解码后保存在请求自己的内存中
+ */
+class HttpRequest : public copyable
+{
+public:
+    enum Method
+    {
+        kInvalid,
+        kGet,
+        kPost,
+        kHead,
+        kPut,
+        kDelete,
+        kOptions,
+    };
+
+    enum Version
+    {
+        kUnknown,
+        kHttp10,
+        kHttp11,
+    };
+
+    // 相对于请求起始位置的一段数据
+    struct Range
+    {
+        size_t offset = 0;
+        size_t length = 0;
+    };
+    using HeaderList = std::vector<std::pair<Range, Range>>;
+
+    HttpRequest()
+        : base_(nullptr), method_(kInvalid), version_(kUnknown), chunked_(false)
+    {
+    }
+
+    Method method() const { return method_; }
+    const char *methodString() const;
+    Version getVersion() const { return version_; }
+    std::string_view path() const { return view(path_); }
+    std::string_view query() const { return view(query_); }
+    std::string_view body() const { return chunked_ ? std::string_view(chunkedBody_) : view(body_); }
+    Timestamp receiveTime() const { return receiveTime_; }
+
+    // 字段名大小写不敏感，不存在时返回空
+    std::string_view getHeader(std::string_view field) const;
+    size_t headerCount() const { return headers_.size(); }
+    std::string_view headerField(size_t i) const { return view(headers_[i].first); }
+    std::string_view headerValue(size_t i) const { return view(headers_[i].second); }
+
+    // 根据http版本和Connection头判断是否保持连接
+    bool keepAlive() const;
+
+private:
+    friend class HttpContext;
+
+    std::string_view view(const Range &r) const
+    {
+        return base_ ? std::string_view(base_ + r.offset, r.length) : std::string_view();
+    }
+
+    // 解析完成后由HttpContext设置，指向inputBuffer中请求的起始位置
+    const char *base_;
+    Method method_;
+    Version version_;
+    Range path_;
+    Range query_;
+    HeaderList headers_;
+    Range body_;
+    bool chunked_;
+    std::string chunkedBody_;
+    Timestamp receiveTime_;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef HTTPRESPONSE_H
+#define HTTPRESPONSE_H
+
+#include "copyable.h"
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class Buffer;
+
+/**
+ * @brief http响应，由HttpServer序列化到连接的发送缓冲区
+ *        body长度已知时使用Content-Length，setChunked(true)以后body按chunk编码
+ */
+class HttpResponse : public copyable
+{
+public:
+    enum HttpStatusCode
+    {
+        kUnknown,
+        k101SwitchingProtocols = 101,
+        k200Ok = 200,
+        k204NoContent = 204,
+        k301MovedPermanently = 301,
+        k304NotModified = 304,
+        k400BadRequest = 400,
+        k403Forbidden = 403,
+        k404NotFound = 404,
+        k413PayloadTooLarge = 413,
+        k426UpgradeRequired = 426,
+        k431RequestHeaderFieldsTooLarge = 431,
+        k500InternalServerError = 500,
+        k501NotImplemented = 501,
+    };
+
+    explicit HttpResponse(bool close)
+        : statusCode_(kUnknown), closeConnection_(close), chunked_(false), cacheable_(false)
+    {
+    }
+
+    void setStatusCode(HttpStatusCode code) { statusCode_ = code; }
+    HttpStatusCode statusCode() const { return statusCode_; }
+    // 不设置时使用状态码对应的标准描述
+    void setStatusMessage(const std::string &message) { statusMessage_ = message; }
+
+    void setCloseConnection(bool on) { closeConnection_ = on; }
+    bool closeConnection() const { return closeConnection_; }
+
+    void setContentType(const std::string &contentType) { addHeader("Content-Type", contentType); }
+    void addHeader(const std::string &key, const std::string &value) { headers_.emplace_back(key, value); }
+
+    void setBody(const std::string &body) { body_ = body; }
+    void setBody(std::string &&body) { body_ = std::move(body); }
+    const std::string &body() const { return body_; }
+
+    // 使用Transfer-Encoding: chunked，每次appendChunk追加一个chunk
+    void setChunked(bool on) { chunked_ = on; }
+    bool chunked() const { return chunked_; }
+    void appendChunk(std::string_view data);
+
+    // 允许HttpServer把这个响应序列化以后缓存，后续相同的GET请求直接使用缓存
+    void setCacheable(bool on) { cacheable_ = on; }
+    bool cacheable() const { return cacheable_; }
+
+    // withBody为false时只写状态行和头部（HEAD请求、304）
+    void appendToBuffer(Buffer *output, bool withBody = true) const;
+
+    // 直接向buffer写一个chunk或者结束chunk，可以用于在一次回调之外继续发送chunked body
+    static void appendChunk(Buffer *output, std::string_view data);
+    static void appendLastChunk(Buffer *output);
+    static const char *defaultStatusMessage(HttpStatusCode code);
+
+private:
+    HttpStatusCode statusCode_;
+    std::string statusMessage_;
+    std::vector<std::pair<std::string, std::string>> headers_;
+    bool closeConnection_;
+    bool chunked_;
+    bool cacheable_;
+    std::string body_; // chunked时保存已经编码好的chunk
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef HTTPRESPONSECACHE_H
+#define HTTPRESPONSECACHE_H
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+class HttpRequest;
+class HttpResponse;
+
+/**
+ * @brief 序列化好的http响应缓存，每个io loop一个，只在所属loop线程中读写
+ *        缓存的是完整的响应字节（状态行+头部+body）和对应的304响应，
+ *        命中时把共享的不可变buffer交给TcpConnection的发送链，不拷贝也不重新格式化
+ *        按总字节数限制大小，超过时淘汰最久没有使用的条目
+ */
+class HttpResponseCache : noncopyable
+{
+public:
+    using Payload = std::shared_ptr<const std::string>;
+
+    explicit HttpResponseCache(size_t maxBytes);
+
+    // 命中时返回要发送的响应：If-None-Match匹配时为304，否则为完整响应；未命中返回空
+    Payload lookup(const HttpRequest &req);
+    // 缓存响应（自动加上ETag），返回值和lookup相同
+    Payload insert(const HttpRequest &req, const HttpResponse &response);
+    void erase(const std::string &key);
+    void clear();
+
+    // 以下统计可以在其它线程读取，misses只统计需要生成并插入缓存的次数，不包括不可缓存的请求
+    uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+    size_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+    size_t entries() const { return entries_.load(std::memory_order_relaxed); }
+
+    // 缓存的key为path，有query时为path?query
+    static void makeKey(const HttpRequest &req, std::string *key);
+
+private:
+    struct Entry
+    {
+        std::string key;
+        std::string etag;
+        Payload response;    // 200响应
+        Payload notModified; // 304响应
+    };
+    using EntryList = std::list<Entry>; // 头部是最近使用的
+
+    Payload respond(const HttpRequest &req, const Entry &entry) const;
+    void evict();
+    static size_t entrySize(const Entry &entry);
+
+    const size_t maxBytes_;
+    EntryList lru_;
+    std::unordered_map<std::string, EntryList::iterator> index_;
+    std::string keyScratch_; // 查找时复用的key，避免每次分配内存
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<size_t> bytes_;
+    std::atomic<size_t> entries_;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef HTTPSERVER_H
+#define HTTPSERVER_H
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include "HttpContext.h"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class HttpRequest;
+class HttpResponse;
+class HttpResponseCache;
+
+/**
+ * @brief 基于TcpServer的http/1.1服务器
+ *        支持keep-alive和pipelining，同一连接上的请求按顺序应答
+ *        一次读事件中解析出的所有请求的响应写到同一个Buffer里，只调用一次send
+ */
+class HttpServer : noncopyable
+{
+public:
+    // 在连接所属的loop线程中同步调用，request中的string_view只在回调期间有效
+    using HttpCallback = std::function<void(const HttpRequest &, HttpResponse *)>;
+
+    HttpServer(EventLoop *loop,
+               const InetAddress &listenAddr,
+               const std::string &name,
+               TcpServer::Option option = TcpServer::kNoReusePort);
+    ~HttpServer();
+
+    EventLoop *getLoop() const { return server_.getLoop(); }
+    TcpServer &tcpServer() { return server_; }
+
+    void setHttpCallback(const HttpCallback &cb) { httpCallback_ = cb; }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    // 超过限制的请求分别应答431和413，然后关闭连接
+    void setMaxHeaderSize(size_t n) { maxHeaderSize_ = n; }
+    void setMaxBodySize(size_t n) { maxBodySize_ = n; }
+
+    // 开启响应缓存，每个io loop各自缓存最多maxBytesPerLoop字节，在start()之前调用
+    // HttpCallback中调用了setCacheable(true)的200响应会被缓存，之后相同的GET请求不再调用回调
+    void setResponseCache(size_t maxBytesPerLoop) { cacheMaxBytes_ = maxBytesPerLoop; }
+    // 在所有loop的缓存中删除key（path或者path?query）
+    void invalidateCache(const std::string &key);
+
+    struct CacheStats
+    {
+        EventLoop *loop;
+        uint64_t hits;
+        uint64_t misses;
+        size_t entries;
+        size_t bytes;
+    };
+    // 每个loop一项，缩容回收的loop的缓存随loop一起删除
+    std::vector<CacheStats> cacheStats() const;
+
+    void start();
+
+private:
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    // 处理一个请求，响应追加到output，返回是否需要关闭连接
+    bool onRequest(const TcpConnectionPtr &conn, HttpContext *context, Buffer *output);
+    // 在loop线程中调用，返回该loop的缓存，第一次调用时创建
+    HttpResponseCache *cacheOf(EventLoop *loop);
+    // 在baseLoop中调用，loop上的连接已经全部关闭
+    void onLoopRetired(EventLoop *loop);
+
+    HttpCallback httpCallback_;
+    size_t maxHeaderSize_;
+    size_t maxBodySize_;
+    size_t cacheMaxBytes_; // 0表示不缓存
+    mutable std::mutex cacheMutex_;
+    // 受cacheMutex_保护，投递到loop中的invalidate任务也持有一份
+    std::unordered_map<EventLoop *, std::shared_ptr<HttpResponseCache>> caches_;
+    // 放在最后，最先析构：io线程退出以后才能销毁回调和缓存
+    TcpServer server_;
+};
+
+#endif
@@ -4,29 +4,58 @@
 #include "copyable.h"
 
 #include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <string>
 
 /**
- * @brief 封装ip port的类
+ * @brief 封装ip port的类，也可以保存一个unix域socket的路径
+ *        TcpServer/TcpClient用unix域地址时走同样的Acceptor/Connector/TcpConnection流程，
+ *        只是socket的协议族不同，同一台机器上的进程间通信可以绕开TCP协议栈
  */
 class InetAddress : public copyable
 {
 public:
     explicit InetAddress(uint16_t port = 0, std::string ip = "127.0.0.1");
     explicit InetAddress(const sockaddr_in addr)
-        : addr_(addr)
+        : len_(sizeof addr)
     {
+        addr_.in = addr;
     }
 
+    // unix域地址，path以'@'开头时使用Linux的抽象命名空间，不在文件系统中创建文件
+    static InetAddress unixDomain(const std::string &path);
+
+    sa_family_t family() const { return addr_.in.sin_family; }
+    bool isUnix() const { return family() == AF_UNIX; }
+
+    // unix域地址时toIp()返回路径，toPort()返回0，toIpPort()返回"unix:路径"
     std::string toIp() const;
     std::string toIpPort() const;
     uint16_t toPort() const;
 
-    const sockaddr_in *getSockAddr() const { return &addr_; }
-    void setSockAddr(const sockaddr_in &addr) { addr_ = addr; }
+    // 只对AF_INET地址有意义
+    const sockaddr_in *getSockAddr() const { return &addr_.in; }
+    void setSockAddr(const sockaddr_in &addr)
+    {
+        addr_.in = addr;
+        len_ = sizeof addr;
+    }
+
+    // 通用的地址，传给bind/connect/sendto
+    const sockaddr *sockAddr() const { return &addr_.sa; }
+    socklen_t sockAddrLen() const { return len_; }
+    // 从accept/getsockname的结果设置，len不超过sizeof(sockaddr_un)
+    void setSockAddr(const sockaddr *addr, socklen_t len);
 
 private:
-    sockaddr_in addr_; // 地址结构
+    union
+    {
+        sockaddr sa;
+        sockaddr_in in;
+        sockaddr_un un;
+    } addr_; // 地址结构
+    socklen_t len_; // 抽象命名空间的地址不以'\0'结尾，需要记录实际长度
 };
 
 #endif
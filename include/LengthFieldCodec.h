@@ -0,0 +1,61 @@
+#ifndef LENGTHFIELDCODEC_H
+#define LENGTHFIELDCODEC_H
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Timestamp.h"
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief 长度前缀的分帧编解码器，放在TcpConnection和用户回调之间
+ *        帧格式：4字节网络字节序的body长度 + body，开启校验时body为payload + 4字节CRC32C
+ *        解码时直接在inputBuffer中原地解析，回调拿到的是buffer中payload的视图
+ *        编码时payload写在Buffer中，长度头写到kCheapPrepend预留的空间
+ */
+class LengthFieldCodec : noncopyable
+{
+public:
+    enum ErrorCode
+    {
+        kInvalidLength,    // 长度为负数
+        kFrameTooLarge,    // 超过maxFrameSize
+        kChecksumMismatch, // CRC32C校验失败
+    };
+
+    // payload指向inputBuffer中的数据，只在回调期间有效，需要保留时由用户拷贝
+    using FrameCallback = std::function<void(const TcpConnectionPtr &, std::string_view payload, Timestamp)>;
+    using ErrorCallback = std::function<void(const TcpConnectionPtr &, ErrorCode)>;
+
+    static const size_t kHeaderLen = sizeof(int32_t);
+    static const size_t kChecksumLen = sizeof(uint32_t);
+    static const size_t kDefaultMaxFrameSize = 64 * 1024 * 1024; // 64M
+
+    explicit LengthFieldCodec(const FrameCallback &cb,
+                              bool checksum = false,
+                              size_t maxFrameSize = kDefaultMaxFrameSize);
+
+    // 默认的错误处理是打印日志并关闭连接
+    void setErrorCallback(const ErrorCallback &cb) { errorCallback_ = cb; }
+
+    // 作为TcpConnection的MessageCallback
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+
+    // buf中是payload，原地加上长度头和校验后发送，发送后buf被清空
+    void send(const TcpConnectionPtr &conn, Buffer *buf) const;
+    void send(const TcpConnectionPtr &conn, std::string_view payload) const;
+    // 只编码不发送
+    void encode(Buffer *buf) const;
+
+private:
+    static void defaultErrorCallback(const TcpConnectionPtr &conn, ErrorCode code);
+
+    FrameCallback frameCallback_;
+    ErrorCallback errorCallback_;
+    const bool checksum_;
+    const size_t maxFrameSize_;
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef LOADBALANCER_H
+#define LOADBALANCER_H
+
+#include "noncopyable.h"
+
+#include <vector>
+
+class EventLoop;
+class InetAddress;
+
+/**
+ * @brief 为新连接选择subloop的负载均衡策略接口
+ */
+class LoadBalancer : noncopyable
+{
+public:
+    enum Policy
+    {
+        kRoundRobin,        // 轮询
+        kLeastConnections,  // 连接数最少的loop
+        kLeastLoopLag,      // 单次循环耗时和连接数综合最轻的loop
+        kPeerHash,          // 按对端ip哈希，同一客户端固定落在同一个loop
+    };
+
+    virtual ~LoadBalancer() = default;
+
+    // loops不为空，peerAddr可能为nullptr
+    virtual EventLoop *select(const std::vector<EventLoop *> &loops, const InetAddress *peerAddr) = 0;
+
+    // EventLoopThreadPool通过该接口获取具体的策略实例
+    static LoadBalancer *newLoadBalancer(Policy policy);
+};
+
+#endif
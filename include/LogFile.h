@@ -0,0 +1,48 @@
+#ifndef LOGFILE_H
+#define LOGFILE_H
+
+#include "noncopyable.h"
+
+#include <stdio.h>
+#include <string>
+#include <sys/types.h>
+#include <time.h>
+
+/**
+ * @brief 按大小和时间滚动的日志文件，只在一个线程中使用（AsyncLogger的后台线程）
+ *        文件名为 basename.年月日-时分秒.主机名.pid.log
+ *        写入超过rollSize字节，或者进入新的rollInterval周期（默认按天）时换一个新文件
+ */
+class LogFile : noncopyable
+{
+public:
+    LogFile(const std::string &basename, off_t rollSize, int rollIntervalSeconds = kDefaultRollInterval);
+    ~LogFile();
+
+    void append(const char *data, size_t len);
+    void flush();
+    // 换一个新文件，同一秒内不会重复滚动
+    bool rollFile();
+
+    const std::string &currentFileName() const { return fileName_; }
+    int rolledFiles() const { return rolledFiles_; }
+
+    static const int kDefaultRollInterval = 24 * 60 * 60;
+
+private:
+    static std::string getLogFileName(const std::string &basename, time_t now);
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const int rollInterval_;
+
+    FILE *fp_;
+    char buffer_[64 * 1024]; // stdio的缓冲区，由flush()或者写满时刷到内核
+    std::string fileName_;
+    off_t writtenBytes_;
+    time_t startOfPeriod_; // 当前文件所在周期的开始时间
+    time_t lastRoll_;
+    int rolledFiles_;
+};
+
+#endif
@@ -3,93 +3,164 @@
 
 #include "noncopyable.h"
 
+#include <atomic>
+#include <mutex>
 #include <string>
-#include <iostream>
+#include <unordered_map>
+#include <vector>
+#include <stddef.h>
+#include <stdlib.h>
+
+/**
+ * @brief 定义日志的级别
+ */
+enum LogLevel
+{
+    DEBUG, // debug信息
+    INFO,  // 普通信息
+    ERROR, // 错误信息
+    FATAL, // core信息
+};
+
+// 编译期的最低级别，低于它的LOG宏直接编译为空，比如-DMYMUDUO_LOG_MIN_LEVEL=1去掉所有LOG_DEBUG
+// 0:DEBUG 1:INFO 2:ERROR，LOG_FATAL总是保留
+#ifndef MYMUDUO_LOG_MIN_LEVEL
+#define MYMUDUO_LOG_MIN_LEVEL 0
+#endif
+
+// 日志模块名，默认是源文件名去掉目录和扩展名（比如EpollPoller），
+// 可以在编译选项中或者第一次包含本文件之前定义成别的名字
+#ifndef LOG_MODULE
+#define LOG_MODULE __BASE_FILE__
+#endif
+
+/**
+ * @brief 一个日志模块的运行期级别，每个编译单元有一个，在静态初始化时向Logger注册
+ *        LOG宏只读一次level_（relaxed），级别不够时不求值参数、不格式化
+ */
+class LogModule : noncopyable
+{
+public:
+    explicit LogModule(const char *file);
+    ~LogModule();
+
+    bool enabled(int level) const { return level >= level_.load(std::memory_order_relaxed); }
+    const std::string &name() const { return name_; }
+
+private:
+    friend class Logger;
+
+    std::string name_;
+    std::atomic_int level_;
+};
+
+namespace
+{
+    LogModule g_logModule(LOG_MODULE);
+}
+
+#define LOG_ENABLED(level) ((level) >= MYMUDUO_LOG_MIN_LEVEL && g_logModule.enabled(level))
 
 /**
  * @brief 定义LOG宏
+ *        一行日志（级别、位置、时间、内容）先格式化到线程局部的缓冲区，再一次交给输出函数
+ *        默认输出到stdout，不逐行flush；用AsyncLogger作为输出函数时，调用线程不会等待磁盘
  */
 
-#define LOG_INFO(logmsgfmt, ...)                                                             \
-    do                                                                                       \
-    {                                                                                        \
-        std::cout << "[INFO]" << __FILE__ << ":" << __LINE__ << ":" << __FUNCTION__ << ": "; \
-        Logger &logger = Logger::instance();                                                 \
-        logger.setLogLevel(INFO);                                                            \
-        char buf[1024] = {0};                                                                \
-        snprintf(buf, 1024, logmsgfmt, ##__VA_ARGS__);                                       \
-        logger.log(buf);                                                                     \
+#define LOG_DEBUG(logmsgfmt, ...)                                                                   \
+    do                                                                                              \
+    {                                                                                               \
+        if (LOG_ENABLED(DEBUG))                                                                     \
+        {                                                                                           \
+            Logger::instance().log(DEBUG, __FILE__, __LINE__, __FUNCTION__, logmsgfmt, ##__VA_ARGS__); \
+        }                                                                                           \
     } while (0)
 
-#define LOG_ERROR(logmsgfmt, ...)                                                             \
-    do                                                                                        \
-    {                                                                                         \
-        std::cout << "[ERROR]" << __FILE__ << ":" << __LINE__ << ":" << __FUNCTION__ << ": "; \
-        Logger &logger = Logger::instance();                                                  \
-        logger.setLogLevel(ERROR);                                                            \
-        char buf[1024] = {0};                                                                 \
-        snprintf(buf, 1024, logmsgfmt, ##__VA_ARGS__);                                        \
-        logger.log(buf);                                                                      \
+#define LOG_INFO(logmsgfmt, ...)                                                                   \
+    do                                                                                             \
+    {                                                                                              \
+        if (LOG_ENABLED(INFO))                                                                     \
+        {                                                                                          \
+            Logger::instance().log(INFO, __FILE__, __LINE__, __FUNCTION__, logmsgfmt, ##__VA_ARGS__); \
+        }                                                                                          \
     } while (0)
 
-#define LOG_FATAL(logmsgfmt, ...)                                                             \
-    do                                                                                        \
-    {                                                                                         \
-        std::cout << "[FATAL]" << __FILE__ << ":" << __LINE__ << ":" << __FUNCTION__ << ": "; \
-        Logger &logger = Logger::instance();                                                  \
-        logger.setLogLevel(FATAL);                                                            \
-        char buf[1024] = {0};                                                                 \
-        snprintf(buf, 1024, logmsgfmt, ##__VA_ARGS__);                                        \
-        logger.log(buf);                                                                      \
-        exit(-1);                                                                             \
+#define LOG_ERROR(logmsgfmt, ...)                                                                   \
+    do                                                                                              \
+    {                                                                                               \
+        if (LOG_ENABLED(ERROR))                                                                     \
+        {                                                                                           \
+            Logger::instance().log(ERROR, __FILE__, __LINE__, __FUNCTION__, logmsgfmt, ##__VA_ARGS__); \
+        }                                                                                           \
     } while (0)
 
-#ifdef MUDEBUG
-#define LOG_DEBUG(logmsgfmt, ...)                                                             \
-    do                                                                                        \
-    {                                                                                         \
-        std::cout << "[DEBUG]" << __FILE__ << ":" << __LINE__ << ":" << __FUNCTION__ << ": "; \
-        Logger &logger = Logger::instance();                                                  \
-        logger.setLogLevel(DEBUG);                                                            \
-        char buf[1024] = {0};                                                                 \
-        snprintf(buf, 1024, logmsgfmt, ##__VA_ARGS__);                                        \
-        logger.log(buf);                                                                      \
+// FATAL不受级别限制
+#define LOG_FATAL(logmsgfmt, ...)                                                           \
+    do                                                                                      \
+    {                                                                                       \
+        Logger::instance().log(FATAL, __FILE__, __LINE__, __FUNCTION__, logmsgfmt, ##__VA_ARGS__); \
+        Logger::instance().flush();                                                         \
+        exit(-1);                                                                           \
     } while (0)
-#else
-#define LOG_DEBUG(logmsgfmt, ...)
-#endif
-
-/**
- * @brief 定义日志的级别
- */
-enum LogLevel
-{
-    INFO,  // 普通信息
-    ERROR, // 错误信息
-    FATAL, // core信息
-    DEBUG  // debug信息
-};
 
 /**
  * @brief 输出一个日志类
+ *        全局级别默认是INFO，可以用环境变量MYMUDUO_LOG_LEVEL设置，格式同configure()
  */
 class Logger : noncopyable
 {
 public:
+    // msg是完整的一行，以'\n'结尾
+    using OutputFunc = void (*)(const char *msg, size_t len);
+    using FlushFunc = void (*)();
+
     // 获取单例对象
     static Logger &instance();
 
-    // 设置日志级别
+    // 输出日志，任意线程都可以调用，调用方已经检查过级别
+    void log(int level, const char *file, int line, const char *func, const char *fmt, ...)
+        __attribute__((format(printf, 6, 7)));
+
+    // 以下设置任意线程都可以调用，立即对所有LOG宏生效
+    // 全局级别，对没有单独设置级别的模块生效
     void setLogLevel(int level);
+    int logLevel() const;
+    // 单独设置一个模块的级别，模块名见LOG_MODULE
+    void setModuleLevel(const std::string &module, int level);
+    void clearModuleLevel(const std::string &module);
+    // 解析"INFO,EpollPoller=DEBUG,TcpConnection=ERROR"，第一个不带'='的项是全局级别，格式错误时返回false
+    bool configure(const std::string &spec);
+    // 已经注册的模块名，用于查看可以设置哪些模块
+    std::vector<std::string> modules() const;
+
+    static const char *levelName(int level);
+    // 不区分大小写，不认识时返回-1
+    static int parseLevel(const std::string &name);
 
-    // 输出日志
-    void log(std::string msg);
+    // 替换输出函数，比如换成AsyncLogger::append，在启动时设置
+    void setOutput(OutputFunc output) { output_.store(output, std::memory_order_release); }
+    void setFlush(FlushFunc flush) { flush_.store(flush, std::memory_order_release); }
+    // FATAL日志退出之前调用，确保日志落盘
+    void flush() { flush_.load(std::memory_order_acquire)(); }
 
 private:
+    friend class LogModule;
+
     // 构造私有化
-    Logger() {}
+    Logger();
+
+    void registerModule(LogModule *module);
+    void unregisterModule(LogModule *module);
+    // 持有mutex_时调用，按全局级别和单独设置的级别更新模块
+    void applyLevel(LogModule *module);
+
+    std::atomic<OutputFunc> output_;
+    std::atomic<FlushFunc> flush_;
 
-    int logLevel_;
+    mutable std::mutex mutex_;
+    int level_; // 以下受mutex_保护
+    std::unordered_map<std::string, int> moduleLevels_; // 单独设置的级别，之后注册的模块也会用到
+    std::vector<LogModule *> modules_;
 };
 
 #endif
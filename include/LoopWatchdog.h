@@ -0,0 +1,133 @@
+#ifndef LOOPWATCHDOG_H
+#define LOOPWATCHDOG_H
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+
+class Channel;
+class EventLoop;
+
+/**
+ * @brief 一个EventLoop当前在执行什么，由loop线程写、LoopWatchdog读
+ *        每进入和离开一次channel事件处理或者一个pending functor，seq各加一，奇数表示正在执行回调
+ *        loop线程每次回调只做几次relaxed store，不读时钟；是否超时由watchdog线程观察seq是否停在同一个奇数上来判断
+ *        和EventLoop共享所有权，loop析构以后watchdog仍然可以安全地读
+ */
+struct alignas(64) LoopActivity
+{
+    enum Kind
+    {
+        kIdle,
+        kChannelEvent,
+        kPendingFunctor,
+    };
+
+    explicit LoopActivity(pid_t t) : tid(t), seq(0), kind(kIdle), channel(nullptr), alive(true), captureSeq(0), depth(0) {}
+
+    // loop线程调用
+    void enter(Kind k, Channel *c)
+    {
+        kind.store(k, std::memory_order_relaxed);
+        channel.store(c, std::memory_order_relaxed);
+        seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    void leave()
+    {
+        seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    const pid_t tid;
+    std::atomic<uint64_t> seq;
+    std::atomic_int kind;
+    std::atomic<Channel *> channel; // kChannelEvent时正在处理的channel
+    std::atomic_bool alive;         // loop已经析构时为false
+
+    // 以下由卡住的线程在信号处理函数中填写，写完以后设置captureSeq
+    static const int kMaxFrames = 64;
+    std::atomic<uint64_t> captureSeq;
+    void *frames[kMaxFrames];
+    int depth;
+    int revents;
+    int fd;
+    char owner[256]; // channel所属对象的描述，比如连接名
+};
+using LoopActivityPtr = std::shared_ptr<LoopActivity>;
+
+/**
+ * @brief 卡住的loop的检测
+ *        后台线程每threshold/4检查一次被监视的loop，如果一个loop在同一个channel事件或者functor里停留超过threshold，
+ *        向该线程发送信号，在信号处理函数中抓取调用栈和正在处理的channel（fd、事件、所属连接名），然后回调StallCallback，
+ *        默认用LOG_ERROR输出；同一次卡住只报告一次
+ *        调用栈中的函数名依赖动态符号表，可执行文件需要用-rdynamic链接
+ *        用法：
+ *            LoopWatchdog watchdog(0.1); // 100ms
+ *            server.setThreadInitcallback([&](EventLoop *loop) { watchdog.watch(loop); });
+ *            watchdog.watch(&baseLoop);
+ *            watchdog.start();
+ */
+class LoopWatchdog : noncopyable
+{
+public:
+    struct StallReport
+    {
+        pid_t loopTid;
+        const char *callbackType; // "channel event"或者"pending functor"
+        int fd;                   // channel event时有效，否则为-1
+        int revents;
+        std::string owner;        // channel所属对象的描述，比如连接名，可能为空
+        double stalledSeconds;    // 检测到时已经卡住的时间
+        std::vector<std::string> backtrace;
+    };
+    using StallCallback = std::function<void(const StallReport &)>;
+
+    explicit LoopWatchdog(double thresholdSeconds);
+    ~LoopWatchdog();
+
+    // 线程安全，loop析构以后自动不再检查
+    void watch(EventLoop *loop);
+    void setStallCallback(const StallCallback &cb) { stallCallback_ = cb; }
+    // 抓取调用栈使用的信号，默认SIGRTMIN+2，在start()之前设置
+    void setSignal(int signo) { signo_ = signo; }
+
+    void start();
+    void stop();
+
+    uint64_t stalls() const { return stalls_.load(std::memory_order_relaxed); }
+
+private:
+    struct Watched
+    {
+        LoopActivityPtr activity;
+        uint64_t lastSeq;
+        int64_t sinceNs;
+        bool reported;
+    };
+
+    void threadFunc();
+    void check(Watched *w, int64_t nowNs);
+    void report(const LoopActivityPtr &activity, uint64_t seq, double stalledSeconds);
+    static void defaultStallCallback(const StallReport &report);
+
+    const double threshold_;
+    int signo_;
+    StallCallback stallCallback_;
+    std::atomic<uint64_t> stalls_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool running_;                 // 受mutex_保护
+    std::vector<Watched> watched_; // 受mutex_保护
+    std::unique_ptr<Thread> thread_;
+};
+
+#endif
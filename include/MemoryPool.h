@@ -0,0 +1,90 @@
+#ifndef MEMORYPOOL_H
+#define MEMORYPOOL_H
+
+#include "noncopyable.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+#include <new>
+#include <unistd.h>
+
+/**
+ * @brief 每个EventLoop持有的定长分块内存池
+ *        按64字节划分大小等级，owner线程分配和回收不加锁，
+ *        其它线程回收的内存块先挂到远端空闲链表，owner线程分配时批量取回
+ *        由shared_ptr管理：EventLoop和每个PoolAllocator各持有一份，loop析构以后，
+ *        只要还有从池中分配的对象（比如被用户持有的TcpConnectionPtr），chunk就不会被释放
+ */
+class MemoryPool : noncopyable
+{
+public:
+    static const size_t kAlignment = 64;
+    static const size_t kMaxBlockSize = 2048;
+    static const size_t kChunkSize = 64 * 1024;
+
+    MemoryPool();
+    ~MemoryPool();
+
+    // 超过kMaxBlockSize的请求直接走operator new
+    void *allocate(size_t size);
+    void deallocate(void *p, size_t size);
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+    static const size_t kNumClasses = kMaxBlockSize / kAlignment;
+
+    static size_t classIndex(size_t size) { return (size + kAlignment - 1) / kAlignment - 1; }
+    static size_t classSize(size_t index) { return (index + 1) * kAlignment; }
+
+    bool isOwnerThread() const;
+    // 从新的chunk上切分出一批内存块，需持有mutex_
+    FreeBlock *carveLocked(size_t index);
+
+    const pid_t ownerTid_;
+    FreeBlock *freeLists_[kNumClasses];   // 只有owner线程访问
+    FreeBlock *remoteLists_[kNumClasses]; // mutex_保护，其它线程释放的内存块
+    std::vector<void *> chunks_;          // mutex_保护
+    std::mutex mutex_;
+};
+
+/**
+ * @brief 配合std::allocate_shared使用的分配器，从指定的MemoryPool上分配
+ *        allocate_shared把分配器的拷贝保存在控制块里，所以最后一个对象释放以后内存池才会析构
+ */
+template <typename T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+
+    explicit PoolAllocator(const std::shared_ptr<MemoryPool> &pool) : pool_(pool) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &other) : pool_(other.pool()) {}
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(pool_->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        pool_->deallocate(p, n * sizeof(T));
+    }
+
+    const std::shared_ptr<MemoryPool> &pool() const { return pool_; }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> &other) const { return pool_ == other.pool(); }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U> &other) const { return pool_ != other.pool(); }
+
+private:
+    std::shared_ptr<MemoryPool> pool_;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief 单写者计数器：只由拥有它的线程（一般是loop线程）修改，任意线程都可以读
+ *        修改用普通的读加写，不需要lock前缀的原子加；也可以减，用作gauge
+ */
+class MetricCounter
+{
+public:
+    MetricCounter() : value_(0) {}
+
+    void add(int64_t n = 1) { value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_;
+};
+
+// 一个EventLoop的指标，只由loop线程修改，独占缓存行
+struct alignas(64) LoopMetrics
+{
+    MetricCounter wakeups;  // poll返回的次数
+    MetricCounter events;   // 处理的channel事件数
+    MetricCounter functors; // 执行的queueInLoop/runInLoop回调数
+};
+
+// 一个TcpServer在一个io loop上的连接的指标，只由该loop线程修改，独占缓存行
+struct alignas(64) ConnectionMetrics
+{
+    explicit ConnectionMetrics(int tid) : loopTid(tid) {}
+
+    const int loopTid;
+    MetricCounter connections; // 当前连接数
+    MetricCounter closed;
+    MetricCounter bytesRead;
+    MetricCounter bytesWritten;
+    MetricCounter readCalls;
+    MetricCounter writeCalls;
+    MetricCounter readEagain;
+    MetricCounter writeEagain;
+    MetricCounter highWaterMarkHits; // 待发送数据超过高水位的次数
+    MetricCounter bufferedBytes;     // 当前所有连接待发送的字节数
+    // 开启了接收时间戳的连接上，数据从到达内核到loop的poll返回的时间之和与次数，两者的比值是平均调度延迟
+    MetricCounter receiveDelayUs;
+    MetricCounter receiveDelaySamples;
+};
+using ConnectionMetricsPtr = std::shared_ptr<ConnectionMetrics>;
+
+/**
+ * @brief 指标汇总，EventLoop和TcpServer在构造时登记采集函数，析构时注销
+ *        热路径只修改各自的计数器，scrape()时才调用采集函数读取、汇总并按Prometheus文本格式输出
+ */
+class MetricsRegistry : noncopyable
+{
+public:
+    enum Type
+    {
+        kCounter,
+        kGauge,
+    };
+
+    // 一个采样值，name和help是字符串常量，labels形如 server="echo",loop="1234"
+    struct Sample
+    {
+        const char *name;
+        const char *help;
+        Type type;
+        std::string labels;
+        int64_t value;
+    };
+    using Collector = std::function<void(std::vector<Sample> *)>;
+
+    static MetricsRegistry &instance();
+
+    int addCollector(Collector collector);
+    // 返回以后collector不会再被调用
+    void removeCollector(int id);
+
+    // Prometheus text format 0.0.4，同名的采样值放在一起，只输出一次HELP和TYPE
+    std::string scrape();
+
+    // 转义label的值中的反斜杠、双引号和换行
+    static std::string escapeLabel(const std::string &value);
+
+private:
+    MetricsRegistry() : nextId_(1) {}
+
+    std::mutex mutex_; // 采集期间一直持有，保证注销以后collector不再被调用
+    int nextId_;
+    std::map<int, Collector> collectors_;
+};
+
+#endif
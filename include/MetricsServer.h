@@ -0,0 +1,30 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include "noncopyable.h"
+#include "HttpServer.h"
+
+#include <string>
+
+/**
+ * @brief 在一个loop上提供GET /metrics，返回MetricsRegistry中所有EventLoop和TcpServer的指标
+ *        采集只读取各线程的计数器，不向io loop投递任务，io loop阻塞时也能正常应答
+ *        用法：
+ *            MetricsServer metrics(&loop, InetAddress(9100), "metrics");
+ *            metrics.start();
+ */
+class MetricsServer : noncopyable
+{
+public:
+    MetricsServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &name = "MetricsServer");
+
+    HttpServer &httpServer() { return server_; }
+    void start() { server_.start(); }
+
+private:
+    void onRequest(const HttpRequest &req, HttpResponse *resp);
+
+    HttpServer server_;
+};
+
+#endif
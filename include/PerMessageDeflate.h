@@ -0,0 +1,23 @@
+#ifndef PERMESSAGEDEFLATE_H
+#define PERMESSAGEDEFLATE_H
+
+#include <stddef.h>
+#include <string>
+
+// websocket的permessage-deflate扩展（RFC 7692）
+// 协商时固定使用server_no_context_takeover和client_no_context_takeover，每条消息独立压缩，
+// zlib流按线程复用，不需要为每个连接保存几百KB的压缩状态
+// 编译时没有找到zlib则available()返回false，服务端不会同意这个扩展
+namespace PerMessageDeflate
+{
+    bool available();
+    // 握手应答中Sec-WebSocket-Extensions的值
+    const char *responseExtension();
+
+    // 压缩一条消息，结果追加到out，去掉了末尾的00 00 ff ff
+    bool compress(const char *data, size_t len, std::string *out);
+    // 解压一条消息，结果追加到out，解压后超过maxSize返回false
+    bool decompress(const char *data, size_t len, std::string *out, size_t maxSize);
+}
+
+#endif
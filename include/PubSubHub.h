@@ -0,0 +1,98 @@
+#ifndef PUBSUBHUB_H
+#define PUBSUBHUB_H
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class EventLoop;
+
+/**
+ * @brief 按topic向大量连接广播消息
+ *        发布时只把消息放进一个不可变的共享缓冲区，每个有订阅者的loop投递一次任务，
+ *        loop中逐个订阅者以引用的方式挂到发送链上，不拷贝payload，
+ *        一次广播的内存和跨线程开销和loop的个数成正比，而不是和订阅者个数成正比
+ *        订阅表按loop分开保存，只在各自的loop线程中访问，发布路径上只有投递队列需要加锁
+ *        hub必须在所有订阅连接所属的loop退出以后才能析构
+ */
+class PubSubHub : noncopyable
+{
+public:
+    using Payload = std::shared_ptr<const std::string>;
+
+    // 订阅者的发送缓冲区积压超过上限时的处理方式
+    enum SlowSubscriberPolicy
+    {
+        kDropMessage, // 跳过这个订阅者，它会丢失这些消息
+        kDisconnect,  // 强制关闭这个订阅者的连接
+    };
+
+    struct Stats
+    {
+        uint64_t published;    // publish调用次数
+        uint64_t delivered;    // 挂到订阅者发送链上的消息数
+        uint64_t dropped;      // 因为积压被丢弃的消息数
+        uint64_t disconnected; // 因为积压被关闭的连接数
+    };
+
+    static const size_t kDefaultMaxPendingBytes = 4 * 1024 * 1024;
+
+    PubSubHub();
+    ~PubSubHub();
+
+    void setSlowSubscriberPolicy(SlowSubscriberPolicy policy, size_t maxPendingBytes)
+    {
+        policy_ = policy;
+        maxPendingBytes_ = maxPendingBytes;
+    }
+
+    // 以下三个函数任意线程都可以调用，实际操作在连接所属的loop中执行
+    void subscribe(const std::string &topic, const TcpConnectionPtr &conn);
+    void unsubscribe(const std::string &topic, const TcpConnectionPtr &conn);
+    // 连接断开时调用，退订这个连接的所有topic
+    void unsubscribeAll(const TcpConnectionPtr &conn);
+
+    // 任意线程都可以调用，message是已经编码好的完整协议数据（比如带长度头或者websocket帧）
+    void publish(const std::string &topic, const Payload &message);
+    void publish(const std::string &topic, std::string message)
+    {
+        publish(topic, std::make_shared<const std::string>(std::move(message)));
+    }
+
+    Stats stats() const;
+
+    // loop被回收时调用，丢弃它的订阅表，之后的publish不再投递到这个loop
+    // 配合TcpServer::setLoopRetiredCallback使用
+    void removeLoop(EventLoop *loop);
+
+private:
+    struct LoopHub;
+    using LoopHubPtr = std::shared_ptr<LoopHub>; // 已经投递给loop的任务持有一份，removeLoop以后仍然有效
+
+    // 返回loop对应的订阅表，第一次调用时创建
+    LoopHubPtr loopHub(EventLoop *loop);
+    // 在loop线程中调用：topic在这个loop上有了第一个订阅者/失去了最后一个订阅者
+    void addTopicLoop(const std::string &topic, const LoopHubPtr &hub);
+    void removeTopicLoop(const std::string &topic, LoopHub *hub);
+    void flush(LoopHub *hub);
+
+    SlowSubscriberPolicy policy_;
+    size_t maxPendingBytes_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<EventLoop *, LoopHubPtr> loops_;                  // 受mutex_保护
+    std::unordered_map<std::string, std::vector<LoopHubPtr>> topicLoops_; // 有订阅者的loop，受mutex_保护
+
+    std::atomic<uint64_t> published_;
+    std::atomic<uint64_t> delivered_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> disconnected_;
+};
+
+#endif
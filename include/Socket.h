@@ -20,6 +20,7 @@ public:
     void bindAddress(const InetAddress &localaddr);
     void listen();
     int accept(InetAddress *peeraddr);
+    void getLocalAddr(InetAddress *localaddr) const;
 
     void shutdownWrite();
 
@@ -27,6 +28,11 @@ public:
     void setReuseAddr(bool on);
     void setReusePort(bool on);
     void setKeepAlive(bool on);
+    // SO_TIMESTAMPING，内核在收到数据时打软件时间戳，用recvmsg随数据一起取出，失败返回false
+    bool setReceiveTimestamping(bool on);
+
+    // SO_INCOMING_CPU，内核处理该socket收包的cpu，获取失败返回-1
+    int incomingCpu() const;
 
 private:
     const int sockfd_;
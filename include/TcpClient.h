@@ -0,0 +1,71 @@
+#ifndef TCPCLIENT_H
+#define TCPCLIENT_H
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "InetAddress.h"
+#include "TcpConnection.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class Connector;
+class EventLoop;
+
+// 对外的客户端编程使用的类，一个TcpClient同一时刻最多有一条连接
+class TcpClient : noncopyable
+{
+public:
+    TcpClient(EventLoop *loop,
+              const InetAddress &serverAddr,
+              const std::string &nameArg);
+    ~TcpClient();
+
+    // 发起连接，失败时按指数退避重试
+    void connect();
+    // 关闭写端，断开已经建立的连接
+    void disconnect();
+    // 停止正在进行的连接和重试
+    void stop();
+
+    TcpConnectionPtr connection() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return connection_;
+    }
+
+    EventLoop *getLoop() const { return loop_; }
+    const std::string &name() const { return name_; }
+    // 连接建立以后被对端关闭时是否自动重连
+    bool retry() const { return retry_; }
+    void enableRetry() { retry_ = true; }
+    // 设置连接重试的初始间隔和最大间隔，单位毫秒，在connect()之前调用
+    void setRetryDelay(int initDelayMs, int maxDelayMs);
+
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+
+private:
+    // 在loop线程中执行，Connector连接成功
+    void newConnection(int sockfd);
+    // 在loop线程中执行，连接断开
+    void removeConnection(const TcpConnectionPtr &conn);
+
+    EventLoop *loop_;
+    std::shared_ptr<Connector> connector_;
+    const std::string name_;
+    std::shared_ptr<const std::string> connNamePrefix_; // 所有连接共享的名字前缀
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    WriteCompleteCallback writeCompleteCallback_;
+    std::atomic_bool retry_;
+    std::atomic_bool connect_;
+    uint64_t nextConnId_; // 只在loop线程中访问
+    mutable std::mutex mutex_;
+    TcpConnectionPtr connection_; // 受mutex_保护
+};
+
+#endif
@@ -6,14 +6,20 @@
 #include "Timestamp.h"
 #include "Callbacks.h"
 #include "Buffer.h"
+#include "Socket.h"
+#include "Channel.h"
+#include "Metrics.h"
 
+#include <any>
+#include <deque>
 #include <memory>
 #include <string>
 #include <atomic>
+#include <mutex>
+#include <vector>
+#include <errno.h>
 
-class Channel;
 class EventLoop;
-class Socket;
 
 /**
  * @brief TcpServer -> Acceptor -> 有一个新用户连接connfd -> TcpConnection 设置回调 -> Channel -> Poller -> Channel回调操作
@@ -21,24 +27,57 @@ class Socket;
 class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnection>
 {
 public:
+    // namePrefix由所属的server共享，连接名在第一次调用name()时才拼接
     TcpConnection(EventLoop *loop,
-                  const std::string &name,
+                  uint64_t id,
+                  const std::shared_ptr<const std::string> &namePrefix,
                   int sockfd,
-                  const InetAddress &localAddr,
                   const InetAddress &peerAddr);
     ~TcpConnection();
 
     EventLoop *getLoop() const { return loop_; }
-    const std::string &name() const { return name_; }
-    const InetAddress &localAddress() const { return localAddr_; }
+    uint64_t id() const { return id_; }
+    const std::string &name() const;
+    // 本端地址在第一次使用时才通过getsockname获取
+    const InetAddress &localAddress() const;
     const InetAddress &peerAddress() const { return peerAddr_; }
 
     bool connected() const { return state_ == kConnected; }
 
+    // 内核处理该连接收包的cpu，和loop所在的cpu比较可以发现跨核/跨NUMA节点的流量
+    int incomingCpu() const { return socket_.incomingCpu(); }
+
     // 发送数据
     void send(const std::string &buf);
+    // 发送buf中的全部可读数据并清空buf，在loop线程中调用时不会额外拷贝
+    void send(Buffer *buf);
+    // 发送不可变的共享数据，只增加引用计数，没发完的部分直接挂在发送链上，不拷贝
+    void send(const std::shared_ptr<const std::string> &data);
+    // 只能用于unix域连接：发送data，同时用SCM_RIGHTS把fd的一个副本传给对端，调用返回后可以关闭fd
+    // fd附在data的第一个字节上，对端在收到这段数据的消息回调中用takePassedFds()取出，data不能为空
+    void sendFd(int fd, const std::string &data);
+    // 只在loop线程中调用：取走对端传过来的fd，之后由调用方负责关闭，没有取走的fd在连接析构时关闭
+    std::vector<int> takePassedFds()
+    {
+        std::vector<int> fds;
+        fds.swap(passedFds_);
+        return fds;
+    }
+    // 只能在loop线程中调用：cork之后的send只追加到发送缓冲区，不调用write，
+    // uncork时用一次writev把积累的数据发出去，用于把一批小响应合并成一次系统调用
+    void cork() { corked_ = true; }
+    void uncork();
+    // 待发送的字节数，包括outputBuffer_和outputChain_，只在loop线程中调用
+    size_t pendingOutputBytes() const { return outputBuffer_.readableBytes() + outputChainBytes_; }
     // 关闭连接
     void shutdown();
+    // 不等待对端，直接关闭连接
+    void forceClose();
+
+    // 上层协议（比如http解析状态）挂在连接上的数据，只在loop线程中访问
+    void setContext(const std::any &context) { context_ = context; }
+    const std::any &getContext() const { return context_; }
+    std::any *getMutableContext() { return &context_; }
 
     void setConnectionCallback(const ConnectionCallback &cb)
     {
@@ -66,6 +105,16 @@ public:
         closeCallback_ = cb;
     }
 
+    // 在connectionEstablished()之前设置，连接的读写统计计入metrics，由同一个loop上的连接共享
+    void setMetrics(const ConnectionMetricsPtr &metrics) { metrics_ = metrics; }
+
+    // 开启以后用recvmsg读取，同时取出内核收到数据的时间（SO_TIMESTAMPING软件时间戳），只支持TCP
+    // 在loop线程中调用，比如ConnectionCallback里，失败时保持关闭并返回false
+    bool setReceiveTimestamping(bool on);
+    // 在MessageCallback中调用：本次读到的数据中最后一个报文段到达内核的时间，没有开启或者内核没有给出时无效
+    // 和MessageCallback参数中loop的poll返回时间相减，就是数据在socket里等待loop处理的时间
+    Timestamp kernelReceiveTime() const { return kernelReceiveTime_; }
+
     // 连接建立
     void connectionEstablished();
     // 连接销毁
@@ -81,24 +130,65 @@ private:
     };
     void setState(StateE state) { state_ = state; }
 
+    // Channel::OwnerDescriber，写出连接名，不分配内存
+    static void describe(const void *self, char *buf, size_t len);
+
     void handleRead(Timestamp receiveTime);
     void handleWrite();
     void handleClose();
     void handleError();
 
     void sendInLoop(const void *data, size_t len);
+    // fd是调用方dup出来的副本，发送以后或者失败时关闭
+    void sendFdInLoop(int fd, const std::string &data);
+    // payload非空时data指向payload，未发送的部分以引用的方式挂到outputChain_上
+    void sendInLoop(const void *data, size_t len, const std::shared_ptr<const std::string> &payload);
+    // 把outputBuffer_和outputChain_中的数据用writev写到socket
+    ssize_t writeOutput(int *saveErrno);
+    // 统计一次写系统调用的结果
+    void recordWrite(ssize_t n, int saveErrno)
+    {
+        if (metrics_)
+        {
+            metrics_->writeCalls.add();
+            if (n > 0)
+            {
+                metrics_->bytesWritten.add(n);
+            }
+            else if (n < 0 && saveErrno == EAGAIN)
+            {
+                metrics_->writeEagain.add();
+            }
+        }
+    }
+    // 把待发送字节数的变化计入metrics_->bufferedBytes
+    void updateBufferedBytes()
+    {
+        if (metrics_)
+        {
+            size_t pending = pendingOutputBytes();
+            metrics_->bufferedBytes.add(static_cast<int64_t>(pending) - static_cast<int64_t>(reportedOutputBytes_));
+            reportedOutputBytes_ = pending;
+        }
+    }
     void shutdownInLoop();
+    void forceCloseInLoop();
 
     EventLoop *loop_; // subloop
-    std::string name_;
+    const uint64_t id_;
+    std::shared_ptr<const std::string> namePrefix_;
     std::atomic_int state_;
     bool reading_;
+    bool corked_;
 
-    // 关联了一个socket和channel
-    std::unique_ptr<Channel> channel_;
-    std::unique_ptr<Socket> socket_;
+    // 关联了一个socket和channel，直接内嵌在TcpConnection中，和它一起从loop的内存池分配
+    Socket socket_;
+    Channel channel_;
 
-    const InetAddress localAddr_;
+    mutable std::once_flag nameOnce_;
+    mutable std::string name_;
+    mutable std::once_flag localAddrOnce_;
+    mutable InetAddress localAddr_;
     const InetAddress peerAddr_;
 
     ConnectionCallback connectionCallback_;
@@ -108,8 +198,26 @@ private:
     HighWaterMarkCallback highWaterMarkCallback_;
     size_t highWaterMark_;
 
+    // 发送链上的一段共享数据，offset之前的部分已经发送
+    struct OutputSegment
+    {
+        std::shared_ptr<const std::string> data;
+        size_t offset;
+        int passedFd = -1; // 不为-1时要和这一段的第一个字节一起用SCM_RIGHTS发送
+    };
+
     Buffer outputBuffer_; // 向fd写数据
+    // outputBuffer_之后待发送的数据，非空时新的数据都追加到这里，保证发送顺序
+    std::deque<OutputSegment> outputChain_;
+    size_t outputChainBytes_;
     Buffer inputBuffer_;  // 从fd读数据
+    std::vector<int> passedFds_; // unix域连接上对端传过来、还没有被取走的fd
+    bool receiveTimestamping_;
+    Timestamp kernelReceiveTime_; // 最近一次读到数据时内核的接收时间
+    std::any context_;
+
+    ConnectionMetricsPtr metrics_;
+    size_t reportedOutputBytes_; // 已经计入metrics_->bufferedBytes的待发送字节数
 };
 
 #endif
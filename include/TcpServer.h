@@ -9,18 +9,22 @@
 #include "Callbacks.h"
 #include "TcpConnection.h"
 #include "Buffer.h"
+#include "Metrics.h"
 
 #include <functional>
 #include <string>
 #include <memory>
 #include <atomic>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 // 对外的服务器编程使用的类
 class TcpServer : noncopyable
 {
 public:
     using ThreadInitCallback = std::function<void(EventLoop*)>;
+    using LoopRetiredCallback = std::function<void(EventLoop*)>;
 
     enum Option
     {
@@ -28,6 +32,13 @@ public:
         kReusePort,
     };
 
+    // 运行时缩容时，被移除的subloop上已有连接的处理方式
+    enum DrainMode
+    {
+        kGracefulClose, // 关闭写端，等待对端关闭
+        kForceClose,    // 直接关闭
+    };
+
     TcpServer(EventLoop *loop,
                 const InetAddress &listenAddr,
                 const std::string &nameArg,
@@ -38,23 +49,70 @@ public:
     void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
     void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
     void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+    // 缩容时subloop上的连接全部关闭以后、loop线程退出之前，在baseLoop中回调，用来清理按loop保存的状态
+    void setLoopRetiredCallback(const LoopRetiredCallback &cb) { loopRetiredCallback_ = cb; }
 
-    // 设置底层subloop的个数
+    // 设置底层subloop的个数，start()之后调用会在运行时扩容或缩容
     void setThreadNum(int numThreads);
+    void setDrainMode(DrainMode mode) { drainMode_ = mode; }
+    // kGracefulClose模式下等待对端关闭的最长时间（秒），超时后强制关闭剩下的连接，<=0表示一直等待
+    void setDrainTimeout(double seconds) { drainTimeout_ = seconds; }
+    // 在start()之前设置subloop、baseLoop绑定的cpu，以及是否优先使用本地NUMA节点的内存
+    void setThreadCpus(const std::vector<std::vector<int>> &threadCpus) { threadPool_->setThreadCpus(threadCpus); }
+    void setBaseLoopCpus(const std::vector<int> &cpus) { threadPool_->setBaseLoopCpus(cpus); }
+    void setNumaLocal(bool on) { threadPool_->setNumaLocal(on); }
+    // 在start()之前设置，所有连接开启内核接收时间戳，见TcpConnection::setReceiveTimestamping
+    void setReceiveTimestamping(bool on) { receiveTimestamping_ = on; }
+    // 设置新连接分配subloop的策略，默认轮询
+    void setLoadBalancePolicy(LoadBalancer::Policy policy);
+
+    EventLoop *getLoop() const { return loop_; }
+    const std::string &name() const { return name_; }
+    const std::string &ipPort() const { return ipPort_; }
 
     // 开启服务器监听
     void start();
+
+    // 遍历所有连接，cb在每个连接所属的subloop线程中执行，可用于广播和关闭
+    void forEachConnection(const ConnectionCallback &cb);
+
 private:
-    void newConnection(int sockfd, const InetAddress &peerAddr);
-    void removeConnection(const TcpConnectionPtr &conn);
-    void removeConnectionInLoop(const TcpConnectionPtr &conn);
+    using ConnectionMap = std::unordered_map<uint64_t, TcpConnectionPtr>;
+
+    // 每个subloop各自持有的连接表，只在所属loop线程中访问，连接的关闭无需回到baseLoop
+    struct ConnectionShard
+    {
+        ConnectionShard(EventLoop *l, const ConnectionMetricsPtr &m) : loop(l), metrics(m), retiring(false), drainTimer(0) {}
+        EventLoop *loop;
+        ConnectionMap connections;
+        ConnectionMetricsPtr metrics; // 这个loop上所有连接共享，只在所属loop线程中修改
+        bool retiring; // 所属loop正在被移除，连接全部关闭后通知baseLoop回收
+        TimerId drainTimer; // 优雅关闭的超时定时器，0表示没有
+    };
+    using ConnectionShardPtr = std::shared_ptr<ConnectionShard>;
+
+    // baseLoop已经accept、但还没有在subloop中创建TcpConnection的连接
+    struct PendingConnection
+    {
+        int sockfd;
+        uint64_t id;
+        InetAddress peerAddr;
+    };
 
-    using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+    void newConnections(const Acceptor::NewConnectionList &newConns);
+    void establishConnections(const ConnectionShardPtr &shard, const std::vector<PendingConnection> &pending);
+    void removeConnection(ConnectionShard *shard, const TcpConnectionPtr &conn);
+    const ConnectionShardPtr &shardOf(EventLoop *ioLoop);
+    void retireLoop(EventLoop *ioLoop);
+    void notifyLoopRetired(ConnectionShard *shard);
+    void loopRetired(EventLoop *ioLoop);
+    void collectMetrics(std::vector<MetricsRegistry::Sample> *out);
 
     EventLoop *loop_; // baseLoop 用户定义的loop
 
     const std::string ipPort_;
     const std::string name_;
+    std::shared_ptr<const std::string> connNamePrefix_; // "name-ip:port#"，所有连接共享
 
     std::unique_ptr<Acceptor> acceptor_; // 运行在mainLoop，任务就是监听新连接事件
 
@@ -65,10 +123,19 @@ private:
     WriteCompleteCallback writeCompleteCallback_; // 消息发送完成以后的回调
 
     ThreadInitCallback threadInitCallback_; // loop线程初始化的回调
+    LoopRetiredCallback loopRetiredCallback_; // subloop被回收时的回调
 
     std::atomic_int started_;
+    DrainMode drainMode_;
+    double drainTimeout_;
+    bool receiveTimestamping_;
+
+    uint64_t nextConnId_;
+    std::unordered_map<EventLoop *, ConnectionShardPtr> shards_; // subloop => 连接表，只在baseLoop中访问
 
-    int nextConnId_;
-    ConnectionMap connections_; // 保存所有的连接
+    MetricCounter accepted_; // 只在baseLoop中修改
+    std::mutex metricsMutex_;
+    std::vector<ConnectionMetricsPtr> metrics_; // 每个用过的subloop一份，loop被回收以后也保留，计数不会变小
+    int metricsId_;
 };
 #endif
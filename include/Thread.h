@@ -9,6 +9,7 @@
 #include <unistd.h>
 #include <string>
 #include <atomic>
+#include <vector>
 
 class Thread : noncopyable
 {
@@ -19,6 +20,14 @@ public:
     explicit Thread(ThreadFunc func, const std::string& name = std::string());
     ~Thread();
 
+    // 在start()之前设置，线程启动后、执行func之前绑定cpu
+    // numaLocal为true时，线程之后分配的内存优先放在本地NUMA节点
+    void setCpuAffinity(const std::vector<int> &cpus, bool numaLocal = false)
+    {
+        cpus_ = cpus;
+        numaLocal_ = numaLocal;
+    }
+
     void start();
     void join();
 
@@ -38,6 +47,8 @@ private:
     pid_t tid_;
     ThreadFunc func_;
     std::string name_;
+    std::vector<int> cpus_;
+    bool numaLocal_;
     static std::atomic_int numCreated_;
 };
 
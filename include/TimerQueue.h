@@ -0,0 +1,55 @@
+#ifndef TIMERQUEUE_H
+#define TIMERQUEUE_H
+
+#include "noncopyable.h"
+#include "Channel.h"
+#include "Callbacks.h"
+
+#include <atomic>
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+class EventLoop;
+
+/**
+ * @brief 基于timerfd的定时器队列，定时器到期事件和其它io事件一样由EventLoop分发
+ *        时间使用CLOCK_MONOTONIC，单位微秒
+ */
+class TimerQueue : noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    // 线程安全，intervalUs大于0表示周期定时器
+    TimerId addTimer(TimerCallback cb, int64_t delayUs, int64_t intervalUs);
+    void cancel(TimerId timerId);
+
+    // CLOCK_MONOTONIC的当前时间，单位微秒
+    static int64_t nowUs();
+
+private:
+    struct Timer
+    {
+        TimerCallback callback;
+        int64_t expiration;
+        int64_t interval;
+    };
+    using TimerList = std::set<std::pair<int64_t, TimerId>>; // (到期时间, id)，按到期时间排序
+
+    void addTimerInLoop(TimerId timerId, const Timer &timer);
+    void cancelInLoop(TimerId timerId);
+    // timerfd可读，执行所有到期的定时器
+    void handleRead();
+    void resetTimerfd();
+
+    EventLoop *loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+    TimerList timers_;
+    std::unordered_map<TimerId, Timer> timerMap_;
+    std::atomic<TimerId> nextTimerId_;
+};
+
+#endif
@@ -17,8 +17,20 @@ public:
 
     static Timestamp now();
     std::string ToString() const;
+
+    int64_t microSecondsSinceEpoch() const { return microsenconds_since_epoch_; }
+    // 默认构造的Timestamp无效，比如内核没有给出接收时间
+    bool valid() const { return microsenconds_since_epoch_ > 0; }
+
+    static const int kMicroSecondsPerSecond = 1000 * 1000;
 private:
     int64_t microsenconds_since_epoch_;
 };
 
+// 两个时间的差，单位微秒
+inline int64_t timeDifferenceUs(Timestamp high, Timestamp low)
+{
+    return high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+}
+
 #endif
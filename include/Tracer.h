@@ -0,0 +1,169 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief 事件循环的耗时跟踪，导出为Chrome trace（chrome://tracing、Perfetto）的JSON
+ *        每个线程一个固定大小的环形缓冲区，只由本线程写入，满了以后覆盖最旧的span，不加锁也不分配内存
+ *        采样以一次Channel::handleEvent或者一批pending functor为单位（根span），
+ *        每samplePeriod个根span记录一个，被采中的根span里嵌套的span（handleRead、messageCallback、handleWrite）一起记录，
+ *        没有采中时每个span只有一次线程局部变量的判断；samplePeriod为0（默认）时关闭
+ *        编译时定义MYMUDUO_DISABLE_TRACE可以去掉所有埋点
+ *        用法：
+ *            Tracer::instance().setSamplePeriod(100); // 每100次事件处理记录一次
+ *            ...
+ *            Tracer::instance().dump("/tmp/trace.json");
+ */
+class Tracer : noncopyable
+{
+public:
+    static const size_t kDefaultRingSize = 16384; // 每个线程保留的span个数
+
+    // 一段耗时，name必须是字符串常量
+    struct Span
+    {
+        const char *name;
+        int64_t startNs;
+        int64_t durationNs;
+        int64_t arg;
+    };
+
+    static Tracer &instance();
+
+    // 每period个根span记录一个，1表示全部记录，0表示关闭
+    void setSamplePeriod(int period) { s_samplePeriod.store(period, std::memory_order_relaxed); }
+    int samplePeriod() const { return s_samplePeriod.load(std::memory_order_relaxed); }
+    // 只影响之后第一次记录span的线程
+    void setRingSize(size_t spans) { ringSize_.store(spans, std::memory_order_relaxed); }
+
+    // 所有线程当前缓冲区中的span，按Chrome trace的JSON格式输出；不影响继续记录
+    std::string dumpJson();
+    bool dump(const std::string &path);
+    // 清空所有线程的缓冲区
+    void clear();
+
+    // 以下供TraceScope使用
+    static int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    // 根span是否采样，采中时设置t_sampled，嵌套的span一起记录
+    static bool sampleRoot()
+    {
+        if (t_sampled)
+        {
+            return true;
+        }
+        int period = s_samplePeriod.load(std::memory_order_relaxed);
+        if (__builtin_expect(period <= 0, 1) || --t_countdown > 0)
+        {
+            return false;
+        }
+        t_countdown = period;
+        return true;
+    }
+    void record(const char *name, int64_t startNs, int64_t endNs, int64_t arg);
+
+    static __thread bool t_sampled; // 当前线程正处在一个被采中的根span里
+    static __thread int t_countdown; // 距离下一次采样还有几个根span
+
+private:
+    // 单写者环形缓冲区，读取方拷贝以后检查写位置，丢掉拷贝期间被覆盖的span
+    class Ring : noncopyable
+    {
+    public:
+        Ring(size_t size, int tid) : spans_(new Span[size]), size_(size), tid_(tid), head_(0) {}
+
+        void push(const Span &span)
+        {
+            uint64_t head = head_.load(std::memory_order_relaxed);
+            spans_[head % size_] = span;
+            head_.store(head + 1, std::memory_order_release);
+        }
+        void snapshot(std::vector<Span> *out) const;
+        void clear() { cleared_.store(head_.load(std::memory_order_acquire), std::memory_order_relaxed); }
+        int tid() const { return tid_; }
+
+        std::atomic_bool retired{false}; // 所属线程已经退出
+
+    private:
+        std::unique_ptr<Span[]> spans_;
+        const size_t size_;
+        const int tid_;
+        std::atomic<uint64_t> head_;
+        std::atomic<uint64_t> cleared_{0}; // 之前的span已经被clear()
+    };
+    using RingPtr = std::shared_ptr<Ring>;
+
+    Tracer() : ringSize_(kDefaultRingSize) {}
+    Ring *ring();
+
+    static std::atomic_int s_samplePeriod; // 静态成员，常量初始化，热路径上不经过instance()
+
+    std::atomic<size_t> ringSize_;
+    std::mutex mutex_;
+    std::vector<RingPtr> rings_; // 受mutex_保护
+};
+
+/**
+ * @brief 记录一个span，作用域结束时写入本线程的环形缓冲区
+ *        root为true时是根span，按采样周期决定是否记录；否则只在所属的根span被采中时记录
+ */
+class TraceScope : noncopyable
+{
+public:
+    TraceScope(const char *name, int64_t arg, bool root)
+        : name_(nullptr), arg_(arg), startNs_(0), outermost_(false)
+    {
+        if (name != nullptr && (root ? Tracer::sampleRoot() : Tracer::t_sampled))
+        {
+            name_ = name;
+            outermost_ = !Tracer::t_sampled;
+            Tracer::t_sampled = true;
+            startNs_ = Tracer::nowNs();
+        }
+    }
+    ~TraceScope()
+    {
+        if (name_ != nullptr)
+        {
+            Tracer::instance().record(name_, startNs_, Tracer::nowNs(), arg_);
+            if (outermost_)
+            {
+                Tracer::t_sampled = false;
+            }
+        }
+    }
+    // 在作用域内更新附加的参数，比如处理的字节数
+    void setArg(int64_t arg) { arg_ = arg; }
+
+private:
+    const char *name_; // 为nullptr时不记录
+    int64_t arg_;
+    int64_t startNs_;
+    bool outermost_;
+};
+
+#define MYMUDUO_TRACE_CONCAT_(a, b) a##b
+#define MYMUDUO_TRACE_CONCAT(a, b) MYMUDUO_TRACE_CONCAT_(a, b)
+
+#ifndef MYMUDUO_DISABLE_TRACE
+// name为nullptr时不记录
+#define TRACE_ROOT_SPAN(name, arg) TraceScope MYMUDUO_TRACE_CONCAT(traceScope, __LINE__)(name, arg, true)
+#define TRACE_SPAN(name, arg) TraceScope MYMUDUO_TRACE_CONCAT(traceScope, __LINE__)(name, arg, false)
+#else
+#define TRACE_ROOT_SPAN(name, arg) do { } while (0)
+#define TRACE_SPAN(name, arg) do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef UDPCHANNEL_H
+#define UDPCHANNEL_H
+
+#include "noncopyable.h"
+#include "Socket.h"
+#include "Channel.h"
+#include "InetAddress.h"
+#include "Timestamp.h"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+class EventLoop;
+
+/**
+ * @brief 一个loop上的UDP socket
+ *        可读时用recvmmsg一次收一批数据报到预先分配的缓冲区，
+ *        读回调中发送的数据报先放进发送批次，这次读事件处理完以后用sendmmsg一次发出
+ *        开启GRO时内核把同一个流的多个数据报合并成一个大缓冲区交上来，回调之前按gso_size拆开；
+ *        sendSegments在内核支持UDP_SEGMENT时把多个等长数据报作为一个消息交给内核切分
+ *        除了统计以外的所有函数都只能在loop线程中调用
+ */
+class UdpChannel : noncopyable
+{
+public:
+    // data只在回调期间有效
+    using MessageCallback = std::function<void(UdpChannel *, const char *data, size_t len, const InetAddress &peer, Timestamp receiveTime)>;
+
+    static const int kDefaultBatchSize = 64;
+    static const size_t kDefaultBufferSize = 2048;
+    static const size_t kGroBufferSize = 65536;
+
+    UdpChannel(EventLoop *loop, const InetAddress &bindAddr, bool reusePort);
+    ~UdpChannel();
+
+    EventLoop *getLoop() const { return loop_; }
+    int fd() const { return socket_.fd(); }
+    InetAddress localAddress() const;
+
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    // 在start()之前设置：每次recvmmsg最多收batchSize个数据报，每个缓冲区bufferSize字节
+    void setBatch(int batchSize, size_t bufferSize);
+    // 在start()之前设置，内核不支持UDP_GRO时返回false；开启以后缓冲区至少64K
+    bool enableGro();
+    bool groEnabled() const { return gro_; }
+    bool gsoSupported() const { return gso_; }
+
+    void start();
+
+    // 数据报被拷贝到发送批次中；读回调中或者cork以后等批次结束再发出，否则立即发出
+    void send(const InetAddress &peer, const char *data, size_t len);
+    // 把data按segmentSize切成多个数据报发给peer，最后一个可以短一些
+    void sendSegments(const InetAddress &peer, const char *data, size_t len, size_t segmentSize);
+    // 在读回调之外连续发送多个数据报时，用cork/uncork把它们合并成一次sendmmsg
+    void cork() { corked_ = true; }
+    void uncork()
+    {
+        corked_ = false;
+        flush();
+    }
+    // 立即用sendmmsg发出发送批次
+    void flush();
+
+    // 统计，任意线程都可以读取
+    uint64_t receivedDatagrams() const { return receivedDatagrams_; }
+    uint64_t receiveCalls() const { return receiveCalls_; }
+    uint64_t sentDatagrams() const { return sentDatagrams_; }
+    uint64_t sendCalls() const { return sendCalls_; }
+    // 接收时被截断、发送时缓冲区满（EAGAIN）或者出错而丢弃的数据报
+    uint64_t droppedDatagrams() const { return droppedDatagrams_; }
+
+private:
+    // 发送批次中的一个消息，数据在sendArena_中，segment不为0时是一个GSO消息
+    struct PendingMessage
+    {
+        sockaddr_in peer;
+        size_t offset;
+        size_t len;
+        uint16_t segment;
+    };
+
+    static const size_t kMaxPendingMessages = 1024; // sendmmsg一次最多UIO_MAXIOV个
+    static const int kMaxGsoSegments = 64;
+
+    void handleRead(Timestamp receiveTime);
+    void enqueue(const sockaddr_in &peer, const char *data, size_t len, uint16_t segment);
+    // GSO被拒绝（比如网卡不支持校验和卸载）时，退回逐个数据报发送
+    void sendSegmentsOneByOne(const PendingMessage &msg);
+
+    EventLoop *loop_;
+    Socket socket_;
+    Channel channel_;
+    MessageCallback messageCallback_;
+    bool gro_;
+    bool gso_;
+    bool inRead_; // 正在处理读事件，flush留到读事件结束时做
+    bool corked_;
+
+    // 接收：batchSize_个缓冲区在recvBuffer_中连续存放
+    int batchSize_;
+    size_t bufferSize_;
+    std::vector<char> recvBuffer_;
+    std::vector<mmsghdr> recvMsgs_;
+    std::vector<iovec> recvIovs_;
+    std::vector<sockaddr_in> recvAddrs_;
+    std::vector<char> recvControl_;
+
+    // 发送
+    std::string sendArena_;
+    std::vector<PendingMessage> pending_;
+    std::vector<mmsghdr> sendMsgs_;
+    std::vector<iovec> sendIovs_;
+    std::vector<char> sendControl_;
+
+    std::atomic<uint64_t> receivedDatagrams_;
+    std::atomic<uint64_t> receiveCalls_;
+    std::atomic<uint64_t> sentDatagrams_;
+    std::atomic<uint64_t> sendCalls_;
+    std::atomic<uint64_t> droppedDatagrams_;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef UDPSERVER_H
+#define UDPSERVER_H
+
+#include "noncopyable.h"
+#include "UdpChannel.h"
+#include "InetAddress.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class EventLoop;
+class EventLoopThreadPool;
+
+/**
+ * @brief 对外的UDP服务器编程类
+ *        每个loop上一个绑定同一地址的UdpChannel，用SO_REUSEPORT让内核按四元组把数据报分到各个socket，
+ *        同一个对端的数据报总是在同一个loop中处理；setThreadNum(0)时只在baseLoop上收发
+ */
+class UdpServer : noncopyable
+{
+public:
+    using ThreadInitCallback = std::function<void(EventLoop *)>;
+
+    UdpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg);
+    ~UdpServer();
+
+    // 以下设置在start()之前调用
+    void setThreadInitcallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
+    void setMessageCallback(const UdpChannel::MessageCallback &cb) { messageCallback_ = cb; }
+    void setThreadNum(int numThreads);
+    void setBatch(int batchSize, size_t bufferSize)
+    {
+        batchSize_ = batchSize;
+        bufferSize_ = bufferSize;
+    }
+    void enableGro(bool on) { gro_ = on; }
+
+    EventLoop *getLoop() const { return loop_; }
+    const std::string &name() const { return name_; }
+    const std::string &ipPort() const { return ipPort_; }
+
+    void start();
+
+    // start()之后可用，每个loop一个
+    const std::vector<UdpChannel *> &channels() const { return channels_; }
+    // 所有channel的统计之和
+    uint64_t receivedDatagrams() const;
+    uint64_t receiveCalls() const;
+    uint64_t droppedDatagrams() const;
+
+private:
+    EventLoop *loop_; // baseLoop
+    const InetAddress listenAddr_;
+    const std::string ipPort_;
+    const std::string name_;
+
+    std::shared_ptr<EventLoopThreadPool> threadPool_;
+    ThreadInitCallback threadInitCallback_;
+    UdpChannel::MessageCallback messageCallback_;
+    int batchSize_;
+    size_t bufferSize_;
+    bool gro_;
+    bool started_;
+
+    std::vector<UdpChannel *> channels_; // 各自在所属loop中析构
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef WEBSOCKETCONTEXT_H
+#define WEBSOCKETCONTEXT_H
+
+#include "copyable.h"
+
+#include <stddef.h>
+#include <string>
+#include <string_view>
+
+class Buffer;
+
+/**
+ * @brief websocket帧的解析状态，握手完成以后挂在连接上
+ *        帧在inputBuffer中原地解掩码，没有分片、没有压缩的消息直接以视图的形式交给回调，
+ *        分片和压缩的消息才拼接到自己的内存中
+ */
+class WebSocketContext : public copyable
+{
+public:
+    enum Opcode
+    {
+        kContinuation = 0x0,
+        kText = 0x1,
+        kBinary = 0x2,
+        kClose = 0x8,
+        kPing = 0x9,
+        kPong = 0xa,
+    };
+
+    enum CloseCode
+    {
+        kNormalClosure = 1000,
+        kGoingAway = 1001,
+        kProtocolError = 1002,
+        kInvalidPayload = 1007,
+        kPolicyViolation = 1008,
+        kMessageTooBig = 1009,
+        kInternalError = 1011,
+    };
+
+    enum ParseResult
+    {
+        kMessage,    // 一条完整的text/binary消息
+        kControl,    // 一个控制帧（close/ping/pong）
+        kIncomplete, // 等待更多数据
+        kError,      // 协议错误，errorCode()给出关闭码
+        kFragment,   // 内部使用：非结束的分片已经拼接并取走
+    };
+
+    WebSocketContext(size_t maxMessageSize, bool deflate);
+
+    // 解析buf开头的一帧，返回kMessage/kControl时通过opcode()和payload()取得内容，
+    // 处理完以后必须调用consume()把这一帧从buf中取走
+    ParseResult parse(Buffer *buf);
+    void consume(Buffer *buf);
+
+    Opcode opcode() const { return opcode_; }
+    // 指向inputBuffer或者内部的拼接缓冲区，只在consume()之前有效
+    std::string_view payload() const { return payload_; }
+    CloseCode errorCode() const { return errorCode_; }
+    bool deflate() const { return deflate_; }
+
+    // 构造一个服务端帧（不加掩码）追加到buf
+    static void appendFrame(Buffer *buf, Opcode opcode, const char *data, size_t len, bool compressed = false);
+    // 帧头的最大长度：2字节 + 8字节扩展长度
+    static const size_t kMaxHeaderLen = 10;
+
+private:
+    ParseResult parseFrame(Buffer *buf);
+    ParseResult fail(CloseCode code);
+    ParseResult finishMessage(std::string_view data);
+
+    size_t maxMessageSize_;
+    bool deflate_;          // 是否协商了permessage-deflate
+    size_t frameLen_;       // 当前帧的总长度，consume时取走
+    bool fragmented_;       // 正在接收分片消息
+    bool compressed_;       // 当前消息是否压缩（第一帧的RSV1）
+    Opcode messageOpcode_;  // 分片消息第一帧的opcode
+    std::string message_;   // 分片消息拼接的内容
+    std::string inflated_;  // 解压以后的内容
+    Opcode opcode_;
+    std::string_view payload_;
+    CloseCode errorCode_;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef WEBSOCKETKERNELS_H
+#define WEBSOCKETKERNELS_H
+
+#include <stddef.h>
+
+// websocket逐字节处理的热点：解掩码和text帧的UTF-8校验
+// x86上运行时根据cpu选择AVX2/SSE2实现，其它平台使用标量实现
+namespace WebSocketKernels
+{
+    enum Isa
+    {
+        kScalar,
+        kSse2,
+        kAvx2,
+    };
+
+    // 当前cpu支持的最好的实现
+    Isa detectIsa();
+    const char *isaName(Isa isa);
+
+    // data[i] ^= mask[i % 4]，原地解掩码（掩码和解掩码是同一个操作）
+    void unmask(char *data, size_t len, const char mask[4]);
+    void unmask(char *data, size_t len, const char mask[4], Isa isa);
+
+    // 完整消息的UTF-8校验，拒绝过长编码、代理对和超过U+10FFFF的码点
+    bool validateUtf8(const char *data, size_t len);
+    bool validateUtf8(const char *data, size_t len, Isa isa);
+}
+
+#endif
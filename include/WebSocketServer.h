@@ -0,0 +1,84 @@
+#ifndef WEBSOCKETSERVER_H
+#define WEBSOCKETSERVER_H
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include "WebSocketContext.h"
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+class HttpRequest;
+struct WebSocketSession;
+
+/**
+ * @brief 基于TcpServer的websocket服务器（RFC 6455）
+ *        握手复用HttpContext解析升级请求，之后连接上的数据按帧解析
+ *        帧在inputBuffer中原地解掩码，没有分片的消息以视图的形式直接交给回调
+ *        一次读事件中产生的pong/close和回调中发送的消息合并成一次writev
+ */
+class WebSocketServer : noncopyable
+{
+public:
+    using Opcode = WebSocketContext::Opcode;
+    using CloseCode = WebSocketContext::CloseCode;
+
+    // 握手完成（conn->connected()为true）和连接断开时调用
+    using ConnectionCallback = std::function<void(const TcpConnectionPtr &)>;
+    // 在连接所属的loop线程中同步调用，message只在回调期间有效
+    using MessageCallback = std::function<void(const TcpConnectionPtr &, std::string_view message, bool binary, Timestamp)>;
+    // 应答握手之前调用，可以检查path、Origin等，返回false时应答403
+    using HandshakeCallback = std::function<bool(const TcpConnectionPtr &, const HttpRequest &)>;
+
+    static const size_t kDefaultMaxMessageSize = 16 * 1024 * 1024;
+
+    WebSocketServer(EventLoop *loop,
+                    const InetAddress &listenAddr,
+                    const std::string &name,
+                    TcpServer::Option option = TcpServer::kNoReusePort);
+    ~WebSocketServer();
+
+    EventLoop *getLoop() const { return server_.getLoop(); }
+    TcpServer &tcpServer() { return server_; }
+
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    void setHandshakeCallback(const HandshakeCallback &cb) { handshakeCallback_ = cb; }
+    // 超过限制的消息（分片拼接或者解压以后）以1009关闭连接
+    void setMaxMessageSize(size_t n) { maxMessageSize_ = n; }
+    // 客户端提出permessage-deflate时同意，不短于minSize的消息压缩发送，在start()之前调用
+    void enableCompression(bool on, size_t minSize = 256)
+    {
+        compression_ = on;
+        minCompressSize_ = minSize;
+    }
+
+    void start();
+
+    // 发送一条消息，任意线程都可以调用
+    void send(const TcpConnectionPtr &conn, std::string_view message, bool binary = false);
+    // 发送close帧，发送缓冲区清空以后关闭写端，任意线程都可以调用
+    void close(const TcpConnectionPtr &conn, CloseCode code = WebSocketContext::kNormalClosure, std::string_view reason = std::string_view());
+
+private:
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    // 处理升级请求，返回是否升级成功
+    bool handleHandshake(const TcpConnectionPtr &conn, WebSocketSession *session, Buffer *buf, Timestamp receiveTime);
+    void handleFrames(const TcpConnectionPtr &conn, WebSocketSession *session, Buffer *buf, Timestamp receiveTime);
+    void sendInLoop(const TcpConnectionPtr &conn, std::string_view message, bool binary);
+    void closeInLoop(const TcpConnectionPtr &conn, WebSocketSession *session, CloseCode code, std::string_view reason);
+
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    HandshakeCallback handshakeCallback_;
+    size_t maxMessageSize_;
+    bool compression_;
+    size_t minCompressSize_;
+    // 放在最后，最先析构：io线程退出以后才能销毁回调
+    TcpServer server_;
+};
+
+#endif
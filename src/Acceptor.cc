@@ -4,13 +4,15 @@
 
 #include <sys/types.h>    
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 
-static int createNonblocking()
+static int createNonblocking(int family)
 {
-    int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (sockfd < 0) 
     {
         LOG_FATAL("%s:%s:%d listen socket create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
@@ -20,12 +22,32 @@ static int createNonblocking()
 
 Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport)
     : loop_(loop)
-    , acceptSocket_(createNonblocking()) // socket
+    , acceptSocket_(createNonblocking(listenAddr.family())) // socket
     , acceptChannel_(loop, acceptSocket_.fd())
     , listenning_(false)
+    , maxAcceptPerRead_(kDefaultMaxAcceptPerRead)
+    , idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
 {
-    acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
+    if (listenAddr.isUnix())
+    {
+        // 上次运行留下的socket文件会让bind失败，抽象命名空间的地址随socket关闭自动释放
+        // 只删除socket文件，路径写错时不能误删普通文件
+        std::string path = listenAddr.toIp();
+        if (!path.empty() && path[0] != '@')
+        {
+            struct stat st;
+            if (::lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+            {
+                ::unlink(path.c_str());
+            }
+            unixPath_ = path;
+        }
+    }
+    else
+    {
+        acceptSocket_.setReuseAddr(true);
+        acceptSocket_.setReusePort(true);
+    }
     acceptSocket_.bindAddress(listenAddr); // bind
     // TcpServer::start() Acceptor.listen  有新用户的连接，要执行一个回调（connfd=》channel=》subloop）
     // baseLoop => acceptChannel_(listenfd) => 
@@ -36,6 +58,11 @@ Acceptor::~Acceptor()
 {
     acceptChannel_.disableAll();
     acceptChannel_.remove();
+    ::close(idleFd_);
+    if (!unixPath_.empty())
+    {
+        ::unlink(unixPath_.c_str());
+    }
 }
 
 void Acceptor::listen()
@@ -46,27 +73,78 @@ void Acceptor::listen()
 }
 
 // listenfd有事件发生了，就是有新用户连接了
+// 一次可读事件中循环accept，直到EAGAIN或者达到maxAcceptPerRead_，然后统一分发
 void Acceptor::handleRead()
 {
-    InetAddress peerAddr;
-    int connfd = acceptSocket_.accept(&peerAddr);
-    if (connfd >= 0)
+    for (int i = 0; i < maxAcceptPerRead_; ++i)
     {
-        if (newConnectionCallback_)
+        InetAddress peerAddr;
+        int connfd = acceptSocket_.accept(&peerAddr);
+        if (connfd >= 0)
+        {
+            pendingConns_.emplace_back(connfd, peerAddr);
+            continue;
+        }
+
+        int savedErrno = errno;
+        if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)
+        {
+            break;
+        }
+        else if (savedErrno == EINTR || savedErrno == ECONNABORTED)
+        {
+            continue;
+        }
+        else if (savedErrno == EMFILE || savedErrno == ENFILE)
         {
-            newConnectionCallback_(connfd, peerAddr); // 轮询找到subLoop，唤醒，分发当前的新客户端的Channel
+            LOG_ERROR("%s:%s:%d sockfd reached limit! \n", __FILE__, __FUNCTION__, __LINE__);
+            handleFdExhausted();
+            break;
         }
         else
         {
-            ::close(connfd);
+            LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__, savedErrno);
+            break;
         }
     }
+
+    if (pendingConns_.empty())
+    {
+        return;
+    }
+
+    if (newConnectionBatchCallback_)
+    {
+        newConnectionBatchCallback_(pendingConns_); // 按subLoop分组，每个subLoop只唤醒一次
+    }
     else
     {
-        LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
-        if (errno == EMFILE)
+        for (auto &item : pendingConns_)
         {
-            LOG_ERROR("%s:%s:%d sockfd reached limit! \n", __FILE__, __FUNCTION__, __LINE__);
+            if (newConnectionCallback_)
+            {
+                newConnectionCallback_(item.first, item.second); // 轮询找到subLoop，唤醒，分发当前的新客户端的Channel
+            }
+            else
+            {
+                ::close(item.first);
+            }
         }
     }
-}
\ No newline at end of file
+    pendingConns_.clear();
+}
+
+void Acceptor::handleFdExhausted()
+{
+    if (idleFd_ < 0)
+    {
+        return;
+    }
+    ::close(idleFd_);
+    idleFd_ = ::accept(acceptSocket_.fd(), nullptr, nullptr);
+    if (idleFd_ >= 0)
+    {
+        ::close(idleFd_);
+    }
+    idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
@@ -0,0 +1,170 @@
+#include "AsyncLogger.h"
+#include "LogFile.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+AsyncLogger::AsyncLogger(const std::string &basename, off_t rollSize, int flushIntervalSeconds, int rollIntervalSeconds)
+    : basename_(basename)
+    , rollSize_(rollSize)
+    , flushInterval_(flushIntervalSeconds > 0 ? flushIntervalSeconds : 1)
+    , rollInterval_(rollIntervalSeconds)
+    , running_(false)
+    , thread_(std::bind(&AsyncLogger::threadFunc, this), "AsyncLogger")
+    , currentBuffer_(new LogBuffer)
+    , nextBuffer_(new LogBuffer)
+    , flushRequested_(0)
+    , flushDone_(0)
+    , droppedBytes_(0)
+    , rolledFiles_(0)
+{
+    buffers_.reserve(16);
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    if (running_)
+    {
+        stop();
+    }
+}
+
+void AsyncLogger::start()
+{
+    running_ = true;
+    thread_.start();
+}
+
+void AsyncLogger::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cond_.notify_one();
+    thread_.join();
+}
+
+void AsyncLogger::append(const char *msg, size_t len)
+{
+    // 一个缓冲区都放不下的行直接丢弃，记进丢弃的字节数
+    if (len >= kBufferSize)
+    {
+        droppedBytes_ += len;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (currentBuffer_->avail() > len)
+    {
+        currentBuffer_->append(msg, len);
+        return;
+    }
+
+    // 当前缓冲区写满，交给后台线程
+    buffers_.push_back(std::move(currentBuffer_));
+    if (nextBuffer_)
+    {
+        currentBuffer_ = std::move(nextBuffer_);
+    }
+    else
+    {
+        currentBuffer_.reset(new LogBuffer); // 很少发生，后台线程写得太慢
+    }
+    currentBuffer_->append(msg, len);
+    cond_.notify_one();
+}
+
+void AsyncLogger::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!running_)
+    {
+        return;
+    }
+    uint64_t request = ++flushRequested_;
+    cond_.notify_one();
+    flushedCond_.wait(lock, [this, request]() { return flushDone_ >= request || !running_; });
+}
+
+void AsyncLogger::threadFunc()
+{
+    LogFile output(basename_, rollSize_, rollInterval_);
+    // 后台线程的两块备用缓冲区，和前端交换，稳定运行时不再分配内存
+    BufferPtr newBuffer1(new LogBuffer);
+    BufferPtr newBuffer2(new LogBuffer);
+    BufferVector buffersToWrite;
+    buffersToWrite.reserve(16);
+
+    bool running = true;
+    while (running)
+    {
+        uint64_t flushRequest;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (buffers_.empty() && running_ && flushRequested_ == flushDone_)
+            {
+                cond_.wait_for(lock, std::chrono::seconds(flushInterval_));
+            }
+            running = running_;
+            buffers_.push_back(std::move(currentBuffer_));
+            currentBuffer_ = std::move(newBuffer1);
+            buffersToWrite.swap(buffers_);
+            if (!nextBuffer_)
+            {
+                nextBuffer_ = std::move(newBuffer2);
+            }
+            flushRequest = flushRequested_;
+        }
+
+        if (buffersToWrite.size() > kMaxBuffersToWrite)
+        {
+            size_t dropped = 0;
+            for (size_t i = 2; i < buffersToWrite.size(); ++i)
+            {
+                dropped += buffersToWrite[i]->length();
+            }
+            droppedBytes_ += dropped;
+            char buf[256];
+            int n = snprintf(buf, sizeof buf, "AsyncLogger dropped %zu bytes, %zu larger buffers\n",
+                             dropped, buffersToWrite.size() - 2);
+            fputs(buf, stderr);
+            output.append(buf, n);
+            buffersToWrite.resize(2);
+        }
+
+        for (const BufferPtr &buffer : buffersToWrite)
+        {
+            output.append(buffer->data(), buffer->length());
+        }
+
+        // 留两块缓冲区作为下一轮的备用，其余的释放
+        if (buffersToWrite.size() > 2)
+        {
+            buffersToWrite.resize(2);
+        }
+        if (!newBuffer1)
+        {
+            newBuffer1 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer1->reset();
+        }
+        if (!newBuffer2 && !buffersToWrite.empty())
+        {
+            newBuffer2 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer2->reset();
+        }
+        buffersToWrite.clear();
+        output.flush();
+        rolledFiles_ = output.rolledFiles();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            flushDone_ = flushRequest;
+        }
+        flushedCond_.notify_all();
+    }
+    output.flush();
+}
@@ -0,0 +1,741 @@
+#include "BinaryLogger.h"
+#include "CurrentThread.h"
+#include "LogFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+namespace
+{
+    const char kMagic[8] = {'M', 'Y', 'B', 'L', 'O', 'G', '0', '1'};
+
+    template <typename T>
+    void put(std::string *out, T v)
+    {
+        out->append(reinterpret_cast<const char *>(&v), sizeof v);
+    }
+
+    void putString(std::string *out, const char *s)
+    {
+        uint32_t len = static_cast<uint32_t>(::strlen(s));
+        put(out, len);
+        out->append(s, len);
+    }
+
+    // 解码时按顺序读取字段，越界时ok变为false
+    class Reader
+    {
+    public:
+        Reader(const char *data, size_t len) : p_(data), end_(data + len), ok_(true) {}
+
+        template <typename T>
+        T get()
+        {
+            T v{};
+            if (static_cast<size_t>(end_ - p_) < sizeof v)
+            {
+                ok_ = false;
+                return v;
+            }
+            ::memcpy(&v, p_, sizeof v);
+            p_ += sizeof v;
+            return v;
+        }
+
+        std::string getString()
+        {
+            uint32_t len = get<uint32_t>();
+            if (!ok_ || static_cast<size_t>(end_ - p_) < len)
+            {
+                ok_ = false;
+                return std::string();
+            }
+            std::string s(p_, len);
+            p_ += len;
+            return s;
+        }
+
+        bool ok() const { return ok_; }
+
+    private:
+        const char *p_;
+        const char *end_;
+        bool ok_;
+    };
+
+    struct DecodedFormat
+    {
+        int level;
+        std::string file;
+        int line;
+        std::string func;
+        std::string fmt;
+        std::string argTypes;
+    };
+
+    __attribute__((format(printf, 2, 3))) void appendf(std::string *out, const char *fmt, ...)
+    {
+        char buf[512];
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buf, sizeof buf, fmt, args);
+        va_end(args);
+        if (n < 0)
+        {
+            return;
+        }
+        if (static_cast<size_t>(n) < sizeof buf)
+        {
+            out->append(buf, n);
+            return;
+        }
+        size_t old = out->size();
+        out->resize(old + n + 1);
+        va_start(args, fmt);
+        vsnprintf(&(*out)[old], n + 1, fmt, args);
+        va_end(args);
+        out->resize(old + n);
+    }
+
+    // 一个参数，整数和指针都按64位保存
+    struct Arg
+    {
+        char type;
+        int64_t i;
+        double d;
+        std::string s;
+    };
+
+    // printf按长度修饰符从整数参数中读取的位数，没有修饰符时是int
+    int integerBits(const std::string &length)
+    {
+        static const struct
+        {
+            const char *length;
+            size_t bytes;
+        } kLengths[] = {
+            {"", sizeof(int)}, {"hh", sizeof(char)}, {"h", sizeof(short)}, {"l", sizeof(long)}, {"ll", sizeof(long long)},
+            {"q", sizeof(long long)}, {"j", sizeof(intmax_t)}, {"z", sizeof(size_t)}, {"t", sizeof(ptrdiff_t)},
+        };
+        for (const auto &item : kLengths)
+        {
+            if (length == item.length)
+            {
+                return CHAR_BIT * item.bytes;
+            }
+        }
+        return CHAR_BIT * sizeof(long long);
+    }
+
+    // 按printf的规则把参数填进格式串；整数都按64位保存，
+    // 先按长度修饰符截断到printf实际读取的宽度，%d/%i再做符号扩展，这样%x、%u输出的位数和Logger一致
+    void formatMessage(std::string *out, const std::string &fmt, const std::vector<Arg> &args)
+    {
+        size_t next = 0;
+        static const Arg missing{'s', 0, 0, "<missing>"};
+        auto take = [&]() -> const Arg & { return next < args.size() ? args[next++] : missing; };
+
+        for (size_t i = 0; i < fmt.size(); ++i)
+        {
+            if (fmt[i] != '%')
+            {
+                out->push_back(fmt[i]);
+                continue;
+            }
+            if (i + 1 < fmt.size() && fmt[i + 1] == '%')
+            {
+                out->push_back('%');
+                ++i;
+                continue;
+            }
+
+            // 标志、宽度、精度，'*'替换成参数的值
+            std::string spec("%");
+            size_t j = i + 1;
+            while (j < fmt.size() && ::strchr("-+ #0'", fmt[j]))
+            {
+                spec.push_back(fmt[j++]);
+            }
+            auto number = [&]() {
+                if (j < fmt.size() && fmt[j] == '*')
+                {
+                    spec += std::to_string(take().i);
+                    ++j;
+                }
+                while (j < fmt.size() && isdigit(static_cast<unsigned char>(fmt[j])))
+                {
+                    spec.push_back(fmt[j++]);
+                }
+            };
+            number();
+            if (j < fmt.size() && fmt[j] == '.')
+            {
+                spec.push_back(fmt[j++]);
+                number();
+            }
+            std::string length;
+            while (j < fmt.size() && ::strchr("hlLqjzt", fmt[j]))
+            {
+                length.push_back(fmt[j++]);
+            }
+            if (j >= fmt.size())
+            {
+                out->append(fmt, i, std::string::npos);
+                return;
+            }
+            char conv = fmt[j];
+            i = j;
+            if (conv == 'n')
+            {
+                continue;
+            }
+
+            const Arg &arg = take();
+            if (arg.type == 's' || conv == 's')
+            {
+                spec.push_back('s');
+                appendf(out, spec.c_str(), arg.type == 's' ? arg.s.c_str() : "<bad arg>");
+            }
+            else if (::strchr("eEfFgGaA", conv))
+            {
+                spec.push_back(conv);
+                appendf(out, spec.c_str(), arg.type == 'd' ? arg.d : static_cast<double>(arg.i));
+            }
+            else if (conv == 'c')
+            {
+                spec.push_back('c');
+                appendf(out, spec.c_str(), static_cast<int>(arg.i));
+            }
+            else if (conv == 'p')
+            {
+                spec.push_back('p');
+                appendf(out, spec.c_str(), reinterpret_cast<void *>(static_cast<uintptr_t>(arg.i)));
+            }
+            else
+            {
+                uint64_t value = static_cast<uint64_t>(arg.type == 'd' ? static_cast<int64_t>(arg.d) : arg.i);
+                int bits = integerBits(length);
+                uint64_t mask = bits < 64 ? (uint64_t(1) << bits) - 1 : ~uint64_t(0);
+                value &= mask;
+                spec += "ll";
+                spec.push_back(conv);
+                if (conv == 'd' || conv == 'i')
+                {
+                    bool negative = bits < 64 && (value >> (bits - 1)) != 0;
+                    appendf(out, spec.c_str(), static_cast<long long>(negative ? value | ~mask : value));
+                }
+                else
+                {
+                    appendf(out, spec.c_str(), static_cast<unsigned long long>(value));
+                }
+            }
+        }
+    }
+}
+
+BinaryLogger::StagingBuffer::StagingBuffer(size_t size, int tid)
+    : dropped(0)
+    , retired(false)
+    , reportedDropped(0)
+    , size_(size)
+    , tid_(tid)
+    , storage_(new char[size])
+    , minFreeSpace_(size)
+    , producerPos_(0)
+    , endOfRecordedSpace_(size)
+    , consumerPos_(0)
+    , peekedPos_(0)
+{
+}
+
+char *BinaryLogger::StagingBuffer::reserve(size_t n)
+{
+    // 始终保留至少一个字节的空隙，producerPos_ == consumerPos_只表示空
+    size_t producer = producerPos_.load(std::memory_order_relaxed);
+    if (n < minFreeSpace_)
+    {
+        return storage_.get() + producer;
+    }
+
+    size_t consumer = consumerPos_.load(std::memory_order_acquire);
+    if (consumer <= producer)
+    {
+        minFreeSpace_ = size_ - producer;
+        if (minFreeSpace_ > n)
+        {
+            return storage_.get() + producer;
+        }
+        // 尾部放不下，回绕到开头；consumer在开头时回绕以后就和它重合了，视为满
+        if (consumer == 0)
+        {
+            return nullptr;
+        }
+        endOfRecordedSpace_.store(producer, std::memory_order_relaxed);
+        producerPos_.store(0, std::memory_order_release);
+        producer = 0;
+    }
+    minFreeSpace_ = consumer - producer;
+    return minFreeSpace_ > n ? storage_.get() + producer : nullptr;
+}
+
+void BinaryLogger::StagingBuffer::peek(const char **first, size_t *firstLen, const char **second, size_t *secondLen)
+{
+    size_t producer = producerPos_.load(std::memory_order_acquire);
+    size_t consumer = consumerPos_.load(std::memory_order_relaxed);
+    *first = storage_.get() + consumer;
+    *second = storage_.get();
+    if (producer >= consumer)
+    {
+        *firstLen = producer - consumer;
+        *secondLen = 0;
+    }
+    else
+    {
+        // 生产者已经回绕，endOfRecordedSpace_在producerPos_之前写入
+        *firstLen = endOfRecordedSpace_.load(std::memory_order_relaxed) - consumer;
+        *secondLen = producer;
+    }
+    peekedPos_ = producer;
+}
+
+BinaryLogger &BinaryLogger::instance()
+{
+    static BinaryLogger logger;
+    return logger;
+}
+
+BinaryLogger::BinaryLogger()
+    : running_(false)
+    , rollSize_(0)
+    , bufferSize_(kDefaultBufferSize)
+    , flushRequested_(0)
+    , flushDone_(0)
+    , retiredDropped_(0)
+    , writtenBytes_(0)
+{
+}
+
+BinaryLogger::~BinaryLogger()
+{
+    if (running_)
+    {
+        stop();
+    }
+}
+
+void BinaryLogger::start(const std::string &basename, off_t rollSize, size_t bufferSize)
+{
+    if (running_)
+    {
+        return;
+    }
+    basename_ = basename;
+    rollSize_ = rollSize;
+    bufferSize_ = bufferSize;
+    retiredDropped_ = 0;
+    writtenBytes_ = 0;
+    running_ = true;
+    thread_.reset(new Thread(std::bind(&BinaryLogger::threadFunc, this), "BinaryLogger"));
+    thread_->start();
+}
+
+void BinaryLogger::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+        {
+            return;
+        }
+        running_ = false;
+    }
+    cond_.notify_one();
+    thread_->join();
+    thread_.reset();
+}
+
+void BinaryLogger::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!running_)
+    {
+        return;
+    }
+    uint64_t request = ++flushRequested_;
+    cond_.notify_one();
+    flushedCond_.wait(lock, [this, request]() { return flushDone_ >= request || !running_; });
+}
+
+uint64_t BinaryLogger::droppedRecords() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t dropped = retiredDropped_;
+    for (const StagingBufferPtr &buffer : buffers_)
+    {
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+uint32_t BinaryLogger::registerFormat(int level, const char *file, int line, const char *func, const char *fmt, std::string argTypes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t id = static_cast<uint32_t>(formats_.size() + 1);
+    formats_.push_back(FormatInfo{id, level, file, line, func, fmt, std::move(argTypes)});
+    return id;
+}
+
+BinaryLogger::StagingBuffer *BinaryLogger::stagingBuffer()
+{
+    // 线程退出时标记缓冲区，后台线程读完以后释放
+    struct Holder
+    {
+        StagingBufferPtr buffer;
+        ~Holder()
+        {
+            if (buffer)
+            {
+                buffer->retired.store(true, std::memory_order_release);
+            }
+        }
+    };
+    static thread_local StagingBuffer *t_buffer = nullptr;
+    if (__builtin_expect(t_buffer == nullptr, 0))
+    {
+        static thread_local Holder holder;
+        holder.buffer = std::make_shared<StagingBuffer>(bufferSize_, CurrentThread::tid());
+        t_buffer = holder.buffer.get();
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers_.push_back(holder.buffer);
+    }
+    return t_buffer;
+}
+
+void BinaryLogger::appendFormat(std::string *out, const FormatInfo &info)
+{
+    put<uint8_t>(out, kFormatEntry);
+    put<uint32_t>(out, info.id);
+    put<int32_t>(out, info.level);
+    put<int32_t>(out, info.line);
+    putString(out, info.file);
+    putString(out, info.func);
+    putString(out, info.fmt);
+    putString(out, info.argTypes.c_str());
+}
+
+std::string BinaryLogger::fileHeader(size_t formats)
+{
+    std::string out(kMagic, sizeof kMagic);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < formats; ++i)
+    {
+        appendFormat(&out, formats_[i]);
+    }
+    return out;
+}
+
+size_t BinaryLogger::drain(LogFile *output, size_t *formatsWritten)
+{
+    struct Pending
+    {
+        StagingBuffer *buffer;
+        const char *first;
+        size_t firstLen;
+        const char *second;
+        size_t secondLen;
+    };
+    std::vector<StagingBufferPtr> buffers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers = buffers_;
+    }
+
+    // 先确定要写的记录，再写字典：这些记录用到的格式串一定已经登记过了
+    std::vector<Pending> pending;
+    for (const StagingBufferPtr &buffer : buffers)
+    {
+        Pending p{buffer.get(), nullptr, 0, nullptr, 0};
+        buffer->peek(&p.first, &p.firstLen, &p.second, &p.secondLen);
+        if (p.firstLen + p.secondLen > 0)
+        {
+            pending.push_back(p);
+        }
+    }
+
+    std::string out;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (; *formatsWritten < formats_.size(); ++*formatsWritten)
+        {
+            appendFormat(&out, formats_[*formatsWritten]);
+        }
+    }
+    for (const Pending &p : pending)
+    {
+        put<uint8_t>(&out, kRecordsEntry);
+        put<int32_t>(&out, p.buffer->tid());
+        put<uint32_t>(&out, static_cast<uint32_t>(p.firstLen + p.secondLen));
+        out.append(p.first, p.firstLen);
+        out.append(p.second, p.secondLen);
+        p.buffer->consume();
+    }
+    for (const StagingBufferPtr &buffer : buffers)
+    {
+        uint64_t dropped = buffer->dropped.load(std::memory_order_relaxed);
+        if (dropped != buffer->reportedDropped)
+        {
+            put<uint8_t>(&out, kDroppedEntry);
+            put<int32_t>(&out, buffer->tid());
+            put<uint64_t>(&out, dropped);
+            buffer->reportedDropped = dropped;
+        }
+    }
+
+    if (!out.empty())
+    {
+        // 一轮的数据一次写入，文件只会在条目之间滚动，新文件开头补上文件头和完整的字典
+        int rolled = output->rolledFiles();
+        output->append(out.data(), out.size());
+        writtenBytes_ += out.size();
+        if (output->rolledFiles() != rolled)
+        {
+            std::string header = fileHeader(*formatsWritten);
+            output->append(header.data(), header.size());
+        }
+    }
+
+    // 线程已经退出并且读完的缓冲区
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.erase(std::remove_if(buffers_.begin(), buffers_.end(), [this](const StagingBufferPtr &buffer) {
+        const char *first, *second;
+        size_t firstLen, secondLen;
+        if (!buffer->retired.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        buffer->peek(&first, &firstLen, &second, &secondLen);
+        if (firstLen + secondLen != 0)
+        {
+            return false;
+        }
+        retiredDropped_ += buffer->dropped.load(std::memory_order_relaxed);
+        return true;
+    }), buffers_.end());
+    return out.size();
+}
+
+void BinaryLogger::threadFunc()
+{
+    LogFile output(basename_, rollSize_);
+    std::string header = fileHeader(0);
+    output.append(header.data(), header.size());
+    size_t formatsWritten = 0;
+
+    while (true)
+    {
+        uint64_t flushRequest;
+        bool running;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            flushRequest = flushRequested_;
+            running = running_;
+        }
+
+        size_t written = drain(&output, &formatsWritten);
+        if (!running && written == 0)
+        {
+            break;
+        }
+        if (flushRequest != flushDone_)
+        {
+            output.flush();
+            std::lock_guard<std::mutex> lock(mutex_);
+            flushDone_ = flushRequest;
+            flushedCond_.notify_all();
+        }
+        if (written == 0)
+        {
+            // 生产者不通知后台线程，空闲时每毫秒检查一次
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait_for(lock, std::chrono::milliseconds(1), [this]() { return flushRequested_ != flushDone_ || !running_; });
+        }
+    }
+    output.flush();
+    std::lock_guard<std::mutex> lock(mutex_);
+    flushedCond_.notify_all();
+}
+
+long BinaryLogger::decode(FILE *in, FILE *out, bool sortByTime)
+{
+    char magic[sizeof kMagic];
+    if (::fread(magic, 1, sizeof magic, in) != sizeof magic || ::memcmp(magic, kMagic, sizeof magic) != 0)
+    {
+        return -1;
+    }
+
+    static const char *const kLevelNames[] = {"[DEBUG]", "[INFO]", "[ERROR]", "[FATAL]"};
+    std::vector<DecodedFormat> formats(1); // id从1开始
+    std::vector<std::pair<int64_t, std::string>> lines;
+    long count = 0;
+    time_t lastSecond = -1;
+    char timebuf[64] = {0};
+
+    auto emit = [&](int64_t ts, std::string line) {
+        if (sortByTime)
+        {
+            lines.emplace_back(ts, std::move(line));
+        }
+        else
+        {
+            ::fwrite(line.data(), 1, line.size(), out);
+        }
+    };
+
+    int kind;
+    while ((kind = ::fgetc(in)) != EOF)
+    {
+        if (kind == kFormatEntry)
+        {
+            // 字典项的长度不定，逐个字段读
+            auto readInt = [&](void *v, size_t n) { return ::fread(v, 1, n, in) == n; };
+            auto readString = [&](std::string *s) {
+                uint32_t len;
+                if (!readInt(&len, sizeof len))
+                {
+                    return false;
+                }
+                s->resize(len);
+                return len == 0 || ::fread(&(*s)[0], 1, len, in) == len;
+            };
+            uint32_t id;
+            DecodedFormat f;
+            int32_t level, line;
+            if (!readInt(&id, sizeof id) || !readInt(&level, sizeof level) || !readInt(&line, sizeof line) ||
+                !readString(&f.file) || !readString(&f.func) || !readString(&f.fmt) || !readString(&f.argTypes))
+            {
+                return -1;
+            }
+            f.level = level;
+            f.line = line;
+            if (formats.size() <= id)
+            {
+                formats.resize(id + 1);
+            }
+            formats[id] = std::move(f);
+        }
+        else if (kind == kRecordsEntry)
+        {
+            int32_t tid;
+            uint32_t len;
+            if (::fread(&tid, 1, sizeof tid, in) != sizeof tid || ::fread(&len, 1, sizeof len, in) != sizeof len)
+            {
+                return -1;
+            }
+            std::string data(len, '\0');
+            if (len > 0 && ::fread(&data[0], 1, len, in) != len)
+            {
+                return -1;
+            }
+            size_t pos = 0;
+            while (pos + sizeof(RecordHeader) <= len)
+            {
+                RecordHeader header;
+                ::memcpy(&header, &data[pos], sizeof header);
+                if (header.formatId >= formats.size() || pos + sizeof header + header.argsLen > len)
+                {
+                    return -1;
+                }
+                const DecodedFormat &f = formats[header.formatId];
+                Reader reader(&data[pos + sizeof header], header.argsLen);
+                std::vector<Arg> args;
+                for (char type : f.argTypes)
+                {
+                    Arg arg{type, 0, 0, std::string()};
+                    if (type == 's')
+                    {
+                        arg.s = reader.getString();
+                    }
+                    else if (type == 'd')
+                    {
+                        arg.d = reader.get<double>();
+                    }
+                    else
+                    {
+                        arg.i = reader.get<int64_t>();
+                    }
+                    args.push_back(std::move(arg));
+                }
+                if (!reader.ok())
+                {
+                    return -1;
+                }
+                pos += (sizeof header + header.argsLen + 7) & ~size_t(7);
+
+                // 和Logger相同的格式："[INFO]file:line:func: 年/月/日 时:分:秒.微秒 内容"
+                time_t seconds = header.timestampNs / 1000000000;
+                if (seconds != lastSecond)
+                {
+                    lastSecond = seconds;
+                    struct tm tm;
+                    ::localtime_r(&seconds, &tm);
+                    snprintf(timebuf, sizeof timebuf, "%4d/%02d/%02d %02d:%02d:%02d",
+                             tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+                }
+                std::string line;
+                appendf(&line, "%s%s:%d:%s: %s.%06ld ",
+                        f.level >= DEBUG && f.level <= FATAL ? kLevelNames[f.level] : "[UNKNOWN]",
+                        f.file.c_str(), f.line, f.func.c_str(), timebuf,
+                        static_cast<long>(header.timestampNs % 1000000000 / 1000));
+                formatMessage(&line, f.fmt, args);
+                if (line.back() != '\n')
+                {
+                    line.push_back('\n');
+                }
+                emit(header.timestampNs, std::move(line));
+                ++count;
+            }
+        }
+        else if (kind == kDroppedEntry)
+        {
+            int32_t tid;
+            uint64_t dropped;
+            if (::fread(&tid, 1, sizeof tid, in) != sizeof tid || ::fread(&dropped, 1, sizeof dropped, in) != sizeof dropped)
+            {
+                return -1;
+            }
+            std::string line;
+            appendf(&line, "[DROPPED] tid=%d dropped=%llu records in total\n", tid, static_cast<unsigned long long>(dropped));
+            // 排序时放在最后一条记录之后
+            emit(lines.empty() ? 0 : lines.back().first, std::move(line));
+        }
+        else if (kind == kMagic[0])
+        {
+            // 滚动后的新文件被拼接在一起
+            if (::fread(magic, 1, sizeof magic - 1, in) != sizeof magic - 1 || ::memcmp(magic, kMagic + 1, sizeof magic - 1) != 0)
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            return -1;
+        }
+    }
+
+    if (sortByTime)
+    {
+        std::stable_sort(lines.begin(), lines.end(), [](const std::pair<int64_t, std::string> &a, const std::pair<int64_t, std::string> &b) {
+            return a.first < b.first;
+        });
+        for (const auto &line : lines)
+        {
+            ::fwrite(line.second.data(), 1, line.second.size(), out);
+        }
+    }
+    return count;
+}
@@ -1,5 +1,9 @@
 #include "Buffer.h"
+#include "Timestamp.h"
 
+#include <errno.h>
+#include <linux/errqueue.h>
+#include <sys/socket.h>
 #include <sys/uio.h>
 #include <unistd.h>
 
@@ -39,6 +43,114 @@ ssize_t Buffer::readFd(int fd, int *saveErrno)
     return n;
 }
 
+ssize_t Buffer::readFd(int fd, int *saveErrno, std::vector<int> *passedFds)
+{
+    if (passedFds == nullptr)
+    {
+        return readFd(fd, saveErrno);
+    }
+
+    const int kMaxPassedFds = 16; // 一次recvmsg最多接收的fd个数，超出的被内核关闭
+    char extrabuf[65535];
+    char control[CMSG_SPACE(kMaxPassedFds * sizeof(int))];
+    size_t writeable = writeableBytes();
+
+    struct iovec vec[2];
+    vec[0].iov_base = beginWrite();
+    vec[0].iov_len = writeable;
+    vec[1].iov_base = extrabuf;
+    vec[1].iov_len = sizeof extrabuf;
+
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof msg);
+    msg.msg_iov = vec;
+    msg.msg_iovlen = (writeable < sizeof extrabuf) ? 2 : 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+
+    ssize_t n = ::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    if (n < 0)
+    {
+        *saveErrno = errno;
+        return n;
+    }
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        {
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const int *fds = reinterpret_cast<const int *>(CMSG_DATA(cmsg));
+            passedFds->insert(passedFds->end(), fds, fds + count);
+        }
+    }
+
+    if (static_cast<size_t>(n) <= writeable)
+    {
+        writeIndex_ += n;
+    }
+    else
+    {
+        writeIndex_ = buffer_.size();
+        append(extrabuf, n - writeable);
+    }
+    return n;
+}
+
+ssize_t Buffer::readFdWithTimestamp(int fd, int *saveErrno, Timestamp *receiveTime)
+{
+    char extrabuf[65535];
+    char control[CMSG_SPACE(sizeof(struct scm_timestamping))];
+    size_t writeable = writeableBytes();
+
+    struct iovec vec[2];
+    vec[0].iov_base = beginWrite();
+    vec[0].iov_len = writeable;
+    vec[1].iov_base = extrabuf;
+    vec[1].iov_len = sizeof extrabuf;
+
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof msg);
+    msg.msg_iov = vec;
+    msg.msg_iovlen = (writeable < sizeof extrabuf) ? 2 : 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+
+    *receiveTime = Timestamp();
+    ssize_t n = ::recvmsg(fd, &msg, 0);
+    if (n < 0)
+    {
+        *saveErrno = errno;
+        return n;
+    }
+
+    // TCP一次读到多个报文段时，内核给出的是其中最后一个的时间；ts[0]为软件时间戳，CLOCK_REALTIME
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING)
+        {
+            struct scm_timestamping tss;
+            ::memcpy(&tss, CMSG_DATA(cmsg), sizeof tss);
+            if (tss.ts[0].tv_sec != 0 || tss.ts[0].tv_nsec != 0)
+            {
+                *receiveTime = Timestamp(static_cast<int64_t>(tss.ts[0].tv_sec) * Timestamp::kMicroSecondsPerSecond +
+                                         tss.ts[0].tv_nsec / 1000);
+            }
+        }
+    }
+
+    if (static_cast<size_t>(n) <= writeable)
+    {
+        writeIndex_ += n;
+    }
+    else
+    {
+        writeIndex_ = buffer_.size();
+        append(extrabuf, n - writeable);
+    }
+    return n;
+}
+
 ssize_t Buffer::writeFd(int fd, int *saveErrno)
 {
    ssize_t n = ::write(fd, peek(), readableBytes());
@@ -1,6 +1,7 @@
 #include "Channel.h"
 #include "EventLoop.h"
 #include "Logger.h"
+#include "Tracer.h"
 
 #include <sys/epoll.h>
 
@@ -9,7 +10,7 @@ const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;
 const int Channel::kWriteEvent = EPOLLOUT;
 
 Channel::Channel(EventLoop *loop, int fd)
-    : loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1), tied_(false)
+    : loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1), tied_(false), owner_(nullptr), describeOwner_(nullptr)
 {
 }
 
@@ -19,6 +20,7 @@ Channel::~Channel()
 
 void Channel::handleEvent(Timestamp receiveTime)
 {
+    TRACE_ROOT_SPAN("Channel::handleEvent", fd_);
     if (tied_)
     {
         std::shared_ptr<void> guard = tie_.lock();
@@ -39,6 +41,19 @@ void Channel::tie(const std::shared_ptr<void> &obj)
     tied_ = true;
 }
 
+void Channel::describeOwner(char *buf, size_t len) const
+{
+    if (len == 0)
+    {
+        return;
+    }
+    buf[0] = '\0';
+    if (describeOwner_ != nullptr)
+    {
+        describeOwner_(owner_, buf, len);
+    }
+}
+
 void Channel::remove()
 {
     loop_->removeChannel(this);
@@ -0,0 +1,212 @@
+#include "ComputeThreadPool.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <stdio.h>
+
+// 当前线程所属的计算线程池和worker下标，非worker线程为nullptr/-1
+static __thread ComputeThreadPool *t_computePool = nullptr;
+static __thread int t_workerIndex = -1;
+
+ComputeThreadPool::ComputeThreadPool(const std::string &name)
+    : name_(name)
+    , numThreads_(0)
+    , running_(false)
+    , next_(0)
+    , stealable_(0)
+    , idle_(0)
+{
+}
+
+ComputeThreadPool::~ComputeThreadPool()
+{
+    if (running_)
+    {
+        stop();
+    }
+}
+
+void ComputeThreadPool::start()
+{
+    if (numThreads_ <= 0)
+    {
+        LOG_FATAL("ComputeThreadPool [%s] thread num must be positive!\n", name_.c_str());
+    }
+    running_ = true;
+    for (int i = 0; i < numThreads_; ++i)
+    {
+        workers_.emplace_back(new Worker());
+    }
+    for (int i = 0; i < numThreads_; ++i)
+    {
+        char buf[name_.size() + 32];
+        snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
+        threads_.emplace_back(new Thread(std::bind(&ComputeThreadPool::workerFunc, this, i), buf));
+        threads_.back()->start();
+    }
+}
+
+void ComputeThreadPool::stop()
+{
+    running_ = false;
+    wakeup(true);
+    for (auto &t : threads_)
+    {
+        t->join();
+    }
+    threads_.clear();
+}
+
+void ComputeThreadPool::run(Task task)
+{
+    // stop()以后worker已经退出，任务入队也不会再执行，带done的版本会让等待done的一方永远挂住
+    if (!running_)
+    {
+        LOG_FATAL("ComputeThreadPool [%s] run() called before start() or after stop()!\n", name_.c_str());
+    }
+    int index;
+    if (t_computePool == this)
+    {
+        index = t_workerIndex; // worker中提交的任务放到自己的队列，缓存更友好
+    }
+    else
+    {
+        index = next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    }
+
+    Worker &worker = *workers_[index];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    stealable_.fetch_add(1);
+    wakeup(false);
+}
+
+void ComputeThreadPool::run(Task work, EventLoop *loop, Task done)
+{
+    run([work = std::move(work), loop, done = std::move(done)]() {
+        work();
+        loop->queueInLoop(done);
+    });
+}
+
+void ComputeThreadPool::runOrdered(uint64_t key, Task task)
+{
+    if (!running_)
+    {
+        LOG_FATAL("ComputeThreadPool [%s] runOrdered() called before start() or after stop()!\n", name_.c_str());
+    }
+    Worker &worker = *workers_[key % workers_.size()];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.ordered.push_back(std::move(task));
+    }
+    worker.orderedCount.fetch_add(1);
+    wakeup(true); // 只有指定的worker能执行，需要确保它被唤醒
+}
+
+void ComputeThreadPool::runOrdered(uint64_t key, Task work, EventLoop *loop, Task done)
+{
+    // 同一个worker串行执行，done按完成顺序进入loop的队列，顺序不会被打乱
+    runOrdered(key, [work = std::move(work), loop, done = std::move(done)]() {
+        work();
+        loop->queueInLoop(done);
+    });
+}
+
+void ComputeThreadPool::workerFunc(int index)
+{
+    t_computePool = this;
+    t_workerIndex = index;
+
+    Task task;
+    while (true)
+    {
+        if (takeTask(index, &task))
+        {
+            task();
+            task = nullptr;
+        }
+        else if (!running_)
+        {
+            break;
+        }
+        else
+        {
+            waitForTask(index);
+        }
+    }
+
+    t_computePool = nullptr;
+    t_workerIndex = -1;
+}
+
+bool ComputeThreadPool::takeTask(int index, Task *task)
+{
+    Worker &self = *workers_[index];
+    {
+        std::lock_guard<std::mutex> lock(self.mutex);
+        // 有序任务优先，避免被不断到来的普通任务饿死
+        if (!self.ordered.empty())
+        {
+            *task = std::move(self.ordered.front());
+            self.ordered.pop_front();
+            self.orderedCount.fetch_sub(1);
+            return true;
+        }
+        if (!self.tasks.empty())
+        {
+            *task = std::move(self.tasks.back());
+            self.tasks.pop_back();
+            stealable_.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // 自己的队列为空，从其它worker的队列头部窃取
+    size_t n = workers_.size();
+    for (size_t i = 1; i < n && stealable_.load(std::memory_order_relaxed) > 0; ++i)
+    {
+        Worker &victim = *workers_[(index + i) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            *task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            stealable_.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ComputeThreadPool::waitForTask(int index)
+{
+    Worker &self = *workers_[index];
+    std::unique_lock<std::mutex> lock(sleepMutex_);
+    idle_.fetch_add(1);
+    cond_.wait(lock, [this, &self]() {
+        return stealable_.load() > 0 || self.orderedCount.load() > 0 || !running_;
+    });
+    idle_.fetch_sub(1);
+}
+
+void ComputeThreadPool::wakeup(bool all)
+{
+    // 任务计数先于idle_更新，worker在sleepMutex_内先增加idle_再检查计数，不会丢失唤醒
+    if (idle_.load() > 0 || !running_)
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+        }
+        if (all)
+        {
+            cond_.notify_all();
+        }
+        else
+        {
+            cond_.notify_one();
+        }
+    }
+}
@@ -0,0 +1,226 @@
+#include "ConnectionPool.h"
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "Buffer.h"
+#include "Logger.h"
+
+ConnectionPool::ConnectionPool(EventLoop *loop,
+                               const InetAddress &serverAddr,
+                               const std::string &name,
+                               int numConnections,
+                               MatchMode mode,
+                               const ResponseParser &parser)
+    : loop_(loop)
+    , serverAddr_(serverAddr)
+    , name_(name)
+    , mode_(mode)
+    , parser_(parser)
+    , maxInflight_(0)
+    , inflight_(0)
+{
+    if (numConnections <= 0)
+    {
+        LOG_FATAL("ConnectionPool [%s] connection num must be positive!\n", name_.c_str());
+    }
+    for (int i = 0; i < numConnections; ++i)
+    {
+        std::unique_ptr<Backend> backend(new Backend());
+        backend->client.reset(new TcpClient(loop_, serverAddr_, name_ + "-" + std::to_string(i)));
+        backend->client->enableRetry();
+        backend->client->setConnectionCallback(
+            std::bind(&ConnectionPool::onConnection, this, static_cast<size_t>(i), std::placeholders::_1));
+        backend->client->setMessageCallback(
+            std::bind(&ConnectionPool::onMessage, this, static_cast<size_t>(i), std::placeholders::_1, std::placeholders::_2));
+        backends_.push_back(std::move(backend));
+    }
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    for (auto &backend : backends_)
+    {
+        // 连接可能比连接池活得更久，先断开和连接池的关联
+        if (backend->conn)
+        {
+            backend->conn->setConnectionCallback([](const TcpConnectionPtr &) {});
+            backend->conn->setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) {
+                buf->retrieveAll();
+            });
+        }
+        backend->client->stop();
+        failInflight(*backend);
+        backend->conn.reset(); // TcpClient析构时只有自己持有连接才会关闭它
+        backend->client.reset();
+    }
+    for (auto &request : pending_)
+    {
+        request.callback(false, std::string());
+    }
+}
+
+void ConnectionPool::start()
+{
+    for (auto &backend : backends_)
+    {
+        backend->client->connect();
+    }
+}
+
+size_t ConnectionPool::connectedCount() const
+{
+    size_t n = 0;
+    for (auto &backend : backends_)
+    {
+        if (backend->conn)
+        {
+            ++n;
+        }
+    }
+    return n;
+}
+
+void ConnectionPool::send(const std::string &request, const ResponseCallback &cb, uint64_t requestId)
+{
+    Request req{request, cb, requestId};
+    Backend *backend = pending_.empty() ? pickBackend() : nullptr; // 有排队的请求时不能插队
+    if (backend)
+    {
+        dispatch(*backend, req);
+    }
+    else
+    {
+        pending_.push_back(std::move(req));
+    }
+}
+
+ConnectionPool::Backend *ConnectionPool::pickBackend()
+{
+    // 连接数一般很少，直接遍历找未完成请求最少的连接
+    Backend *best = nullptr;
+    for (auto &backend : backends_)
+    {
+        if (backend->conn && (maxInflight_ == 0 || backend->inflight < maxInflight_)
+            && (best == nullptr || backend->inflight < best->inflight))
+        {
+            best = backend.get();
+        }
+    }
+    return best;
+}
+
+void ConnectionPool::dispatch(Backend &backend, Request &request)
+{
+    if (mode_ == kFifo)
+    {
+        backend.fifo.push_back(std::move(request.callback));
+    }
+    else
+    {
+        backend.byId[request.requestId] = std::move(request.callback);
+    }
+    ++backend.inflight;
+    ++inflight_;
+    backend.conn->send(request.data);
+}
+
+void ConnectionPool::flushPending()
+{
+    while (!pending_.empty())
+    {
+        Backend *backend = pickBackend();
+        if (backend == nullptr)
+        {
+            break;
+        }
+        dispatch(*backend, pending_.front());
+        pending_.pop_front();
+    }
+}
+
+void ConnectionPool::failInflight(Backend &backend)
+{
+    // 先取出来再回调，回调中可能会发送新的请求
+    std::deque<ResponseCallback> fifo;
+    std::unordered_map<uint64_t, ResponseCallback> byId;
+    fifo.swap(backend.fifo);
+    byId.swap(backend.byId);
+    inflight_ -= backend.inflight;
+    backend.inflight = 0;
+
+    for (auto &cb : fifo)
+    {
+        cb(false, std::string());
+    }
+    for (auto &item : byId)
+    {
+        item.second(false, std::string());
+    }
+}
+
+void ConnectionPool::onConnection(size_t index, const TcpConnectionPtr &conn)
+{
+    Backend &backend = *backends_[index];
+    if (conn->connected())
+    {
+        backend.conn = conn;
+        flushPending();
+    }
+    else
+    {
+        backend.conn.reset();
+        if (backend.inflight > 0)
+        {
+            LOG_ERROR("ConnectionPool [%s] connection %s closed with %d requests in flight\n",
+                      name_.c_str(), conn->name().c_str(), (int)backend.inflight);
+        }
+        failInflight(backend);
+    }
+}
+
+void ConnectionPool::onMessage(size_t index, const TcpConnectionPtr &conn, Buffer *buf)
+{
+    Backend &backend = *backends_[index];
+    std::string response;
+    uint64_t requestId = 0;
+    while (true)
+    {
+        ParseResult result = parser_(buf, &response, &requestId);
+        if (result == kIncomplete)
+        {
+            break;
+        }
+        if (result == kError)
+        {
+            LOG_ERROR("ConnectionPool [%s] bad response on %s\n", name_.c_str(), conn->name().c_str());
+            conn->forceClose();
+            break;
+        }
+
+        ResponseCallback cb;
+        if (mode_ == kFifo && !backend.fifo.empty())
+        {
+            cb = std::move(backend.fifo.front());
+            backend.fifo.pop_front();
+        }
+        else if (mode_ == kRequestId)
+        {
+            auto it = backend.byId.find(requestId);
+            if (it != backend.byId.end())
+            {
+                cb = std::move(it->second);
+                backend.byId.erase(it);
+            }
+        }
+        if (!cb)
+        {
+            LOG_ERROR("ConnectionPool [%s] unexpected response on %s\n", name_.c_str(), conn->name().c_str());
+            conn->forceClose();
+            break;
+        }
+
+        --backend.inflight;
+        --inflight_;
+        cb(true, response);
+    }
+    flushPending();
+}
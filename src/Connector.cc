@@ -0,0 +1,238 @@
+#include "Connector.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+static int createNonblocking(int family)
+{
+    int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sockfd < 0)
+    {
+        LOG_FATAL("%s:%s:%d connect socket create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    return sockfd;
+}
+
+static int getSocketError(int sockfd)
+{
+    int optval = 0;
+    socklen_t optlen = sizeof optval;
+    if (::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    {
+        return errno;
+    }
+    return optval;
+}
+
+// 本地端口和目的端口相同时，内核可能让socket连上自己
+static bool isSelfConnect(int sockfd)
+{
+    sockaddr_in localaddr, peeraddr;
+    socklen_t len = sizeof localaddr;
+    ::memset(&localaddr, 0, sizeof localaddr);
+    ::memset(&peeraddr, 0, sizeof peeraddr);
+    ::getsockname(sockfd, (sockaddr *)&localaddr, &len);
+    len = sizeof peeraddr;
+    ::getpeername(sockfd, (sockaddr *)&peeraddr, &len);
+    return localaddr.sin_port == peeraddr.sin_port
+        && localaddr.sin_addr.s_addr == peeraddr.sin_addr.s_addr;
+}
+
+Connector::Connector(EventLoop *loop, const InetAddress &serverAddr)
+    : loop_(loop)
+    , serverAddr_(serverAddr)
+    , connect_(false)
+    , state_(kDisconnected)
+    , initRetryDelayMs_(kDefaultInitRetryDelayMs)
+    , maxRetryDelayMs_(kDefaultMaxRetryDelayMs)
+    , retryDelayMs_(kDefaultInitRetryDelayMs)
+    , retryTimer_(0)
+{
+}
+
+Connector::~Connector()
+{
+    if (channel_)
+    {
+        LOG_ERROR("Connector::dtor[%s] channel is still alive\n", serverAddr_.toIpPort().c_str());
+    }
+}
+
+void Connector::setRetryDelay(int initDelayMs, int maxDelayMs)
+{
+    initRetryDelayMs_ = initDelayMs;
+    maxRetryDelayMs_ = maxDelayMs < initDelayMs ? initDelayMs : maxDelayMs;
+    retryDelayMs_ = initRetryDelayMs_;
+}
+
+void Connector::start()
+{
+    connect_ = true;
+    loop_->runInLoop(std::bind(&Connector::startInLoop, shared_from_this()));
+}
+
+void Connector::startInLoop()
+{
+    if (state_ != kDisconnected)
+    {
+        return;
+    }
+    if (connect_)
+    {
+        connect();
+    }
+}
+
+void Connector::stop()
+{
+    connect_ = false;
+    loop_->queueInLoop(std::bind(&Connector::stopInLoop, shared_from_this()));
+}
+
+void Connector::stopInLoop()
+{
+    if (retryTimer_ != 0)
+    {
+        loop_->cancel(retryTimer_);
+        retryTimer_ = 0;
+    }
+    if (state_ == kConnecting)
+    {
+        setState(kDisconnected);
+        int sockfd = removeAndResetChannel();
+        ::close(sockfd);
+    }
+}
+
+void Connector::restart()
+{
+    setState(kDisconnected);
+    retryDelayMs_ = initRetryDelayMs_;
+    connect_ = true;
+    startInLoop();
+}
+
+void Connector::connect()
+{
+    int sockfd = createNonblocking(serverAddr_.family());
+    int ret = ::connect(sockfd, serverAddr_.sockAddr(), serverAddr_.sockAddrLen());
+    int savedErrno = (ret == 0) ? 0 : errno;
+    switch (savedErrno)
+    {
+    case 0:
+    case EINPROGRESS:
+    case EINTR:
+    case EISCONN:
+        connecting(sockfd);
+        break;
+
+    case EAGAIN:
+    case EADDRINUSE:
+    case EADDRNOTAVAIL:
+    case ECONNREFUSED:
+    case ENETUNREACH:
+    case ENOENT: // unix域地址的socket文件还没有创建
+        retry(sockfd);
+        break;
+
+    default: // EACCES EPERM EAFNOSUPPORT EBADF等，重试没有意义
+        LOG_ERROR("Connector::connect to %s error:%d\n", serverAddr_.toIpPort().c_str(), savedErrno);
+        ::close(sockfd);
+        break;
+    }
+}
+
+void Connector::connecting(int sockfd)
+{
+    setState(kConnecting);
+    channel_.reset(new Channel(loop_, sockfd));
+    channel_->setWriteCallback(std::bind(&Connector::handleWrite, this));
+    channel_->setErrorCallback(std::bind(&Connector::handleError, this));
+    channel_->enableWriting(); // socket可写表示连接建立或者失败
+}
+
+int Connector::removeAndResetChannel()
+{
+    channel_->disableAll();
+    channel_->remove();
+    int sockfd = channel_->fd();
+    // 当前可能正处于channel_的回调中，不能在这里直接释放
+    loop_->queueInLoop(std::bind(&Connector::resetChannel, shared_from_this()));
+    return sockfd;
+}
+
+void Connector::resetChannel()
+{
+    channel_.reset();
+}
+
+void Connector::handleWrite()
+{
+    if (state_ != kConnecting)
+    {
+        return;
+    }
+
+    int sockfd = removeAndResetChannel();
+    int err = getSocketError(sockfd);
+    if (err)
+    {
+        LOG_ERROR("Connector::handleWrite %s SO_ERROR:%d\n", serverAddr_.toIpPort().c_str(), err);
+        retry(sockfd);
+    }
+    else if (!serverAddr_.isUnix() && isSelfConnect(sockfd))
+    {
+        LOG_ERROR("Connector::handleWrite %s self connect\n", serverAddr_.toIpPort().c_str());
+        retry(sockfd);
+    }
+    else
+    {
+        setState(kConnected);
+        if (connect_ && newConnectionCallback_)
+        {
+            newConnectionCallback_(sockfd);
+        }
+        else
+        {
+            ::close(sockfd);
+        }
+    }
+}
+
+void Connector::handleError()
+{
+    if (state_ == kConnecting)
+    {
+        int sockfd = removeAndResetChannel();
+        LOG_ERROR("Connector::handleError %s SO_ERROR:%d\n", serverAddr_.toIpPort().c_str(), getSocketError(sockfd));
+        retry(sockfd);
+    }
+}
+
+void Connector::retry(int sockfd)
+{
+    ::close(sockfd);
+    setState(kDisconnected);
+    if (connect_)
+    {
+        LOG_INFO("Connector::retry connecting to %s in %d milliseconds\n",
+                 serverAddr_.toIpPort().c_str(), retryDelayMs_);
+        std::weak_ptr<Connector> weak(shared_from_this());
+        retryTimer_ = loop_->runAfter(retryDelayMs_ / 1000.0, [weak]() {
+            std::shared_ptr<Connector> connector = weak.lock();
+            if (connector)
+            {
+                connector->retryTimer_ = 0;
+                connector->startInLoop();
+            }
+        });
+        retryDelayMs_ = retryDelayMs_ * 2 < maxRetryDelayMs_ ? retryDelayMs_ * 2 : maxRetryDelayMs_;
+    }
+}
@@ -0,0 +1,97 @@
+#include "Crc32c.h"
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace
+{
+    const uint32_t kPoly = 0x82f63b78; // Castagnoli多项式的反转形式
+
+    struct Table
+    {
+        uint32_t t[256];
+        Table()
+        {
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t crc = i;
+                for (int k = 0; k < 8; ++k)
+                {
+                    crc = (crc & 1) ? (crc >> 1) ^ kPoly : crc >> 1;
+                }
+                t[i] = crc;
+            }
+        }
+    };
+
+    uint32_t extendPortable(uint32_t crc, const char *p, size_t len)
+    {
+        static const Table kTable; // 函数内静态变量，避免和其它文件的静态初始化顺序问题
+        uint32_t l = ~crc;
+        for (size_t i = 0; i < len; ++i)
+        {
+            l = kTable.t[(l ^ static_cast<uint8_t>(p[i])) & 0xff] ^ (l >> 8);
+        }
+        return ~l;
+    }
+
+#if defined(__x86_64__)
+    __attribute__((target("sse4.2")))
+    uint32_t extendSse42(uint32_t crc, const char *p, size_t len)
+    {
+        uint64_t l = ~crc;
+        // 先按字节处理到8字节对齐，再每次处理8字节
+        while (len > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0)
+        {
+            l = _mm_crc32_u8(static_cast<uint32_t>(l), static_cast<uint8_t>(*p++));
+            --len;
+        }
+        while (len >= 8)
+        {
+            uint64_t v;
+            ::memcpy(&v, p, sizeof v);
+            l = _mm_crc32_u64(l, v);
+            p += 8;
+            len -= 8;
+        }
+        while (len > 0)
+        {
+            l = _mm_crc32_u8(static_cast<uint32_t>(l), static_cast<uint8_t>(*p++));
+            --len;
+        }
+        return ~static_cast<uint32_t>(l);
+    }
+#endif
+
+    using ExtendFunc = uint32_t (*)(uint32_t, const char *, size_t);
+
+    ExtendFunc chooseExtend()
+    {
+#if defined(__x86_64__)
+        if (__builtin_cpu_supports("sse4.2"))
+        {
+            return extendSse42;
+        }
+#endif
+        return extendPortable;
+    }
+
+    ExtendFunc extendFunc()
+    {
+        static const ExtendFunc func = chooseExtend();
+        return func;
+    }
+}
+
+uint32_t Crc32c::extend(uint32_t crc, const void *data, size_t len)
+{
+    return extendFunc()(crc, static_cast<const char *>(data), len);
+}
+
+bool Crc32c::hardwareAccelerated()
+{
+    return extendFunc() != extendPortable;
+}
@@ -1,5 +1,8 @@
 #include "CurrentThread.h"
 
+#include <sched.h>
+#include <linux/mempolicy.h>
+
 namespace CurrentThread
 {
     __thread int t_cachedTid = 0;
@@ -10,4 +13,39 @@ namespace CurrentThread
             t_cachedTid = static_cast<pid_t>(::syscall(SYS_gettid));
         }
     }
+
+    bool setAffinity(const std::vector<int> &cpus)
+    {
+        if (cpus.empty())
+        {
+            return true;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int c : cpus)
+        {
+            if (c >= 0 && c < CPU_SETSIZE)
+            {
+                CPU_SET(c, &set);
+            }
+        }
+        return ::sched_setaffinity(0, sizeof set, &set) == 0;
+    }
+
+    bool preferLocalNumaNode()
+    {
+        unsigned cpu = 0;
+        unsigned node = 0;
+        if (::syscall(SYS_getcpu, &cpu, &node, nullptr) < 0 || node >= sizeof(unsigned long) * 8)
+        {
+            return false;
+        }
+        unsigned long nodemask = 1UL << node;
+        return ::syscall(SYS_set_mempolicy, MPOL_PREFERRED, &nodemask, sizeof(nodemask) * 8) == 0;
+    }
+
+    int cpu()
+    {
+        return ::sched_getcpu();
+    }
 }
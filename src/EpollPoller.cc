@@ -67,7 +67,7 @@ void EpollPoller::removeChannel(Channel *channel)
 
 Timestamp EpollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 {
-    LOG_DEBUG("fd total count:%d\n", channelMap_.size());
+    LOG_DEBUG("fd total count:%zu\n", channelMap_.size());
 
     int numEvents = ::epoll_wait(epollFd_, &*events_.begin(), static_cast<int>(events_.size()), timeoutMs);
     int saveerr = errno;
@@ -2,11 +2,17 @@
 #include "Logger.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "MemoryPool.h"
+#include "TimerQueue.h"
+#include "Tracer.h"
+#include "LoopWatchdog.h"
 
 #include <sys/eventfd.h>
+#include <signal.h>
 #include <unistd.h>
 #include <errno.h>
 #include <memory>
+#include <chrono>
 
 // 防止一个线程创建多个loop
 __thread EventLoop* t_loopInThisThread = nullptr;
@@ -14,6 +20,17 @@ __thread EventLoop* t_loopInThisThread = nullptr;
 // 定义默认的poller超时时间
 const int kPoolTimeoutMs = 10000;
 
+// 对端关闭以后继续写socket会产生SIGPIPE，默认处理是结束进程，网络库统一忽略，由write返回EPIPE
+class IgnoreSigPipe
+{
+public:
+    IgnoreSigPipe()
+    {
+        ::signal(SIGPIPE, SIG_IGN);
+    }
+};
+IgnoreSigPipe initObj;
+
 // 创建wakeupFd_
 int createEventfd()
 {
@@ -51,6 +68,12 @@ EventLoop::EventLoop()
     , poller_(Poller::newDefaultPoller(this))
     , wakeupFd_(createEventfd())
     , wakeupChannel_(std::unique_ptr<Channel>(new Channel(this, wakeupFd_)))
+    , memoryPool_(std::make_shared<MemoryPool>())
+    , timerQueue_(new TimerQueue(this))
+    , activeConnections_(0)
+    , iterationTimeNs_(0)
+    , metricsId_(0)
+    , activity_(std::make_shared<LoopActivity>(threadId_))
 {
     LOG_DEBUG("Eventloop created %p in thread %d\n", this, threadId_);
     if(t_loopInThisThread)
@@ -65,10 +88,15 @@ EventLoop::EventLoop()
     // 设置wakeup
     wakeupChannel_->setReadCallback(std::bind(&EventLoop::handleRead, this));
     wakeupChannel_->enableReading();
+
+    metricsId_ = MetricsRegistry::instance().addCollector(
+        std::bind(&EventLoop::collectMetrics, this, std::placeholders::_1));
 }
 
 EventLoop::~EventLoop()
 {
+    MetricsRegistry::instance().removeCollector(metricsId_);
+    activity_->alive.store(false, std::memory_order_relaxed);
     wakeupChannel_->disableAll();
     wakeupChannel_->remove();
     ::close(wakeupFd_);
@@ -86,15 +114,27 @@ void EventLoop::loop()
     {
         activeChannels_.clear();
         pollReturnTime_ = poller_->poll(kPoolTimeoutMs, &activeChannels_);
+        auto busyStart = std::chrono::steady_clock::now();
+        metrics_.wakeups.add();
+        metrics_.events.add(activeChannels_.size());
 
         // 每一个发生事件的channel处理各自事件
+        LoopActivity *activity = activity_.get();
         for(auto channel : activeChannels_)
         {
+            activity->enter(LoopActivity::kChannelEvent, channel);
             channel->handleEvent(pollReturnTime_);
+            activity->leave();
         }
 
         // 执行当前loop上的回调
         doPendingFunctors();
+
+        // 更新本次循环的忙碌耗时，new = old * 7/8 + sample * 1/8
+        int64_t busyNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - busyStart).count();
+        int64_t oldNs = iterationTimeNs_.load(std::memory_order_relaxed);
+        iterationTimeNs_.store(oldNs - (oldNs >> 3) + (busyNs >> 3), std::memory_order_relaxed);
     }
 
     LOG_DEBUG("Eventloop %p stop looping\n", this);
@@ -103,7 +143,7 @@ void EventLoop::loop()
 
 void EventLoop::quit()
 {
-    quit_ = false;
+    quit_ = true;
     if(!isInLoopThread())
     {
         wakeup();
@@ -144,10 +184,26 @@ void EventLoop::wakeup()
     ssize_t ret = ::write(wakeupFd_, &one, sizeof one);
     if(ret != sizeof one)
     {
-        LOG_ERROR("Eventloop %p write %d bytes instead of 8 \n", this, ret);
+        LOG_ERROR("Eventloop %p write %zd bytes instead of 8 \n", this, ret);
     }
 }
 
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), static_cast<int64_t>(delay * 1000000), 0);
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+    int64_t intervalUs = static_cast<int64_t>(interval * 1000000);
+    return timerQueue_->addTimer(std::move(cb), intervalUs, intervalUs);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
 void EventLoop::updateChannel(Channel *channel)
 {
     poller_->updateChannel(channel);
@@ -169,7 +225,7 @@ void EventLoop::handleRead()
     ssize_t ret = ::read(wakeupFd_, &one, sizeof one);
     if(ret != sizeof one)
     {
-        LOG_ERROR("Eventloop %p read %d bytes instead of 8 \n", this, ret);
+        LOG_ERROR("Eventloop %p read %zd bytes instead of 8 \n", this, ret);
     }
 }
 
@@ -182,12 +238,27 @@ void EventLoop::doPendingFunctors()
         std::lock_guard<std::mutex> lock(mutex_);
         functors.swap(pendingFunctors_);
     }
+    TRACE_ROOT_SPAN(functors.empty() ? nullptr : "EventLoop::doPendingFunctors", static_cast<int64_t>(functors.size()));
 
+    LoopActivity *activity = activity_.get();
     for(auto functor : functors)
     {
+        activity->enter(LoopActivity::kPendingFunctor, nullptr);
         functor();
+        activity->leave();
     }
+    metrics_.functors.add(functors.size());
 
     callingPendingFunctors_ = false;
 
 }
+
+void EventLoop::collectMetrics(std::vector<MetricsRegistry::Sample> *out) const
+{
+    std::string labels = "loop=\"" + std::to_string(threadId_) + "\"";
+    out->push_back({"mymuduo_loop_wakeups_total", "Number of times the poller returned.", MetricsRegistry::kCounter, labels, metrics_.wakeups.value()});
+    out->push_back({"mymuduo_loop_events_total", "Number of channel events handled.", MetricsRegistry::kCounter, labels, metrics_.events.value()});
+    out->push_back({"mymuduo_loop_functors_total", "Number of queued functors executed.", MetricsRegistry::kCounter, labels, metrics_.functors.value()});
+    out->push_back({"mymuduo_loop_connections", "Connections assigned to the loop.", MetricsRegistry::kGauge, labels, activeConnections()});
+    out->push_back({"mymuduo_loop_busy_ns", "Moving average of the busy time per iteration in nanoseconds.", MetricsRegistry::kGauge, labels, iterationTimeNs()});
+}
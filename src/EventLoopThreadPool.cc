@@ -1,10 +1,12 @@
 #include "EventLoopThreadPool.h"
 #include "EventLoopThread.h"
+#include "CurrentThread.h"
 
 #include <memory>
+#include <algorithm>
 
 EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, const std::string &nameArg)
-    : baseLoop_(baseLoop), name_(nameArg), started_(false), numThreads_(0), next_(0)
+    : baseLoop_(baseLoop), name_(nameArg), started_(false), numThreads_(0), numaLocal_(false), balancer_(LoadBalancer::newLoadBalancer(LoadBalancer::kRoundRobin)), nextThreadIndex_(0)
 {
 }
 
@@ -15,14 +17,17 @@ EventLoopThreadPool::~EventLoopThreadPool()
 void EventLoopThreadPool::start(const ThreadInitCallback &cb)
 {
     started_ = true;
+    initCallback_ = cb;
+
+    // start()运行在baseLoop线程中
+    if (!baseLoopCpus_.empty())
+    {
+        CurrentThread::setAffinity(baseLoopCpus_);
+    }
 
     for (int i = 0; i < numThreads_; i++)
     {
-        char buf[name_.size() + 32];
-        snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
-        EventLoopThread *t = new EventLoopThread(cb, buf);
-        threads_.emplace_back(t);
-        loops_.emplace_back(t->startLoop());
+        addLoop();
     }
 
     if (numThreads_ == 0 && cb)
@@ -31,18 +36,90 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
     }
 }
 
-EventLoop *EventLoopThreadPool::getNextLoop()
+void EventLoopThreadPool::addLoop()
 {
-    EventLoop *loop = baseLoop_;
+    char buf[name_.size() + 32];
+    snprintf(buf, sizeof buf, "%s%d", name_.c_str(), nextThreadIndex_++);
+    EventLoopThread *t = new EventLoopThread(initCallback_, buf);
+    size_t slot = loops_.size(); // 第slot个subloop使用threadCpus_[slot]
+    if (slot < threadCpus_.size())
+    {
+        t->setCpuAffinity(threadCpus_[slot], numaLocal_);
+    }
+    threads_.emplace_back(t);
+    loops_.emplace_back(t->startLoop());
+}
 
-    if (!loops_.empty()) // 通过轮询获取下一个处理事件的loop
+void EventLoopThreadPool::resize(int numThreads)
+{
+    if (numThreads < 0)
     {
-        loop = loops_[next_];
-        ++next_;
-        if (next_ >= loops_.size())
+        numThreads = 0;
+    }
+    numThreads_ = numThreads;
+    if (!started_)
+    {
+        return;
+    }
+
+    while (static_cast<int>(loops_.size()) < numThreads)
+    {
+        addLoop();
+    }
+
+    while (static_cast<int>(loops_.size()) > numThreads)
+    {
+        // 从loops_中移除以后，getNextLoop不会再选中它
+        EventLoop *loop = loops_.back();
+        loops_.pop_back();
+        retiring_.emplace_back(loop, std::move(threads_.back()));
+        threads_.pop_back();
+
+        if (retireCallback_)
         {
-            next_ = 0;
+            retireCallback_(loop);
         }
+        else
+        {
+            retireDone(loop);
+        }
+    }
+}
+
+void EventLoopThreadPool::retireDone(EventLoop *loop)
+{
+    auto it = std::find_if(retiring_.begin(), retiring_.end(),
+        [loop](const std::pair<EventLoop *, std::unique_ptr<EventLoopThread>> &item) { return item.first == loop; });
+    if (it != retiring_.end())
+    {
+        retiring_.erase(it); // ~EventLoopThread会quit并join该loop线程
+    }
+}
+
+void EventLoopThreadPool::setLoadBalancePolicy(LoadBalancer::Policy policy)
+{
+    balancer_.reset(LoadBalancer::newLoadBalancer(policy));
+}
+
+EventLoop *EventLoopThreadPool::getNextLoop()
+{
+    EventLoop *loop = baseLoop_;
+
+    if (!loops_.empty()) // 通过负载均衡策略获取下一个处理事件的loop
+    {
+        loop = balancer_->select(loops_, nullptr);
+    }
+
+    return loop;
+}
+
+EventLoop *EventLoopThreadPool::getNextLoop(const InetAddress &peerAddr)
+{
+    EventLoop *loop = baseLoop_;
+
+    if (!loops_.empty())
+    {
+        loop = balancer_->select(loops_, &peerAddr);
     }
 
     return loop;
@@ -0,0 +1,396 @@
+#include "HttpContext.h"
+#include "Buffer.h"
+
+#include <string.h>
+#include <strings.h>
+
+namespace
+{
+    const size_t npos = static_cast<size_t>(-1);
+    const size_t kMaxChunkSizeLine = 1024;
+
+    bool equalsIgnoreCase(std::string_view a, const char *b)
+    {
+        size_t len = ::strlen(b);
+        return a.size() == len && ::strncasecmp(a.data(), b, len) == 0;
+    }
+
+    // Content-Length只允许十进制数字
+    bool parseContentLength(std::string_view s, size_t *result)
+    {
+        if (s.empty() || s.size() > 18)
+        {
+            return false;
+        }
+        size_t n = 0;
+        for (char c : s)
+        {
+            if (c < '0' || c > '9')
+            {
+                return false;
+            }
+            n = n * 10 + (c - '0');
+        }
+        *result = n;
+        return true;
+    }
+
+    // Content-Length可以出现多次，也可以是逗号分隔的列表，所有值必须相同，否则消息边界有歧义（RFC 9112 6.3）
+    bool mergeContentLength(std::string_view value, size_t *result, bool *seen)
+    {
+        while (true)
+        {
+            size_t comma = value.find(',');
+            std::string_view item = value.substr(0, comma);
+            while (!item.empty() && (item.front() == ' ' || item.front() == '\t'))
+            {
+                item.remove_prefix(1);
+            }
+            while (!item.empty() && (item.back() == ' ' || item.back() == '\t'))
+            {
+                item.remove_suffix(1);
+            }
+            size_t n;
+            if (!parseContentLength(item, &n) || (*seen && n != *result))
+            {
+                return false;
+            }
+            *result = n;
+            *seen = true;
+            if (comma == std::string_view::npos)
+            {
+                return true;
+            }
+            value.remove_prefix(comma + 1);
+        }
+    }
+
+    // chunk-size [; chunk-ext]
+    bool parseChunkSize(const char *begin, const char *end, size_t *result)
+    {
+        size_t n = 0;
+        const char *p = begin;
+        for (; p < end && *p != ';' && *p != ' ' && *p != '\t'; ++p)
+        {
+            int digit;
+            if (*p >= '0' && *p <= '9')
+                digit = *p - '0';
+            else if (*p >= 'a' && *p <= 'f')
+                digit = *p - 'a' + 10;
+            else if (*p >= 'A' && *p <= 'F')
+                digit = *p - 'A' + 10;
+            else
+                return false;
+            if (p - begin >= 15) // 防止溢出
+            {
+                return false;
+            }
+            n = n * 16 + digit;
+        }
+        *result = n;
+        return p != begin;
+    }
+}
+
+HttpContext::HttpContext(size_t maxHeaderSize, size_t maxBodySize)
+    : maxHeaderSize_(maxHeaderSize)
+    , maxBodySize_(maxBodySize)
+    , state_(kExpectRequestLine)
+    , pos_(0)
+    , scanned_(0)
+    , contentLength_(0)
+    , expectContinue_(false)
+    , errorStatus_(HttpResponse::kUnknown)
+    , cache_(nullptr)
+{
+}
+
+void HttpContext::reset()
+{
+    state_ = kExpectRequestLine;
+    pos_ = 0;
+    scanned_ = 0;
+    contentLength_ = 0;
+    expectContinue_ = false;
+    errorStatus_ = HttpResponse::kUnknown;
+
+    // 保留headers_和chunkedBody_的容量，后续请求不用重新分配内存
+    request_.base_ = nullptr;
+    request_.method_ = HttpRequest::kInvalid;
+    request_.version_ = HttpRequest::kUnknown;
+    request_.path_ = HttpRequest::Range();
+    request_.query_ = HttpRequest::Range();
+    request_.headers_.clear();
+    request_.body_ = HttpRequest::Range();
+    request_.chunked_ = false;
+    request_.chunkedBody_.clear();
+}
+
+HttpContext::ParseResult HttpContext::fail(HttpResponse::HttpStatusCode code)
+{
+    errorStatus_ = code;
+    return kError;
+}
+
+size_t HttpContext::findCRLF(const char *begin, size_t readable) const
+{
+    size_t start = scanned_ > pos_ ? scanned_ : pos_;
+    if (start < readable)
+    {
+        const void *crlf = ::memmem(begin + start, readable - start, "\r\n", 2);
+        if (crlf)
+        {
+            return static_cast<const char *>(crlf) - begin;
+        }
+    }
+    return npos;
+}
+
+bool HttpContext::processRequestLine(const char *begin, size_t end)
+{
+    const char *start = begin + pos_;
+    const char *lineEnd = begin + end;
+
+    const char *space = static_cast<const char *>(::memchr(start, ' ', lineEnd - start));
+    if (space == nullptr)
+    {
+        return false;
+    }
+    std::string_view method(start, space - start);
+    if (method == "GET")
+        request_.method_ = HttpRequest::kGet;
+    else if (method == "POST")
+        request_.method_ = HttpRequest::kPost;
+    else if (method == "HEAD")
+        request_.method_ = HttpRequest::kHead;
+    else if (method == "PUT")
+        request_.method_ = HttpRequest::kPut;
+    else if (method == "DELETE")
+        request_.method_ = HttpRequest::kDelete;
+    else if (method == "OPTIONS")
+        request_.method_ = HttpRequest::kOptions;
+    else
+        return false;
+
+    start = space + 1;
+    space = static_cast<const char *>(::memchr(start, ' ', lineEnd - start));
+    if (space == nullptr || space == start)
+    {
+        return false;
+    }
+    const char *question = static_cast<const char *>(::memchr(start, '?', space - start));
+    if (question)
+    {
+        request_.path_ = {static_cast<size_t>(start - begin), static_cast<size_t>(question - start)};
+        request_.query_ = {static_cast<size_t>(question + 1 - begin), static_cast<size_t>(space - question - 1)};
+    }
+    else
+    {
+        request_.path_ = {static_cast<size_t>(start - begin), static_cast<size_t>(space - start)};
+    }
+
+    std::string_view version(space + 1, lineEnd - space - 1);
+    if (version == "HTTP/1.1")
+        request_.version_ = HttpRequest::kHttp11;
+    else if (version == "HTTP/1.0")
+        request_.version_ = HttpRequest::kHttp10;
+    else
+        return false;
+    return true;
+}
+
+bool HttpContext::processHeader(const char *begin, size_t end)
+{
+    const char *start = begin + pos_;
+    const char *lineEnd = begin + end;
+    const char *colon = static_cast<const char *>(::memchr(start, ':', lineEnd - start));
+    if (colon == nullptr || colon == start)
+    {
+        return false;
+    }
+    for (const char *p = start; p < colon; ++p)
+    {
+        if (*p == ' ' || *p == '\t') // 字段名和冒号之间不允许有空白
+        {
+            return false;
+        }
+    }
+
+    const char *value = colon + 1;
+    while (value < lineEnd && (*value == ' ' || *value == '\t'))
+    {
+        ++value;
+    }
+    const char *valueEnd = lineEnd;
+    while (valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t'))
+    {
+        --valueEnd;
+    }
+    request_.headers_.emplace_back(
+        HttpRequest::Range{static_cast<size_t>(start - begin), static_cast<size_t>(colon - start)},
+        HttpRequest::Range{static_cast<size_t>(value - begin), static_cast<size_t>(valueEnd - value)});
+    return true;
+}
+
+HttpContext::ParseResult HttpContext::parseRequest(Buffer *buf, Timestamp receiveTime)
+{
+    const char *begin = buf->peek();
+    size_t readable = buf->readableBytes();
+    request_.base_ = begin; // Buffer可能挪动过数据，每次重新设置
+
+    while (true)
+    {
+        switch (state_)
+        {
+        case kExpectRequestLine:
+        case kExpectHeaders:
+        {
+            size_t eol = findCRLF(begin, readable);
+            if (eol == npos || eol > maxHeaderSize_)
+            {
+                if ((eol == npos ? readable : eol) > maxHeaderSize_)
+                {
+                    return fail(HttpResponse::k431RequestHeaderFieldsTooLarge);
+                }
+                scanned_ = readable > 0 ? readable - 1 : 0; // 最后一个字节可能是'\r'
+                return kIncomplete;
+            }
+
+            if (state_ == kExpectRequestLine)
+            {
+                if (!processRequestLine(begin, eol))
+                {
+                    return fail(HttpResponse::k400BadRequest);
+                }
+                state_ = kExpectHeaders;
+            }
+            else if (eol != pos_)
+            {
+                if (!processHeader(begin, eol))
+                {
+                    return fail(HttpResponse::k400BadRequest);
+                }
+            }
+            else // 空行，头部结束
+            {
+                // 每个Content-Length都要检查，只看第一个的话前后两级代理可能按不同的长度切分请求
+                bool hasContentLength = false;
+                for (size_t i = 0; i < request_.headerCount(); ++i)
+                {
+                    if (equalsIgnoreCase(request_.headerField(i), "Content-Length")
+                        && !mergeContentLength(request_.headerValue(i), &contentLength_, &hasContentLength))
+                    {
+                        return fail(HttpResponse::k400BadRequest);
+                    }
+                }
+                std::string_view transferEncoding = request_.getHeader("Transfer-Encoding");
+                if (!transferEncoding.empty())
+                {
+                    // 同时带Transfer-Encoding和Content-Length是请求走私的典型手法，直接拒绝
+                    if (hasContentLength)
+                    {
+                        return fail(HttpResponse::k400BadRequest);
+                    }
+                    if (!equalsIgnoreCase(transferEncoding, "chunked"))
+                    {
+                        return fail(HttpResponse::k501NotImplemented);
+                    }
+                    request_.chunked_ = true;
+                    state_ = kExpectChunkSize;
+                }
+                else if (hasContentLength)
+                {
+                    if (contentLength_ > maxBodySize_)
+                    {
+                        return fail(HttpResponse::k413PayloadTooLarge);
+                    }
+                    state_ = contentLength_ > 0 ? kExpectBody : kGotAll;
+                }
+                else
+                {
+                    state_ = kGotAll;
+                }
+                expectContinue_ = state_ != kGotAll && request_.version_ == HttpRequest::kHttp11
+                    && equalsIgnoreCase(request_.getHeader("Expect"), "100-continue");
+            }
+            pos_ = scanned_ = eol + 2;
+            break;
+        }
+
+        case kExpectBody:
+            if (readable - pos_ < contentLength_)
+            {
+                return kIncomplete;
+            }
+            request_.body_ = {pos_, contentLength_};
+            pos_ += contentLength_;
+            state_ = kGotAll;
+            break;
+
+        case kExpectChunkSize:
+        {
+            size_t eol = findCRLF(begin, readable);
+            if (eol == npos)
+            {
+                if (readable - pos_ > kMaxChunkSizeLine)
+                {
+                    return fail(HttpResponse::k400BadRequest);
+                }
+                scanned_ = readable > 0 ? readable - 1 : 0;
+                return kIncomplete;
+            }
+            if (!parseChunkSize(begin + pos_, begin + eol, &contentLength_))
+            {
+                return fail(HttpResponse::k400BadRequest);
+            }
+            if (request_.chunkedBody_.size() + contentLength_ > maxBodySize_)
+            {
+                return fail(HttpResponse::k413PayloadTooLarge);
+            }
+            state_ = contentLength_ > 0 ? kExpectChunkData : kExpectTrailers;
+            pos_ = scanned_ = eol + 2;
+            break;
+        }
+
+        case kExpectChunkData:
+            if (readable - pos_ < contentLength_ + 2)
+            {
+                return kIncomplete;
+            }
+            if (begin[pos_ + contentLength_] != '\r' || begin[pos_ + contentLength_ + 1] != '\n')
+            {
+                return fail(HttpResponse::k400BadRequest);
+            }
+            request_.chunkedBody_.append(begin + pos_, contentLength_);
+            pos_ = scanned_ = pos_ + contentLength_ + 2;
+            state_ = kExpectChunkSize;
+            break;
+
+        case kExpectTrailers:
+        {
+            // trailer字段直接忽略，直到空行
+            size_t eol = findCRLF(begin, readable);
+            if (eol == npos)
+            {
+                if (readable - pos_ > maxHeaderSize_)
+                {
+                    return fail(HttpResponse::k431RequestHeaderFieldsTooLarge);
+                }
+                scanned_ = readable > 0 ? readable - 1 : 0;
+                return kIncomplete;
+            }
+            if (eol == pos_)
+            {
+                state_ = kGotAll;
+            }
+            pos_ = scanned_ = eol + 2;
+            break;
+        }
+
+        case kGotAll:
+            request_.receiveTime_ = receiveTime;
+            expectContinue_ = false;
+            return kGotRequest;
+        }
+    }
+}
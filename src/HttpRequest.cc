@@ -0,0 +1,47 @@
+#include "HttpRequest.h"
+
+#include <strings.h>
+
+const char *HttpRequest::methodString() const
+{
+    switch (method_)
+    {
+    case kGet:
+        return "GET";
+    case kPost:
+        return "POST";
+    case kHead:
+        return "HEAD";
+    case kPut:
+        return "PUT";
+    case kDelete:
+        return "DELETE";
+    case kOptions:
+        return "OPTIONS";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+std::string_view HttpRequest::getHeader(std::string_view field) const
+{
+    for (const auto &header : headers_)
+    {
+        std::string_view name = view(header.first);
+        if (name.size() == field.size() && ::strncasecmp(name.data(), field.data(), field.size()) == 0)
+        {
+            return view(header.second);
+        }
+    }
+    return std::string_view();
+}
+
+bool HttpRequest::keepAlive() const
+{
+    std::string_view connection = getHeader("Connection");
+    if (version_ == kHttp11)
+    {
+        return !(connection.size() == 5 && ::strncasecmp(connection.data(), "close", 5) == 0);
+    }
+    return connection.size() == 10 && ::strncasecmp(connection.data(), "keep-alive", 10) == 0;
+}
@@ -0,0 +1,115 @@
+#include "HttpResponse.h"
+#include "Buffer.h"
+
+#include <stdio.h>
+
+const char *HttpResponse::defaultStatusMessage(HttpStatusCode code)
+{
+    switch (code)
+    {
+    case k101SwitchingProtocols:
+        return "Switching Protocols";
+    case k200Ok:
+        return "OK";
+    case k204NoContent:
+        return "No Content";
+    case k301MovedPermanently:
+        return "Moved Permanently";
+    case k304NotModified:
+        return "Not Modified";
+    case k400BadRequest:
+        return "Bad Request";
+    case k403Forbidden:
+        return "Forbidden";
+    case k404NotFound:
+        return "Not Found";
+    case k413PayloadTooLarge:
+        return "Payload Too Large";
+    case k426UpgradeRequired:
+        return "Upgrade Required";
+    case k431RequestHeaderFieldsTooLarge:
+        return "Request Header Fields Too Large";
+    case k500InternalServerError:
+        return "Internal Server Error";
+    case k501NotImplemented:
+        return "Not Implemented";
+    default:
+        return "Unknown";
+    }
+}
+
+void HttpResponse::appendChunk(std::string_view data)
+{
+    if (data.empty()) // 空chunk表示body结束，由appendToBuffer统一添加
+    {
+        return;
+    }
+    char buf[32];
+    int n = snprintf(buf, sizeof buf, "%zx\r\n", data.size());
+    body_.append(buf, n);
+    body_.append(data.data(), data.size());
+    body_.append("\r\n", 2);
+}
+
+void HttpResponse::appendChunk(Buffer *output, std::string_view data)
+{
+    if (data.empty())
+    {
+        return;
+    }
+    char buf[32];
+    int n = snprintf(buf, sizeof buf, "%zx\r\n", data.size());
+    output->append(buf, n);
+    output->append(data.data(), data.size());
+    output->append("\r\n", 2);
+}
+
+void HttpResponse::appendLastChunk(Buffer *output)
+{
+    output->append("0\r\n\r\n", 5);
+}
+
+void HttpResponse::appendToBuffer(Buffer *output, bool withBody) const
+{
+    char buf[64];
+    int n = snprintf(buf, sizeof buf, "HTTP/1.1 %d ", statusCode_);
+    output->append(buf, n);
+    output->append(statusMessage_.empty() ? std::string(defaultStatusMessage(statusCode_)) : statusMessage_);
+    output->append("\r\n", 2);
+
+    if (chunked_)
+    {
+        output->append("Transfer-Encoding: chunked\r\n", 28);
+    }
+    else if (statusCode_ != k204NoContent && statusCode_ != k304NotModified) // 这两种响应没有body
+    {
+        n = snprintf(buf, sizeof buf, "Content-Length: %zu\r\n", body_.size());
+        output->append(buf, n);
+    }
+    if (closeConnection_)
+    {
+        output->append("Connection: close\r\n", 19);
+    }
+    else
+    {
+        output->append("Connection: Keep-Alive\r\n", 24);
+    }
+
+    for (const auto &header : headers_)
+    {
+        output->append(header.first);
+        output->append(": ", 2);
+        output->append(header.second);
+        output->append("\r\n", 2);
+    }
+    output->append("\r\n", 2);
+
+    if (withBody)
+    {
+        output->append(body_);
+        if (chunked_)
+        {
+            appendLastChunk(output);
+        }
+    }
+}
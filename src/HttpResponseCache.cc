@@ -0,0 +1,162 @@
+#include "HttpResponseCache.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "Buffer.h"
+#include "Crc32c.h"
+
+#include <stdio.h>
+
+HttpResponseCache::HttpResponseCache(size_t maxBytes)
+    : maxBytes_(maxBytes)
+    , hits_(0)
+    , misses_(0)
+    , bytes_(0)
+    , entries_(0)
+{
+}
+
+void HttpResponseCache::makeKey(const HttpRequest &req, std::string *key)
+{
+    key->assign(req.path().data(), req.path().size());
+    if (!req.query().empty())
+    {
+        key->push_back('?');
+        key->append(req.query().data(), req.query().size());
+    }
+}
+
+size_t HttpResponseCache::entrySize(const Entry &entry)
+{
+    return entry.key.size() + entry.response->size() + entry.notModified->size();
+}
+
+// If-None-Match可以是*或者逗号分隔的ETag列表，弱校验时忽略W/前缀
+static bool etagMatches(std::string_view ifNoneMatch, const std::string &etag)
+{
+    if (ifNoneMatch == "*")
+    {
+        return true;
+    }
+    while (!ifNoneMatch.empty())
+    {
+        size_t comma = ifNoneMatch.find(',');
+        std::string_view tag = ifNoneMatch.substr(0, comma);
+        while (!tag.empty() && (tag.front() == ' ' || tag.front() == '\t'))
+        {
+            tag.remove_prefix(1);
+        }
+        while (!tag.empty() && (tag.back() == ' ' || tag.back() == '\t'))
+        {
+            tag.remove_suffix(1);
+        }
+        if (tag.size() > 2 && tag[0] == 'W' && tag[1] == '/')
+        {
+            tag.remove_prefix(2);
+        }
+        if (tag == etag)
+        {
+            return true;
+        }
+        if (comma == std::string_view::npos)
+        {
+            break;
+        }
+        ifNoneMatch.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+HttpResponseCache::Payload HttpResponseCache::respond(const HttpRequest &req, const Entry &entry) const
+{
+    std::string_view ifNoneMatch = req.getHeader("If-None-Match");
+    if (!ifNoneMatch.empty() && etagMatches(ifNoneMatch, entry.etag))
+    {
+        return entry.notModified;
+    }
+    return entry.response;
+}
+
+HttpResponseCache::Payload HttpResponseCache::lookup(const HttpRequest &req)
+{
+    makeKey(req, &keyScratch_);
+    auto it = index_.find(keyScratch_);
+    if (it == index_.end())
+    {
+        return Payload();
+    }
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return respond(req, *it->second);
+}
+
+HttpResponseCache::Payload HttpResponseCache::insert(const HttpRequest &req, const HttpResponse &response)
+{
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    Entry entry;
+    makeKey(req, &entry.key);
+
+    // ETag由body的CRC32C和长度组成，body不变ETag就不变
+    char etag[48];
+    snprintf(etag, sizeof etag, "\"%08x-%zx\"", Crc32c::value(response.body().data(), response.body().size()), response.body().size());
+    entry.etag = etag;
+
+    HttpResponse full(response);
+    full.setCloseConnection(false);
+    full.addHeader("ETag", entry.etag);
+    Buffer buf;
+    full.appendToBuffer(&buf);
+    entry.response = std::make_shared<const std::string>(buf.retrieveAllAsString());
+
+    HttpResponse notModified(false);
+    notModified.setStatusCode(HttpResponse::k304NotModified);
+    notModified.addHeader("ETag", entry.etag);
+    notModified.appendToBuffer(&buf);
+    entry.notModified = std::make_shared<const std::string>(buf.retrieveAllAsString());
+
+    Payload result = respond(req, entry);
+    size_t size = entrySize(entry);
+    if (size > maxBytes_) // 单个响应比整个缓存还大，不缓存
+    {
+        return result;
+    }
+
+    erase(entry.key);
+    lru_.push_front(std::move(entry));
+    index_[lru_.front().key] = lru_.begin();
+    bytes_.store(bytes() + size, std::memory_order_relaxed);
+    entries_.store(lru_.size(), std::memory_order_relaxed);
+    evict();
+    return result;
+}
+
+void HttpResponseCache::erase(const std::string &key)
+{
+    auto it = index_.find(key);
+    if (it != index_.end())
+    {
+        bytes_.store(bytes() - entrySize(*it->second), std::memory_order_relaxed);
+        lru_.erase(it->second);
+        index_.erase(it);
+        entries_.store(lru_.size(), std::memory_order_relaxed);
+    }
+}
+
+void HttpResponseCache::clear()
+{
+    lru_.clear();
+    index_.clear();
+    bytes_.store(0, std::memory_order_relaxed);
+    entries_.store(0, std::memory_order_relaxed);
+}
+
+void HttpResponseCache::evict()
+{
+    while (bytes() > maxBytes_ && !lru_.empty())
+    {
+        const Entry &victim = lru_.back();
+        bytes_.store(bytes() - entrySize(victim), std::memory_order_relaxed);
+        index_.erase(victim.key);
+        lru_.pop_back();
+    }
+    entries_.store(lru_.size(), std::memory_order_relaxed);
+}
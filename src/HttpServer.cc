@@ -0,0 +1,173 @@
+#include "HttpServer.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "HttpResponseCache.h"
+#include "Logger.h"
+
+static void defaultHttpCallback(const HttpRequest &, HttpResponse *resp)
+{
+    resp->setStatusCode(HttpResponse::k404NotFound);
+    resp->setCloseConnection(true);
+}
+
+HttpServer::HttpServer(EventLoop *loop,
+                       const InetAddress &listenAddr,
+                       const std::string &name,
+                       TcpServer::Option option)
+    : httpCallback_(defaultHttpCallback)
+    , maxHeaderSize_(HttpContext::kDefaultMaxHeaderSize)
+    , maxBodySize_(HttpContext::kDefaultMaxBodySize)
+    , cacheMaxBytes_(0)
+    , server_(loop, listenAddr, name, option)
+{
+    server_.setConnectionCallback(
+        std::bind(&HttpServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(
+        std::bind(&HttpServer::onMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    server_.setLoopRetiredCallback(
+        std::bind(&HttpServer::onLoopRetired, this, std::placeholders::_1));
+}
+
+HttpServer::~HttpServer() = default;
+
+void HttpServer::start()
+{
+    LOG_INFO("HttpServer[%s] starts listening on %s\n", server_.name().c_str(), server_.ipPort().c_str());
+    server_.start();
+}
+
+void HttpServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        HttpContext context(maxHeaderSize_, maxBodySize_);
+        if (cacheMaxBytes_ > 0)
+        {
+            // 每个连接只在建立时查一次，请求路径上访问缓存不需要加锁
+            context.setCache(cacheOf(conn->getLoop()));
+        }
+        conn->setContext(context);
+    }
+}
+
+void HttpServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    if (!conn->connected()) // 已经决定关闭连接，后续请求不再处理
+    {
+        buf->retrieveAll();
+        return;
+    }
+
+    HttpContext *context = std::any_cast<HttpContext>(conn->getMutableContext());
+    // 同一个loop线程中的连接轮流使用，避免每次读事件分配内存
+    static thread_local Buffer output;
+
+    // 这次读事件解析出的所有请求的响应合并成一次writev
+    conn->cork();
+    bool close = false;
+    while (!close)
+    {
+        HttpContext::ParseResult result = context->parseRequest(buf, receiveTime);
+        if (result == HttpContext::kIncomplete)
+        {
+            if (context->expectContinue())
+            {
+                output.append("HTTP/1.1 100 Continue\r\n\r\n", 25);
+                context->clearExpectContinue();
+            }
+            break;
+        }
+        if (result == HttpContext::kError)
+        {
+            HttpResponse response(true);
+            response.setStatusCode(context->errorStatus());
+            response.appendToBuffer(&output);
+            buf->retrieveAll();
+            close = true;
+            break;
+        }
+
+        close = onRequest(conn, context, &output);
+        buf->retrieve(context->requestLength());
+        context->reset();
+    }
+
+    if (output.readableBytes() > 0)
+    {
+        conn->send(&output);
+    }
+    conn->uncork();
+    if (close)
+    {
+        conn->shutdown();
+    }
+}
+
+bool HttpServer::onRequest(const TcpConnectionPtr &conn, HttpContext *context, Buffer *output)
+{
+    const HttpRequest &req = context->request();
+    bool keepAlive = req.keepAlive();
+    HttpResponseCache *cache = (keepAlive && req.method() == HttpRequest::kGet) ? context->cache() : nullptr;
+
+    HttpResponseCache::Payload cached = cache ? cache->lookup(req) : HttpResponseCache::Payload();
+    if (!cached)
+    {
+        HttpResponse response(!keepAlive);
+        httpCallback_(req, &response);
+        if (!(cache && response.cacheable() && response.statusCode() == HttpResponse::k200Ok && !response.closeConnection()))
+        {
+            response.appendToBuffer(output, req.method() != HttpRequest::kHead);
+            return response.closeConnection();
+        }
+        cached = cache->insert(req, response);
+    }
+
+    // 缓存的响应以引用的方式挂到发送链上，前面pipelining请求的响应要先放进发送缓冲区保证顺序
+    if (output->readableBytes() > 0)
+    {
+        conn->send(output);
+    }
+    conn->send(cached);
+    return false;
+}
+
+HttpResponseCache *HttpServer::cacheOf(EventLoop *loop)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    std::shared_ptr<HttpResponseCache> &cache = caches_[loop];
+    if (!cache)
+    {
+        cache = std::make_shared<HttpResponseCache>(cacheMaxBytes_);
+    }
+    return cache.get();
+}
+
+void HttpServer::onLoopRetired(EventLoop *loop)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    caches_.erase(loop);
+}
+
+void HttpServer::invalidateCache(const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    for (auto &item : caches_)
+    {
+        std::shared_ptr<HttpResponseCache> cache = item.second;
+        item.first->runInLoop([cache, key]() {
+            cache->erase(key);
+        });
+    }
+}
+
+std::vector<HttpServer::CacheStats> HttpServer::cacheStats() const
+{
+    std::vector<CacheStats> stats;
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    for (auto &item : caches_)
+    {
+        const HttpResponseCache *cache = item.second.get();
+        stats.push_back(CacheStats{item.first, cache->hits(), cache->misses(), cache->entries(), cache->bytes()});
+    }
+    return stats;
+}
@@ -1,5 +1,7 @@
 #include "InetAddress.h"
 
+#include <algorithm>
+#include <stddef.h>
 #include <strings.h>
 #include <string.h>
 #include <arpa/inet.h>
@@ -7,28 +9,74 @@
 InetAddress::InetAddress(uint16_t port, std::string ip)
 {
     bzero(&addr_, sizeof addr_);
-    addr_.sin_family = AF_INET;
-    addr_.sin_port = htons(port);
-    addr_.sin_addr.s_addr = inet_addr(ip.c_str());
+    addr_.in.sin_family = AF_INET;
+    addr_.in.sin_port = htons(port);
+    addr_.in.sin_addr.s_addr = inet_addr(ip.c_str());
+    len_ = sizeof addr_.in;
+}
+
+InetAddress InetAddress::unixDomain(const std::string &path)
+{
+    InetAddress addr;
+    bzero(&addr.addr_, sizeof addr.addr_);
+    addr.addr_.un.sun_family = AF_UNIX;
+    // 超长的路径被截断，bind/connect时会失败
+    size_t len = std::min(path.size(), sizeof addr.addr_.un.sun_path - 1);
+    ::memcpy(addr.addr_.un.sun_path, path.data(), len);
+    if (len > 0 && path[0] == '@')
+    {
+        addr.addr_.un.sun_path[0] = '\0';
+        addr.len_ = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + len);
+    }
+    else
+    {
+        addr.len_ = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + len + 1);
+    }
+    return addr;
+}
+
+void InetAddress::setSockAddr(const sockaddr *addr, socklen_t len)
+{
+    bzero(&addr_, sizeof addr_);
+    len_ = std::min<socklen_t>(len, sizeof addr_);
+    ::memcpy(&addr_, addr, len_);
 }
 
 std::string InetAddress::toIp() const
 {
+    if (isUnix())
+    {
+        // 对端未绑定地址时路径为空，抽象命名空间的地址还原成'@'开头
+        size_t offset = offsetof(sockaddr_un, sun_path);
+        if (len_ <= offset)
+        {
+            return std::string();
+        }
+        if (addr_.un.sun_path[0] == '\0')
+        {
+            return "@" + std::string(addr_.un.sun_path + 1, len_ - offset - 1);
+        }
+        return std::string(addr_.un.sun_path, strnlen(addr_.un.sun_path, len_ - offset));
+    }
     char buf[128] = {0};
-    inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof buf);
+    inet_ntop(AF_INET, &addr_.in.sin_addr, buf, sizeof buf);
     return buf;
 }
 
 std::string InetAddress::toIpPort() const
 {
+    if (isUnix())
+    {
+        return "unix:" + toIp();
+    }
     char buf[128] = {0};
-    inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof buf);
+    inet_ntop(AF_INET, &addr_.in.sin_addr, buf, sizeof buf);
     int end = strlen(buf);
-    snprintf(buf+end, 128-end, ":%u", ntohs(addr_.sin_port));
+    snprintf(buf+end, 128-end, ":%u", ntohs(addr_.in.sin_port));
     return buf;
 }
 
 uint16_t InetAddress::toPort() const
 {
-    return ntohs(addr_.sin_port);
+    return isUnix() ? 0 : ntohs(addr_.in.sin_port);
 }
@@ -0,0 +1,80 @@
+#include "LengthFieldCodec.h"
+#include "TcpConnection.h"
+#include "Buffer.h"
+#include "Crc32c.h"
+#include "Logger.h"
+
+LengthFieldCodec::LengthFieldCodec(const FrameCallback &cb, bool checksum, size_t maxFrameSize)
+    : frameCallback_(cb)
+    , errorCallback_(&LengthFieldCodec::defaultErrorCallback)
+    , checksum_(checksum)
+    , maxFrameSize_(maxFrameSize)
+{
+}
+
+void LengthFieldCodec::defaultErrorCallback(const TcpConnectionPtr &conn, ErrorCode code)
+{
+    LOG_ERROR("LengthFieldCodec error %d on %s, closing\n", (int)code, conn->name().c_str());
+    conn->forceClose();
+}
+
+void LengthFieldCodec::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    while (buf->readableBytes() >= kHeaderLen)
+    {
+        int32_t len = buf->peekInt32();
+        // 只看长度头就拒绝超大的帧，不等数据缓存下来
+        if (len < 0 || (checksum_ && static_cast<size_t>(len) < kChecksumLen))
+        {
+            errorCallback_(conn, kInvalidLength);
+            break;
+        }
+        if (static_cast<size_t>(len) > maxFrameSize_)
+        {
+            errorCallback_(conn, kFrameTooLarge);
+            break;
+        }
+        if (buf->readableBytes() < kHeaderLen + len)
+        {
+            break;
+        }
+
+        const char *body = buf->peek() + kHeaderLen;
+        size_t payloadLen = checksum_ ? len - kChecksumLen : len;
+        if (checksum_)
+        {
+            uint32_t be32 = 0;
+            ::memcpy(&be32, body + payloadLen, sizeof be32);
+            if (Crc32c::value(body, payloadLen) != be32toh(be32))
+            {
+                errorCallback_(conn, kChecksumMismatch);
+                break;
+            }
+        }
+        frameCallback_(conn, std::string_view(body, payloadLen), receiveTime);
+        buf->retrieve(kHeaderLen + len);
+    }
+}
+
+void LengthFieldCodec::encode(Buffer *buf) const
+{
+    if (checksum_)
+    {
+        uint32_t be32 = htobe32(Crc32c::value(buf->peek(), buf->readableBytes()));
+        buf->append(reinterpret_cast<const char *>(&be32), sizeof be32);
+    }
+    buf->prependInt32(static_cast<int32_t>(buf->readableBytes()));
+}
+
+void LengthFieldCodec::send(const TcpConnectionPtr &conn, Buffer *buf) const
+{
+    encode(buf);
+    conn->send(buf);
+}
+
+void LengthFieldCodec::send(const TcpConnectionPtr &conn, std::string_view payload) const
+{
+    Buffer buf(payload.size() + kChecksumLen);
+    buf.append(payload.data(), payload.size());
+    send(conn, &buf);
+}
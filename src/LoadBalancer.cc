@@ -0,0 +1,131 @@
+#include "LoadBalancer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <algorithm>
+
+namespace
+{
+
+class RoundRobinBalancer : public LoadBalancer
+{
+public:
+    RoundRobinBalancer() : next_(0) {}
+
+    EventLoop *select(const std::vector<EventLoop *> &loops, const InetAddress *) override
+    {
+        if (next_ >= loops.size())
+        {
+            next_ = 0;
+        }
+        return loops[next_++];
+    }
+
+private:
+    size_t next_;
+};
+
+class LeastConnectionsBalancer : public LoadBalancer
+{
+public:
+    LeastConnectionsBalancer() : next_(0) {}
+
+    EventLoop *select(const std::vector<EventLoop *> &loops, const InetAddress *) override
+    {
+        // 从上次选中的位置之后开始扫描，连接数相同时依次轮转，避免总是落在第一个loop
+        size_t n = loops.size();
+        size_t best = next_ % n;
+        int bestConns = loops[best]->activeConnections();
+        for (size_t i = 1; i < n; ++i)
+        {
+            size_t idx = (next_ + i) % n;
+            int conns = loops[idx]->activeConnections();
+            if (conns < bestConns)
+            {
+                best = idx;
+                bestConns = conns;
+            }
+        }
+        next_ = best + 1;
+        return loops[best];
+    }
+
+private:
+    size_t next_;
+};
+
+class LeastLoopLagBalancer : public LoadBalancer
+{
+public:
+    LeastLoopLagBalancer() : next_(0) {}
+
+    EventLoop *select(const std::vector<EventLoop *> &loops, const InetAddress *) override
+    {
+        // 循环耗时是滑动平均，同一批accept到的连接分配期间不会变化，单看它会把整批连接都分到同一个loop
+        // 所以按 耗时 x (连接数 + 1) 打分：TcpServer每选一次立即给loop的连接数加一，连续的选择会分散开
+        // kLagFloorNs让空闲loop（耗时接近0）之间仍然按连接数区分；分数相同时从上次选中的位置之后轮转
+        size_t n = loops.size();
+        size_t best = next_ % n;
+        int64_t bestScore = score(loops[best]);
+        for (size_t i = 1; i < n; ++i)
+        {
+            size_t idx = (next_ + i) % n;
+            int64_t s = score(loops[idx]);
+            if (s < bestScore)
+            {
+                best = idx;
+                bestScore = s;
+            }
+        }
+        next_ = best + 1;
+        return loops[best];
+    }
+
+private:
+    static const int64_t kLagFloorNs = 10 * 1000;
+
+    static int64_t score(EventLoop *loop)
+    {
+        return (loop->iterationTimeNs() + kLagFloorNs) * (std::max(loop->activeConnections(), 0) + 1);
+    }
+
+    size_t next_;
+};
+
+class PeerHashBalancer : public LoadBalancer
+{
+public:
+    EventLoop *select(const std::vector<EventLoop *> &loops, const InetAddress *peerAddr) override
+    {
+        // unix域socket的对端一般没有绑定地址，无法区分客户端
+        if (peerAddr == nullptr || peerAddr->isUnix())
+        {
+            return roundRobin_.select(loops, peerAddr);
+        }
+        // 只对ip做哈希，同一客户端的多个连接落在同一个loop
+        uint64_t h = peerAddr->getSockAddr()->sin_addr.s_addr;
+        h *= 0x9E3779B97F4A7C15ULL;
+        return loops[(h >> 32) % loops.size()];
+    }
+
+private:
+    RoundRobinBalancer roundRobin_;
+};
+
+}
+
+LoadBalancer *LoadBalancer::newLoadBalancer(Policy policy)
+{
+    switch (policy)
+    {
+    case kLeastConnections:
+        return new LeastConnectionsBalancer();
+    case kLeastLoopLag:
+        return new LeastLoopLagBalancer();
+    case kPeerHash:
+        return new PeerHashBalancer();
+    case kRoundRobin:
+    default:
+        return new RoundRobinBalancer();
+    }
+}
@@ -0,0 +1,115 @@
+#include "LogFile.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+LogFile::LogFile(const std::string &basename, off_t rollSize, int rollIntervalSeconds)
+    : basename_(basename)
+    , rollSize_(rollSize)
+    , rollInterval_(rollIntervalSeconds > 0 ? rollIntervalSeconds : kDefaultRollInterval)
+    , fp_(nullptr)
+    , writtenBytes_(0)
+    , startOfPeriod_(0)
+    , lastRoll_(0)
+    , rolledFiles_(0)
+{
+    rollFile();
+}
+
+LogFile::~LogFile()
+{
+    if (fp_ != nullptr)
+    {
+        ::fclose(fp_);
+    }
+}
+
+void LogFile::append(const char *data, size_t len)
+{
+    if (fp_ == nullptr)
+    {
+        return;
+    }
+    size_t written = 0;
+    while (written < len)
+    {
+        size_t n = ::fwrite_unlocked(data + written, 1, len - written, fp_);
+        if (n == 0)
+        {
+            // 这里不能再写日志，直接输出到stderr
+            fprintf(stderr, "LogFile::append() failed %s\n", strerror(ferror(fp_) ? errno : EIO));
+            break;
+        }
+        written += n;
+    }
+    writtenBytes_ += written;
+
+    if (writtenBytes_ > rollSize_)
+    {
+        rollFile();
+    }
+    else
+    {
+        time_t now = ::time(nullptr);
+        if (now / rollInterval_ * rollInterval_ != startOfPeriod_)
+        {
+            rollFile();
+        }
+    }
+}
+
+void LogFile::flush()
+{
+    if (fp_ != nullptr)
+    {
+        ::fflush(fp_);
+    }
+}
+
+bool LogFile::rollFile()
+{
+    time_t now = ::time(nullptr);
+    if (now <= lastRoll_)
+    {
+        return false;
+    }
+    std::string fileName = getLogFileName(basename_, now);
+    FILE *fp = ::fopen(fileName.c_str(), "ae"); // 'e'为O_CLOEXEC
+    if (fp == nullptr)
+    {
+        fprintf(stderr, "LogFile::rollFile() open %s failed %s\n", fileName.c_str(), strerror(errno));
+        return false;
+    }
+    if (fp_ != nullptr)
+    {
+        ::fclose(fp_);
+    }
+    fp_ = fp;
+    ::setbuffer(fp_, buffer_, sizeof buffer_);
+    fileName_ = fileName;
+    writtenBytes_ = 0;
+    lastRoll_ = now;
+    startOfPeriod_ = now / rollInterval_ * rollInterval_;
+    ++rolledFiles_;
+    return true;
+}
+
+std::string LogFile::getLogFileName(const std::string &basename, time_t now)
+{
+    char timebuf[32];
+    struct tm tm;
+    ::localtime_r(&now, &tm);
+    ::strftime(timebuf, sizeof timebuf, ".%Y%m%d-%H%M%S.", &tm);
+
+    char hostname[256];
+    if (::gethostname(hostname, sizeof hostname) != 0)
+    {
+        ::strcpy(hostname, "unknownhost");
+    }
+    hostname[sizeof hostname - 1] = '\0';
+
+    char pidbuf[32];
+    snprintf(pidbuf, sizeof pidbuf, ".%d.log", ::getpid());
+    return basename + timebuf + hostname + pidbuf;
+}
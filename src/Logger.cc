@@ -1,7 +1,35 @@
-#include <iostream>
-
 #include "Logger.h"
-#include "Timestamp.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+namespace
+{
+    const char *const kLevelNames[] = {"[DEBUG]", "[INFO]", "[ERROR]", "[FATAL]"};
+
+    void defaultOutput(const char *msg, size_t len)
+    {
+        ::fwrite(msg, 1, len, stdout);
+    }
+
+    void defaultFlush()
+    {
+        ::fflush(stdout);
+    }
+
+    // 每个线程缓存当前秒的时间字符串，同一秒内的日志只需要格式化微秒部分
+    thread_local time_t t_lastSecond = 0;
+    thread_local char t_time[64];
+
+    // 一行日志的格式化缓冲区，超长的日志退回到堆上分配
+    const size_t kLineBufferSize = 4096;
+    thread_local char t_line[kLineBufferSize];
+}
 
 // 获取单例对象
 Logger &Logger::instance()
@@ -10,16 +38,225 @@ Logger &Logger::instance()
     return logger;
 }
 
-// 设置日志级别
+Logger::Logger()
+    : output_(defaultOutput)
+    , flush_(defaultFlush)
+    , level_(INFO)
+{
+    const char *spec = ::getenv("MYMUDUO_LOG_LEVEL");
+    if (spec != nullptr && !configure(spec))
+    {
+        fprintf(stderr, "invalid MYMUDUO_LOG_LEVEL: %s\n", spec);
+    }
+}
+
+LogModule::LogModule(const char *file)
+    : level_(INFO)
+{
+    // 去掉目录和扩展名
+    const char *base = ::strrchr(file, '/');
+    base = base ? base + 1 : file;
+    const char *dot = ::strrchr(base, '.');
+    name_.assign(base, dot ? dot - base : ::strlen(base));
+    Logger::instance().registerModule(this);
+}
+
+LogModule::~LogModule()
+{
+    Logger::instance().unregisterModule(this);
+}
+
+void Logger::registerModule(LogModule *module)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    modules_.push_back(module);
+    applyLevel(module);
+}
+
+void Logger::unregisterModule(LogModule *module)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    modules_.erase(std::remove(modules_.begin(), modules_.end(), module), modules_.end());
+}
+
+void Logger::applyLevel(LogModule *module)
+{
+    auto it = moduleLevels_.find(module->name_);
+    module->level_.store(it != moduleLevels_.end() ? it->second : level_, std::memory_order_relaxed);
+}
+
 void Logger::setLogLevel(int level)
 {
-    logLevel_ = level;
+    std::lock_guard<std::mutex> lock(mutex_);
+    level_ = level;
+    for (LogModule *module : modules_)
+    {
+        applyLevel(module);
+    }
+}
+
+int Logger::logLevel() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return level_;
+}
+
+void Logger::setModuleLevel(const std::string &module, int level)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    moduleLevels_[module] = level;
+    for (LogModule *m : modules_)
+    {
+        if (m->name_ == module)
+        {
+            applyLevel(m);
+        }
+    }
+}
+
+void Logger::clearModuleLevel(const std::string &module)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    moduleLevels_.erase(module);
+    for (LogModule *m : modules_)
+    {
+        if (m->name_ == module)
+        {
+            applyLevel(m);
+        }
+    }
+}
+
+bool Logger::configure(const std::string &spec)
+{
+    // 先全部解析，格式正确才生效
+    int level = -1;
+    std::vector<std::pair<std::string, int>> moduleLevels;
+    size_t begin = 0;
+    while (begin <= spec.size())
+    {
+        size_t end = spec.find(',', begin);
+        if (end == std::string::npos)
+        {
+            end = spec.size();
+        }
+        std::string item = spec.substr(begin, end - begin);
+        begin = end + 1;
+        if (item.empty())
+        {
+            continue;
+        }
+        size_t eq = item.find('=');
+        if (eq == std::string::npos)
+        {
+            level = parseLevel(item);
+            if (level < 0)
+            {
+                return false;
+            }
+            continue;
+        }
+        int moduleLevel = parseLevel(item.substr(eq + 1));
+        if (eq == 0 || moduleLevel < 0)
+        {
+            return false;
+        }
+        moduleLevels.emplace_back(item.substr(0, eq), moduleLevel);
+    }
+
+    if (level >= 0)
+    {
+        setLogLevel(level);
+    }
+    for (const auto &item : moduleLevels)
+    {
+        setModuleLevel(item.first, item.second);
+    }
+    return true;
+}
+
+std::vector<std::string> Logger::modules() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> names;
+    for (LogModule *module : modules_)
+    {
+        names.push_back(module->name_);
+    }
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    return names;
+}
+
+const char *Logger::levelName(int level)
+{
+    static const char *const names[] = {"DEBUG", "INFO", "ERROR", "FATAL"};
+    return level >= DEBUG && level <= FATAL ? names[level] : "UNKNOWN";
+}
+
+int Logger::parseLevel(const std::string &name)
+{
+    std::string upper(name);
+    for (char &c : upper)
+    {
+        c = static_cast<char>(::toupper(static_cast<unsigned char>(c)));
+    }
+    for (int level = DEBUG; level <= FATAL; ++level)
+    {
+        if (upper == levelName(level))
+        {
+            return level;
+        }
+    }
+    return -1;
 }
 
 // 输出日志
-void Logger::log(std::string msg)
+void Logger::log(int level, const char *file, int line, const char *func, const char *fmt, ...)
 {
+    struct timeval tv;
+    ::gettimeofday(&tv, nullptr);
+    if (tv.tv_sec != t_lastSecond)
+    {
+        t_lastSecond = tv.tv_sec;
+        struct tm tm;
+        ::localtime_r(&t_lastSecond, &tm);
+        snprintf(t_time, sizeof t_time, "%4d/%02d/%02d %02d:%02d:%02d",
+                 tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    }
+
+    const char *tag = level >= DEBUG && level <= FATAL ? kLevelNames[level] : "[UNKNOWN]";
+    int prefix = snprintf(t_line, kLineBufferSize, "%s%s:%d:%s: %s.%06ld ",
+                          tag, file, line, func, t_time, static_cast<long>(tv.tv_usec));
+    if (prefix < 0)
+    {
+        return;
+    }
+    size_t len = static_cast<size_t>(prefix) < kLineBufferSize ? prefix : kLineBufferSize - 1;
 
-    std::cout << Timestamp::now().ToString() << " " << msg << std::endl;
-    
-}
\ No newline at end of file
+    va_list args;
+    va_start(args, fmt);
+    va_list copy;
+    va_copy(copy, args);
+    int n = vsnprintf(t_line + len, kLineBufferSize - len, fmt, args);
+    va_end(args);
+
+    std::string heapLine; // 超长的日志
+    char *data = t_line;
+    if (n >= 0 && len + n + 1 >= kLineBufferSize)
+    {
+        heapLine.assign(t_line, len);
+        heapLine.resize(len + n + 1);
+        vsnprintf(&heapLine[len], n + 1, fmt, copy);
+        data = &heapLine[0];
+    }
+    va_end(copy);
+    len += n > 0 ? n : 0;
+
+    // 格式串里大多已经带了换行
+    if (len == 0 || data[len - 1] != '\n')
+    {
+        data[len++] = '\n';
+    }
+    output_.load(std::memory_order_acquire)(data, len);
+}
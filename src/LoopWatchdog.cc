@@ -0,0 +1,218 @@
+#include "LoopWatchdog.h"
+#include "EventLoop.h"
+#include "Channel.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+// EventLoop.cpp中每个线程的loop
+extern __thread EventLoop *t_loopInThisThread;
+
+namespace
+{
+    int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // 在卡住的线程中执行：此时它正处在channel的handleEvent里，channel和所属对象都还有效
+    void captureStack(int)
+    {
+        int savedErrno = errno;
+        EventLoop *loop = t_loopInThisThread;
+        LoopActivity *activity = loop != nullptr ? loop->activity().get() : nullptr;
+        if (activity != nullptr)
+        {
+            activity->depth = ::backtrace(activity->frames, LoopActivity::kMaxFrames);
+            Channel *channel = activity->channel.load(std::memory_order_relaxed);
+            activity->owner[0] = '\0';
+            if (activity->kind.load(std::memory_order_relaxed) == LoopActivity::kChannelEvent && channel != nullptr)
+            {
+                activity->fd = channel->fd();
+                activity->revents = channel->revents();
+                channel->describeOwner(activity->owner, sizeof activity->owner);
+            }
+            else
+            {
+                activity->fd = -1;
+                activity->revents = 0;
+            }
+            activity->captureSeq.store(activity->seq.load(std::memory_order_relaxed), std::memory_order_release);
+        }
+        errno = savedErrno;
+    }
+}
+
+LoopWatchdog::LoopWatchdog(double thresholdSeconds)
+    : threshold_(thresholdSeconds)
+    , signo_(SIGRTMIN + 2)
+    , stallCallback_(defaultStallCallback)
+    , stalls_(0)
+    , running_(false)
+{
+}
+
+LoopWatchdog::~LoopWatchdog()
+{
+    stop();
+}
+
+void LoopWatchdog::watch(EventLoop *loop)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    watched_.push_back(Watched{loop->activity(), 0, nowNs(), false});
+}
+
+void LoopWatchdog::start()
+{
+    // backtrace第一次调用时会加载libgcc并分配内存，先在这里调用一次，信号处理函数中就不会再分配
+    void *frame;
+    ::backtrace(&frame, 1);
+
+    struct sigaction sa;
+    ::memset(&sa, 0, sizeof sa);
+    sa.sa_handler = captureStack;
+    sa.sa_flags = SA_RESTART;
+    ::sigemptyset(&sa.sa_mask);
+    if (::sigaction(signo_, &sa, nullptr) < 0)
+    {
+        LOG_ERROR("LoopWatchdog::start sigaction(%d) errno=%d\n", signo_, errno);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_)
+    {
+        return;
+    }
+    running_ = true;
+    thread_.reset(new Thread(std::bind(&LoopWatchdog::threadFunc, this), "LoopWatchdog"));
+    thread_->start();
+}
+
+void LoopWatchdog::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+        {
+            return;
+        }
+        running_ = false;
+    }
+    cond_.notify_one();
+    thread_->join();
+    thread_.reset();
+}
+
+void LoopWatchdog::threadFunc()
+{
+    // 检测的误差不超过threshold的1/4
+    auto interval = std::chrono::nanoseconds(std::max<int64_t>(static_cast<int64_t>(threshold_ * 1e9 / 4), 1000000));
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_)
+    {
+        cond_.wait_for(lock, interval);
+        if (!running_)
+        {
+            break;
+        }
+
+        struct Stall
+        {
+            LoopActivityPtr activity;
+            uint64_t seq;
+            double seconds;
+        };
+        std::vector<Stall> stalls;
+        int64_t now = nowNs();
+        watched_.erase(std::remove_if(watched_.begin(), watched_.end(), [](const Watched &w) {
+            return !w.activity->alive.load(std::memory_order_relaxed);
+        }), watched_.end());
+        for (Watched &w : watched_)
+        {
+            uint64_t seq = w.activity->seq.load(std::memory_order_acquire);
+            if (seq != w.lastSeq)
+            {
+                w.lastSeq = seq;
+                w.sinceNs = now;
+                w.reported = false;
+            }
+            else if ((seq & 1) && !w.reported && now - w.sinceNs >= threshold_ * 1e9)
+            {
+                w.reported = true;
+                stalls.push_back(Stall{w.activity, seq, (now - w.sinceNs) / 1e9});
+            }
+        }
+
+        // 抓取调用栈要等待目标线程处理信号，不持有锁
+        lock.unlock();
+        for (const Stall &stall : stalls)
+        {
+            report(stall.activity, stall.seq, stall.seconds);
+        }
+        lock.lock();
+    }
+}
+
+void LoopWatchdog::report(const LoopActivityPtr &activity, uint64_t seq, double stalledSeconds)
+{
+    stalls_.fetch_add(1, std::memory_order_relaxed);
+
+    StallReport r;
+    r.loopTid = activity->tid;
+    r.callbackType = activity->kind.load(std::memory_order_relaxed) == LoopActivity::kChannelEvent ? "channel event" : "pending functor";
+    r.fd = -1;
+    r.revents = 0;
+    r.stalledSeconds = stalledSeconds;
+
+    // 信号只发给卡住的那个线程，最多等100ms
+    activity->captureSeq.store(0, std::memory_order_relaxed);
+    if (::syscall(SYS_tgkill, ::getpid(), activity->tid, signo_) == 0)
+    {
+        int64_t deadline = nowNs() + 100 * 1000 * 1000;
+        while (activity->captureSeq.load(std::memory_order_acquire) == 0 && nowNs() < deadline)
+        {
+            ::usleep(100);
+        }
+    }
+    // 回调在等待期间已经返回时，抓到的是之后的调用栈，不使用
+    if (activity->captureSeq.load(std::memory_order_acquire) == seq)
+    {
+        r.fd = activity->fd;
+        r.revents = activity->revents;
+        r.owner = activity->owner;
+        char **symbols = ::backtrace_symbols(activity->frames, activity->depth);
+        for (int i = 0; i < activity->depth; ++i)
+        {
+            r.backtrace.push_back(symbols != nullptr ? symbols[i] : "?");
+        }
+        ::free(symbols);
+    }
+
+    if (stallCallback_)
+    {
+        stallCallback_(r);
+    }
+}
+
+void LoopWatchdog::defaultStallCallback(const StallReport &report)
+{
+    std::string stack;
+    for (const std::string &frame : report.backtrace)
+    {
+        stack += "\n    ";
+        stack += frame;
+    }
+    LOG_ERROR("LoopWatchdog: loop thread %d stalled for %.3fs in %s fd=%d revents=0x%x owner=%s%s\n",
+              report.loopTid, report.stalledSeconds, report.callbackType, report.fd, report.revents,
+              report.owner.empty() ? "-" : report.owner.c_str(),
+              stack.empty() ? " (no backtrace)" : stack.c_str());
+}
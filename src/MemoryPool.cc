@@ -0,0 +1,104 @@
+#include "MemoryPool.h"
+#include "CurrentThread.h"
+
+#include <string.h>
+
+MemoryPool::MemoryPool()
+    : ownerTid_(CurrentThread::tid())
+{
+    memset(freeLists_, 0, sizeof freeLists_);
+    memset(remoteLists_, 0, sizeof remoteLists_);
+}
+
+MemoryPool::~MemoryPool()
+{
+    for (void *chunk : chunks_)
+    {
+        ::operator delete(chunk, std::align_val_t(kAlignment));
+    }
+}
+
+bool MemoryPool::isOwnerThread() const
+{
+    return ownerTid_ == CurrentThread::tid();
+}
+
+void *MemoryPool::allocate(size_t size)
+{
+    if (size == 0 || size > kMaxBlockSize)
+    {
+        return ::operator new(size);
+    }
+
+    size_t index = classIndex(size);
+    if (isOwnerThread())
+    {
+        FreeBlock *block = freeLists_[index];
+        if (block == nullptr)
+        {
+            // 本地链表为空，先把其它线程归还的内存块整体取回，不够再切新的chunk
+            std::lock_guard<std::mutex> lock(mutex_);
+            block = remoteLists_[index];
+            remoteLists_[index] = nullptr;
+            if (block == nullptr)
+            {
+                block = carveLocked(index);
+            }
+        }
+        freeLists_[index] = block->next;
+        return block;
+    }
+
+    // 非owner线程分配，只能使用远端链表
+    std::lock_guard<std::mutex> lock(mutex_);
+    FreeBlock *block = remoteLists_[index];
+    if (block == nullptr)
+    {
+        block = carveLocked(index);
+    }
+    remoteLists_[index] = block->next;
+    return block;
+}
+
+void MemoryPool::deallocate(void *p, size_t size)
+{
+    if (p == nullptr)
+    {
+        return;
+    }
+    if (size == 0 || size > kMaxBlockSize)
+    {
+        ::operator delete(p);
+        return;
+    }
+
+    size_t index = classIndex(size);
+    FreeBlock *block = static_cast<FreeBlock *>(p);
+    if (isOwnerThread())
+    {
+        block->next = freeLists_[index];
+        freeLists_[index] = block;
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        block->next = remoteLists_[index];
+        remoteLists_[index] = block;
+    }
+}
+
+MemoryPool::FreeBlock *MemoryPool::carveLocked(size_t index)
+{
+    size_t blockSize = classSize(index);
+    char *chunk = static_cast<char *>(::operator new(kChunkSize, std::align_val_t(kAlignment)));
+    chunks_.push_back(chunk);
+
+    size_t count = kChunkSize / blockSize;
+    for (size_t i = 0; i < count - 1; ++i)
+    {
+        reinterpret_cast<FreeBlock *>(chunk + i * blockSize)->next =
+            reinterpret_cast<FreeBlock *>(chunk + (i + 1) * blockSize);
+    }
+    reinterpret_cast<FreeBlock *>(chunk + (count - 1) * blockSize)->next = nullptr;
+    return reinterpret_cast<FreeBlock *>(chunk);
+}
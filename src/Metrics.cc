@@ -0,0 +1,92 @@
+#include "Metrics.h"
+
+#include <algorithm>
+#include <string.h>
+
+MetricsRegistry &MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+int MetricsRegistry::addCollector(Collector collector)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    int id = nextId_++;
+    collectors_[id] = std::move(collector);
+    return id;
+}
+
+void MetricsRegistry::removeCollector(int id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    collectors_.erase(id);
+}
+
+std::string MetricsRegistry::scrape()
+{
+    std::vector<Sample> samples;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &item : collectors_)
+        {
+            item.second(&samples);
+        }
+    }
+    // 按名字分组，同一个指标内保持登记顺序
+    std::stable_sort(samples.begin(), samples.end(), [](const Sample &a, const Sample &b) {
+        return ::strcmp(a.name, b.name) < 0;
+    });
+
+    std::string out;
+    out.reserve(samples.size() * 96);
+    const char *current = nullptr;
+    for (const Sample &s : samples)
+    {
+        if (current == nullptr || ::strcmp(current, s.name) != 0)
+        {
+            current = s.name;
+            out += "# HELP ";
+            out += s.name;
+            out += ' ';
+            out += s.help;
+            out += "\n# TYPE ";
+            out += s.name;
+            out += s.type == kCounter ? " counter\n" : " gauge\n";
+        }
+        out += s.name;
+        if (!s.labels.empty())
+        {
+            out += '{';
+            out += s.labels;
+            out += '}';
+        }
+        out += ' ';
+        out += std::to_string(s.value);
+        out += '\n';
+    }
+    return out;
+}
+
+std::string MetricsRegistry::escapeLabel(const std::string &value)
+{
+    std::string out;
+    out.reserve(value.size());
+    for (char c : value)
+    {
+        if (c == '\\' || c == '"')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (c == '\n')
+        {
+            out += "\\n";
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    return out;
+}
@@ -0,0 +1,28 @@
+#include "MetricsServer.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "Metrics.h"
+
+MetricsServer::MetricsServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &name)
+    : server_(loop, listenAddr, name)
+{
+    server_.setHttpCallback(
+        std::bind(&MetricsServer::onRequest, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+void MetricsServer::onRequest(const HttpRequest &req, HttpResponse *resp)
+{
+    if (req.path() != "/metrics")
+    {
+        resp->setStatusCode(HttpResponse::k404NotFound);
+        return;
+    }
+    if (req.method() != HttpRequest::kGet && req.method() != HttpRequest::kHead)
+    {
+        resp->setStatusCode(HttpResponse::k501NotImplemented);
+        return;
+    }
+    resp->setStatusCode(HttpResponse::k200Ok);
+    resp->setContentType("text/plain; version=0.0.4; charset=utf-8");
+    resp->setBody(MetricsRegistry::instance().scrape());
+}
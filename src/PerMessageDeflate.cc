@@ -0,0 +1,147 @@
+#include "PerMessageDeflate.h"
+#include "Logger.h"
+
+#ifdef MYMUDUO_HAVE_ZLIB
+#include <zlib.h>
+#include <string.h>
+#include <algorithm>
+
+namespace
+{
+    // 每个线程一对zlib流，每条消息开始前reset
+    struct ZStreams
+    {
+        ZStreams()
+        {
+            ::memset(&deflater, 0, sizeof deflater);
+            ::memset(&inflater, 0, sizeof inflater);
+            // 负的windowBits表示raw deflate，没有zlib头
+            deflateOk = ::deflateInit2(&deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+            inflateOk = ::inflateInit2(&inflater, -15) == Z_OK;
+        }
+        ~ZStreams()
+        {
+            if (deflateOk)
+                ::deflateEnd(&deflater);
+            if (inflateOk)
+                ::inflateEnd(&inflater);
+        }
+
+        z_stream deflater;
+        z_stream inflater;
+        bool deflateOk;
+        bool inflateOk;
+    };
+
+    thread_local ZStreams t_streams;
+    const unsigned char kTail[4] = {0x00, 0x00, 0xff, 0xff};
+}
+
+bool PerMessageDeflate::available()
+{
+    return true;
+}
+
+const char *PerMessageDeflate::responseExtension()
+{
+    return "permessage-deflate; server_no_context_takeover; client_no_context_takeover";
+}
+
+bool PerMessageDeflate::compress(const char *data, size_t len, std::string *out)
+{
+    z_stream &zs = t_streams.deflater;
+    if (!t_streams.deflateOk || ::deflateReset(&zs) != Z_OK)
+    {
+        return false;
+    }
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    zs.avail_in = static_cast<uInt>(len);
+
+    size_t start = out->size();
+    do
+    {
+        size_t used = out->size();
+        out->resize(used + ::deflateBound(&zs, zs.avail_in) + 16);
+        zs.next_out = reinterpret_cast<Bytef *>(&(*out)[used]);
+        zs.avail_out = static_cast<uInt>(out->size() - used);
+        if (::deflate(&zs, Z_SYNC_FLUSH) == Z_STREAM_ERROR)
+        {
+            out->resize(start);
+            return false;
+        }
+        out->resize(out->size() - zs.avail_out);
+    } while (zs.avail_out == 0 || zs.avail_in > 0);
+
+    // SYNC_FLUSH以00 00 ff ff结尾，按RFC 7692去掉
+    if (out->size() - start >= 4 && ::memcmp(out->data() + out->size() - 4, kTail, 4) == 0)
+    {
+        out->resize(out->size() - 4);
+    }
+    return true;
+}
+
+bool PerMessageDeflate::decompress(const char *data, size_t len, std::string *out, size_t maxSize)
+{
+    z_stream &zs = t_streams.inflater;
+    if (!t_streams.inflateOk || ::inflateReset(&zs) != Z_OK)
+    {
+        return false;
+    }
+
+    size_t start = out->size();
+    // 先解压消息本身，再补上发送方去掉的00 00 ff ff
+    const unsigned char *inputs[2] = {reinterpret_cast<const unsigned char *>(data), kTail};
+    size_t lengths[2] = {len, sizeof kTail};
+    for (int k = 0; k < 2; ++k)
+    {
+        zs.next_in = const_cast<Bytef *>(inputs[k]);
+        zs.avail_in = static_cast<uInt>(lengths[k]);
+        // 输入用完并且输出缓冲区没有被写满时，这一段输入才算处理完
+        do
+        {
+            size_t used = out->size();
+            size_t chunk = std::min(lengths[k] * 4 + 1024, maxSize + 1 - (used - start));
+            out->resize(used + chunk);
+            zs.next_out = reinterpret_cast<Bytef *>(&(*out)[used]);
+            zs.avail_out = static_cast<uInt>(chunk);
+            int ret = ::inflate(&zs, Z_SYNC_FLUSH);
+            out->resize(out->size() - zs.avail_out);
+            if (out->size() - start > maxSize || (ret != Z_OK && ret != Z_BUF_ERROR && ret != Z_STREAM_END))
+            {
+                out->resize(start);
+                return false;
+            }
+            if (ret != Z_OK) // 流结束或者没有进展
+            {
+                break;
+            }
+        } while (zs.avail_in > 0 || zs.avail_out == 0);
+    }
+    return true;
+}
+
+#else
+
+bool PerMessageDeflate::available()
+{
+    return false;
+}
+
+const char *PerMessageDeflate::responseExtension()
+{
+    return "";
+}
+
+bool PerMessageDeflate::compress(const char *, size_t, std::string *)
+{
+    LOG_ERROR("PerMessageDeflate: built without zlib\n");
+    return false;
+}
+
+bool PerMessageDeflate::decompress(const char *, size_t, std::string *, size_t)
+{
+    LOG_ERROR("PerMessageDeflate: built without zlib\n");
+    return false;
+}
+
+#endif
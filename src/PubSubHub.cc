@@ -0,0 +1,303 @@
+#include "PubSubHub.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+
+#include <algorithm>
+#include <iterator>
+
+// 一个loop上的订阅表和投递队列
+struct PubSubHub::LoopHub
+{
+    struct Topic
+    {
+        std::vector<TcpConnectionPtr> subscribers;
+        std::unordered_map<TcpConnection *, size_t> index; // 订阅者在subscribers中的下标，用于O(1)删除
+    };
+
+    explicit LoopHub(EventLoop *l) : loop(l) {}
+
+    // 删除一个订阅者，返回topic是否已经没有订阅者
+    bool removeSubscriber(const std::string &name, TcpConnection *conn)
+    {
+        auto it = topics.find(name);
+        if (it == topics.end())
+        {
+            return false;
+        }
+        Topic &topic = it->second;
+        auto pos = topic.index.find(conn);
+        if (pos == topic.index.end())
+        {
+            return false;
+        }
+        // 和最后一个交换以后删除
+        size_t i = pos->second;
+        topic.index.erase(pos);
+        if (i + 1 != topic.subscribers.size())
+        {
+            topic.subscribers[i] = std::move(topic.subscribers.back());
+            topic.index[topic.subscribers[i].get()] = i;
+        }
+        topic.subscribers.pop_back();
+        if (topic.subscribers.empty())
+        {
+            topics.erase(it);
+            return true;
+        }
+        return false;
+    }
+
+    // 删除订阅者，同时从这个连接的topic列表中删除，返回topic是否已经没有订阅者
+    bool unsubscribe(const std::string &name, TcpConnection *conn)
+    {
+        auto it = connTopics.find(conn);
+        if (it != connTopics.end())
+        {
+            std::vector<std::string> &names = it->second;
+            names.erase(std::remove(names.begin(), names.end(), name), names.end());
+            if (names.empty())
+            {
+                connTopics.erase(it);
+            }
+        }
+        return removeSubscriber(name, conn);
+    }
+
+    EventLoop *loop;
+    // 以下两个只在loop线程中访问
+    std::unordered_map<std::string, Topic> topics;
+    std::unordered_map<TcpConnection *, std::vector<std::string>> connTopics;
+
+    // 其它线程发布的消息先放进pending，队列从空变为非空时才唤醒loop，一批消息只投递一次任务
+    std::mutex mutex;
+    std::vector<std::pair<std::string, Payload>> pending;
+    std::vector<std::pair<std::string, Payload>> flushing; // 在loop线程中和pending交换，复用内存
+};
+
+PubSubHub::PubSubHub()
+    : policy_(kDropMessage)
+    , maxPendingBytes_(kDefaultMaxPendingBytes)
+    , published_(0)
+    , delivered_(0)
+    , dropped_(0)
+    , disconnected_(0)
+{
+}
+
+PubSubHub::~PubSubHub() = default;
+
+PubSubHub::LoopHubPtr PubSubHub::loopHub(EventLoop *loop)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    LoopHubPtr &hub = loops_[loop];
+    if (!hub)
+    {
+        hub = std::make_shared<LoopHub>(loop);
+    }
+    return hub;
+}
+
+void PubSubHub::removeLoop(EventLoop *loop)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    loops_.erase(loop);
+    for (auto it = topicLoops_.begin(); it != topicLoops_.end();)
+    {
+        std::vector<LoopHubPtr> &hubs = it->second;
+        hubs.erase(std::remove_if(hubs.begin(), hubs.end(), [loop](const LoopHubPtr &hub) { return hub->loop == loop; }),
+                   hubs.end());
+        it = hubs.empty() ? topicLoops_.erase(it) : std::next(it);
+    }
+}
+
+void PubSubHub::subscribe(const std::string &topic, const TcpConnectionPtr &conn)
+{
+    LoopHubPtr hub = loopHub(conn->getLoop());
+    hub->loop->runInLoop([this, hub, topic, conn]() {
+        if (!conn->connected())
+        {
+            return;
+        }
+        LoopHub::Topic &t = hub->topics[topic];
+        if (!t.index.emplace(conn.get(), t.subscribers.size()).second)
+        {
+            return; // 已经订阅过
+        }
+        t.subscribers.push_back(conn);
+        hub->connTopics[conn.get()].push_back(topic);
+        if (t.subscribers.size() == 1)
+        {
+            addTopicLoop(topic, hub);
+        }
+    });
+}
+
+void PubSubHub::unsubscribe(const std::string &topic, const TcpConnectionPtr &conn)
+{
+    LoopHubPtr hub = loopHub(conn->getLoop());
+    hub->loop->runInLoop([this, hub, topic, conn]() {
+        if (hub->unsubscribe(topic, conn.get()))
+        {
+            removeTopicLoop(topic, hub.get());
+        }
+    });
+}
+
+void PubSubHub::unsubscribeAll(const TcpConnectionPtr &conn)
+{
+    LoopHubPtr hub = loopHub(conn->getLoop());
+    hub->loop->runInLoop([this, hub, conn]() {
+        auto it = hub->connTopics.find(conn.get());
+        if (it == hub->connTopics.end())
+        {
+            return;
+        }
+        for (const std::string &topic : it->second)
+        {
+            if (hub->removeSubscriber(topic, conn.get()))
+            {
+                removeTopicLoop(topic, hub.get());
+            }
+        }
+        hub->connTopics.erase(it);
+    });
+}
+
+void PubSubHub::addTopicLoop(const std::string &topic, const LoopHubPtr &hub)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = loops_.find(hub->loop);
+    if (it == loops_.end() || it->second != hub)
+    {
+        return; // loop已经被removeLoop移除
+    }
+    topicLoops_[topic].push_back(hub);
+}
+
+void PubSubHub::removeTopicLoop(const std::string &topic, LoopHub *hub)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = topicLoops_.find(topic);
+    if (it != topicLoops_.end())
+    {
+        std::vector<LoopHubPtr> &hubs = it->second;
+        hubs.erase(std::remove_if(hubs.begin(), hubs.end(), [hub](const LoopHubPtr &h) { return h.get() == hub; }),
+                   hubs.end());
+        if (hubs.empty())
+        {
+            topicLoops_.erase(it);
+        }
+    }
+}
+
+void PubSubHub::publish(const std::string &topic, const Payload &message)
+{
+    ++published_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = topicLoops_.find(topic);
+    if (it == topicLoops_.end())
+    {
+        return;
+    }
+    for (const LoopHubPtr &hub : it->second)
+    {
+        bool wakeup;
+        {
+            std::lock_guard<std::mutex> hubLock(hub->mutex);
+            wakeup = hub->pending.empty();
+            hub->pending.emplace_back(topic, message);
+        }
+        if (wakeup)
+        {
+            hub->loop->queueInLoop([this, hub]() { flush(hub.get()); });
+        }
+    }
+}
+
+void PubSubHub::flush(LoopHub *hub)
+{
+    std::vector<std::pair<std::string, Payload>> &messages = hub->flushing;
+    {
+        std::lock_guard<std::mutex> lock(hub->mutex);
+        messages.swap(hub->pending);
+    }
+
+    uint64_t delivered = 0;
+    uint64_t dropped = 0;
+    uint64_t disconnected = 0;
+    std::vector<std::pair<std::string, TcpConnectionPtr>> dead;
+
+    // 连续的同一个topic的消息一起发送，每个订阅者只调用一次writev
+    size_t n = messages.size();
+    for (size_t begin = 0, end = 0; begin < n; begin = end)
+    {
+        const std::string &name = messages[begin].first;
+        for (end = begin + 1; end < n && messages[end].first == name; ++end)
+        {
+        }
+        auto it = hub->topics.find(name);
+        if (it == hub->topics.end())
+        {
+            continue;
+        }
+
+        size_t count = end - begin;
+        for (const TcpConnectionPtr &conn : it->second.subscribers)
+        {
+            if (!conn->connected())
+            {
+                dead.emplace_back(name, conn);
+                continue;
+            }
+            // 按这一批消息之前的积压判断，避免一批较大的消息本身触发限制
+            if (conn->pendingOutputBytes() > maxPendingBytes_)
+            {
+                if (policy_ == kDisconnect)
+                {
+                    conn->forceClose();
+                    dead.emplace_back(name, conn);
+                    ++disconnected;
+                }
+                else
+                {
+                    dropped += count;
+                }
+                continue;
+            }
+
+            if (count == 1)
+            {
+                conn->send(messages[begin].second);
+            }
+            else
+            {
+                conn->cork();
+                for (size_t i = begin; i < end; ++i)
+                {
+                    conn->send(messages[i].second);
+                }
+                conn->uncork();
+            }
+            delivered += count;
+        }
+    }
+    messages.clear();
+
+    // 已经断开的订阅者不需要用户调用unsubscribeAll也会被清理
+    for (const auto &item : dead)
+    {
+        if (hub->unsubscribe(item.first, item.second.get()))
+        {
+            removeTopicLoop(item.first, hub);
+        }
+    }
+
+    delivered_ += delivered;
+    dropped_ += dropped;
+    disconnected_ += disconnected;
+}
+
+PubSubHub::Stats PubSubHub::stats() const
+{
+    return Stats{published_.load(), delivered_.load(), dropped_.load(), disconnected_.load()};
+}
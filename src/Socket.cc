@@ -8,6 +8,8 @@
 #include <strings.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <errno.h>
+#include <linux/net_tstamp.h>
 
 Socket::~Socket()
 {
@@ -16,7 +18,7 @@ Socket::~Socket()
 
 void Socket::bindAddress(const InetAddress &localaddr)
 {
-    if (0 != ::bind(sockfd_, (sockaddr *)localaddr.getSockAddr(), sizeof(sockaddr_in)))
+    if (0 != ::bind(sockfd_, localaddr.sockAddr(), localaddr.sockAddrLen()))
     {
         LOG_FATAL("bind sockfd:%d fail \n", sockfd_);
     }
@@ -38,17 +40,29 @@ int Socket::accept(InetAddress *peeraddr)
      * Reactor模型 one loop per thread
      * poller + non-blocking IO
      */
-    sockaddr_in addr;
+    sockaddr_storage addr;
     socklen_t len = sizeof addr;
     bzero(&addr, sizeof addr);
     int connfd = ::accept4(sockfd_, (sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
     if (connfd >= 0)
     {
-        peeraddr->setSockAddr(addr);
+        peeraddr->setSockAddr((sockaddr *)&addr, len);
     }
     return connfd;
 }
 
+void Socket::getLocalAddr(InetAddress *localaddr) const
+{
+    sockaddr_storage addr;
+    socklen_t len = sizeof addr;
+    bzero(&addr, sizeof addr);
+    if (::getsockname(sockfd_, (sockaddr *)&addr, &len) < 0)
+    {
+        LOG_ERROR("get local address failed! sockfd:%d \n", sockfd_);
+    }
+    localaddr->setSockAddr((sockaddr *)&addr, len);
+}
+
 void Socket::shutdownWrite()
 {
     if (::shutdown(sockfd_, SHUT_WR) < 0)
@@ -79,4 +93,26 @@ void Socket::setKeepAlive(bool on)
 {
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof optval);
-}
\ No newline at end of file
+}
+
+bool Socket::setReceiveTimestamping(bool on)
+{
+    int flags = on ? (SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE) : 0;
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof flags) < 0)
+    {
+        LOG_ERROR("Socket::setReceiveTimestamping fd=%d errno=%d\n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
+
+int Socket::incomingCpu() const
+{
+    int cpu = -1;
+    socklen_t len = sizeof cpu;
+    if (::getsockopt(sockfd_, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) < 0)
+    {
+        return -1;
+    }
+    return cpu;
+}
@@ -3,16 +3,41 @@
 #include "Socket.h"
 #include "Channel.h"
 #include "EventLoop.h"
+#include "Tracer.h"
 
+#include <algorithm>
 #include <functional>
 #include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <strings.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <string>
 
+// 用sendmsg发送iov，附带一个SCM_RIGHTS的fd
+static ssize_t sendWithFd(int sockfd, struct iovec *vec, int iovcnt, int fd)
+{
+    char control[CMSG_SPACE(sizeof(int))];
+    ::memset(control, 0, sizeof control);
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof msg);
+    msg.msg_iov = vec;
+    msg.msg_iovlen = iovcnt;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    ::memcpy(CMSG_DATA(cmsg), &fd, sizeof fd);
+    return ::sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+}
+
 static EventLoop *CheckLoopNotNull(EventLoop *loop)
 {
     if (loop == nullptr)
@@ -22,26 +47,83 @@ static EventLoop *CheckLoopNotNull(EventLoop *loop)
     return loop;
 }
 
-TcpConnection::TcpConnection(EventLoop *loop, const std::string &name, int sockfd, const InetAddress &localAddr, const InetAddress &peerAddr)
-    : loop_(CheckLoopNotNull(loop)), name_(name), state_(kConnecting), reading_(true), socket_(new Socket(sockfd)), channel_(new Channel(loop, sockfd)), localAddr_(localAddr), peerAddr_(peerAddr), highWaterMark_(64 * 1024 * 1024) // 64M
+TcpConnection::TcpConnection(EventLoop *loop, uint64_t id, const std::shared_ptr<const std::string> &namePrefix, int sockfd, const InetAddress &peerAddr)
+    : loop_(CheckLoopNotNull(loop)), id_(id), namePrefix_(namePrefix), state_(kConnecting), reading_(true), corked_(false), socket_(sockfd), channel_(loop, sockfd), peerAddr_(peerAddr), highWaterMark_(64 * 1024 * 1024), outputChainBytes_(0), receiveTimestamping_(false), reportedOutputBytes_(0) // 64M
 {
     // 下面给channel设置相应的回调函数，poller给channel通知感兴趣的事件发生了，channel会回调相应的操作函数
-    channel_->setReadCallback(std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
-    channel_->setWriteCallback(
+    channel_.setReadCallback(std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
+    channel_.setWriteCallback(
         std::bind(&TcpConnection::handleWrite, this));
-    channel_->setCloseCallback(
+    channel_.setCloseCallback(
         std::bind(&TcpConnection::handleClose, this));
-    channel_->setErrorCallback(
+    channel_.setErrorCallback(
         std::bind(&TcpConnection::handleError, this));
+    channel_.setOwner(this, &TcpConnection::describe);
 
-    LOG_DEBUG("TcpConnection::ctor[%s] at fd=%d\n", name_.c_str(), sockfd);
-    socket_->setKeepAlive(true);
+    LOG_DEBUG("TcpConnection::ctor[#%llu] at fd=%d\n", (unsigned long long)id_, sockfd);
+    if (!peerAddr_.isUnix())
+    {
+        socket_.setKeepAlive(true);
+    }
 }
 
 TcpConnection::~TcpConnection()
 {
-    LOG_DEBUG("TcpConnection::dtor[%s] at fd=%d state=%d \n",
-             name_.c_str(), channel_->fd(), (int)state_);
+    LOG_DEBUG("TcpConnection::dtor[#%llu] at fd=%d state=%d \n",
+             (unsigned long long)id_, channel_.fd(), (int)state_);
+    // 没有发出去的和没有被取走的fd
+    for (const OutputSegment &segment : outputChain_)
+    {
+        if (segment.passedFd >= 0)
+        {
+            ::close(segment.passedFd);
+        }
+    }
+    for (int fd : passedFds_)
+    {
+        ::close(fd);
+    }
+}
+
+const std::string &TcpConnection::name() const
+{
+    std::call_once(nameOnce_, [this]() {
+        name_ = (namePrefix_ ? *namePrefix_ : std::string()) + std::to_string(id_);
+    });
+    return name_;
+}
+
+void TcpConnection::describe(const void *self, char *buf, size_t len)
+{
+    // 在信号处理函数中调用，不能用name()和snprintf
+    const TcpConnection *conn = static_cast<const TcpConnection *>(self);
+    size_t n = 0;
+    if (conn->namePrefix_)
+    {
+        n = std::min(conn->namePrefix_->size(), len - 1);
+        ::memcpy(buf, conn->namePrefix_->data(), n);
+    }
+    char digits[24];
+    int d = 0;
+    uint64_t id = conn->id_;
+    do
+    {
+        digits[d++] = static_cast<char>('0' + id % 10);
+        id /= 10;
+    } while (id > 0);
+    while (d > 0 && n < len - 1)
+    {
+        buf[n++] = digits[--d];
+    }
+    buf[n] = '\0';
+}
+
+const InetAddress &TcpConnection::localAddress() const
+{
+    std::call_once(localAddrOnce_, [this]() {
+        socket_.getLocalAddr(&localAddr_);
+    });
+    return localAddr_;
 }
 
 void TcpConnection::send(const std::string &buf)
@@ -54,12 +136,88 @@ void TcpConnection::send(const std::string &buf)
         }
         else
         {
-            loop_->runInLoop(
-                std::bind(&TcpConnection::sendInLoop, this, buf.c_str(), buf.size()));
+            // 跨线程发送时拷贝一份数据，调用方的buf在投递到loop以后可能已经析构
+            TcpConnectionPtr self(shared_from_this());
+            loop_->runInLoop([self, buf]() {
+                self->sendInLoop(buf.c_str(), buf.size());
+            });
         }
     }
 }
 
+void TcpConnection::send(Buffer *buf)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            if (corked_ && pendingOutputBytes() == 0)
+            {
+                outputBuffer_.swap(*buf); // 发送缓冲区为空时直接交换，不拷贝
+                updateBufferedBytes();
+            }
+            else
+            {
+                sendInLoop(buf->peek(), buf->readableBytes());
+            }
+            buf->retrieveAll();
+        }
+        else
+        {
+            TcpConnectionPtr self(shared_from_this());
+            std::string data(buf->retrieveAllAsString());
+            loop_->runInLoop([self, data]() {
+                self->sendInLoop(data.data(), data.size());
+            });
+        }
+    }
+}
+
+void TcpConnection::send(const std::shared_ptr<const std::string> &data)
+{
+    if (state_ == kConnected && data)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(data->data(), data->size(), data);
+        }
+        else
+        {
+            TcpConnectionPtr self(shared_from_this());
+            loop_->runInLoop([self, data]() {
+                self->sendInLoop(data->data(), data->size(), data);
+            });
+        }
+    }
+}
+
+void TcpConnection::sendFd(int fd, const std::string &data)
+{
+    if (state_ != kConnected || data.empty() || !peerAddr_.isUnix())
+    {
+        LOG_ERROR("TcpConnection::sendFd %s: need a connected unix domain connection and non-empty data\n", name().c_str());
+        return;
+    }
+    // 调用方在返回以后就可以关闭fd，传给对端的是这里dup出来的副本
+    int dupFd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (dupFd < 0)
+    {
+        LOG_ERROR("TcpConnection::sendFd dup fd=%d errno=%d\n", fd, errno);
+        return;
+    }
+    if (loop_->isInLoopThread())
+    {
+        sendFdInLoop(dupFd, data);
+    }
+    else
+    {
+        TcpConnectionPtr self(shared_from_this());
+        loop_->runInLoop([self, dupFd, data]() {
+            self->sendFdInLoop(dupFd, data);
+        });
+    }
+}
+
 void TcpConnection::shutdown()
 {
     if (state_ == kConnected)
@@ -70,11 +228,37 @@ void TcpConnection::shutdown()
     }
 }
 
+void TcpConnection::forceClose()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        loop_->queueInLoop(
+            std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    }
+}
+
+bool TcpConnection::setReceiveTimestamping(bool on)
+{
+    if (peerAddr_.isUnix())
+    {
+        LOG_ERROR("TcpConnection::setReceiveTimestamping [%s] - not supported on unix domain sockets\n", name().c_str());
+        return false;
+    }
+    if (!socket_.setReceiveTimestamping(on))
+    {
+        return false;
+    }
+    receiveTimestamping_ = on;
+    kernelReceiveTime_ = Timestamp();
+    return true;
+}
+
 void TcpConnection::connectionEstablished()
 {
     setState(kConnected);
-    channel_->tie(shared_from_this());
-    channel_->enableReading();
+    channel_.tie(shared_from_this());
+    channel_.enableReading();
 
     connectionCallback_(shared_from_this());
 }
@@ -84,19 +268,57 @@ void TcpConnection::connectionDestroyed()
     if (state_ == kConnected)
     {
         setState(kDisconnected);
-        channel_->disableAll();
+        channel_.disableAll();
         connectionCallback_(shared_from_this());
     }
-    channel_->remove(); // 把channel从poller中删除
+    channel_.remove(); // 把channel从poller中删除
+    if (metrics_)
+    {
+        // 没发出去的数据随连接一起丢弃
+        metrics_->bufferedBytes.add(-static_cast<int64_t>(reportedOutputBytes_));
+        reportedOutputBytes_ = 0;
+    }
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
+    TRACE_SPAN("TcpConnection::handleRead", static_cast<int64_t>(id_));
     int saveErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &saveErrno);
+    // unix域连接用recvmsg，顺便接收对端传过来的fd；开启了接收时间戳时也用recvmsg
+    ssize_t n;
+    if (peerAddr_.isUnix())
+    {
+        n = inputBuffer_.readFd(channel_.fd(), &saveErrno, &passedFds_);
+    }
+    else if (receiveTimestamping_)
+    {
+        n = inputBuffer_.readFdWithTimestamp(channel_.fd(), &saveErrno, &kernelReceiveTime_);
+        if (n > 0 && metrics_ && kernelReceiveTime_.valid())
+        {
+            metrics_->receiveDelayUs.add(std::max<int64_t>(timeDifferenceUs(receiveTime, kernelReceiveTime_), 0));
+            metrics_->receiveDelaySamples.add();
+        }
+    }
+    else
+    {
+        n = inputBuffer_.readFd(channel_.fd(), &saveErrno);
+    }
+    if (metrics_)
+    {
+        metrics_->readCalls.add();
+        if (n > 0)
+        {
+            metrics_->bytesRead.add(n);
+        }
+        else if (n < 0 && saveErrno == EAGAIN)
+        {
+            metrics_->readEagain.add();
+        }
+    }
     if (n > 0)
     {
         // 已建立连接的用户，有可读事件发生了，调用用户传入的回调操作onMessage
+        TRACE_SPAN("messageCallback", n);
         messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
     }
     else if (n == 0)
@@ -113,16 +335,17 @@ void TcpConnection::handleRead(Timestamp receiveTime)
 
 void TcpConnection::handleWrite()
 {
-    if (!channel_->isWriteEvent())
+    TRACE_SPAN("TcpConnection::handleWrite", static_cast<int64_t>(id_));
+    if (channel_.isWriteEvent())
     {
         int saveErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &saveErrno);
+        ssize_t n = writeOutput(&saveErrno);
+        updateBufferedBytes();
         if (n > 0)
         {
-            outputBuffer_.retrieve(n);
-            if (outputBuffer_.readableBytes() == 0) // 全部写完
+            if (pendingOutputBytes() == 0) // 全部写完
             {
-                channel_->disableWriting();
+                channel_.disableWriting();
                 if (writeCompleteCallback_)
                 {
                     loop_->queueInLoop(
@@ -138,15 +361,100 @@ void TcpConnection::handleWrite()
     }
     else
     {
-        LOG_ERROR("TcpConnection fd=%d is down, no more writing!\n", channel_->fd());
+        LOG_ERROR("TcpConnection fd=%d is down, no more writing!\n", channel_.fd());
+    }
+}
+
+ssize_t TcpConnection::writeOutput(int *saveErrno)
+{
+    if (outputChain_.empty())
+    {
+        ssize_t n = outputBuffer_.writeFd(channel_.fd(), saveErrno);
+        recordWrite(n, *saveErrno);
+        if (n > 0)
+        {
+            outputBuffer_.retrieve(n);
+        }
+        return n;
+    }
+
+    // outputBuffer_在前，发送链上的数据按顺序跟在后面，一次writev尽量多写
+    const int kMaxIov = 64;
+    struct iovec vec[kMaxIov];
+    int iovcnt = 0;
+    if (outputBuffer_.readableBytes() > 0)
+    {
+        vec[iovcnt].iov_base = const_cast<char *>(outputBuffer_.peek());
+        vec[iovcnt].iov_len = outputBuffer_.readableBytes();
+        ++iovcnt;
+    }
+    // 要传fd的段只能作为一次发送的开头，它之前的数据先发完
+    int passedFd = -1;
+    for (auto it = outputChain_.begin(); it != outputChain_.end() && iovcnt < kMaxIov; ++it)
+    {
+        if (it->passedFd >= 0)
+        {
+            if (iovcnt > 0)
+            {
+                break;
+            }
+            passedFd = it->passedFd;
+        }
+        vec[iovcnt].iov_base = const_cast<char *>(it->data->data() + it->offset);
+        vec[iovcnt].iov_len = it->data->size() - it->offset;
+        ++iovcnt;
+    }
+
+    ssize_t n;
+    if (passedFd < 0)
+    {
+        n = ::writev(channel_.fd(), vec, iovcnt);
+    }
+    else
+    {
+        n = sendWithFd(channel_.fd(), vec, iovcnt, passedFd);
+        if (n > 0)
+        {
+            ::close(passedFd);
+            outputChain_.front().passedFd = -1;
+        }
+    }
+    if (n < 0)
+    {
+        *saveErrno = errno;
     }
+    recordWrite(n, *saveErrno);
+    if (n < 0)
+    {
+        return n;
+    }
+
+    size_t remaining = n;
+    size_t fromBuffer = std::min(remaining, outputBuffer_.readableBytes());
+    outputBuffer_.retrieve(fromBuffer);
+    remaining -= fromBuffer;
+    while (remaining > 0)
+    {
+        OutputSegment &front = outputChain_.front();
+        size_t left = front.data->size() - front.offset;
+        if (remaining < left)
+        {
+            front.offset += remaining;
+            outputChainBytes_ -= remaining;
+            break;
+        }
+        remaining -= left;
+        outputChainBytes_ -= left;
+        outputChain_.pop_front();
+    }
+    return n;
 }
 
 void TcpConnection::handleClose()
 {
-    LOG_DEBUG("TcpConnection::handleClose fd=%d state=%d \n", channel_->fd(), (int)state_);
+    LOG_DEBUG("TcpConnection::handleClose fd=%d state=%d \n", channel_.fd(), (int)state_);
     setState(kDisconnected);
-    channel_->disableAll();
+    channel_.disableAll();
 
     TcpConnectionPtr connPtr(shared_from_this());
     connectionCallback_(connPtr); // 执行连接关闭的回调
@@ -159,7 +467,7 @@ void TcpConnection::handleError()
     socklen_t optlen = sizeof optval;
     int err = 0;
 
-    if (::getsockopt(channel_->fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    if (::getsockopt(channel_.fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
     {
         err = errno;
     }
@@ -167,10 +475,15 @@ void TcpConnection::handleError()
     {
         err = optval;
     }
-    LOG_ERROR("TcpConnection::HandleError name:%s - SO_ERROR:%d\n", name_.c_str(), err);
+    LOG_ERROR("TcpConnection::HandleError name:%s - SO_ERROR:%d\n", name().c_str(), err);
 }
 
 void TcpConnection::sendInLoop(const void *data, size_t len)
+{
+    sendInLoop(data, len, std::shared_ptr<const std::string>());
+}
+
+void TcpConnection::sendInLoop(const void *data, size_t len, const std::shared_ptr<const std::string> &payload)
 {
     ssize_t nwrote = 0;
     size_t remaining = len;
@@ -184,9 +497,10 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
     }
 
     // 表示channel_第一次开始写数据，而且缓冲区没有待发送数据
-    if (!channel_->isWriteEvent() && outputBuffer_.readableBytes() == 0)
+    if (!corked_ && !channel_.isWriteEvent() && pendingOutputBytes() == 0)
     {
-        nwrote = ::write(channel_->fd(), data, len);
+        nwrote = ::write(channel_.fd(), data, len);
+        recordWrite(nwrote, nwrote < 0 ? errno : 0);
         if (nwrote >= 0)
         {
             remaining = len - nwrote;
@@ -216,25 +530,141 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
     // 也就是调用TcpConnection::handleWrite方法，把发送缓冲区中的数据全部发送完成
     if (!faultError && remaining > 0)
     {
-        size_t oldlen = outputBuffer_.readableBytes(); // 目前发送缓冲区中待发送数据长度
-        if (oldlen + remaining >= highWaterMark_ && oldlen < highWaterMark_ && highWaterMarkCallback_)
+        size_t oldlen = pendingOutputBytes(); // 目前待发送数据长度
+        if (oldlen + remaining >= highWaterMark_ && oldlen < highWaterMark_)
         {
-            loop_->queueInLoop(
-                std::bind(highWaterMarkCallback_, shared_from_this(), oldlen + remaining));
+            if (metrics_)
+            {
+                metrics_->highWaterMarkHits.add();
+            }
+            if (highWaterMarkCallback_)
+            {
+                loop_->queueInLoop(
+                    std::bind(highWaterMarkCallback_, shared_from_this(), oldlen + remaining));
+            }
         }
 
-        outputBuffer_.append((char *)data + nwrote, remaining);
-        if (!channel_->isWriteEvent())
+        if (payload)
+        {
+            // 共享数据不拷贝，记录剩余部分的起始位置
+            outputChain_.push_back(OutputSegment{payload, payload->size() - remaining});
+            outputChainBytes_ += remaining;
+        }
+        else if (outputChain_.empty())
+        {
+            outputBuffer_.append((char *)data + nwrote, remaining);
+        }
+        else
+        {
+            // 发送链非空时追加到链尾，保证和之前的共享数据的顺序
+            outputChain_.push_back(OutputSegment{std::make_shared<const std::string>((char *)data + nwrote, remaining), 0});
+            outputChainBytes_ += remaining;
+        }
+        if (!corked_ && !channel_.isWriteEvent())
         {
-            channel_->enableWriting(); // 这里一定要注册channel的写事件，否则poller不会给channel通知epollout
+            channel_.enableWriting(); // 这里一定要注册channel的写事件，否则poller不会给channel通知epollout
+        }
+        updateBufferedBytes();
+    }
+}
+
+void TcpConnection::sendFdInLoop(int fd, const std::string &data)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("DISCONNECTED, give up writing!\n");
+        ::close(fd);
+        return;
+    }
+
+    size_t nwrote = 0;
+    if (!corked_ && !channel_.isWriteEvent() && pendingOutputBytes() == 0)
+    {
+        struct iovec vec;
+        vec.iov_base = const_cast<char *>(data.data());
+        vec.iov_len = data.size();
+        ssize_t n = sendWithFd(channel_.fd(), &vec, 1, fd);
+        recordWrite(n, n < 0 ? errno : 0);
+        if (n > 0)
+        {
+            ::close(fd); // 已经随第一个字节发出
+            fd = -1;
+            nwrote = n;
+            if (nwrote == data.size())
+            {
+                if (writeCompleteCallback_)
+                {
+                    loop_->queueInLoop(
+                        std::bind(writeCompleteCallback_, shared_from_this()));
+                }
+                return;
+            }
+        }
+        else if (errno != EWOULDBLOCK)
+        {
+            LOG_ERROR("TcpConnection::sendFdInLoop fd=%d errno=%d\n", channel_.fd(), errno);
+            ::close(fd);
+            return;
+        }
+    }
+
+    // 剩下的数据挂到发送链上，fd还没发出时随这一段的第一个字节发送
+    outputChain_.push_back(OutputSegment{std::make_shared<const std::string>(data, nwrote), 0, fd});
+    outputChainBytes_ += data.size() - nwrote;
+    if (!corked_ && !channel_.isWriteEvent())
+    {
+        channel_.enableWriting();
+    }
+    updateBufferedBytes();
+}
+
+void TcpConnection::uncork()
+{
+    corked_ = false;
+    if (channel_.isWriteEvent() || pendingOutputBytes() == 0 || state_ == kDisconnected)
+    {
+        return;
+    }
+
+    int saveErrno = 0;
+    ssize_t n = writeOutput(&saveErrno);
+    updateBufferedBytes();
+    if (n < 0 && saveErrno != EWOULDBLOCK)
+    {
+        // EPIPE、ECONNRESET等错误交给后续的读事件处理关闭
+        LOG_ERROR("TcpConnection::uncork fd=%d errno=%d\n", channel_.fd(), saveErrno);
+        return;
+    }
+    if (pendingOutputBytes() > 0)
+    {
+        channel_.enableWriting();
+    }
+    else
+    {
+        if (writeCompleteCallback_)
+        {
+            loop_->queueInLoop(
+                std::bind(writeCompleteCallback_, shared_from_this()));
+        }
+        if (state_ == kDisconnecting)
+        {
+            shutdownInLoop();
         }
     }
 }
 
 void TcpConnection::shutdownInLoop()
 {
-    if (!channel_->isWriteEvent()) // 说明outputBuffer中的数据已经全部发送完成
+    if (!channel_.isWriteEvent() && pendingOutputBytes() == 0) // 说明outputBuffer中的数据已经全部发送完成
+    {
+        socket_.shutdownWrite(); // 关闭写端
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
     {
-        socket_->shutdownWrite(); // 关闭写端
+        handleClose(); // 和对端主动关闭走相同的流程
     }
 }
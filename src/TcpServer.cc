@@ -1,9 +1,11 @@
 #include "TcpServer.h"
 #include "Logger.h"
 #include "TcpConnection.h"
+#include "MemoryPool.h"
 
 #include <strings.h>
 #include <functional>
+#include <algorithm>
 
 static EventLoop *CheckLoopNotNull(EventLoop *loop)
 {
@@ -20,6 +22,7 @@ static EventLoop *CheckLoopNotNull(EventLoop *loop)
 
     const std::string ipPort_;
     const std::string name_;
+    std::shared_ptr<const std::string> connNamePrefix_; // "name-ip:port#"，所有连接共享
 
     std::unique_ptr<Acceptor> acceptor_; // 运行在mainLoop，任务就是监听新连接事件
 
@@ -32,34 +35,62 @@ static EventLoop *CheckLoopNotNull(EventLoop *loop)
     ThreadInitCallback threadInitCallback_; // loop线程初始化的回调
 
     std::atomic_int started_;
+    DrainMode drainMode_;
 
-    int nextConnId_;
-    ConnectionMap connections_; // 保存所有的连接
+    uint64_t nextConnId_;
+    std::unordered_map<EventLoop *, ConnectionShardPtr> shards_; // subloop => 连接表，只在baseLoop中访问
+
+    MetricCounter accepted_; // 只在baseLoop中修改
+    std::mutex metricsMutex_;
+    std::vector<ConnectionMetricsPtr> metrics_; // 每个用过的subloop一份
+    int metricsId_;
 */
 TcpServer::TcpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg, Option option)
-    : loop_(CheckLoopNotNull(loop)), ipPort_(listenAddr.toIpPort()), name_(nameArg), acceptor_(new Acceptor(loop_, listenAddr, option == kReusePort)), threadPool_(std::make_shared<EventLoopThreadPool>(loop, name_)), connectionCallback_(), messageCallback_(), nextConnId_(1), started_(0)
+    : loop_(CheckLoopNotNull(loop)), ipPort_(listenAddr.toIpPort()), name_(nameArg), connNamePrefix_(std::make_shared<const std::string>(nameArg + "-" + ipPort_ + "#")), acceptor_(new Acceptor(loop_, listenAddr, option == kReusePort)), threadPool_(std::make_shared<EventLoopThreadPool>(loop, name_)), connectionCallback_(), messageCallback_(), nextConnId_(1), started_(0), drainMode_(kGracefulClose), drainTimeout_(30.0), receiveTimestamping_(false), metricsId_(0)
 {
-    // 当有新用户连接时，会执行TcpServer::newConnection回调
-    acceptor_->setNewConnectionCallback(
-        std::bind(&TcpServer::newConnection, this, std::placeholders::_1, std::placeholders::_2));
+    // 当有新用户连接时，会执行TcpServer::newConnections回调
+    acceptor_->setNewConnectionBatchCallback(
+        std::bind(&TcpServer::newConnections, this, std::placeholders::_1));
+    metricsId_ = MetricsRegistry::instance().addCollector(
+        std::bind(&TcpServer::collectMetrics, this, std::placeholders::_1));
 }
 
 TcpServer::~TcpServer()
 {
-    // 销毁所有连接
-    for (auto item : connections_)
+    MetricsRegistry::instance().removeCollector(metricsId_);
+    // 销毁所有连接，每个连接表交给它所属的subloop处理
+    for (auto &item : shards_)
     {
-        TcpConnectionPtr conn(item.second);
-        item.second.reset();
-
-        conn->getLoop()->runInLoop(
-            std::bind(&TcpConnection::connectionDestroyed, conn));
+        ConnectionShardPtr shard = item.second;
+        shard->loop->runInLoop([shard]() {
+            ConnectionMap connections;
+            connections.swap(shard->connections);
+            shard->loop->addActiveConnection(-static_cast<int>(connections.size()));
+            shard->metrics->connections.add(-static_cast<int64_t>(connections.size()));
+            shard->metrics->closed.add(connections.size());
+            for (auto &conn : connections)
+            {
+                conn.second->connectionDestroyed();
+            }
+        });
     }
 }
 
 void TcpServer::setThreadNum(int numThreads)
 {
-    threadPool_->setThreadNum(numThreads);
+    if (started_ == 0)
+    {
+        threadPool_->setThreadNum(numThreads);
+    }
+    else
+    {
+        loop_->runInLoop(std::bind(&EventLoopThreadPool::resize, threadPool_.get(), numThreads));
+    }
+}
+
+void TcpServer::setLoadBalancePolicy(LoadBalancer::Policy policy)
+{
+    loop_->runInLoop(std::bind(&EventLoopThreadPool::setLoadBalancePolicy, threadPool_.get(), policy));
 }
 
 // 开启服务器监听   loop.loop()
@@ -67,69 +98,257 @@ void TcpServer::start()
 {
     if (started_++ == 0) // 防止一个TcpServer对象被start多次
     {
+        threadPool_->setLoopRetireCallback(std::bind(&TcpServer::retireLoop, this, std::placeholders::_1));
         threadPool_->start(threadInitCallback_);
+        for (EventLoop *ioLoop : threadPool_->getAllLoops())
+        {
+            shardOf(ioLoop);
+        }
         loop_->runInLoop(
             std::bind(&Acceptor::listen, acceptor_.get()));
     }
 }
 
-// 有一个新的客户端的连接，acceptor会执行这个回调操作
-void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
+// 有新的客户端的连接，acceptor会执行这个回调操作，一次可读事件accept到的连接一起传进来
+void TcpServer::newConnections(const Acceptor::NewConnectionList &newConns)
 {
-    // 轮询算法，选择一个subLoop，来管理channel
-    EventLoop *ioLoop = threadPool_->getNextLoop();
-    char buf[64] = {0};
-    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
-    std::string connName = name_ + buf;
-
-    LOG_DEBUG("TcpServer::newConnection [%s] - new connection [%s] from %s \n",
-              name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
-
-    // 通过sockfd获取其绑定的本机的ip地址和端口信息
-    sockaddr_in local;
-    ::bzero(&local, sizeof local);
-    socklen_t addrlen = sizeof local;
-    if (::getsockname(sockfd, (sockaddr*)&local, &addrlen) < 0)
+    // 按subLoop分组，每个subLoop只投递一次，只唤醒一次
+    std::vector<std::pair<ConnectionShardPtr, std::vector<PendingConnection>>> batches;
+    accepted_.add(newConns.size());
+    for (auto &item : newConns)
     {
-        LOG_ERROR("get local address failed!\n");
+        // 按负载均衡策略（默认轮询），选择一个subLoop，来管理channel
+        EventLoop *ioLoop = threadPool_->getNextLoop(item.second);
+        ioLoop->addActiveConnection(1); // 立即计入，同一批次的后续连接能看到
+        const ConnectionShardPtr &shard = shardOf(ioLoop);
+
+        auto batch = std::find_if(batches.begin(), batches.end(),
+            [&shard](const std::pair<ConnectionShardPtr, std::vector<PendingConnection>> &b) { return b.first == shard; });
+        if (batch == batches.end())
+        {
+            batches.emplace_back(shard, std::vector<PendingConnection>());
+            batch = batches.end() - 1;
+        }
+        batch->second.push_back(PendingConnection{item.first, nextConnId_++, item.second});
+    }
+
+    for (auto &batch : batches)
+    {
+        ConnectionShardPtr shard = batch.first;
+        shard->loop->runInLoop([this, shard, pending = std::move(batch.second)]() {
+            establishConnections(shard, pending);
+        });
     }
-    InetAddress localAddr(local);
-
-    // 根据连接成功的sockfd，创建TcpConnection连接对象
-    TcpConnectionPtr conn(new TcpConnection(
-        ioLoop,
-        connName,
-        sockfd,
-        localAddr,
-        peerAddr));
-    connections_[connName] = conn;
-
-    // 下面的回调都是用户设置给TcpServer=>TcpConnection=>Channel=>Poller=>notify channel调用回调
-    conn->setConnectionCallback(connectionCallback_);
-    conn->setMessageCallback(messageCallback_);
-    conn->setWriteCompleteCallback(writeCompleteCallback_);
-
-    // 设置了如何关闭连接的回调   conn->shutDown()
-    conn->setCloseCallback(
-        std::bind(&TcpServer::removeConnection, this, std::placeholders::_1));
-
-    // 直接调用TcpConnection::connectEstablished
-    ioLoop->runInLoop(std::bind(&TcpConnection::connectionEstablished, conn));
 }
 
-void TcpServer::removeConnection(const TcpConnectionPtr &conn)
+// 在subloop中执行：TcpConnection从subloop自己的内存池分配（绑核时即本地NUMA节点），然后登记并建立连接
+void TcpServer::establishConnections(const ConnectionShardPtr &shard, const std::vector<PendingConnection> &pending)
 {
-    loop_->runInLoop(
-        std::bind(&TcpServer::removeConnectionInLoop, this, conn));
+    EventLoop *ioLoop = shard->loop;
+    for (const PendingConnection &p : pending)
+    {
+        LOG_DEBUG("TcpServer::newConnection [%s] - new connection [#%llu] from %s \n",
+                  name_.c_str(), (unsigned long long)p.id, p.peerAddr.toIpPort().c_str());
+
+        // 根据连接成功的sockfd，创建TcpConnection连接对象
+        // 连接名和本端地址都延迟到使用时才生成，对象本身（包括控制块、Socket、Channel）一次分配
+        TcpConnectionPtr conn = std::allocate_shared<TcpConnection>(
+            PoolAllocator<TcpConnection>(ioLoop->memoryPool()),
+            ioLoop,
+            p.id,
+            connNamePrefix_,
+            p.sockfd,
+            p.peerAddr);
+
+        // 下面的回调都是用户设置给TcpServer=>TcpConnection=>Channel=>Poller=>notify channel调用回调
+        // 回调需要在start()之前设置好，之后只读
+        conn->setConnectionCallback(connectionCallback_);
+        conn->setMessageCallback(messageCallback_);
+        conn->setWriteCompleteCallback(writeCompleteCallback_);
+        conn->setMetrics(shard->metrics);
+        if (receiveTimestamping_)
+        {
+            conn->setReceiveTimestamping(true);
+        }
+
+        // 设置了如何关闭连接的回调   conn->shutDown()
+        conn->setCloseCallback(
+            std::bind(&TcpServer::removeConnection, this, shard.get(), std::placeholders::_1));
+
+        shard->connections[conn->id()] = conn;
+        shard->metrics->connections.add();
+        conn->connectionEstablished();
+    }
 }
 
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
+// 在连接所属的subloop中执行，不再经过baseLoop
+void TcpServer::removeConnection(ConnectionShard *shard, const TcpConnectionPtr &conn)
 {
-    LOG_DEBUG("TcpServer::removeConnectionInLoop [%s] - connection %s\n",
-              name_.c_str(), conn->name().c_str());
+    LOG_DEBUG("TcpServer::removeConnection [%s] - connection #%llu\n",
+              name_.c_str(), (unsigned long long)conn->id());
 
-    connections_.erase(conn->name());
+    if (shard->connections.erase(conn->id()) > 0)
+    {
+        shard->loop->addActiveConnection(-1);
+        shard->metrics->connections.add(-1);
+        shard->metrics->closed.add();
+    }
     conn->getLoop()->queueInLoop(
         std::bind(&TcpConnection::connectionDestroyed, conn));
+
+    if (shard->retiring && shard->connections.empty())
+    {
+        if (shard->drainTimer)
+        {
+            shard->loop->cancel(shard->drainTimer);
+            shard->drainTimer = 0;
+        }
+        // 排在connectionDestroyed之后，保证loop退出前连接已经销毁
+        shard->loop->queueInLoop(std::bind(&TcpServer::notifyLoopRetired, this, shard));
+    }
+}
+
+// 只在baseLoop中访问shards_
+const TcpServer::ConnectionShardPtr &TcpServer::shardOf(EventLoop *ioLoop)
+{
+    ConnectionShardPtr &shard = shards_[ioLoop];
+    if (!shard)
+    {
+        ConnectionMetricsPtr metrics = std::make_shared<ConnectionMetrics>(ioLoop->threadId());
+        {
+            std::lock_guard<std::mutex> lock(metricsMutex_);
+            metrics_.push_back(metrics);
+        }
+        shard = std::make_shared<ConnectionShard>(ioLoop, metrics);
+    }
+    return shard;
+}
+
+// 线程池缩容时在baseLoop中回调，此时ioLoop已经不会再分到新连接
+// 暂不支持把连接迁移到其它loop，按drainMode_关闭ioLoop上的所有连接，关闭完以后回收loop线程
+void TcpServer::retireLoop(EventLoop *ioLoop)
+{
+    auto it = shards_.find(ioLoop);
+    if (it == shards_.end())
+    {
+        loopRetired(ioLoop);
+        return;
+    }
+    ConnectionShardPtr shard = it->second; // 回收完成之前保留在shards_中，广播和析构仍然能覆盖这些连接
+
+    bool force = drainMode_ == kForceClose;
+    double timeout = drainTimeout_;
+    ioLoop->runInLoop([this, shard, force, timeout]() {
+        LOG_INFO("TcpServer [%s] - retiring loop %p with %d connections\n",
+                 name_.c_str(), shard->loop, (int)shard->connections.size());
+        shard->retiring = true;
+        if (shard->connections.empty())
+        {
+            notifyLoopRetired(shard.get());
+            return;
+        }
+
+        std::vector<TcpConnectionPtr> conns;
+        conns.reserve(shard->connections.size());
+        for (auto &conn : shard->connections)
+        {
+            conns.push_back(conn.second);
+        }
+        for (auto &conn : conns)
+        {
+            if (force)
+            {
+                conn->forceClose();
+            }
+            else
+            {
+                conn->shutdown();
+            }
+        }
+
+        // 对端一直不关闭时loop无法回收，到期后强制关闭剩下的连接
+        if (!force && timeout > 0 && !shard->connections.empty())
+        {
+            shard->drainTimer = shard->loop->runAfter(timeout, [this, shard]() {
+                ConnectionShard *s = shard.get();
+                s->drainTimer = 0;
+                LOG_INFO("TcpServer [%s] - drain timeout on loop %p, force closing %d connections\n",
+                         name_.c_str(), s->loop, (int)s->connections.size());
+                std::vector<TcpConnectionPtr> rest;
+                rest.reserve(s->connections.size());
+                for (auto &conn : s->connections)
+                {
+                    rest.push_back(conn.second);
+                }
+                for (auto &conn : rest)
+                {
+                    conn->forceClose();
+                }
+            });
+        }
+    });
+}
+
+void TcpServer::notifyLoopRetired(ConnectionShard *shard)
+{
+    loop_->queueInLoop(std::bind(&TcpServer::loopRetired, this, shard->loop));
+}
+
+// 在baseLoop中调用，ioLoop上已经没有连接，回调以后回收loop线程
+void TcpServer::loopRetired(EventLoop *ioLoop)
+{
+    if (loopRetiredCallback_)
+    {
+        loopRetiredCallback_(ioLoop);
+    }
+    shards_.erase(ioLoop);
+    threadPool_->retireDone(ioLoop);
+}
+
+void TcpServer::forEachConnection(const ConnectionCallback &cb)
+{
+    loop_->runInLoop([this, cb]() {
+        for (auto &item : shards_)
+        {
+            ConnectionShardPtr shard = item.second;
+            shard->loop->runInLoop([shard, cb]() {
+                // cb中可能关闭连接并修改连接表，先取一份快照
+                std::vector<TcpConnectionPtr> conns;
+                conns.reserve(shard->connections.size());
+                for (auto &conn : shard->connections)
+                {
+                    conns.push_back(conn.second);
+                }
+                for (auto &conn : conns)
+                {
+                    cb(conn);
+                }
+            });
+        }
+    });
+}
+
+// 在scrape的线程中调用，只读取计数器
+void TcpServer::collectMetrics(std::vector<MetricsRegistry::Sample> *out)
+{
+    std::string server = "server=\"" + MetricsRegistry::escapeLabel(name_) + "\"";
+    out->push_back({"mymuduo_server_connections_accepted_total", "Connections accepted by the server.", MetricsRegistry::kCounter, server, accepted_.value()});
+
+    std::lock_guard<std::mutex> lock(metricsMutex_);
+    for (const ConnectionMetricsPtr &m : metrics_)
+    {
+        std::string labels = server + ",loop=\"" + std::to_string(m->loopTid) + "\"";
+        out->push_back({"mymuduo_server_connections_active", "Open connections of the server on the loop.", MetricsRegistry::kGauge, labels, m->connections.value()});
+        out->push_back({"mymuduo_server_connections_closed_total", "Connections of the server closed on the loop.", MetricsRegistry::kCounter, labels, m->closed.value()});
+        out->push_back({"mymuduo_server_read_bytes_total", "Bytes read from connections.", MetricsRegistry::kCounter, labels, m->bytesRead.value()});
+        out->push_back({"mymuduo_server_written_bytes_total", "Bytes written to connections.", MetricsRegistry::kCounter, labels, m->bytesWritten.value()});
+        out->push_back({"mymuduo_server_read_calls_total", "Read system calls on connections.", MetricsRegistry::kCounter, labels, m->readCalls.value()});
+        out->push_back({"mymuduo_server_write_calls_total", "Write system calls on connections.", MetricsRegistry::kCounter, labels, m->writeCalls.value()});
+        out->push_back({"mymuduo_server_read_eagain_total", "Reads that returned EAGAIN.", MetricsRegistry::kCounter, labels, m->readEagain.value()});
+        out->push_back({"mymuduo_server_write_eagain_total", "Writes that returned EAGAIN.", MetricsRegistry::kCounter, labels, m->writeEagain.value()});
+        out->push_back({"mymuduo_server_high_water_mark_total", "Times a connection's pending output crossed the high water mark.", MetricsRegistry::kCounter, labels, m->highWaterMarkHits.value()});
+        out->push_back({"mymuduo_server_output_buffered_bytes", "Bytes waiting in connection output buffers.", MetricsRegistry::kGauge, labels, m->bufferedBytes.value()});
+        out->push_back({"mymuduo_server_receive_delay_microseconds_total", "Time from kernel receive to loop dispatch, summed over timestamped reads.", MetricsRegistry::kCounter, labels, m->receiveDelayUs.value()});
+        out->push_back({"mymuduo_server_receive_delay_samples_total", "Reads that carried a kernel receive timestamp.", MetricsRegistry::kCounter, labels, m->receiveDelaySamples.value()});
+    }
 }
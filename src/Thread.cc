@@ -1,6 +1,8 @@
 #include "Thread.h"
 #include "CurrentThread.h"
+#include "Logger.h"
 
+#include <errno.h>
 #include <semaphore.h>
 
 std::atomic_int Thread::numCreated_{0};
@@ -11,6 +13,7 @@ Thread::Thread(ThreadFunc func, const std::string& name)
     , tid_(0)
     , func_(std::move(func))
     , name_(name)
+    , numaLocal_(false)
 {
     setDefaultName();
 }
@@ -33,6 +36,22 @@ void Thread::start()
     thread_ = std::shared_ptr<std::thread>(new std::thread(
         [&]() {
             tid_ = CurrentThread::tid();
+            if(!cpus_.empty())
+            {
+                if(!CurrentThread::setAffinity(cpus_))
+                {
+                    std::string cpus;
+                    for(int c : cpus_)
+                    {
+                        cpus += (cpus.empty() ? "" : ",") + std::to_string(c);
+                    }
+                    LOG_ERROR("Thread %s: sched_setaffinity(%s) failed errno=%d\n", name_.c_str(), cpus.c_str(), errno);
+                }
+                if(numaLocal_ && !CurrentThread::preferLocalNumaNode())
+                {
+                    LOG_ERROR("Thread %s: set_mempolicy(MPOL_PREFERRED) failed errno=%d\n", name_.c_str(), errno);
+                }
+            }
             sem_post(&sem);
             func_();
         }
@@ -0,0 +1,148 @@
+#include "TimerQueue.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <sys/timerfd.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+static int createTimerfd()
+{
+    int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerfd < 0)
+    {
+        LOG_FATAL("timerfd_create error: %d\n", errno);
+    }
+    return timerfd;
+}
+
+TimerQueue::TimerQueue(EventLoop *loop)
+    : loop_(loop)
+    , timerfd_(createTimerfd())
+    , timerfdChannel_(loop, timerfd_)
+    , nextTimerId_(1)
+{
+    timerfdChannel_.setReadCallback(std::bind(&TimerQueue::handleRead, this));
+    timerfdChannel_.enableReading();
+}
+
+TimerQueue::~TimerQueue()
+{
+    timerfdChannel_.disableAll();
+    timerfdChannel_.remove();
+    ::close(timerfd_);
+}
+
+int64_t TimerQueue::nowUs()
+{
+    timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+TimerId TimerQueue::addTimer(TimerCallback cb, int64_t delayUs, int64_t intervalUs)
+{
+    TimerId timerId = nextTimerId_.fetch_add(1);
+    Timer timer{std::move(cb), nowUs() + (delayUs > 0 ? delayUs : 0), intervalUs};
+    loop_->runInLoop([this, timerId, timer]() {
+        addTimerInLoop(timerId, timer);
+    });
+    return timerId;
+}
+
+void TimerQueue::cancel(TimerId timerId)
+{
+    loop_->runInLoop(std::bind(&TimerQueue::cancelInLoop, this, timerId));
+}
+
+void TimerQueue::addTimerInLoop(TimerId timerId, const Timer &timer)
+{
+    bool earliest = timers_.empty() || timer.expiration < timers_.begin()->first;
+    timers_.insert(std::make_pair(timer.expiration, timerId));
+    timerMap_[timerId] = timer;
+    if (earliest)
+    {
+        resetTimerfd();
+    }
+}
+
+void TimerQueue::cancelInLoop(TimerId timerId)
+{
+    auto it = timerMap_.find(timerId);
+    if (it != timerMap_.end())
+    {
+        timers_.erase(std::make_pair(it->second.expiration, timerId));
+        timerMap_.erase(it);
+    }
+}
+
+void TimerQueue::handleRead()
+{
+    uint64_t howmany;
+    ssize_t n = ::read(timerfd_, &howmany, sizeof howmany);
+    if (n != sizeof howmany)
+    {
+        LOG_ERROR("TimerQueue::handleRead() reads %d bytes instead of 8\n", (int)n);
+    }
+
+    // 先把到期的定时器取出来，回调中可能会添加或取消定时器
+    int64_t now = nowUs();
+    std::vector<TimerId> expired;
+    auto end = timers_.lower_bound(std::make_pair(now + 1, TimerId(0)));
+    for (auto it = timers_.begin(); it != end; ++it)
+    {
+        expired.push_back(it->second);
+    }
+    timers_.erase(timers_.begin(), end);
+
+    for (TimerId timerId : expired)
+    {
+        auto it = timerMap_.find(timerId);
+        if (it == timerMap_.end()) // 已经在前面的回调中被取消
+        {
+            continue;
+        }
+        if (it->second.interval > 0)
+        {
+            TimerCallback cb = it->second.callback;
+            cb();
+            it = timerMap_.find(timerId);
+            if (it != timerMap_.end()) // 回调中没有取消，重新加入
+            {
+                it->second.expiration = now + it->second.interval;
+                timers_.insert(std::make_pair(it->second.expiration, timerId));
+            }
+        }
+        else
+        {
+            TimerCallback cb = std::move(it->second.callback);
+            timerMap_.erase(it);
+            cb();
+        }
+    }
+
+    resetTimerfd();
+}
+
+void TimerQueue::resetTimerfd()
+{
+    itimerspec newValue;
+    ::memset(&newValue, 0, sizeof newValue);
+    if (!timers_.empty())
+    {
+        // it_value全为0会停止timerfd，至少设置1微秒
+        int64_t delayUs = timers_.begin()->first - nowUs();
+        if (delayUs < 1)
+        {
+            delayUs = 1;
+        }
+        newValue.it_value.tv_sec = static_cast<time_t>(delayUs / 1000000);
+        newValue.it_value.tv_nsec = static_cast<long>((delayUs % 1000000) * 1000);
+    }
+    if (::timerfd_settime(timerfd_, 0, &newValue, nullptr) < 0)
+    {
+        LOG_ERROR("timerfd_settime error: %d\n", errno);
+    }
+}
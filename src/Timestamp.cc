@@ -10,22 +10,28 @@ Timestamp::Timestamp(int64_t microsenconds_since_epoch) : microsenconds_since_ep
 {
 }
 
+// 和内核给socket打的接收时间戳同一个时钟（CLOCK_REALTIME），两者可以直接相减
 Timestamp Timestamp::now()
 {
-    return Timestamp(time(nullptr));
+    timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return Timestamp(static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
 }
 
 std::string Timestamp::ToString() const
 {
-    tm* tm_local = localtime(&microsenconds_since_epoch_);
+    time_t seconds = static_cast<time_t>(microsenconds_since_epoch_ / kMicroSecondsPerSecond);
+    tm tm_local;
+    localtime_r(&seconds, &tm_local);
     char buf[128] = {0};
-    snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d",
-        tm_local->tm_year + 1900,
-        tm_local->tm_mon + 1,
-        tm_local->tm_mday,
-        tm_local->tm_hour,
-        tm_local->tm_min,
-        tm_local->tm_sec);
+    snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d.%06d",
+        tm_local.tm_year + 1900,
+        tm_local.tm_mon + 1,
+        tm_local.tm_mday,
+        tm_local.tm_hour,
+        tm_local.tm_min,
+        tm_local.tm_sec,
+        static_cast<int>(microsenconds_since_epoch_ % kMicroSecondsPerSecond));
 
     return buf;
 }
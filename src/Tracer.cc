@@ -0,0 +1,122 @@
+#include "Tracer.h"
+#include "CurrentThread.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <unistd.h>
+
+std::atomic_int Tracer::s_samplePeriod(0);
+__thread bool Tracer::t_sampled = false;
+__thread int Tracer::t_countdown = 0;
+
+Tracer &Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::Ring::snapshot(std::vector<Span> *out) const
+{
+    uint64_t head = head_.load(std::memory_order_acquire);
+    uint64_t begin = std::max(cleared_.load(std::memory_order_relaxed), head > size_ ? head - size_ : 0);
+    size_t old = out->size();
+    for (uint64_t i = begin; i < head; ++i)
+    {
+        out->push_back(spans_[i % size_]);
+    }
+    // 拷贝期间写入方可能已经覆盖了最旧的一部分，这部分丢掉；
+    // 写入方先写spans_[newHead % size_]再发布head，所以newHead - size_这一项也可能正在被改写
+    uint64_t newHead = head_.load(std::memory_order_acquire);
+    if (newHead + 1 > begin + size_)
+    {
+        size_t overwritten = std::min<uint64_t>(newHead + 1 - size_ - begin, head - begin);
+        out->erase(out->begin() + old, out->begin() + old + overwritten);
+    }
+}
+
+Tracer::Ring *Tracer::ring()
+{
+    // 线程退出时标记，下一次dump以后释放
+    struct Holder
+    {
+        RingPtr ring;
+        ~Holder()
+        {
+            if (ring)
+            {
+                ring->retired.store(true, std::memory_order_release);
+            }
+        }
+    };
+    static thread_local Ring *t_ring = nullptr;
+    if (__builtin_expect(t_ring == nullptr, 0))
+    {
+        static thread_local Holder holder;
+        holder.ring = std::make_shared<Ring>(std::max<size_t>(ringSize_.load(std::memory_order_relaxed), 1), CurrentThread::tid());
+        t_ring = holder.ring.get();
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings_.push_back(holder.ring);
+    }
+    return t_ring;
+}
+
+void Tracer::record(const char *name, int64_t startNs, int64_t endNs, int64_t arg)
+{
+    ring()->push(Span{name, startNs, endNs - startNs, arg});
+}
+
+std::string Tracer::dumpJson()
+{
+    std::vector<RingPtr> rings;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings = rings_;
+        rings_.erase(std::remove_if(rings_.begin(), rings_.end(), [](const RingPtr &ring) {
+            return ring->retired.load(std::memory_order_acquire);
+        }), rings_.end());
+    }
+
+    // 完整事件（ph=X），时间单位是微秒
+    std::string out("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    int pid = static_cast<int>(::getpid());
+    bool first = true;
+    char buf[256];
+    std::vector<Span> spans;
+    for (const RingPtr &ring : rings)
+    {
+        spans.clear();
+        ring->snapshot(&spans);
+        for (const Span &span : spans)
+        {
+            snprintf(buf, sizeof buf,
+                     "%s\n{\"name\":\"%s\",\"cat\":\"mymuduo\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"arg\":%lld}}",
+                     first ? "" : ",", span.name, span.startNs / 1000.0, span.durationNs / 1000.0,
+                     pid, ring->tid(), static_cast<long long>(span.arg));
+            out += buf;
+            first = false;
+        }
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+bool Tracer::dump(const std::string &path)
+{
+    std::string json = dumpJson();
+    FILE *fp = ::fopen(path.c_str(), "w");
+    if (fp == nullptr)
+    {
+        return false;
+    }
+    bool ok = ::fwrite(json.data(), 1, json.size(), fp) == json.size();
+    return ::fclose(fp) == 0 && ok;
+}
+
+void Tracer::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const RingPtr &ring : rings_)
+    {
+        ring->clear();
+    }
+}
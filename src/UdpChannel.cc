@@ -0,0 +1,333 @@
+#include "UdpChannel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <netinet/udp.h>
+
+// 老版本的glibc头文件中没有这两个选项
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+namespace
+{
+    int createNonblockingUdp()
+    {
+        int sockfd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (sockfd < 0)
+        {
+            LOG_FATAL("%s:%s:%d udp socket create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+        }
+        return sockfd;
+    }
+
+    // GRO上报的gso_size是int，UDP_SEGMENT是uint16_t，按大的分配
+    const size_t kControlSpace = CMSG_SPACE(sizeof(int));
+    // 一次读事件最多收这么多批，避免一个socket饿死loop上的其它事件
+    const int kMaxBatchesPerRead = 8;
+    // 单个UDP数据报的最大payload
+    const size_t kMaxUdpPayload = 65507;
+}
+
+// std::max按引用取参数，需要定义
+const size_t UdpChannel::kGroBufferSize;
+
+UdpChannel::UdpChannel(EventLoop *loop, const InetAddress &bindAddr, bool reusePort)
+    : loop_(loop)
+    , socket_(createNonblockingUdp())
+    , channel_(loop, socket_.fd())
+    , gro_(false)
+    , gso_(false)
+    , inRead_(false)
+    , corked_(false)
+    , batchSize_(kDefaultBatchSize)
+    , bufferSize_(kDefaultBufferSize)
+    , receivedDatagrams_(0)
+    , receiveCalls_(0)
+    , sentDatagrams_(0)
+    , sendCalls_(0)
+    , droppedDatagrams_(0)
+{
+    socket_.setReuseAddr(true);
+    socket_.setReusePort(reusePort);
+    socket_.bindAddress(bindAddr);
+
+    // 能读取UDP_SEGMENT说明内核支持GSO（4.18以上）
+    int segment = 0;
+    socklen_t len = sizeof segment;
+    gso_ = ::getsockopt(socket_.fd(), SOL_UDP, UDP_SEGMENT, &segment, &len) == 0;
+
+    channel_.setReadCallback(std::bind(&UdpChannel::handleRead, this, std::placeholders::_1));
+}
+
+UdpChannel::~UdpChannel()
+{
+    flush();
+    channel_.disableAll();
+    channel_.remove();
+}
+
+InetAddress UdpChannel::localAddress() const
+{
+    InetAddress addr;
+    socket_.getLocalAddr(&addr);
+    return addr;
+}
+
+void UdpChannel::setBatch(int batchSize, size_t bufferSize)
+{
+    batchSize_ = batchSize > 0 ? batchSize : 1;
+    bufferSize_ = gro_ ? std::max(bufferSize, kGroBufferSize) : bufferSize;
+}
+
+bool UdpChannel::enableGro()
+{
+    int on = 1;
+    if (::setsockopt(socket_.fd(), SOL_UDP, UDP_GRO, &on, sizeof on) < 0)
+    {
+        LOG_ERROR("UdpChannel fd=%d UDP_GRO not supported, errno=%d\n", socket_.fd(), errno);
+        return false;
+    }
+    gro_ = true;
+    bufferSize_ = std::max(bufferSize_, kGroBufferSize);
+    return true;
+}
+
+void UdpChannel::start()
+{
+    // 接收用的数组只分配一次，每次recvmmsg只需要重置长度字段
+    recvBuffer_.resize(batchSize_ * bufferSize_);
+    recvMsgs_.resize(batchSize_);
+    recvIovs_.resize(batchSize_);
+    recvAddrs_.resize(batchSize_);
+    recvControl_.resize(gro_ ? batchSize_ * kControlSpace : 0);
+    for (int i = 0; i < batchSize_; ++i)
+    {
+        recvIovs_[i].iov_base = &recvBuffer_[i * bufferSize_];
+        recvIovs_[i].iov_len = bufferSize_;
+        msghdr &hdr = recvMsgs_[i].msg_hdr;
+        ::memset(&hdr, 0, sizeof hdr);
+        hdr.msg_name = &recvAddrs_[i];
+        hdr.msg_iov = &recvIovs_[i];
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = gro_ ? &recvControl_[i * kControlSpace] : nullptr;
+    }
+    loop_->runInLoop([this]() { channel_.enableReading(); });
+}
+
+void UdpChannel::handleRead(Timestamp receiveTime)
+{
+    inRead_ = true;
+    for (int round = 0; round < kMaxBatchesPerRead; ++round)
+    {
+        for (int i = 0; i < batchSize_; ++i)
+        {
+            recvMsgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            recvMsgs_[i].msg_hdr.msg_controllen = gro_ ? kControlSpace : 0;
+            recvMsgs_[i].msg_hdr.msg_flags = 0;
+        }
+        int n = ::recvmmsg(socket_.fd(), recvMsgs_.data(), batchSize_, MSG_DONTWAIT, nullptr);
+        if (n <= 0)
+        {
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                LOG_ERROR("UdpChannel::handleRead fd=%d recvmmsg errno=%d\n", socket_.fd(), errno);
+            }
+            break;
+        }
+        receiveCalls_.fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t datagrams = 0;
+        uint64_t truncated = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            const msghdr &hdr = recvMsgs_[i].msg_hdr;
+            if (hdr.msg_flags & MSG_TRUNC)
+            {
+                ++truncated;
+                continue;
+            }
+            const char *data = &recvBuffer_[i * bufferSize_];
+            size_t len = recvMsgs_[i].msg_len;
+            size_t segment = len;
+            if (gro_)
+            {
+                for (cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(const_cast<msghdr *>(&hdr), cmsg))
+                {
+                    if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+                    {
+                        int gsoSize;
+                        ::memcpy(&gsoSize, CMSG_DATA(cmsg), sizeof gsoSize);
+                        segment = gsoSize > 0 ? gsoSize : len;
+                    }
+                }
+            }
+
+            InetAddress peer(recvAddrs_[i]);
+            size_t offset = 0;
+            do // 空数据报也要回调一次
+            {
+                size_t size = std::min(segment, len - offset);
+                if (messageCallback_)
+                {
+                    messageCallback_(this, data + offset, size, peer, receiveTime);
+                }
+                offset += size;
+                ++datagrams;
+            } while (offset < len);
+        }
+        receivedDatagrams_.fetch_add(datagrams, std::memory_order_relaxed);
+        if (truncated > 0)
+        {
+            droppedDatagrams_.fetch_add(truncated, std::memory_order_relaxed);
+        }
+        if (n < batchSize_)
+        {
+            break;
+        }
+    }
+    inRead_ = false;
+    flush();
+}
+
+void UdpChannel::send(const InetAddress &peer, const char *data, size_t len)
+{
+    enqueue(*peer.getSockAddr(), data, len, 0);
+}
+
+void UdpChannel::sendSegments(const InetAddress &peer, const char *data, size_t len, size_t segmentSize)
+{
+    if (segmentSize == 0 || segmentSize > kMaxUdpPayload)
+    {
+        segmentSize = std::min(len, kMaxUdpPayload);
+    }
+    // 一个GSO消息最多kMaxGsoSegments段，总长不超过一个数据报的最大长度
+    size_t perMessage = gso_ ? std::min<size_t>(kMaxGsoSegments, kMaxUdpPayload / segmentSize) * segmentSize : segmentSize;
+    size_t offset = 0;
+    do
+    {
+        size_t chunk = std::min(perMessage, len - offset);
+        enqueue(*peer.getSockAddr(), data + offset, chunk, chunk > segmentSize ? static_cast<uint16_t>(segmentSize) : 0);
+        offset += chunk;
+    } while (offset < len);
+}
+
+void UdpChannel::enqueue(const sockaddr_in &peer, const char *data, size_t len, uint16_t segment)
+{
+    // 只记录偏移量，sendArena_扩容不影响已经放进来的数据
+    pending_.push_back(PendingMessage{peer, sendArena_.size(), len, segment});
+    sendArena_.append(data, len);
+    if ((!inRead_ && !corked_) || pending_.size() >= kMaxPendingMessages)
+    {
+        flush();
+    }
+}
+
+void UdpChannel::flush()
+{
+    size_t n = pending_.size();
+    if (n == 0)
+    {
+        return;
+    }
+
+    sendMsgs_.resize(n);
+    sendIovs_.resize(n);
+    sendControl_.assign(n * kControlSpace, 0);
+    for (size_t i = 0; i < n; ++i)
+    {
+        PendingMessage &msg = pending_[i];
+        sendIovs_[i].iov_base = &sendArena_[msg.offset];
+        sendIovs_[i].iov_len = msg.len;
+        msghdr &hdr = sendMsgs_[i].msg_hdr;
+        ::memset(&hdr, 0, sizeof hdr);
+        hdr.msg_name = &msg.peer;
+        hdr.msg_namelen = sizeof msg.peer;
+        hdr.msg_iov = &sendIovs_[i];
+        hdr.msg_iovlen = 1;
+        if (msg.segment > 0)
+        {
+            hdr.msg_control = &sendControl_[i * kControlSpace];
+            hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+            cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            ::memcpy(CMSG_DATA(cmsg), &msg.segment, sizeof msg.segment);
+        }
+    }
+
+    auto datagramsOf = [](const PendingMessage &msg) -> uint64_t {
+        return msg.segment > 0 ? (msg.len + msg.segment - 1) / msg.segment : 1;
+    };
+
+    size_t sent = 0;
+    while (sent < n)
+    {
+        int r = ::sendmmsg(socket_.fd(), &sendMsgs_[sent], static_cast<unsigned>(n - sent), MSG_DONTWAIT);
+        sendCalls_.fetch_add(1, std::memory_order_relaxed);
+        if (r > 0)
+        {
+            uint64_t datagrams = 0;
+            for (size_t i = sent; i < sent + r; ++i)
+            {
+                datagrams += datagramsOf(pending_[i]);
+            }
+            sentDatagrams_.fetch_add(datagrams, std::memory_order_relaxed);
+            sent += r;
+            continue;
+        }
+        if (r < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (r < 0 && (errno == EIO || errno == EINVAL) && pending_[sent].segment > 0)
+        {
+            LOG_ERROR("UdpChannel fd=%d UDP_SEGMENT rejected, errno=%d, fall back to plain datagrams\n", socket_.fd(), errno);
+            gso_ = false;
+            sendSegmentsOneByOne(pending_[sent]);
+            ++sent;
+            continue;
+        }
+        // 发送缓冲区满或者其它错误：UDP本来就不保证送达，丢弃剩下的数据报，不阻塞loop
+        if (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            LOG_ERROR("UdpChannel::flush fd=%d sendmmsg errno=%d\n", socket_.fd(), errno);
+        }
+        uint64_t dropped = 0;
+        for (size_t i = sent; i < n; ++i)
+        {
+            dropped += datagramsOf(pending_[i]);
+        }
+        droppedDatagrams_.fetch_add(dropped, std::memory_order_relaxed);
+        break;
+    }
+
+    pending_.clear();
+    sendArena_.clear();
+}
+
+void UdpChannel::sendSegmentsOneByOne(const PendingMessage &msg)
+{
+    for (size_t offset = 0; offset < msg.len; offset += msg.segment)
+    {
+        size_t len = std::min<size_t>(msg.segment, msg.len - offset);
+        ssize_t n = ::sendto(socket_.fd(), &sendArena_[msg.offset + offset], len, MSG_DONTWAIT,
+                             reinterpret_cast<const sockaddr *>(&msg.peer), sizeof msg.peer);
+        sendCalls_.fetch_add(1, std::memory_order_relaxed);
+        if (n < 0)
+        {
+            droppedDatagrams_.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            sentDatagrams_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Logger.h"
+
+#include <future>
+
+UdpServer::UdpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg)
+    : loop_(loop)
+    , listenAddr_(listenAddr)
+    , ipPort_(listenAddr.toIpPort())
+    , name_(nameArg)
+    , threadPool_(std::make_shared<EventLoopThreadPool>(loop, nameArg))
+    , batchSize_(UdpChannel::kDefaultBatchSize)
+    , bufferSize_(UdpChannel::kDefaultBufferSize)
+    , gro_(false)
+    , started_(false)
+{
+    if (loop_ == nullptr)
+    {
+        LOG_FATAL("%s:%s:%d mainLoop is null! \n", __FILE__, __FUNCTION__, __LINE__);
+    }
+}
+
+UdpServer::~UdpServer()
+{
+    // channel要在所属loop中注销，等它完成以后线程池才能退出这些loop
+    for (UdpChannel *channel : channels_)
+    {
+        EventLoop *ioLoop = channel->getLoop();
+        if (ioLoop->isInLoopThread())
+        {
+            delete channel;
+            continue;
+        }
+        std::promise<void> done;
+        ioLoop->runInLoop([channel, &done]() {
+            delete channel;
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+}
+
+void UdpServer::setThreadNum(int numThreads)
+{
+    threadPool_->setThreadNum(numThreads);
+}
+
+void UdpServer::start()
+{
+    if (started_)
+    {
+        return;
+    }
+    started_ = true;
+    threadPool_->start(threadInitCallback_);
+
+    std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+    // 只有一个socket时不需要SO_REUSEPORT，避免和其它进程误共享端口
+    bool reusePort = loops.size() > 1;
+    for (EventLoop *ioLoop : loops)
+    {
+        UdpChannel *channel = new UdpChannel(ioLoop, listenAddr_, reusePort);
+        if (gro_)
+        {
+            channel->enableGro();
+        }
+        channel->setBatch(batchSize_, bufferSize_);
+        channel->setMessageCallback(messageCallback_);
+        channel->start();
+        channels_.push_back(channel);
+    }
+    LOG_INFO("UdpServer [%s] started at %s with %zu sockets\n", name_.c_str(), ipPort_.c_str(), channels_.size());
+}
+
+uint64_t UdpServer::receivedDatagrams() const
+{
+    uint64_t n = 0;
+    for (UdpChannel *channel : channels_)
+    {
+        n += channel->receivedDatagrams();
+    }
+    return n;
+}
+
+uint64_t UdpServer::receiveCalls() const
+{
+    uint64_t n = 0;
+    for (UdpChannel *channel : channels_)
+    {
+        n += channel->receiveCalls();
+    }
+    return n;
+}
+
+uint64_t UdpServer::droppedDatagrams() const
+{
+    uint64_t n = 0;
+    for (UdpChannel *channel : channels_)
+    {
+        n += channel->droppedDatagrams();
+    }
+    return n;
+}
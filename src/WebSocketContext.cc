@@ -0,0 +1,205 @@
+#include "WebSocketContext.h"
+#include "WebSocketKernels.h"
+#include "PerMessageDeflate.h"
+#include "Buffer.h"
+
+#include <endian.h>
+#include <string.h>
+
+WebSocketContext::WebSocketContext(size_t maxMessageSize, bool deflate)
+    : maxMessageSize_(maxMessageSize)
+    , deflate_(deflate)
+    , frameLen_(0)
+    , fragmented_(false)
+    , compressed_(false)
+    , messageOpcode_(kText)
+    , opcode_(kText)
+    , errorCode_(kNormalClosure)
+{
+}
+
+WebSocketContext::ParseResult WebSocketContext::fail(CloseCode code)
+{
+    errorCode_ = code;
+    return kError;
+}
+
+WebSocketContext::ParseResult WebSocketContext::parse(Buffer *buf)
+{
+    ParseResult result;
+    // 非结束的分片在parseFrame中拼接并取走，继续解析下一帧
+    while ((result = parseFrame(buf)) == kFragment)
+    {
+    }
+    return result;
+}
+
+WebSocketContext::ParseResult WebSocketContext::parseFrame(Buffer *buf)
+{
+    size_t readable = buf->readableBytes();
+    if (readable < 2)
+    {
+        return kIncomplete;
+    }
+
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(buf->peek());
+    bool fin = p[0] & 0x80;
+    bool rsv1 = p[0] & 0x40;
+    Opcode opcode = static_cast<Opcode>(p[0] & 0x0f);
+    bool masked = p[1] & 0x80;
+    uint64_t len = p[1] & 0x7f;
+
+    size_t headerLen = 2;
+    if (len == 126)
+    {
+        if (readable < 4)
+        {
+            return kIncomplete;
+        }
+        uint16_t be16;
+        ::memcpy(&be16, p + 2, 2);
+        len = be16toh(be16);
+        headerLen = 4;
+    }
+    else if (len == 127)
+    {
+        if (readable < 10)
+        {
+            return kIncomplete;
+        }
+        uint64_t be64;
+        ::memcpy(&be64, p + 2, 8);
+        len = be64toh(be64);
+        headerLen = 10;
+    }
+
+    // 客户端发来的帧必须加掩码
+    if (!masked || (p[0] & 0x30))
+    {
+        return fail(kProtocolError);
+    }
+    bool control = opcode & 0x8;
+    if (control)
+    {
+        if (!fin || len > 125 || rsv1 || (opcode != kClose && opcode != kPing && opcode != kPong))
+        {
+            return fail(kProtocolError);
+        }
+    }
+    else
+    {
+        if (opcode != kContinuation && opcode != kText && opcode != kBinary)
+        {
+            return fail(kProtocolError);
+        }
+        // RSV1只能出现在协商了压缩的消息的第一帧
+        if (rsv1 && (!deflate_ || opcode == kContinuation))
+        {
+            return fail(kProtocolError);
+        }
+        if ((opcode == kContinuation) != fragmented_)
+        {
+            return fail(kProtocolError);
+        }
+        // 只看帧头就拒绝超大的消息，不等数据缓存下来
+        if (len > maxMessageSize_ || message_.size() + len > maxMessageSize_)
+        {
+            return fail(kMessageTooBig);
+        }
+    }
+
+    headerLen += 4; // 掩码
+    if (readable < headerLen + len)
+    {
+        return kIncomplete;
+    }
+
+    char *payload = buf->mutablePeek() + headerLen;
+    WebSocketKernels::unmask(payload, len, buf->peek() + headerLen - 4);
+    frameLen_ = headerLen + len;
+
+    if (control)
+    {
+        opcode_ = opcode;
+        payload_ = std::string_view(payload, len);
+        return kControl;
+    }
+
+    if (opcode != kContinuation)
+    {
+        messageOpcode_ = opcode;
+        compressed_ = rsv1;
+        if (fin)
+        {
+            return finishMessage(std::string_view(payload, len)); // 没有分片，直接使用buffer中的数据
+        }
+        fragmented_ = true;
+    }
+    message_.append(payload, len);
+    if (!fin)
+    {
+        buf->retrieve(frameLen_);
+        frameLen_ = 0;
+        return kFragment;
+    }
+    return finishMessage(message_);
+}
+
+WebSocketContext::ParseResult WebSocketContext::finishMessage(std::string_view data)
+{
+    fragmented_ = false;
+    if (compressed_)
+    {
+        inflated_.clear();
+        if (!PerMessageDeflate::decompress(data.data(), data.size(), &inflated_, maxMessageSize_))
+        {
+            return fail(kInvalidPayload);
+        }
+        data = inflated_;
+    }
+    if (messageOpcode_ == kText && !WebSocketKernels::validateUtf8(data.data(), data.size()))
+    {
+        return fail(kInvalidPayload);
+    }
+    opcode_ = messageOpcode_;
+    payload_ = data;
+    return kMessage;
+}
+
+void WebSocketContext::consume(Buffer *buf)
+{
+    buf->retrieve(frameLen_);
+    frameLen_ = 0;
+    if (opcode_ < kClose)
+    {
+        message_.clear(); // 保留容量给下一条分片消息
+    }
+    payload_ = std::string_view();
+}
+
+void WebSocketContext::appendFrame(Buffer *buf, Opcode opcode, const char *data, size_t len, bool compressed)
+{
+    char header[kMaxHeaderLen];
+    size_t headerLen = 2;
+    header[0] = static_cast<char>(0x80 | (compressed ? 0x40 : 0) | opcode);
+    if (len < 126)
+    {
+        header[1] = static_cast<char>(len);
+    }
+    else if (len <= 0xffff)
+    {
+        header[1] = 126;
+        uint16_t be16 = htobe16(static_cast<uint16_t>(len));
+        ::memcpy(header + 2, &be16, 2);
+        headerLen = 4;
+    }
+    else
+    {
+        header[1] = 127;
+        uint64_t be64 = htobe64(len);
+        ::memcpy(header + 2, &be64, 8);
+        headerLen = 10;
+    }
+    buf->append(header, headerLen);
+    buf->append(data, len);
+}
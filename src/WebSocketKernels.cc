@@ -0,0 +1,418 @@
+#include "WebSocketKernels.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    void unmaskScalar(char *data, size_t len, const char mask[4])
+    {
+        uint32_t mask32;
+        ::memcpy(&mask32, mask, 4);
+        uint64_t mask64 = (static_cast<uint64_t>(mask32) << 32) | mask32;
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8)
+        {
+            uint64_t v;
+            ::memcpy(&v, data + i, 8);
+            v ^= mask64;
+            ::memcpy(data + i, &v, 8);
+        }
+        for (; i < len; ++i)
+        {
+            data[i] ^= mask[i & 3];
+        }
+    }
+
+    // 校验p开始的一个UTF-8字符，返回字符长度，非法返回0
+    inline size_t utf8SequenceLength(const unsigned char *p, size_t remaining)
+    {
+        unsigned char c = p[0];
+        if (c < 0x80)
+        {
+            return 1;
+        }
+        size_t len;
+        unsigned char lo = 0x80, hi = 0xbf; // 第二个字节的范围
+        if (c >= 0xc2 && c <= 0xdf)
+        {
+            len = 2;
+        }
+        else if (c >= 0xe0 && c <= 0xef)
+        {
+            len = 3;
+            if (c == 0xe0)
+                lo = 0xa0; // 过长编码
+            else if (c == 0xed)
+                hi = 0x9f; // 代理对
+        }
+        else if (c >= 0xf0 && c <= 0xf4)
+        {
+            len = 4;
+            if (c == 0xf0)
+                lo = 0x90; // 过长编码
+            else if (c == 0xf4)
+                hi = 0x8f; // 超过U+10FFFF
+        }
+        else
+        {
+            return 0;
+        }
+        if (remaining < len || p[1] < lo || p[1] > hi)
+        {
+            return 0;
+        }
+        for (size_t i = 2; i < len; ++i)
+        {
+            if ((p[i] & 0xc0) != 0x80)
+            {
+                return 0;
+            }
+        }
+        return len;
+    }
+
+    // 从i开始校验到至少end为止，返回新的位置，非法返回0并把ok置为false
+    inline size_t validateRange(const unsigned char *p, size_t i, size_t end, size_t len, bool *ok)
+    {
+        while (i < end)
+        {
+            size_t n = utf8SequenceLength(p + i, len - i);
+            if (n == 0)
+            {
+                *ok = false;
+                return 0;
+            }
+            i += n;
+        }
+        return i;
+    }
+
+    bool validateUtf8Scalar(const char *data, size_t len)
+    {
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+        size_t i = 0;
+        bool ok = true;
+        // 每次先用8字节判断是否全是ASCII
+        while (i < len && ok)
+        {
+            if (i + 8 <= len)
+            {
+                uint64_t v;
+                ::memcpy(&v, p + i, 8);
+                if ((v & 0x8080808080808080ULL) == 0)
+                {
+                    i += 8;
+                    continue;
+                }
+            }
+            i = validateRange(p, i, i + 8 < len ? i + 8 : len, len, &ok);
+        }
+        return ok;
+    }
+
+#if defined(__x86_64__)
+    __attribute__((target("sse2")))
+    void unmaskSse2(char *data, size_t len, const char mask[4])
+    {
+        int32_t mask32;
+        ::memcpy(&mask32, mask, 4);
+        __m128i m = _mm_set1_epi32(mask32);
+        size_t i = 0;
+        for (; i + 16 <= len; i += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i), _mm_xor_si128(v, m));
+        }
+        // i是16的倍数，剩余部分的掩码相位不变
+        unmaskScalar(data + i, len - i, mask);
+    }
+
+    __attribute__((target("avx2")))
+    void unmaskAvx2(char *data, size_t len, const char mask[4])
+    {
+        int32_t mask32;
+        ::memcpy(&mask32, mask, 4);
+        __m256i m = _mm256_set1_epi32(mask32);
+        size_t i = 0;
+        for (; i + 64 <= len; i += 64)
+        {
+            __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + 32));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(data + i), _mm256_xor_si256(v0, m));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(data + i + 32), _mm256_xor_si256(v1, m));
+        }
+        for (; i + 32 <= len; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(data + i), _mm256_xor_si256(v, m));
+        }
+        unmaskScalar(data + i, len - i, mask);
+    }
+
+    // 不支持SSSE3的cpu上只用SSE2一次判断16字节是否全是ASCII，遇到多字节字符的块再逐个字符校验
+    __attribute__((target("sse2")))
+    bool validateUtf8Sse2(const char *data, size_t len)
+    {
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+        size_t i = 0;
+        bool ok = true;
+        while (i < len && ok)
+        {
+            if (i + 16 <= len)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+                if (_mm_movemask_epi8(v) == 0)
+                {
+                    i += 16;
+                    continue;
+                }
+            }
+            i = validateRange(p, i, i + 16 < len ? i + 16 : len, len, &ok);
+        }
+        return ok;
+    }
+
+    // 多字节字符很多的文本（中文、emoji）上ASCII快速路径几乎总是失败，
+    // 下面用查表法一次校验整个块：按前一个字节的高/低4位和当前字节的高4位查出三组错误位，
+    // 三者相与不为0就说明这两个字节的组合非法，第3、4个字节是否应该是续字节再单独检查
+    // 参考 Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte"
+    enum Utf8Error
+    {
+        kTooShort = 1 << 0,     // 11______ 0_______ 或 11______ 11______
+        kTooLong = 1 << 1,      // 0_______ 10______
+        kOverlong3 = 1 << 2,    // 11100000 100_____
+        kTooLarge = 1 << 3,     // 11110100 1001____ 或 11110101+
+        kSurrogate = 1 << 4,    // 11101101 101_____
+        kOverlong2 = 1 << 5,    // 1100000_ 10______
+        kTooLarge1000 = 1 << 6, // 11110101+ 1000____
+        kOverlong4 = 1 << 6,    // 11110000 1000____
+        kTwoConts = 1 << 7,     // 10______ 10______
+        kCarry = kTooShort | kTooLong | kTwoConts,
+    };
+
+#define UTF8_BYTE1_HIGH                                                         \
+    kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, \
+        kTwoConts, kTwoConts, kTwoConts, kTwoConts,                                 \
+        kTooShort | kOverlong2,                                                     \
+        kTooShort,                                                                  \
+        kTooShort | kOverlong3 | kSurrogate,                                        \
+        kTooShort | kTooLarge | kTooLarge1000 | kOverlong4
+
+#define UTF8_BYTE1_LOW                                                                   \
+    kCarry | kOverlong3 | kOverlong2 | kOverlong4,                                       \
+        kCarry | kOverlong2,                                                             \
+        kCarry,                                                                          \
+        kCarry,                                                                          \
+        kCarry | kTooLarge,                                                              \
+        kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000,          \
+        kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000,          \
+        kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000,          \
+        kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000,          \
+        kCarry | kTooLarge | kTooLarge1000 | kSurrogate,                                 \
+        kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000
+
+#define UTF8_BYTE2_HIGH                                                                          \
+    kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,      \
+        kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge1000 | kOverlong4,             \
+        kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge,                              \
+        kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,                              \
+        kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,                              \
+        kTooShort, kTooShort, kTooShort, kTooShort
+
+    struct Utf8State128
+    {
+        __m128i prev;
+        __m128i error;
+        __m128i prevIncomplete;
+    };
+
+    __attribute__((target("ssse3")))
+    inline void checkUtf8Block(__m128i v, Utf8State128 *state)
+    {
+        if (_mm_movemask_epi8(v) == 0)
+        {
+            state->error = _mm_or_si128(state->error, state->prevIncomplete);
+            state->prevIncomplete = _mm_setzero_si128();
+        }
+        else
+        {
+            const __m128i nibble = _mm_set1_epi8(0x0f);
+            __m128i prev1 = _mm_alignr_epi8(v, state->prev, 15);
+            __m128i sc = _mm_and_si128(
+                _mm_and_si128(_mm_shuffle_epi8(_mm_setr_epi8(UTF8_BYTE1_HIGH), _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                              _mm_shuffle_epi8(_mm_setr_epi8(UTF8_BYTE1_LOW), _mm_and_si128(prev1, nibble))),
+                _mm_shuffle_epi8(_mm_setr_epi8(UTF8_BYTE2_HIGH), _mm_and_si128(_mm_srli_epi16(v, 4), nibble)));
+            __m128i third = _mm_subs_epu8(_mm_alignr_epi8(v, state->prev, 14), _mm_set1_epi8(0xe0 - 0x80));
+            __m128i fourth = _mm_subs_epu8(_mm_alignr_epi8(v, state->prev, 13), _mm_set1_epi8(0xf0 - 0x80));
+            __m128i must23 = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8(static_cast<char>(0x80)));
+            state->error = _mm_or_si128(state->error, _mm_xor_si128(must23, sc));
+            // 块的最后3个字节如果是多字节字符的首字节，需要下一个块来补全
+            state->prevIncomplete = _mm_subs_epu8(v, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                                  static_cast<char>(0xf0 - 1), static_cast<char>(0xe0 - 1), static_cast<char>(0xc0 - 1)));
+        }
+        state->prev = v;
+    }
+
+    __attribute__((target("ssse3")))
+    bool validateUtf8Ssse3(const char *data, size_t len)
+    {
+        Utf8State128 state = {_mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128()};
+        size_t i = 0;
+        for (; i + 16 <= len; i += 16)
+        {
+            checkUtf8Block(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)), &state);
+        }
+        if (i < len)
+        {
+            // 尾部补0，0是ASCII，不完整的字符会被当作后面跟了ASCII而报错
+            char tail[16] = {0};
+            ::memcpy(tail, data + i, len - i);
+            checkUtf8Block(_mm_loadu_si128(reinterpret_cast<const __m128i *>(tail)), &state);
+        }
+        __m128i error = _mm_or_si128(state.error, state.prevIncomplete);
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xffff;
+    }
+
+    struct Utf8State256
+    {
+        __m256i prev;
+        __m256i error;
+        __m256i prevIncomplete;
+    };
+
+    __attribute__((target("avx2")))
+    inline void checkUtf8Block(__m256i v, Utf8State256 *state)
+    {
+        if (_mm256_movemask_epi8(v) == 0)
+        {
+            state->error = _mm256_or_si256(state->error, state->prevIncomplete);
+            state->prevIncomplete = _mm256_setzero_si256();
+        }
+        else
+        {
+            const __m256i nibble = _mm256_set1_epi8(0x0f);
+            // alignr只在128位的lane内移动，先拼出[prev的高半部分, v的低半部分]
+            __m256i carried = _mm256_permute2x128_si256(state->prev, v, 0x21);
+            __m256i prev1 = _mm256_alignr_epi8(v, carried, 15);
+            __m256i sc = _mm256_and_si256(
+                _mm256_and_si256(_mm256_shuffle_epi8(_mm256_setr_epi8(UTF8_BYTE1_HIGH, UTF8_BYTE1_HIGH),
+                                                     _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                                 _mm256_shuffle_epi8(_mm256_setr_epi8(UTF8_BYTE1_LOW, UTF8_BYTE1_LOW),
+                                                     _mm256_and_si256(prev1, nibble))),
+                _mm256_shuffle_epi8(_mm256_setr_epi8(UTF8_BYTE2_HIGH, UTF8_BYTE2_HIGH),
+                                    _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble)));
+            __m256i third = _mm256_subs_epu8(_mm256_alignr_epi8(v, carried, 14), _mm256_set1_epi8(0xe0 - 0x80));
+            __m256i fourth = _mm256_subs_epu8(_mm256_alignr_epi8(v, carried, 13), _mm256_set1_epi8(0xf0 - 0x80));
+            __m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+            state->error = _mm256_or_si256(state->error, _mm256_xor_si256(must23, sc));
+            state->prevIncomplete = _mm256_subs_epu8(v, _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                                         -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                                         static_cast<char>(0xf0 - 1), static_cast<char>(0xe0 - 1), static_cast<char>(0xc0 - 1)));
+        }
+        state->prev = v;
+    }
+
+    __attribute__((target("avx2")))
+    bool validateUtf8Avx2(const char *data, size_t len)
+    {
+        Utf8State256 state = {_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+        size_t i = 0;
+        for (; i + 32 <= len; i += 32)
+        {
+            checkUtf8Block(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i)), &state);
+        }
+        if (i < len)
+        {
+            char tail[32] = {0};
+            ::memcpy(tail, data + i, len - i);
+            checkUtf8Block(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(tail)), &state);
+        }
+        __m256i error = _mm256_or_si256(state.error, state.prevIncomplete);
+        return _mm256_testz_si256(error, error);
+    }
+
+#undef UTF8_BYTE1_HIGH
+#undef UTF8_BYTE1_LOW
+#undef UTF8_BYTE2_HIGH
+#endif
+
+    WebSocketKernels::Isa chooseIsa()
+    {
+#if defined(__x86_64__)
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return WebSocketKernels::kAvx2;
+        }
+        return WebSocketKernels::kSse2; // x86_64一定支持SSE2
+#else
+        return WebSocketKernels::kScalar;
+#endif
+    }
+}
+
+WebSocketKernels::Isa WebSocketKernels::detectIsa()
+{
+    static const Isa isa = chooseIsa();
+    return isa;
+}
+
+const char *WebSocketKernels::isaName(Isa isa)
+{
+    switch (isa)
+    {
+    case kSse2:
+        return "sse2";
+    case kAvx2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+void WebSocketKernels::unmask(char *data, size_t len, const char mask[4])
+{
+    unmask(data, len, mask, detectIsa());
+}
+
+void WebSocketKernels::unmask(char *data, size_t len, const char mask[4], Isa isa)
+{
+#if defined(__x86_64__)
+    if (isa == kAvx2 && detectIsa() == kAvx2)
+    {
+        unmaskAvx2(data, len, mask);
+        return;
+    }
+    if (isa != kScalar)
+    {
+        unmaskSse2(data, len, mask);
+        return;
+    }
+#endif
+    unmaskScalar(data, len, mask);
+}
+
+bool WebSocketKernels::validateUtf8(const char *data, size_t len)
+{
+    return validateUtf8(data, len, detectIsa());
+}
+
+bool WebSocketKernels::validateUtf8(const char *data, size_t len, Isa isa)
+{
+#if defined(__x86_64__)
+    if (isa == kAvx2 && detectIsa() == kAvx2)
+    {
+        return validateUtf8Avx2(data, len);
+    }
+    if (isa != kScalar)
+    {
+        static const bool ssse3 = __builtin_cpu_supports("ssse3");
+        return ssse3 ? validateUtf8Ssse3(data, len) : validateUtf8Sse2(data, len);
+    }
+#endif
+    return validateUtf8Scalar(data, len);
+}
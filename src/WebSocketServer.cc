@@ -0,0 +1,497 @@
+#include "WebSocketServer.h"
+#include "WebSocketKernels.h"
+#include "PerMessageDeflate.h"
+#include "HttpContext.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <endian.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+// 挂在TcpConnection的context上，用shared_ptr保存，any拷贝时不拷贝解析状态
+struct WebSocketSession
+{
+    explicit WebSocketSession(size_t maxHeaderSize)
+        : upgraded(false), closing(false), http(maxHeaderSize, 0), ws(0, false)
+    {
+    }
+
+    bool upgraded; // 握手已经完成
+    bool closing;  // 已经发送了close帧，之后收到的数据全部丢弃
+    HttpContext http;
+    WebSocketContext ws;
+};
+
+using SessionPtr = std::shared_ptr<WebSocketSession>;
+
+namespace
+{
+    const char kWebSocketGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    // 升级请求只有头部，不需要很大的限制
+    const size_t kMaxHandshakeSize = 8 * 1024;
+
+    // 握手只需要对60字节做一次SHA1，没有必要依赖openssl
+    void sha1(const char *data, size_t len, unsigned char digest[20])
+    {
+        uint32_t h[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+        auto rol = [](uint32_t x, int n) { return (x << n) | (x >> (32 - n)); };
+
+        // 补位：0x80，若干个0，最后8字节是按位计的长度
+        size_t total = ((len + 8) / 64 + 1) * 64;
+        std::string msg(data, len);
+        msg.resize(total, '\0');
+        msg[len] = static_cast<char>(0x80);
+        uint64_t bits = htobe64(static_cast<uint64_t>(len) * 8);
+        ::memcpy(&msg[total - 8], &bits, 8);
+
+        for (size_t offset = 0; offset < total; offset += 64)
+        {
+            uint32_t w[80];
+            for (int i = 0; i < 16; ++i)
+            {
+                uint32_t be;
+                ::memcpy(&be, msg.data() + offset + i * 4, 4);
+                w[i] = be32toh(be);
+            }
+            for (int i = 16; i < 80; ++i)
+            {
+                w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            }
+
+            uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+            for (int i = 0; i < 80; ++i)
+            {
+                uint32_t f, k;
+                if (i < 20)
+                {
+                    f = (b & c) | (~b & d);
+                    k = 0x5a827999;
+                }
+                else if (i < 40)
+                {
+                    f = b ^ c ^ d;
+                    k = 0x6ed9eba1;
+                }
+                else if (i < 60)
+                {
+                    f = (b & c) | (b & d) | (c & d);
+                    k = 0x8f1bbcdc;
+                }
+                else
+                {
+                    f = b ^ c ^ d;
+                    k = 0xca62c1d6;
+                }
+                uint32_t temp = rol(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = rol(b, 30);
+                b = a;
+                a = temp;
+            }
+            h[0] += a;
+            h[1] += b;
+            h[2] += c;
+            h[3] += d;
+            h[4] += e;
+        }
+
+        for (int i = 0; i < 5; ++i)
+        {
+            uint32_t be = htobe32(h[i]);
+            ::memcpy(digest + i * 4, &be, 4);
+        }
+    }
+
+    std::string base64Encode(const unsigned char *data, size_t len)
+    {
+        static const char kTable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string result;
+        result.reserve((len + 2) / 3 * 4);
+        size_t i = 0;
+        for (; i + 2 < len; i += 3)
+        {
+            uint32_t n = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+            result += kTable[(n >> 18) & 63];
+            result += kTable[(n >> 12) & 63];
+            result += kTable[(n >> 6) & 63];
+            result += kTable[n & 63];
+        }
+        if (i < len)
+        {
+            uint32_t n = data[i] << 16;
+            if (i + 1 < len)
+            {
+                n |= data[i + 1] << 8;
+            }
+            result += kTable[(n >> 18) & 63];
+            result += kTable[(n >> 12) & 63];
+            result += i + 1 < len ? kTable[(n >> 6) & 63] : '=';
+            result += '=';
+        }
+        return result;
+    }
+
+    std::string_view trim(std::string_view s)
+    {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+        {
+            s.remove_prefix(1);
+        }
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+        {
+            s.remove_suffix(1);
+        }
+        return s;
+    }
+
+    bool equalsIgnoreCase(std::string_view a, std::string_view b)
+    {
+        return a.size() == b.size() && ::strncasecmp(a.data(), b.data(), a.size()) == 0;
+    }
+
+    // 按sep切分value，对每一段调用f，f返回true时停止
+    template <typename F>
+    bool forEachToken(std::string_view value, char sep, F f)
+    {
+        while (!value.empty())
+        {
+            size_t pos = value.find(sep);
+            std::string_view token = trim(value.substr(0, pos));
+            if (f(token))
+            {
+                return true;
+            }
+            if (pos == std::string_view::npos)
+            {
+                break;
+            }
+            value.remove_prefix(pos + 1);
+        }
+        return false;
+    }
+
+    // Connection: keep-alive, Upgrade这种逗号分隔的列表中是否包含token
+    bool hasToken(std::string_view value, std::string_view token)
+    {
+        return forEachToken(value, ',', [token](std::string_view t) { return equalsIgnoreCase(t, token); });
+    }
+
+    // 客户端的每个permessage-deflate提议都可能带参数，
+    // 我们总是用15位窗口压缩，不能接受server_max_window_bits的提议
+    bool acceptDeflateOffer(std::string_view extensions)
+    {
+        return forEachToken(extensions, ',', [](std::string_view offer) {
+            bool isDeflate = false;
+            bool acceptable = true;
+            bool first = true;
+            forEachToken(offer, ';', [&](std::string_view param) {
+                std::string_view name = param.substr(0, param.find('='));
+                if (first)
+                {
+                    isDeflate = equalsIgnoreCase(trim(name), "permessage-deflate");
+                    first = false;
+                }
+                else if (equalsIgnoreCase(trim(name), "server_max_window_bits"))
+                {
+                    acceptable = false;
+                }
+                return !isDeflate || !acceptable;
+            });
+            return isDeflate && acceptable;
+        });
+    }
+
+    bool validCloseCode(uint16_t code)
+    {
+        return (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1011) || (code >= 3000 && code <= 4999);
+    }
+
+    // 同一个loop线程中的连接轮流使用
+    Buffer &outputBuffer()
+    {
+        static thread_local Buffer output;
+        return output;
+    }
+}
+
+WebSocketServer::WebSocketServer(EventLoop *loop,
+                                 const InetAddress &listenAddr,
+                                 const std::string &name,
+                                 TcpServer::Option option)
+    : maxMessageSize_(kDefaultMaxMessageSize)
+    , compression_(false)
+    , minCompressSize_(256)
+    , server_(loop, listenAddr, name, option)
+{
+    server_.setConnectionCallback(
+        std::bind(&WebSocketServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(
+        std::bind(&WebSocketServer::onMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+WebSocketServer::~WebSocketServer() = default;
+
+void WebSocketServer::start()
+{
+    if (compression_ && !PerMessageDeflate::available())
+    {
+        LOG_ERROR("WebSocketServer[%s] built without zlib, permessage-deflate disabled\n", server_.name().c_str());
+        compression_ = false;
+    }
+    LOG_INFO("WebSocketServer[%s] starts listening on %s\n", server_.name().c_str(), server_.ipPort().c_str());
+    server_.start();
+}
+
+void WebSocketServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setContext(std::make_shared<WebSocketSession>(kMaxHandshakeSize));
+    }
+    else
+    {
+        const SessionPtr *session = std::any_cast<SessionPtr>(&conn->getContext());
+        if (session && (*session)->upgraded && connectionCallback_)
+        {
+            connectionCallback_(conn);
+        }
+    }
+}
+
+void WebSocketServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    WebSocketSession *session = std::any_cast<SessionPtr>(conn->getMutableContext())->get();
+    if (!conn->connected() || session->closing)
+    {
+        buf->retrieveAll();
+        return;
+    }
+
+    if (!session->upgraded && !handleHandshake(conn, session, buf, receiveTime))
+    {
+        return;
+    }
+    handleFrames(conn, session, buf, receiveTime);
+}
+
+bool WebSocketServer::handleHandshake(const TcpConnectionPtr &conn, WebSocketSession *session, Buffer *buf, Timestamp receiveTime)
+{
+    HttpContext::ParseResult result = session->http.parseRequest(buf, receiveTime);
+    if (result == HttpContext::kIncomplete)
+    {
+        return false;
+    }
+
+    Buffer &output = outputBuffer();
+    HttpResponse response(true);
+    if (result == HttpContext::kError)
+    {
+        response.setStatusCode(session->http.errorStatus());
+    }
+    else
+    {
+        const HttpRequest &req = session->http.request();
+        std::string_view key = req.getHeader("Sec-WebSocket-Key");
+        if (!hasToken(req.getHeader("Upgrade"), "websocket"))
+        {
+            response.setStatusCode(HttpResponse::k426UpgradeRequired);
+            response.addHeader("Upgrade", "websocket");
+        }
+        else if (req.getHeader("Sec-WebSocket-Version") != "13")
+        {
+            response.setStatusCode(HttpResponse::k426UpgradeRequired);
+            response.addHeader("Sec-WebSocket-Version", "13");
+        }
+        else if (req.method() != HttpRequest::kGet || req.getVersion() != HttpRequest::kHttp11 ||
+                 !hasToken(req.getHeader("Connection"), "upgrade") || key.size() != 24)
+        {
+            response.setStatusCode(HttpResponse::k400BadRequest);
+        }
+        else if (handshakeCallback_ && !handshakeCallback_(conn, req))
+        {
+            response.setStatusCode(HttpResponse::k403Forbidden);
+        }
+        else
+        {
+            std::string input(key);
+            input.append(kWebSocketGuid);
+            unsigned char digest[20];
+            sha1(input.data(), input.size(), digest);
+
+            bool deflate = compression_ && acceptDeflateOffer(req.getHeader("Sec-WebSocket-Extensions"));
+            output.append("HTTP/1.1 101 Switching Protocols\r\n"
+                          "Upgrade: websocket\r\n"
+                          "Connection: Upgrade\r\n"
+                          "Sec-WebSocket-Accept: ");
+            output.append(base64Encode(digest, sizeof digest));
+            output.append("\r\n", 2);
+            if (deflate)
+            {
+                output.append("Sec-WebSocket-Extensions: ");
+                output.append(PerMessageDeflate::responseExtension());
+                output.append("\r\n", 2);
+            }
+            output.append("\r\n", 2);
+            conn->send(&output);
+
+            buf->retrieve(session->http.requestLength());
+            session->upgraded = true;
+            session->ws = WebSocketContext(maxMessageSize_, deflate);
+            if (connectionCallback_)
+            {
+                connectionCallback_(conn);
+            }
+            return true;
+        }
+    }
+
+    response.appendToBuffer(&output);
+    conn->send(&output);
+    buf->retrieveAll();
+    session->closing = true;
+    conn->shutdown();
+    return false;
+}
+
+void WebSocketServer::handleFrames(const TcpConnectionPtr &conn, WebSocketSession *session, Buffer *buf, Timestamp receiveTime)
+{
+    WebSocketContext &ws = session->ws;
+    Buffer &output = outputBuffer();
+
+    // 这次读事件产生的所有帧合并成一次writev
+    conn->cork();
+    while (!session->closing)
+    {
+        WebSocketContext::ParseResult result = ws.parse(buf);
+        if (result == WebSocketContext::kIncomplete)
+        {
+            break;
+        }
+        if (result == WebSocketContext::kError)
+        {
+            buf->retrieveAll();
+            closeInLoop(conn, session, ws.errorCode(), std::string_view());
+            break;
+        }
+
+        std::string_view payload = ws.payload();
+        if (result == WebSocketContext::kMessage)
+        {
+            if (messageCallback_)
+            {
+                messageCallback_(conn, payload, ws.opcode() == WebSocketContext::kBinary, receiveTime);
+            }
+        }
+        else if (ws.opcode() == WebSocketContext::kPing)
+        {
+            WebSocketContext::appendFrame(&output, WebSocketContext::kPong, payload.data(), payload.size());
+            conn->send(&output);
+        }
+        else if (ws.opcode() == WebSocketContext::kClose)
+        {
+            // 回应对方的关闭码，没有关闭码时回应1000
+            CloseCode code = WebSocketContext::kNormalClosure;
+            if (payload.size() == 1)
+            {
+                code = WebSocketContext::kProtocolError;
+            }
+            else if (payload.size() >= 2)
+            {
+                uint16_t be16;
+                ::memcpy(&be16, payload.data(), 2);
+                uint16_t received = be16toh(be16);
+                if (!validCloseCode(received))
+                {
+                    code = WebSocketContext::kProtocolError;
+                }
+                else if (!WebSocketKernels::validateUtf8(payload.data() + 2, payload.size() - 2))
+                {
+                    code = WebSocketContext::kInvalidPayload;
+                }
+                else
+                {
+                    code = static_cast<CloseCode>(received);
+                }
+            }
+            buf->retrieveAll();
+            closeInLoop(conn, session, code, std::string_view());
+            break;
+        }
+        ws.consume(buf);
+    }
+    conn->uncork();
+}
+
+void WebSocketServer::send(const TcpConnectionPtr &conn, std::string_view message, bool binary)
+{
+    EventLoop *loop = conn->getLoop();
+    if (loop->isInLoopThread())
+    {
+        sendInLoop(conn, message, binary);
+    }
+    else
+    {
+        loop->queueInLoop([this, conn, data = std::string(message), binary]() {
+            sendInLoop(conn, data, binary);
+        });
+    }
+}
+
+void WebSocketServer::sendInLoop(const TcpConnectionPtr &conn, std::string_view message, bool binary)
+{
+    const SessionPtr *session = std::any_cast<SessionPtr>(&conn->getContext());
+    if (!conn->connected() || !session || !(*session)->upgraded || (*session)->closing)
+    {
+        return;
+    }
+
+    Buffer &output = outputBuffer();
+    Opcode opcode = binary ? WebSocketContext::kBinary : WebSocketContext::kText;
+    if ((*session)->ws.deflate() && message.size() >= minCompressSize_)
+    {
+        static thread_local std::string compressed;
+        compressed.clear();
+        if (PerMessageDeflate::compress(message.data(), message.size(), &compressed) && compressed.size() < message.size())
+        {
+            WebSocketContext::appendFrame(&output, opcode, compressed.data(), compressed.size(), true);
+            conn->send(&output);
+            return;
+        }
+    }
+    WebSocketContext::appendFrame(&output, opcode, message.data(), message.size());
+    conn->send(&output);
+}
+
+void WebSocketServer::close(const TcpConnectionPtr &conn, CloseCode code, std::string_view reason)
+{
+    conn->getLoop()->runInLoop([this, conn, code, reason = std::string(reason)]() {
+        SessionPtr *session = std::any_cast<SessionPtr>(conn->getMutableContext());
+        if (session && (*session)->upgraded)
+        {
+            closeInLoop(conn, session->get(), code, reason);
+        }
+    });
+}
+
+void WebSocketServer::closeInLoop(const TcpConnectionPtr &conn, WebSocketSession *session, CloseCode code, std::string_view reason)
+{
+    if (session->closing)
+    {
+        return;
+    }
+    session->closing = true;
+
+    char payload[125];
+    uint16_t be16 = htobe16(static_cast<uint16_t>(code));
+    ::memcpy(payload, &be16, 2);
+    size_t len = 2 + std::min(reason.size(), sizeof payload - 2);
+    ::memcpy(payload + 2, reason.data(), len - 2);
+
+    Buffer &output = outputBuffer();
+    WebSocketContext::appendFrame(&output, WebSocketContext::kClose, payload, len);
+    conn->send(&output);
+    conn->shutdown();
+}
@@ -0,0 +1,47 @@
+#include "BinaryLogger.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * 把BinaryLogger写出的二进制日志还原成文本，输出到标准输出
+ * ./blogdecode [-s] file...
+ *   -s 按时间排序所有线程的记录，默认按文件中的顺序（每个线程内有序）
+ * 滚动出来的多个文件可以按顺序依次给出，每个文件都带有完整的格式串字典
+ */
+int main(int argc, char *argv[])
+{
+    bool sortByTime = false;
+    int first = 1;
+    if (argc > 1 && ::strcmp(argv[1], "-s") == 0)
+    {
+        sortByTime = true;
+        first = 2;
+    }
+    if (first >= argc)
+    {
+        fprintf(stderr, "usage: %s [-s] file...\n", argv[0]);
+        return 1;
+    }
+
+    int status = 0;
+    for (int i = first; i < argc; ++i)
+    {
+        FILE *in = ::fopen(argv[i], "rb");
+        if (in == nullptr)
+        {
+            fprintf(stderr, "blogdecode: cannot open %s: %s\n", argv[i], strerror(errno));
+            status = 1;
+            continue;
+        }
+        long n = BinaryLogger::decode(in, stdout, sortByTime);
+        ::fclose(in);
+        if (n < 0)
+        {
+            fprintf(stderr, "blogdecode: %s is not a valid binary log or is truncated\n", argv[i]);
+            status = 1;
+        }
+    }
+    return status;
+}